@@ -55,6 +55,8 @@ struct daemonClientPrivate {
     size_t ndomainEventCallbacks;
     daemonClientEventCallbackPtr *networkEventCallbacks;
     size_t nnetworkEventCallbacks;
+    daemonClientEventCallbackPtr *storagePoolEventCallbacks;
+    size_t nstoragePoolEventCallbacks;
 
 # if WITH_SASL
     virNetSASLSessionPtr sasl;
@@ -68,6 +70,7 @@ struct daemonClientPrivate {
 
     daemonClientStreamPtr streams;
     bool keepalive_supported;
+    bool largeStream;           /* client takes large stream packets */
 };
 
 # if WITH_SASL
@@ -1,4 +1,4 @@
-/* Automatically generated from ../src/remote/lxc_protocol.x by gendispatch.pl.
+/* Automatically generated from ../../src/remote/lxc_protocol.x by gendispatch.pl.
  * Do not edit this file.  Any changes you make will be lost.
  */
 static int lxcDispatchDomainOpenNamespace(
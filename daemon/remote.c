@@ -52,6 +52,7 @@
 #include "object_event.h"
 #include "domain_conf.h"
 #include "network_conf.h"
+#include "storage_conf.h"
 #include "viraccessapicheck.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
@@ -187,6 +188,34 @@ cleanup:
 }
 
 
+static bool
+remoteRelayStoragePoolEventCheckACL(virNetServerClientPtr client,
+                                    virConnectPtr conn,
+                                    virStoragePoolPtr pool)
+{
+    virStoragePoolDef def;
+    virIdentityPtr identity = NULL;
+    bool ret = false;
+
+    /* Same trick as for networks: just enough of a virStoragePoolDef
+     * to satisfy what viraccessdriverpolkit.c references */
+    memset(&def, 0, sizeof(def));
+    def.name = pool->name;
+    memcpy(def.uuid, pool->uuid, VIR_UUID_BUFLEN);
+
+    if (!(identity = virNetServerClientGetIdentity(client)))
+        goto cleanup;
+    if (virIdentitySetCurrent(identity) < 0)
+        goto cleanup;
+    ret = virConnectStoragePoolEventRegisterAnyCheckACL(conn, &def);
+
+cleanup:
+    ignore_value(virIdentitySetCurrent(NULL));
+    virObjectUnref(identity);
+    return ret;
+}
+
+
 static int
 remoteRelayDomainEventLifecycle(virConnectPtr conn,
                                 virDomainPtr dom,
@@ -959,6 +988,56 @@ static virConnectNetworkEventGenericCallback networkEventCallbacks[] = {
 
 verify(ARRAY_CARDINALITY(networkEventCallbacks) == VIR_NETWORK_EVENT_ID_LAST);
 
+static int
+remoteRelayStoragePoolEventJobCompleted(virConnectPtr conn,
+                                        virStoragePoolPtr pool,
+                                        const char *vol,
+                                        unsigned int job,
+                                        int type,
+                                        int state,
+                                        void *opaque)
+{
+    daemonClientEventCallbackPtr callback = opaque;
+    remote_storage_pool_event_job_completed_msg data;
+    char *volname = NULL;
+
+    if (callback->callbackID < 0 ||
+        !remoteRelayStoragePoolEventCheckACL(callback->client, conn, pool))
+        return -1;
+
+    VIR_DEBUG("Relaying storage job %u completion, state %d, callback %d",
+              job, state, callback->callbackID);
+
+    /* build return data */
+    memset(&data, 0, sizeof(data));
+    if (vol) {
+        if (VIR_ALLOC(data.vol) < 0 ||
+            VIR_STRDUP(volname, vol) < 0) {
+            VIR_FREE(data.vol);
+            return -1;
+        }
+        *data.vol = volname;
+    }
+    make_nonnull_storage_pool(&data.pool, pool);
+    data.callbackID = callback->callbackID;
+    data.job = job;
+    data.type = type;
+    data.state = state;
+
+    remoteDispatchObjectEventSend(callback->client, remoteProgram,
+                                  REMOTE_PROC_STORAGE_POOL_EVENT_JOB_COMPLETED,
+                                  (xdrproc_t)xdr_remote_storage_pool_event_job_completed_msg,
+                                  &data);
+
+    return 0;
+}
+
+static virConnectStoragePoolEventGenericCallback storagePoolEventCallbacks[] = {
+    VIR_STORAGE_POOL_EVENT_CALLBACK(remoteRelayStoragePoolEventJobCompleted),
+};
+
+verify(ARRAY_CARDINALITY(storagePoolEventCallbacks) == VIR_STORAGE_POOL_EVENT_ID_LAST);
+
 /*
  * You must hold lock for at least the client
  * We don't free stuff here, merely disconnect the client's
@@ -1006,6 +1085,21 @@ void remoteClientFreeFunc(void *data)
         }
         VIR_FREE(priv->networkEventCallbacks);
 
+        for (i = 0; i < priv->nstoragePoolEventCallbacks; i++) {
+            int callbackID = priv->storagePoolEventCallbacks[i]->callbackID;
+            if (callbackID < 0) {
+                VIR_WARN("unexpected incomplete storage pool callback %zu", i);
+                continue;
+            }
+            VIR_DEBUG("Deregistering remote storage pool event relay %d",
+                      callbackID);
+            priv->storagePoolEventCallbacks[i]->callbackID = -1;
+            if (virConnectStoragePoolEventDeregisterAny(priv->conn,
+                                                        callbackID) < 0)
+                VIR_WARN("unexpected storage pool event deregister failure");
+        }
+        VIR_FREE(priv->storagePoolEventCallbacks);
+
         virConnectClose(priv->conn);
 
         virIdentitySetCurrent(NULL);
@@ -3520,7 +3614,7 @@ remoteDispatchObjectEventSend(virNetServerClientPtr client,
 {
     virNetMessagePtr msg;
 
-    if (!(msg = virNetMessageNew(false)))
+    if (!(msg = virNetServerClientNewMessage(client)))
         goto cleanup;
 
     msg->header.prog = virNetServerProgramGetID(program);
@@ -4195,6 +4289,16 @@ static int remoteDispatchConnectSupportsFeature(virNetServerPtr server ATTRIBUTE
         goto done;
     }
 
+    /* Asking for large stream packets tells us the client can
+     * deal with them too, so use them from now on */
+    if (args->feature == VIR_DRV_FEATURE_PROGRAM_LARGE_STREAM) {
+        virMutexLock(&priv->lock);
+        priv->largeStream = true;
+        virMutexUnlock(&priv->lock);
+        supported = 1;
+        goto done;
+    }
+
     if (!priv->conn) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
         goto cleanup;
@@ -5863,6 +5967,279 @@ cleanup:
 }
 
 
+static int
+remoteDispatchConnectStoragePoolEventRegisterAny(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                                 virNetServerClientPtr client,
+                                                 virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                                 virNetMessageErrorPtr rerr ATTRIBUTE_UNUSED,
+                                                 remote_connect_storage_pool_event_register_any_args *args,
+                                                 remote_connect_storage_pool_event_register_any_ret *ret)
+{
+    int callbackID;
+    int rv = -1;
+    daemonClientEventCallbackPtr callback = NULL;
+    daemonClientEventCallbackPtr ref;
+    struct daemonClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+    virStoragePoolPtr pool = NULL;
+
+    if (!priv->conn) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
+        goto cleanup;
+    }
+
+    virMutexLock(&priv->lock);
+
+    if (args->pool &&
+        !(pool = get_nonnull_storage_pool(priv->conn, *args->pool)))
+        goto cleanup;
+
+    if (args->eventID >= VIR_STORAGE_POOL_EVENT_ID_LAST || args->eventID < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unsupported storage pool event ID %d"),
+                       args->eventID);
+        goto cleanup;
+    }
+
+    /* See remoteDispatchConnectNetworkEventRegisterAny for why the
+     * incomplete callback is appended before registering */
+    if (VIR_ALLOC(callback) < 0)
+        goto cleanup;
+    callback->client = client;
+    callback->eventID = args->eventID;
+    callback->callbackID = -1;
+    ref = callback;
+    if (VIR_APPEND_ELEMENT(priv->storagePoolEventCallbacks,
+                           priv->nstoragePoolEventCallbacks,
+                           callback) < 0)
+        goto cleanup;
+
+    if ((callbackID = virConnectStoragePoolEventRegisterAny(priv->conn,
+                                                            pool,
+                                                            args->eventID,
+                                                            storagePoolEventCallbacks[args->eventID],
+                                                            ref,
+                                                            remoteEventCallbackFree)) < 0) {
+        VIR_SHRINK_N(priv->storagePoolEventCallbacks,
+                     priv->nstoragePoolEventCallbacks, 1);
+        callback = ref;
+        goto cleanup;
+    }
+
+    ref->callbackID = callbackID;
+    ret->callbackID = callbackID;
+
+    rv = 0;
+
+cleanup:
+    VIR_FREE(callback);
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    if (pool)
+        virStoragePoolFree(pool);
+    virMutexUnlock(&priv->lock);
+    return rv;
+}
+
+
+static int
+remoteDispatchConnectStoragePoolEventDeregisterAny(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                                   virNetServerClientPtr client,
+                                                   virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                                   virNetMessageErrorPtr rerr ATTRIBUTE_UNUSED,
+                                                   remote_connect_storage_pool_event_deregister_any_args *args)
+{
+    int rv = -1;
+    size_t i;
+    struct daemonClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+
+    if (!priv->conn) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
+        goto cleanup;
+    }
+
+    virMutexLock(&priv->lock);
+
+    for (i = 0; i < priv->nstoragePoolEventCallbacks; i++) {
+        if (priv->storagePoolEventCallbacks[i]->callbackID == args->callbackID)
+            break;
+    }
+    if (i == priv->nstoragePoolEventCallbacks) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("storage pool event callback %d not registered"),
+                       args->callbackID);
+        goto cleanup;
+    }
+
+    if (virConnectStoragePoolEventDeregisterAny(priv->conn,
+                                                args->callbackID) < 0)
+        goto cleanup;
+
+    VIR_DELETE_ELEMENT(priv->storagePoolEventCallbacks, i,
+                       priv->nstoragePoolEventCallbacks);
+
+    rv = 0;
+
+cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virMutexUnlock(&priv->lock);
+    return rv;
+}
+
+
+static int
+remoteDispatchStorageVolGetJobStats(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                    virNetServerClientPtr client,
+                                    virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                    virNetMessageErrorPtr rerr,
+                                    remote_storage_vol_get_job_stats_args *args,
+                                    remote_storage_vol_get_job_stats_ret *ret)
+{
+    virStorageVolPtr vol = NULL;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    int rv = -1;
+    struct daemonClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+
+    if (!priv->conn) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
+        goto cleanup;
+    }
+
+    if (!(vol = get_nonnull_storage_vol(priv->conn, args->vol)))
+        goto cleanup;
+
+    if (virStorageVolGetJobStats(vol, &ret->type, &params,
+                                 &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (nparams > REMOTE_STORAGE_VOL_JOB_STATS_MAX) {
+        virReportError(VIR_ERR_RPC,
+                       _("Too many job stats '%d' for limit '%d'"),
+                       nparams, REMOTE_STORAGE_VOL_JOB_STATS_MAX);
+        goto cleanup;
+    }
+
+    if (remoteSerializeTypedParameters(params, nparams,
+                                       &ret->params.params_val,
+                                       &ret->params.params_len,
+                                       0) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virTypedParamsFree(params, nparams);
+    if (vol)
+        virStorageVolFree(vol);
+    return rv;
+}
+
+
+static int
+remoteDispatchConnectGetAllDomainStats(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                       virNetServerClientPtr client,
+                                       virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                       virNetMessageErrorPtr rerr,
+                                       remote_connect_get_all_domain_stats_args *args,
+                                       remote_connect_get_all_domain_stats_ret *ret)
+{
+    int rv = -1;
+    size_t i;
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+    virDomainStatsRecordPtr *retStats = NULL;
+    int nrecords = 0;
+    virDomainPtr *doms = NULL;
+
+    if (!priv->conn) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
+        goto cleanup;
+    }
+
+    if (args->doms.doms_len) {
+        if (VIR_ALLOC_N(doms, args->doms.doms_len + 1) < 0)
+            goto cleanup;
+
+        for (i = 0; i < args->doms.doms_len; i++) {
+            if (!(doms[i] = get_nonnull_domain(priv->conn, args->doms.doms_val[i])))
+                goto cleanup;
+        }
+
+        if ((nrecords = virDomainListGetStats(doms,
+                                              args->stats,
+                                              &retStats,
+                                              args->flags)) < 0)
+            goto cleanup;
+    } else {
+        if ((nrecords = virConnectGetAllDomainStats(priv->conn,
+                                                    args->stats,
+                                                    &retStats,
+                                                    args->flags)) < 0)
+            goto cleanup;
+    }
+
+    if (nrecords > REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX) {
+        virReportError(VIR_ERR_RPC,
+                       _("Too many domain stats records '%d' for limit '%d'"),
+                       nrecords, REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX);
+        goto cleanup;
+    }
+
+    if (nrecords) {
+        if (VIR_ALLOC_N(ret->retStats.retStats_val, nrecords) < 0)
+            goto cleanup;
+
+        ret->retStats.retStats_len = nrecords;
+
+        for (i = 0; i < nrecords; i++) {
+            remote_domain_stats_record *dst = ret->retStats.retStats_val + i;
+
+            make_nonnull_domain(&dst->dom, retStats[i]->dom);
+
+            if (retStats[i]->nparams > REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX) {
+                virReportError(VIR_ERR_RPC,
+                               _("Too many domain stats '%d' for limit '%d'"),
+                               retStats[i]->nparams,
+                               REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX);
+                goto cleanup;
+            }
+
+            if (remoteSerializeTypedParameters(retStats[i]->params,
+                                               retStats[i]->nparams,
+                                               &dst->params.params_val,
+                                               &dst->params.params_len,
+                                               VIR_TYPED_PARAM_STRING_OKAY) < 0)
+                goto cleanup;
+        }
+    } else {
+        ret->retStats.retStats_len = 0;
+        ret->retStats.retStats_val = NULL;
+    }
+
+    rv = 0;
+
+cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    if (doms) {
+        for (i = 0; i < args->doms.doms_len; i++) {
+            if (doms[i])
+                virDomainFree(doms[i]);
+        }
+        VIR_FREE(doms);
+    }
+
+    virDomainStatsRecordListFree(retStats);
+    return rv;
+}
+
+
 /*----- Helpers. -----*/
 
 /* get_nonnull_domain and get_nonnull_network turn an on-wire
@@ -1,4 +1,4 @@
-/* Automatically generated from ../src/remote/remote_protocol.x by gendispatch.pl.
+/* Automatically generated from ../../src/remote/remote_protocol.x by gendispatch.pl.
  * Do not edit this file.  Any changes you make will be lost.
  */
 static int remoteDispatchAuthList(
@@ -508,6 +508,28 @@ cleanup:
 
 
 
+static int remoteDispatchConnectGetAllDomainStats(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    remote_connect_get_all_domain_stats_args *args,
+    remote_connect_get_all_domain_stats_ret *ret);
+static int remoteDispatchConnectGetAllDomainStatsHelper(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    void *args,
+    void *ret)
+{
+  VIR_DEBUG("server=%p client=%p msg=%p rerr=%p args=%p ret=%p", server, client, msg, rerr, args, ret);
+  return remoteDispatchConnectGetAllDomainStats(server, client, msg, rerr, args, ret);
+}
+/* remoteDispatchConnectGetAllDomainStats body has to be implemented manually */
+
+
+
 static int remoteDispatchConnectGetCapabilities(
     virNetServerPtr server,
     virNetServerClientPtr client,
@@ -2290,6 +2312,49 @@ static int remoteDispatchConnectOpenHelper(
 
 
 
+static int remoteDispatchConnectStoragePoolEventDeregisterAny(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    remote_connect_storage_pool_event_deregister_any_args *args);
+static int remoteDispatchConnectStoragePoolEventDeregisterAnyHelper(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    void *args,
+    void *ret ATTRIBUTE_UNUSED)
+{
+  VIR_DEBUG("server=%p client=%p msg=%p rerr=%p args=%p ret=%p", server, client, msg, rerr, args, ret);
+  return remoteDispatchConnectStoragePoolEventDeregisterAny(server, client, msg, rerr, args);
+}
+/* remoteDispatchConnectStoragePoolEventDeregisterAny body has to be implemented manually */
+
+
+
+static int remoteDispatchConnectStoragePoolEventRegisterAny(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    remote_connect_storage_pool_event_register_any_args *args,
+    remote_connect_storage_pool_event_register_any_ret *ret);
+static int remoteDispatchConnectStoragePoolEventRegisterAnyHelper(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    void *args,
+    void *ret)
+{
+  VIR_DEBUG("server=%p client=%p msg=%p rerr=%p args=%p ret=%p", server, client, msg, rerr, args, ret);
+  return remoteDispatchConnectStoragePoolEventRegisterAny(server, client, msg, rerr, args, ret);
+}
+/* remoteDispatchConnectStoragePoolEventRegisterAny body has to be implemented manually */
+
+
+
 static int remoteDispatchConnectSupportsFeature(
     virNetServerPtr server,
     virNetServerClientPtr client,
@@ -13279,6 +13344,58 @@ cleanup:
 
 
 
+static int remoteDispatchStorageVolAbortJob(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    remote_storage_vol_abort_job_args *args);
+static int remoteDispatchStorageVolAbortJobHelper(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    void *args,
+    void *ret ATTRIBUTE_UNUSED)
+{
+  VIR_DEBUG("server=%p client=%p msg=%p rerr=%p args=%p ret=%p", server, client, msg, rerr, args, ret);
+  return remoteDispatchStorageVolAbortJob(server, client, msg, rerr, args);
+}
+static int remoteDispatchStorageVolAbortJob(
+    virNetServerPtr server ATTRIBUTE_UNUSED,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg ATTRIBUTE_UNUSED,
+    virNetMessageErrorPtr rerr,
+    remote_storage_vol_abort_job_args *args)
+{
+    int rv = -1;
+    virStorageVolPtr vol = NULL;
+    struct daemonClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+
+    if (!priv->conn) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
+        goto cleanup;
+    }
+
+    if (!(vol = get_nonnull_storage_vol(priv->conn, args->vol)))
+        goto cleanup;
+
+    if (virStorageVolAbortJob(vol, args->flags) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    if (vol)
+        virStorageVolFree(vol);
+    return rv;
+}
+
+
+
 static int remoteDispatchStorageVolCreateXML(
     virNetServerPtr server,
     virNetServerClientPtr client,
@@ -13581,6 +13698,28 @@ cleanup:
 
 
 
+static int remoteDispatchStorageVolGetJobStats(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    remote_storage_vol_get_job_stats_args *args,
+    remote_storage_vol_get_job_stats_ret *ret);
+static int remoteDispatchStorageVolGetJobStatsHelper(
+    virNetServerPtr server,
+    virNetServerClientPtr client,
+    virNetMessagePtr msg,
+    virNetMessageErrorPtr rerr,
+    void *args,
+    void *ret)
+{
+  VIR_DEBUG("server=%p client=%p msg=%p rerr=%p args=%p ret=%p", server, client, msg, rerr, args, ret);
+  return remoteDispatchStorageVolGetJobStats(server, client, msg, rerr, args, ret);
+}
+/* remoteDispatchStorageVolGetJobStats body has to be implemented manually */
+
+
+
 static int remoteDispatchStorageVolGetPath(
     virNetServerPtr server,
     virNetServerClientPtr client,
@@ -17088,5 +17227,59 @@ virNetServerProgramProc remoteProcs[] = {
    true,
    0
 },
+{ /* Method StorageVolGetJobStats => 334 */
+   remoteDispatchStorageVolGetJobStatsHelper,
+   sizeof(remote_storage_vol_get_job_stats_args),
+   (xdrproc_t)xdr_remote_storage_vol_get_job_stats_args,
+   sizeof(remote_storage_vol_get_job_stats_ret),
+   (xdrproc_t)xdr_remote_storage_vol_get_job_stats_ret,
+   true,
+   0
+},
+{ /* Method StorageVolAbortJob => 335 */
+   remoteDispatchStorageVolAbortJobHelper,
+   sizeof(remote_storage_vol_abort_job_args),
+   (xdrproc_t)xdr_remote_storage_vol_abort_job_args,
+   0,
+   (xdrproc_t)xdr_void,
+   true,
+   0
+},
+{ /* Method ConnectStoragePoolEventRegisterAny => 336 */
+   remoteDispatchConnectStoragePoolEventRegisterAnyHelper,
+   sizeof(remote_connect_storage_pool_event_register_any_args),
+   (xdrproc_t)xdr_remote_connect_storage_pool_event_register_any_args,
+   sizeof(remote_connect_storage_pool_event_register_any_ret),
+   (xdrproc_t)xdr_remote_connect_storage_pool_event_register_any_ret,
+   true,
+   1
+},
+{ /* Method ConnectStoragePoolEventDeregisterAny => 337 */
+   remoteDispatchConnectStoragePoolEventDeregisterAnyHelper,
+   sizeof(remote_connect_storage_pool_event_deregister_any_args),
+   (xdrproc_t)xdr_remote_connect_storage_pool_event_deregister_any_args,
+   0,
+   (xdrproc_t)xdr_void,
+   true,
+   1
+},
+{ /* Async event StoragePoolEventJobCompleted => 338 */
+   NULL,
+   0,
+   (xdrproc_t)xdr_void,
+   0,
+   (xdrproc_t)xdr_void,
+   true,
+   0
+},
+{ /* Method ConnectGetAllDomainStats => 339 */
+   remoteDispatchConnectGetAllDomainStatsHelper,
+   sizeof(remote_connect_get_all_domain_stats_args),
+   (xdrproc_t)xdr_remote_connect_get_all_domain_stats_args,
+   sizeof(remote_connect_get_all_domain_stats_ret),
+   (xdrproc_t)xdr_remote_connect_get_all_domain_stats_ret,
+   true,
+   0
+},
 };
 size_t remoteNProcs = ARRAY_CARDINALITY(remoteProcs);
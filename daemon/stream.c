@@ -25,10 +25,13 @@
 
 #include "stream.h"
 #include "remote.h"
+#include "libvirt_internal.h"
 #include "viralloc.h"
 #include "virlog.h"
 #include "virnetserverclient.h"
 #include "virerror.h"
+#include "fdstream.h"
+#include "virfile.h"
 
 #define VIR_FROM_THIS VIR_FROM_STREAMS
 
@@ -50,6 +53,10 @@ struct daemonClientStream {
     virNetMessagePtr rx;
     int tx;
 
+    /* Reused for every chunk read off the stream */
+    char *buffer;
+    size_t bufferLen;
+
     daemonClientStreamPtr next;
 };
 
@@ -197,7 +204,7 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
         events &= ~(VIR_STREAM_EVENT_HANGUP);
         stream->tx = 0;
         stream->recvEOF = 1;
-        if (!(msg = virNetMessageNew(false))) {
+        if (!(msg = virNetServerClientNewMessage(client))) {
             daemonRemoveClientStream(client, stream);
             virNetServerClientClose(client);
             goto cleanup;
@@ -235,7 +242,7 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
             virReportError(VIR_ERR_RPC,
                            "%s", _("stream had I/O failure"));
 
-        msg = virNetMessageNew(false);
+        msg = virNetServerClientNewMessage(client);
         if (!msg) {
             ret = -1;
         } else {
@@ -281,7 +288,8 @@ daemonStreamFilter(virNetServerClientPtr client ATTRIBUTE_UNUSED,
 
     virMutexLock(&stream->priv->lock);
 
-    if (msg->header.type != VIR_NET_STREAM)
+    if (msg->header.type != VIR_NET_STREAM &&
+        msg->header.type != VIR_NET_STREAM_HOLE)
         goto cleanup;
 
     if (!virNetServerProgramMatches(stream->prog, msg))
@@ -382,6 +390,7 @@ int daemonFreeClientStream(virNetServerClientPtr client,
     }
 
     virStreamFree(stream->st);
+    VIR_FREE(stream->buffer);
     VIR_FREE(stream);
 
     return ret;
@@ -548,6 +557,49 @@ daemonStreamHandleWriteData(virNetServerClientPtr client,
 }
 
 
+/*
+ * Process a hole in the data sent by the client, which only
+ * needs to be recreated in the stream target
+ *
+ * Returns 0 if the hole was processed, or a VIR_NET_ERROR was sent,
+ * -1 upon fatal error
+ */
+static int
+daemonStreamHandleHole(virNetServerClientPtr client,
+                       daemonClientStream *stream,
+                       virNetMessagePtr msg)
+{
+    virNetStreamHole data;
+    int ret;
+
+    VIR_DEBUG("client=%p, stream=%p, proc=%d, serial=%d",
+              client, stream, msg->header.proc, msg->header.serial);
+
+    memset(&data, 0, sizeof(data));
+
+    ret = virNetMessageDecodePayload(msg, (xdrproc_t) xdr_virNetStreamHole,
+                                     &data);
+    if (ret == 0)
+        ret = virStreamSendHole(stream->st, data.length, data.flags);
+
+    if (ret < 0) {
+        virNetMessageError rerr;
+
+        memset(&rerr, 0, sizeof(rerr));
+
+        VIR_INFO("Stream send hole failed");
+        stream->closed = 1;
+        return virNetServerProgramSendReplyError(stream->prog,
+                                                 client,
+                                                 msg,
+                                                 &rerr,
+                                                 &msg->header);
+    }
+
+    return 0;
+}
+
+
 /*
  * Process a finish handshake from the client.
  *
@@ -652,7 +704,10 @@ daemonStreamHandleWrite(virNetServerClientPtr client,
             break;
 
         case VIR_NET_CONTINUE:
-            ret = daemonStreamHandleWriteData(client, stream, msg);
+            if (msg->header.type == VIR_NET_STREAM_HOLE)
+                ret = daemonStreamHandleHole(client, stream, msg);
+            else
+                ret = daemonStreamHandleWriteData(client, stream, msg);
             break;
 
         case VIR_NET_ERROR:
@@ -707,8 +762,10 @@ static int
 daemonStreamHandleRead(virNetServerClientPtr client,
                        daemonClientStream *stream)
 {
-    char *buffer;
     size_t bufferLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    int inData = 1;
+    long long length = 0;
+    int fd = -1;
     int ret;
 
     VIR_DEBUG("client=%p, stream=%p tx=%d closed=%d",
@@ -726,10 +783,66 @@ daemonStreamHandleRead(virNetServerClientPtr client,
     if (!stream->tx)
         return 0;
 
-    if (VIR_ALLOC_N(buffer, bufferLen) < 0)
-        return -1;
+    if (stream->priv->largeStream)
+        bufferLen = VIR_NET_MESSAGE_LARGE_STREAM_PAYLOAD_MAX;
+
+    /* Sparse streams tell where their holes are, which are then
+     * announced to the client instead of reading out zeros */
+    if ((ret = virStreamInData(stream->st, &inData, &length)) == 0 &&
+        !inData && length)
+        ret = virStreamRecvHole(stream->st, &length, 0);
+
+    if (ret == 0 && !inData && length) {
+        virNetMessagePtr msg;
+        stream->tx = 0;
+        if (!(msg = virNetServerClientNewMessage(client))) {
+            ret = -1;
+        } else {
+            msg->cb = daemonStreamMessageFinished;
+            msg->opaque = stream;
+            stream->refs++;
+            ret = virNetServerProgramSendStreamHole(remoteProgram,
+                                                    client,
+                                                    msg,
+                                                    stream->procedure,
+                                                    stream->serial,
+                                                    length, 0);
+        }
+        return ret;
+    }
+
+    /* Data waiting in a pipe can go straight to the socket, as
+     * long as the connection does not encrypt it */
+    if (ret == 0 && virNetServerClientCanSplice(client) &&
+        (ret = virFDStreamRecvSplice(stream->st, bufferLen, &fd)) > 0) {
+        virNetMessagePtr msg;
+        stream->tx = 0;
+        if (!(msg = virNetServerClientNewMessage(client))) {
+            ret = -1;
+        } else {
+            msg->cb = daemonStreamMessageFinished;
+            msg->opaque = stream;
+            stream->refs++;
+            ret = virNetServerProgramSendStreamSplice(remoteProgram,
+                                                      client,
+                                                      msg,
+                                                      stream->procedure,
+                                                      stream->serial,
+                                                      fd, ret);
+            fd = -1;
+        }
+        VIR_FORCE_CLOSE(fd);
+        return ret;
+    }
+
+    if (ret == 0 && !stream->buffer) {
+        if (VIR_ALLOC_N(stream->buffer, bufferLen) < 0)
+            return -1;
+        stream->bufferLen = bufferLen;
+    }
 
-    ret = virStreamRecv(stream->st, buffer, bufferLen);
+    if (ret == 0)
+        ret = virStreamRecv(stream->st, stream->buffer, stream->bufferLen);
     if (ret == -2) {
         /* Should never get this, since we're only called when we know
          * we're readable, but hey things change... */
@@ -740,7 +853,7 @@ daemonStreamHandleRead(virNetServerClientPtr client,
 
         memset(&rerr, 0, sizeof(rerr));
 
-        if (!(msg = virNetMessageNew(false)))
+        if (!(msg = virNetServerClientNewMessage(client)))
             ret = -1;
         else
             ret = virNetServerProgramSendStreamError(remoteProgram,
@@ -754,7 +867,7 @@ daemonStreamHandleRead(virNetServerClientPtr client,
         stream->tx = 0;
         if (ret == 0)
             stream->recvEOF = 1;
-        if (!(msg = virNetMessageNew(false)))
+        if (!(msg = virNetServerClientNewMessage(client)))
             ret = -1;
 
         if (msg) {
@@ -766,10 +879,9 @@ daemonStreamHandleRead(virNetServerClientPtr client,
                                                     msg,
                                                     stream->procedure,
                                                     stream->serial,
-                                                    buffer, ret);
+                                                    stream->buffer, ret);
         }
     }
 
-    VIR_FREE(buffer);
     return ret;
 }
@@ -1,4 +1,4 @@
-/* Automatically generated from ./remote/remote_protocol.x by gendispatch.pl.
+/* Automatically generated from ../../src/remote/remote_protocol.x by gendispatch.pl.
  * Do not edit this file.  Any changes you make will be lost.
  */
 #include "internal.h"
@@ -24,6 +24,8 @@ extern bool virConnectDomainEventRegisterAnyCheckACL(virConnectPtr conn, virDoma
 extern int virConnectDomainXMLFromNativeEnsureACL(virConnectPtr conn);
 extern int virConnectDomainXMLToNativeEnsureACL(virConnectPtr conn);
 extern int virConnectFindStoragePoolSourcesEnsureACL(virConnectPtr conn);
+extern int virConnectGetAllDomainStatsEnsureACL(virConnectPtr conn);
+extern bool virConnectGetAllDomainStatsCheckACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virConnectGetCapabilitiesEnsureACL(virConnectPtr conn);
 extern int virConnectGetCPUModelNamesEnsureACL(virConnectPtr conn);
 extern int virConnectGetHostnameEnsureACL(virConnectPtr conn);
@@ -91,6 +93,9 @@ extern bool virConnectNumOfSecretsCheckACL(virConnectPtr conn, virSecretDefPtr s
 extern int virConnectNumOfStoragePoolsEnsureACL(virConnectPtr conn);
 extern bool virConnectNumOfStoragePoolsCheckACL(virConnectPtr conn, virStoragePoolDefPtr pool);
 extern int virConnectOpenEnsureACL(virConnectPtr conn);
+extern int virConnectStoragePoolEventDeregisterAnyEnsureACL(virConnectPtr conn);
+extern int virConnectStoragePoolEventRegisterAnyEnsureACL(virConnectPtr conn);
+extern bool virConnectStoragePoolEventRegisterAnyCheckACL(virConnectPtr conn, virStoragePoolDefPtr pool);
 extern int virConnectSupportsFeatureEnsureACL(virConnectPtr conn);
 extern int virDomainAbortJobEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainAttachDeviceEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
@@ -201,7 +206,7 @@ extern int virDomainRevertToSnapshotEnsureACL(virConnectPtr conn, virDomainDefPt
 extern int virDomainSaveEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSaveFlagsEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSaveImageDefineXMLEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
-extern int virDomainSaveImageGetXMLDescEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
+extern int virDomainSaveImageGetXMLDescEnsureACL(virConnectPtr conn, virDomainDefPtr domain, unsigned int flags);
 extern int virDomainScreenshotEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSendKeyEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSendProcessSignalEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
@@ -226,7 +231,7 @@ extern int virDomainSnapshotCreateXMLEnsureACL(virConnectPtr conn, virDomainDefP
 extern int virDomainSnapshotCurrentEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSnapshotDeleteEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSnapshotGetParentEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
-extern int virDomainSnapshotGetXMLDescEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
+extern int virDomainSnapshotGetXMLDescEnsureACL(virConnectPtr conn, virDomainDefPtr domain, unsigned int flags);
 extern int virDomainSnapshotHasMetadataEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSnapshotIsCurrentEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
 extern int virDomainSnapshotListAllChildrenEnsureACL(virConnectPtr conn, virDomainDefPtr domain);
@@ -325,11 +330,13 @@ extern bool virStoragePoolNumOfVolumesCheckACL(virConnectPtr conn, virStoragePoo
 extern int virStoragePoolRefreshEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool);
 extern int virStoragePoolSetAutostartEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool);
 extern int virStoragePoolUndefineEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool);
+extern int virStorageVolAbortJobEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolCreateXMLEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolCreateXMLFromEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolDeleteEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolDownloadEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolGetInfoEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
+extern int virStorageVolGetJobStatsEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolGetPathEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolGetXMLDescEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
 extern int virStorageVolLookupByKeyEnsureACL(virConnectPtr conn, virStoragePoolDefPtr pool, virStorageVolDefPtr vol);
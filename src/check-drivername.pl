@@ -50,6 +50,8 @@ while (<DRVFILE>) {
 
         next if $drv =~ /virDrvState/;
         next if $drv =~ /virDrvDomainMigrate(Prepare|Perform|Confirm|Begin|Finish)/;
+        # Internal API, used by the daemon to find holes in a stream
+        next if $drv =~ /virDrvStreamInData/;
 
         my $sym = $drv;
         $sym =~ s/virDrv/vir/;
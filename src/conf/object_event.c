@@ -32,14 +32,40 @@
 #include "datatypes.h"
 #include "viralloc.h"
 #include "virerror.h"
+#include "virhash.h"
+#include "virhashcode.h"
 #include "virstring.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+/* Key of the callback index: the event ID, and the object the
+ * callbacks filter on, if any.  Domain and network event IDs overlap,
+ * so callbacks of different classes may share an entry; the class is
+ * checked when matching.  */
+typedef struct _virObjectEventCallbackKey virObjectEventCallbackKey;
+typedef virObjectEventCallbackKey *virObjectEventCallbackKeyPtr;
+struct _virObjectEventCallbackKey {
+    int eventID;
+    bool uuid_filter;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+};
+
+/* The callbacks sharing a key, in order of registration */
+typedef struct _virObjectEventCallbackBucket virObjectEventCallbackBucket;
+typedef virObjectEventCallbackBucket *virObjectEventCallbackBucketPtr;
+struct _virObjectEventCallbackBucket {
+    size_t count;
+    virObjectEventCallbackPtr *callbacks;
+};
+
 struct _virObjectEventCallbackList {
     unsigned int nextID;
     size_t count;
     virObjectEventCallbackPtr *callbacks;
+    /* virObjectEventCallbackKey -> virObjectEventCallbackBucketPtr,
+     * so that dispatching an event only visits the callbacks
+     * registered for its event ID, globally or for its object */
+    virHashTablePtr index;
 };
 
 struct _virObjectEventQueue {
@@ -121,6 +147,168 @@ virObjectEventDispose(void *obj)
     VIR_FREE(event->meta.name);
 }
 
+static uint32_t
+virObjectEventCallbackKeyCode(const void *name, uint32_t seed)
+{
+    return virHashCodeGen(name, sizeof(virObjectEventCallbackKey), seed);
+}
+
+
+static bool
+virObjectEventCallbackKeyEqual(const void *namea, const void *nameb)
+{
+    return memcmp(namea, nameb, sizeof(virObjectEventCallbackKey)) == 0;
+}
+
+
+static void *
+virObjectEventCallbackKeyCopy(const void *name)
+{
+    virObjectEventCallbackKeyPtr key;
+
+    if (VIR_ALLOC_QUIET(key) < 0)
+        return NULL;
+
+    memcpy(key, name, sizeof(*key));
+    return key;
+}
+
+
+static void
+virObjectEventCallbackKeyFree(void *name)
+{
+    VIR_FREE(name);
+}
+
+
+static void
+virObjectEventCallbackBucketFree(void *payload,
+                                 const void *name ATTRIBUTE_UNUSED)
+{
+    virObjectEventCallbackBucketPtr bucket = payload;
+
+    VIR_FREE(bucket->callbacks);
+    VIR_FREE(bucket);
+}
+
+
+/* The key is hashed and compared as raw memory, hence the memset
+ * clearing the padding */
+static void
+virObjectEventCallbackKeyInit(virObjectEventCallbackKeyPtr key,
+                              int eventID,
+                              const unsigned char *uuid)
+{
+    memset(key, 0, sizeof(*key));
+    key->eventID = eventID;
+    if (uuid) {
+        key->uuid_filter = true;
+        memcpy(key->uuid, uuid, VIR_UUID_BUFLEN);
+    }
+}
+
+
+/**
+ * virObjectEventCallbackBucketFind:
+ * @cbList: the list
+ * @eventID: the event ID
+ * @uuid: the uuid of the object filtered on, or NULL
+ *
+ * Internal function to find the callbacks registered for @eventID
+ * which filter on the object with @uuid, or on no object at all if
+ * @uuid is NULL.
+ *
+ * Returns the callbacks, or NULL if there are none.
+ */
+static virObjectEventCallbackBucketPtr
+virObjectEventCallbackBucketFind(virObjectEventCallbackListPtr cbList,
+                                 int eventID,
+                                 const unsigned char *uuid)
+{
+    virObjectEventCallbackKey key;
+
+    virObjectEventCallbackKeyInit(&key, eventID, uuid);
+    return virHashLookup(cbList->index, &key);
+}
+
+
+static int
+virObjectEventCallbackIndexAdd(virObjectEventCallbackListPtr cbList,
+                               virObjectEventCallbackPtr cb)
+{
+    virObjectEventCallbackKey key;
+    virObjectEventCallbackBucketPtr bucket;
+
+    virObjectEventCallbackKeyInit(&key, cb->eventID,
+                                  cb->uuid_filter ? cb->uuid : NULL);
+
+    if (!(bucket = virHashLookup(cbList->index, &key))) {
+        if (VIR_ALLOC(bucket) < 0)
+            return -1;
+        if (virHashAddEntry(cbList->index, &key, bucket) < 0) {
+            VIR_FREE(bucket);
+            return -1;
+        }
+    }
+
+    if (VIR_APPEND_ELEMENT_COPY(bucket->callbacks, bucket->count, cb) < 0) {
+        if (bucket->count == 0)
+            virHashRemoveEntry(cbList->index, &key);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void
+virObjectEventCallbackIndexRemove(virObjectEventCallbackListPtr cbList,
+                                  virObjectEventCallbackPtr cb)
+{
+    virObjectEventCallbackKey key;
+    virObjectEventCallbackBucketPtr bucket;
+    size_t i;
+
+    virObjectEventCallbackKeyInit(&key, cb->eventID,
+                                  cb->uuid_filter ? cb->uuid : NULL);
+
+    if (!(bucket = virHashLookup(cbList->index, &key)))
+        return;
+
+    for (i = 0; i < bucket->count; i++) {
+        if (bucket->callbacks[i] == cb) {
+            VIR_DELETE_ELEMENT(bucket->callbacks, i, bucket->count);
+            break;
+        }
+    }
+
+    if (bucket->count == 0)
+        virHashRemoveEntry(cbList->index, &key);
+}
+
+
+static virObjectEventCallbackListPtr
+virObjectEventCallbackListNew(void)
+{
+    virObjectEventCallbackListPtr list;
+
+    if (VIR_ALLOC(list) < 0)
+        return NULL;
+
+    if (!(list->index = virHashCreateFull(32,
+                                          virObjectEventCallbackBucketFree,
+                                          virObjectEventCallbackKeyCode,
+                                          virObjectEventCallbackKeyEqual,
+                                          virObjectEventCallbackKeyCopy,
+                                          virObjectEventCallbackKeyFree))) {
+        VIR_FREE(list);
+        return NULL;
+    }
+
+    return list;
+}
+
+
 /**
  * virObjectEventCallbackListFree:
  * @list: event callback list head
@@ -141,6 +329,7 @@ virObjectEventCallbackListFree(virObjectEventCallbackListPtr list)
         VIR_FREE(list->callbacks[i]);
     }
     VIR_FREE(list->callbacks);
+    virHashFree(list->index);
     VIR_FREE(list);
 }
 
@@ -177,19 +366,27 @@ virObjectEventCallbackListCount(virConnectPtr conn,
 {
     size_t i;
     int ret = 0;
+    size_t count = cbList->count;
+    virObjectEventCallbackPtr *callbacks = cbList->callbacks;
 
-    for (i = 0; i < cbList->count; i++) {
-        virObjectEventCallbackPtr cb = cbList->callbacks[i];
+    /* Only the callbacks filtering on @uuid can count */
+    if (serverFilter) {
+        virObjectEventCallbackBucketPtr bucket;
+
+        if (!(bucket = virObjectEventCallbackBucketFind(cbList, eventID, uuid)))
+            return 0;
+        count = bucket->count;
+        callbacks = bucket->callbacks;
+    }
+
+    for (i = 0; i < count; i++) {
+        virObjectEventCallbackPtr cb = callbacks[i];
 
         if (cb->klass == klass &&
             cb->eventID == eventID &&
             cb->conn == conn &&
             !cb->deleted &&
-            (!serverFilter ||
-             (cb->remoteID >= 0 &&
-              ((uuid && cb->uuid_filter &&
-                memcmp(cb->uuid, uuid, VIR_UUID_BUFLEN) == 0) ||
-               (!uuid && !cb->uuid_filter)))))
+            (!serverFilter || cb->remoteID >= 0))
             ret++;
     }
     return ret;
@@ -221,6 +418,7 @@ virObjectEventCallbackListRemoveID(virConnectPtr conn,
                                                   cb->uuid_filter ? cb->uuid : NULL,
                                                   cb->remoteID >= 0) - 1;
 
+            virObjectEventCallbackIndexRemove(cbList, cb);
             if (cb->freecb)
                 (*cb->freecb)(cb->opaque);
             virObjectUnref(cb->conn);
@@ -271,6 +469,7 @@ virObjectEventCallbackListPurgeMarked(virObjectEventCallbackListPtr cbList)
     for (n = 0; n < cbList->count; n++) {
         if (cbList->callbacks[n]->deleted) {
             virFreeCallback freecb = cbList->callbacks[n]->freecb;
+            virObjectEventCallbackIndexRemove(cbList, cbList->callbacks[n]);
             if (freecb)
                 (*freecb)(cbList->callbacks[n]->opaque);
             virObjectUnref(cbList->callbacks[n]->conn);
@@ -322,21 +521,22 @@ virObjectEventCallbackLookup(virConnectPtr conn,
                              int *remoteID)
 {
     size_t i;
+    virObjectEventCallbackBucketPtr bucket;
 
     if (remoteID)
         *remoteID = -1;
 
-    for (i = 0; i < cbList->count; i++) {
-        virObjectEventCallbackPtr cb = cbList->callbacks[i];
+    if (!(bucket = virObjectEventCallbackBucketFind(cbList, eventID, uuid)))
+        return -1;
+
+    for (i = 0; i < bucket->count; i++) {
+        virObjectEventCallbackPtr cb = bucket->callbacks[i];
 
         if (cb->deleted)
             continue;
         if (cb->klass == klass &&
             cb->eventID == eventID &&
-            cb->conn == conn &&
-            ((uuid && cb->uuid_filter &&
-              memcmp(cb->uuid, uuid, VIR_UUID_BUFLEN) == 0) ||
-             (!uuid && !cb->uuid_filter))) {
+            cb->conn == conn) {
             if (remoteID)
                 *remoteID = cb->remoteID;
             if (cb->legacy == legacy &&
@@ -427,9 +627,14 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
     event->filter_opaque = filter_opaque;
     event->legacy = legacy;
 
-    if (VIR_APPEND_ELEMENT(cbList->callbacks, cbList->count, event) < 0)
+    if (virObjectEventCallbackIndexAdd(cbList, event) < 0)
         goto cleanup;
 
+    if (VIR_APPEND_ELEMENT(cbList->callbacks, cbList->count, event) < 0) {
+        virObjectEventCallbackIndexRemove(cbList, event);
+        goto cleanup;
+    }
+
     ret = virObjectEventCallbackListCount(conn, cbList, klass, eventID,
                                           uuid, serverFilter);
     if (serverFilter && remoteID < 0)
@@ -579,7 +784,7 @@ virObjectEventStateNew(void)
         goto error;
     }
 
-    if (VIR_ALLOC(state->callbacks) < 0)
+    if (!(state->callbacks = virObjectEventCallbackListNew()))
         goto error;
 
     if (!(state->queue = virObjectEventQueueNew()))
@@ -703,14 +908,37 @@ virObjectEventStateDispatchCallbacks(virObjectEventStatePtr state,
                                      virObjectEventPtr event,
                                      virObjectEventCallbackListPtr callbacks)
 {
-    size_t i;
+    size_t i = 0;
+    size_t j = 0;
+    virObjectEventCallbackBucketPtr global;
+    virObjectEventCallbackBucketPtr object;
+    size_t nglobal;
+    size_t nobject;
+
+    /* Only the callbacks for this event ID, either global or
+     * filtering on the object of the event, can match */
+    global = virObjectEventCallbackBucketFind(callbacks, event->eventID,
+                                              NULL);
+    object = virObjectEventCallbackBucketFind(callbacks, event->eventID,
+                                              event->meta.uuid);
+
     /* Cache this now, since we may be dropping the lock,
        and have more callbacks added. We're guaranteed not
        to have any removed */
-    size_t cbCount = callbacks->count;
-
-    for (i = 0; i < cbCount; i++) {
-        virObjectEventCallbackPtr cb = callbacks->callbacks[i];
+    nglobal = global ? global->count : 0;
+    nobject = object ? object->count : 0;
+
+    /* Callback IDs grow with each registration, so merging by ID
+     * keeps dispatching in order of registration */
+    while (i < nglobal || j < nobject) {
+        virObjectEventCallbackPtr cb;
+
+        if (j == nobject ||
+            (i < nglobal &&
+             global->callbacks[i]->callbackID < object->callbacks[j]->callbackID))
+            cb = global->callbacks[i++];
+        else
+            cb = object->callbacks[j++];
 
         if (!virObjectEventDispatchMatchCallback(event, cb))
             continue;
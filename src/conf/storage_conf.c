@@ -45,6 +45,7 @@
 #include "virfile.h"
 #include "virstring.h"
 #include "virlog.h"
+#include "virhash.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -104,6 +105,10 @@ VIR_ENUM_IMPL(virStoragePoolAuthType,
               VIR_STORAGE_POOL_AUTH_LAST,
               "none", "chap", "ceph")
 
+VIR_ENUM_IMPL(virStoragePoolRefreshMode,
+              VIR_STORAGE_POOL_REFRESH_LAST,
+              "default", "full", "incremental")
+
 typedef const char *(*virStorageVolFormatToString)(int format);
 typedef int (*virStorageVolFormatFromString)(const char *format);
 typedef const char *(*virStorageVolFeatureToString)(int feature);
@@ -452,6 +457,9 @@ virStoragePoolObjFree(virStoragePoolObjPtr obj)
 
     virStoragePoolObjClearVols(obj);
 
+    if (obj->privateDataFreeFunc)
+        (obj->privateDataFreeFunc)(obj->privateData);
+
     virStoragePoolDefFree(obj->def);
     virStoragePoolDefFree(obj->newDef);
 
@@ -459,6 +467,7 @@ virStoragePoolObjFree(virStoragePoolObjPtr obj)
     VIR_FREE(obj->autostartLink);
 
     virMutexDestroy(&obj->lock);
+    virRWLockDestroy(&obj->refreshLock);
 
     VIR_FREE(obj);
 }
@@ -471,6 +480,10 @@ virStoragePoolObjListFree(virStoragePoolObjListPtr pools)
         virStoragePoolObjFree(pools->objs[i]);
     VIR_FREE(pools->objs);
     pools->count = 0;
+    virHashFree(pools->byName);
+    virHashFree(pools->byUUID);
+    pools->byName = NULL;
+    pools->byUUID = NULL;
 }
 
 void
@@ -484,6 +497,15 @@ virStoragePoolObjRemove(virStoragePoolObjListPtr pools,
     for (i = 0; i < pools->count; i++) {
         virStoragePoolObjLock(pools->objs[i]);
         if (pools->objs[i] == pool) {
+            char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+            virUUIDFormat(pool->def->uuid, uuidstr);
+            if (virHashLookup(pools->byName, pool->def->name) == pool)
+                ignore_value(virHashRemoveEntry(pools->byName,
+                                                pool->def->name));
+            if (virHashLookup(pools->byUUID, uuidstr) == pool)
+                ignore_value(virHashRemoveEntry(pools->byUUID, uuidstr));
+
             virStoragePoolObjUnlock(pools->objs[i]);
             virStoragePoolObjFree(pools->objs[i]);
 
@@ -888,6 +910,7 @@ virStoragePoolDefParseXML(xmlXPathContextPtr ctxt)
     char *type = NULL;
     char *uuid = NULL;
     char *target_path = NULL;
+    char *refresh_mode = NULL;
 
     if (VIR_ALLOC(ret) < 0)
         return NULL;
@@ -941,6 +964,34 @@ virStoragePoolDefParseXML(xmlXPathContextPtr ctxt)
         }
     }
 
+    if (virXPathUInt("string(./refresh/@workers)", ctxt,
+                     &ret->refreshWorkers) < -1) {
+        virReportError(VIR_ERR_XML_ERROR, "%s",
+                       _("malformed refresh workers value"));
+        goto error;
+    }
+
+    if ((refresh_mode = virXPathString("string(./refresh/@mode)", ctxt))) {
+        if ((ret->refreshMode =
+             virStoragePoolRefreshModeTypeFromString(refresh_mode)) <= 0) {
+            virReportError(VIR_ERR_XML_ERROR,
+                           _("unknown refresh mode '%s'"), refresh_mode);
+            goto error;
+        }
+
+        if (ret->refreshMode == VIR_STORAGE_POOL_REFRESH_INCREMENTAL &&
+            ret->type != VIR_STORAGE_POOL_RBD &&
+            ret->type != VIR_STORAGE_POOL_GLUSTER &&
+            ret->type != VIR_STORAGE_POOL_OPENVSTORAGE &&
+            ret->type != VIR_STORAGE_POOL_OPENVSTORAGE_TCP &&
+            ret->type != VIR_STORAGE_POOL_OPENVSTORAGE_RDMA) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("incremental refresh is not supported "
+                             "by '%s' pools"), type);
+            goto error;
+        }
+    }
+
     if (options->flags & VIR_STORAGE_POOL_SOURCE_HOST) {
         if (!ret->source.nhost) {
             virReportError(VIR_ERR_XML_ERROR, "%s",
@@ -1032,6 +1083,7 @@ cleanup:
     VIR_FREE(uuid);
     VIR_FREE(type);
     VIR_FREE(target_path);
+    VIR_FREE(refresh_mode);
     return ret;
 
 error:
@@ -1242,6 +1294,16 @@ virStoragePoolDefFormat(virStoragePoolDefPtr def)
     if (virStoragePoolSourceFormat(&buf, options, &def->source) < 0)
         goto cleanup;
 
+    if (def->refreshWorkers || def->refreshMode) {
+        virBufferAddLit(&buf, "  <refresh");
+        if (def->refreshMode)
+            virBufferAsprintf(&buf, " mode='%s'",
+                              virStoragePoolRefreshModeTypeToString(def->refreshMode));
+        if (def->refreshWorkers)
+            virBufferAsprintf(&buf, " workers='%u'", def->refreshWorkers);
+        virBufferAddLit(&buf, "/>\n");
+    }
+
     /* RBD, Sheepdog, and Gluster devices are not local block devs nor
      * files, so they don't have a target */
     if (def->type != VIR_STORAGE_POOL_RBD &&
@@ -1692,32 +1754,38 @@ virStoragePoolObjPtr
 virStoragePoolObjFindByUUID(virStoragePoolObjListPtr pools,
                             const unsigned char *uuid)
 {
-    size_t i;
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    virStoragePoolObjPtr pool;
 
-    for (i = 0; i < pools->count; i++) {
-        virStoragePoolObjLock(pools->objs[i]);
-        if (!memcmp(pools->objs[i]->def->uuid, uuid, VIR_UUID_BUFLEN))
-            return pools->objs[i];
-        virStoragePoolObjUnlock(pools->objs[i]);
+    virUUIDFormat(uuid, uuidstr);
+    if (!(pool = virHashLookup(pools->byUUID, uuidstr)))
+        return NULL;
+
+    virStoragePoolObjLock(pool);
+    if (memcmp(pool->def->uuid, uuid, VIR_UUID_BUFLEN)) {
+        virStoragePoolObjUnlock(pool);
+        return NULL;
     }
 
-    return NULL;
+    return pool;
 }
 
 virStoragePoolObjPtr
 virStoragePoolObjFindByName(virStoragePoolObjListPtr pools,
                             const char *name)
 {
-    size_t i;
+    virStoragePoolObjPtr pool;
 
-    for (i = 0; i < pools->count; i++) {
-        virStoragePoolObjLock(pools->objs[i]);
-        if (STREQ(pools->objs[i]->def->name, name))
-            return pools->objs[i];
-        virStoragePoolObjUnlock(pools->objs[i]);
+    if (!(pool = virHashLookup(pools->byName, name)))
+        return NULL;
+
+    virStoragePoolObjLock(pool);
+    if (STRNEQ(pool->def->name, name)) {
+        virStoragePoolObjUnlock(pool);
+        return NULL;
     }
 
-    return NULL;
+    return pool;
 }
 
 virStoragePoolObjPtr
@@ -1736,26 +1804,424 @@ virStoragePoolSourceFindDuplicateDevices(virStoragePoolObjPtr pool,
     return NULL;
 }
 
+static int
+virStorageVolDefListIndexOne(virHashTablePtr *table,
+                             const char *str,
+                             virStorageVolDefPtr vol)
+{
+    if (!str)
+        return 0;
+
+    if (!*table && !(*table = virHashCreate(32, NULL)))
+        return -1;
+
+    /* Keep the first volume, as a linear scan would find it */
+    if (virHashLookup(*table, str))
+        return 0;
+
+    return virHashAddEntry(*table, str, vol);
+}
+
+static int
+virStorageVolDefListSearchVol(const void *payload,
+                              const void *name ATTRIBUTE_UNUSED,
+                              const void *data)
+{
+    return payload == data;
+}
+
+static void
+virStorageVolDefListUnindexOne(virHashTablePtr table,
+                               const char *str,
+                               virStorageVolDefPtr vol)
+{
+    if (str && virHashLookup(table, str) == vol) {
+        ignore_value(virHashRemoveEntry(table, str));
+        return;
+    }
+
+    /* The string changed since the volume was indexed */
+    ignore_value(virHashRemoveSet(table, virStorageVolDefListSearchVol, vol));
+}
+
+static int
+virStorageVolDefListReindexOne(virHashTablePtr *table,
+                               const char *str,
+                               virStorageVolDefPtr vol)
+{
+    /* Leave the table alone if nothing changed, so that readers of
+     * the index do not race with a refresh holding the name index */
+    if (str && virHashLookup(*table, str) == vol)
+        return 0;
+
+    virStorageVolDefListUnindexOne(*table, str, vol);
+    return virStorageVolDefListIndexOne(table, str, vol);
+}
+
+static void
+virStoragePoolObjUnindexVol(virStoragePoolObjPtr pool,
+                            virStorageVolDefPtr vol)
+{
+    virStorageVolDefListUnindexOne(pool->volumes.byName, vol->name, vol);
+    virStorageVolDefListUnindexOne(pool->volumes.byKey, vol->key, vol);
+    virStorageVolDefListUnindexOne(pool->volumes.byPath,
+                                   vol->target.path, vol);
+}
+
+static int
+virStoragePoolObjIndexVol(virStoragePoolObjPtr pool,
+                          virStorageVolDefPtr vol)
+{
+    if (virStorageVolDefListIndexOne(&pool->volumes.byName,
+                                     vol->name, vol) < 0 ||
+        virStorageVolDefListIndexOne(&pool->volumes.byKey,
+                                     vol->key, vol) < 0 ||
+        virStorageVolDefListIndexOne(&pool->volumes.byPath,
+                                     vol->target.path, vol) < 0) {
+        virStoragePoolObjUnindexVol(pool, vol);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Whether @vol is owned by @pool, rather than borrowed from the live
+ * pool @pool is a refresh shadow of */
+static bool
+virStoragePoolObjOwnsVol(virStoragePoolObjPtr pool,
+                         virStorageVolDefPtr vol)
+{
+    return !pool->origin ||
+        virStorageVolDefFindByName(pool->origin, vol->name) != vol;
+}
+
 void
 virStoragePoolObjClearVols(virStoragePoolObjPtr pool)
 {
     size_t i;
-    for (i = 0; i < pool->volumes.count; i++)
-        virStorageVolDefFree(pool->volumes.objs[i]);
+    for (i = 0; i < pool->volumes.count; i++) {
+        if (virStoragePoolObjOwnsVol(pool, pool->volumes.objs[i]))
+            virStorageVolDefFree(pool->volumes.objs[i]);
+    }
 
     VIR_FREE(pool->volumes.objs);
     pool->volumes.count = 0;
+
+    virHashFree(pool->volumes.byName);
+    virHashFree(pool->volumes.byKey);
+    virHashFree(pool->volumes.byPath);
+    pool->volumes.byName = NULL;
+    pool->volumes.byKey = NULL;
+    pool->volumes.byPath = NULL;
+}
+
+/**
+ * virStoragePoolObjAddVol:
+ * @pool: locked pool object
+ * @vol: volume to add
+ *
+ * Append @vol to the volumes of @pool, which takes ownership of it on
+ * success. Volumes must be added and removed through these helpers
+ * so that the lookup indexes stay in sync.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStoragePoolObjAddVol(virStoragePoolObjPtr pool,
+                        virStorageVolDefPtr vol)
+{
+    if (VIR_APPEND_ELEMENT_COPY(pool->volumes.objs,
+                                pool->volumes.count, vol) < 0)
+        return -1;
+
+    if (virStoragePoolObjIndexVol(pool, vol) < 0) {
+        VIR_DELETE_ELEMENT(pool->volumes.objs, pool->volumes.count - 1,
+                           pool->volumes.count);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * virStoragePoolObjRemoveVol:
+ * @pool: locked pool object
+ * @vol: volume to remove
+ *
+ * Remove @vol from the volumes of @pool. The caller becomes the owner
+ * of @vol.
+ */
+void
+virStoragePoolObjRemoveVol(virStoragePoolObjPtr pool,
+                           virStorageVolDefPtr vol)
+{
+    size_t i;
+
+    for (i = 0; i < pool->volumes.count; i++) {
+        if (pool->volumes.objs[i] == vol) {
+            virStoragePoolObjUnindexVol(pool, vol);
+            VIR_DELETE_ELEMENT(pool->volumes.objs, i, pool->volumes.count);
+            return;
+        }
+    }
+}
+
+/**
+ * virStoragePoolObjReindexVol:
+ * @pool: locked pool object
+ * @vol: volume of @pool
+ *
+ * Update the lookup indexes after the key or target path of @vol
+ * was changed, e.g. by a backend refreshVol callback.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStoragePoolObjReindexVol(virStoragePoolObjPtr pool,
+                            virStorageVolDefPtr vol)
+{
+    if (virStorageVolDefListReindexOne(&pool->volumes.byName,
+                                       vol->name, vol) < 0 ||
+        virStorageVolDefListReindexOne(&pool->volumes.byKey,
+                                       vol->key, vol) < 0 ||
+        virStorageVolDefListReindexOne(&pool->volumes.byPath,
+                                       vol->target.path, vol) < 0)
+        return -1;
+
+    return 0;
+}
+
+/**
+ * virStoragePoolObjDropVol:
+ * @pool: locked pool object
+ * @vol: volume to drop
+ *
+ * Remove @vol from the volumes of @pool and free it, unless @pool is
+ * a refresh shadow which merely borrows @vol from the live pool.
+ */
+void
+virStoragePoolObjDropVol(virStoragePoolObjPtr pool,
+                         virStorageVolDefPtr vol)
+{
+    virStoragePoolObjRemoveVol(pool, vol);
+
+    if (virStoragePoolObjOwnsVol(pool, vol))
+        virStorageVolDefFree(vol);
+}
+
+/**
+ * virStoragePoolObjNewShadow:
+ * @pool: locked, active pool object
+ * @borrowVols: whether the shadow starts out with the volumes of @pool
+ *
+ * Create a private copy of @pool which a backend can refresh while the
+ * lock of @pool is dropped, so that readers of @pool are not held up
+ * by a slow refresh. The shadow has its own copy of the definition and
+ * volume list, but shares the backend private data of @pool; private
+ * data which the backend only attaches during the refresh is handed
+ * over to @pool on commit. With
+ * @borrowVols, the volume definitions themselves are shared with @pool
+ * and are never freed through the shadow.
+ *
+ * The volume list of @pool must not change until the shadow is
+ * released by virStoragePoolObjCommitShadow or
+ * virStoragePoolObjFreeShadow.
+ *
+ * Returns the shadow, or NULL on error.
+ */
+virStoragePoolObjPtr
+virStoragePoolObjNewShadow(virStoragePoolObjPtr pool,
+                           bool borrowVols)
+{
+    virStoragePoolObjPtr shadow;
+    char *xml = NULL;
+    size_t i;
+
+    if (VIR_ALLOC(shadow) < 0)
+        return NULL;
+
+    if (virMutexInit(&shadow->lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        VIR_FREE(shadow);
+        return NULL;
+    }
+    shadow->origin = pool;
+    shadow->active = pool->active;
+    shadow->privateData = pool->privateData;
+    shadow->privateDataFreeFunc = pool->privateDataFreeFunc;
+
+    if (!(xml = virStoragePoolDefFormat(pool->def)) ||
+        !(shadow->def = virStoragePoolDefParseString(xml)))
+        goto error;
+
+    if (borrowVols) {
+        for (i = 0; i < pool->volumes.count; i++) {
+            if (virStoragePoolObjAddVol(shadow, pool->volumes.objs[i]) < 0)
+                goto error;
+        }
+    }
+
+    VIR_FREE(xml);
+    return shadow;
+
+error:
+    VIR_FREE(xml);
+    virStoragePoolObjFreeShadow(shadow);
+    return NULL;
+}
+
+/**
+ * virStoragePoolObjFreeShadow:
+ * @shadow: shadow created by virStoragePoolObjNewShadow
+ *
+ * Discard @shadow, e.g. after its refresh failed. The live pool is
+ * left untouched.
+ */
+void
+virStoragePoolObjFreeShadow(virStoragePoolObjPtr shadow)
+{
+    if (!shadow)
+        return;
+
+    /* Backend state set up by the refresh itself is not shared */
+    if (shadow->origin &&
+        shadow->privateData != shadow->origin->privateData &&
+        shadow->privateDataFreeFunc)
+        (shadow->privateDataFreeFunc)(shadow->privateData);
+
+    virStoragePoolObjClearVols(shadow);
+    virStoragePoolDefFree(shadow->def);
+    virMutexDestroy(&shadow->lock);
+    VIR_FREE(shadow);
+}
+
+/**
+ * virStoragePoolObjCommitShadow:
+ * @pool: locked pool object
+ * @shadow: refreshed shadow of @pool
+ *
+ * Replace the volume list and the runtime state of @pool by the ones
+ * of @shadow, and free @shadow.
+ */
+void
+virStoragePoolObjCommitShadow(virStoragePoolObjPtr pool,
+                              virStoragePoolObjPtr shadow)
+{
+    virStorageVolDefList vols;
+    size_t i;
+
+    /* Free the volumes the refresh did not find any more, then hand
+     * over the new list while the old one is cleared by the shadow */
+    for (i = 0; i < pool->volumes.count; i++) {
+        virStorageVolDefPtr vol = pool->volumes.objs[i];
+
+        if (virStorageVolDefFindByName(shadow, vol->name) != vol)
+            virStorageVolDefFree(vol);
+    }
+    pool->volumes.count = 0;
+
+    vols = pool->volumes;
+    pool->volumes = shadow->volumes;
+    shadow->volumes = vols;
+    shadow->origin = NULL;
+    virStoragePoolObjClearVols(shadow);
+
+    if (shadow->privateData != pool->privateData) {
+        if (pool->privateDataFreeFunc)
+            (pool->privateDataFreeFunc)(pool->privateData);
+        pool->privateData = shadow->privateData;
+        pool->privateDataFreeFunc = shadow->privateDataFreeFunc;
+    }
+
+    pool->def->capacity = shadow->def->capacity;
+    pool->def->allocation = shadow->def->allocation;
+    pool->def->available = shadow->def->available;
+
+    for (i = 0; i < pool->def->source.ndevice &&
+                i < shadow->def->source.ndevice; i++) {
+        virStoragePoolSourceDevicePtr dev = &pool->def->source.devices[i];
+        virStoragePoolSourceDevicePtr sdev = &shadow->def->source.devices[i];
+
+        VIR_FREE(dev->freeExtents);
+        dev->freeExtents = sdev->freeExtents;
+        dev->nfreeExtent = sdev->nfreeExtent;
+        sdev->freeExtents = NULL;
+        sdev->nfreeExtent = 0;
+    }
+
+    virStoragePoolDefFree(shadow->def);
+    virMutexDestroy(&shadow->lock);
+    VIR_FREE(shadow);
+}
+
+/**
+ * virStoragePoolObjSyncVols:
+ * @pool: locked pool object
+ * @names: names of all volumes currently present in the backend
+ * @nnames: number of entries in @names
+ * @vols: filled with the existing volume of each name, or NULL for
+ *        names which have no volume yet
+ *
+ * Drop the volumes of @pool which are not listed in @names any more,
+ * unless they are still being built. This allows a backend to refresh
+ * a pool without rebuilding the volumes it already knows about; those
+ * of @vols which changed are up to the backend to replace, with
+ * virStoragePoolObjDropVol and virStoragePoolObjAddVol.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStoragePoolObjSyncVols(virStoragePoolObjPtr pool,
+                          char *const *names,
+                          size_t nnames,
+                          virStorageVolDefPtr *vols)
+{
+    virHashTablePtr table;
+    size_t i, j;
+    int ret = -1;
+
+    if (!(table = virHashCreate(nnames, NULL)))
+        return -1;
+
+    for (i = 0; i < nnames; i++) {
+        vols[i] = NULL;
+        if (virHashUpdateEntry(table, names[i], &vols[i]) < 0)
+            goto cleanup;
+    }
+
+    for (i = 0, j = 0; i < pool->volumes.count; i++) {
+        virStorageVolDefPtr vol = pool->volumes.objs[i];
+        virStorageVolDefPtr *slot = virHashLookup(table, vol->name);
+
+        if (slot) {
+            *slot = vol;
+        } else if (!vol->building) {
+            VIR_DEBUG("Dropping volume '%s' from storage pool '%s'",
+                      vol->name, pool->def->name);
+            virStoragePoolObjUnindexVol(pool, vol);
+            if (virStoragePoolObjOwnsVol(pool, vol))
+                virStorageVolDefFree(vol);
+            continue;
+        }
+        pool->volumes.objs[j++] = vol;
+    }
+    pool->volumes.count = j;
+    ret = 0;
+
+cleanup:
+    virHashFree(table);
+    return ret;
 }
 
 virStorageVolDefPtr
 virStorageVolDefFindByKey(virStoragePoolObjPtr pool,
                           const char *key)
 {
-    size_t i;
+    virStorageVolDefPtr vol = virHashLookup(pool->volumes.byKey, key);
 
-    for (i = 0; i < pool->volumes.count; i++)
-        if (STREQ(pool->volumes.objs[i]->key, key))
-            return pool->volumes.objs[i];
+    if (vol && STREQ_NULLABLE(vol->key, key))
+        return vol;
 
     return NULL;
 }
@@ -1764,11 +2230,10 @@ virStorageVolDefPtr
 virStorageVolDefFindByPath(virStoragePoolObjPtr pool,
                            const char *path)
 {
-    size_t i;
+    virStorageVolDefPtr vol = virHashLookup(pool->volumes.byPath, path);
 
-    for (i = 0; i < pool->volumes.count; i++)
-        if (STREQ(pool->volumes.objs[i]->target.path, path))
-            return pool->volumes.objs[i];
+    if (vol && STREQ_NULLABLE(vol->target.path, path))
+        return vol;
 
     return NULL;
 }
@@ -1777,11 +2242,10 @@ virStorageVolDefPtr
 virStorageVolDefFindByName(virStoragePoolObjPtr pool,
                            const char *name)
 {
-    size_t i;
+    virStorageVolDefPtr vol = virHashLookup(pool->volumes.byName, name);
 
-    for (i = 0; i < pool->volumes.count; i++)
-        if (STREQ(pool->volumes.objs[i]->name, name))
-            return pool->volumes.objs[i];
+    if (vol && STREQ(vol->name, name))
+        return vol;
 
     return NULL;
 }
@@ -1791,6 +2255,7 @@ virStoragePoolObjAssignDef(virStoragePoolObjListPtr pools,
                            virStoragePoolDefPtr def)
 {
     virStoragePoolObjPtr pool;
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
 
     if ((pool = virStoragePoolObjFindByName(pools, def->name))) {
         if (!virStoragePoolObjIsActive(pool)) {
@@ -1812,19 +2277,38 @@ virStoragePoolObjAssignDef(virStoragePoolObjListPtr pools,
         VIR_FREE(pool);
         return NULL;
     }
+    if (virRWLockInit(&pool->refreshLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize refresh lock"));
+        virMutexDestroy(&pool->lock);
+        VIR_FREE(pool);
+        return NULL;
+    }
     virStoragePoolObjLock(pool);
     pool->active = 0;
     pool->def = def;
 
-    if (VIR_REALLOC_N(pools->objs, pools->count+1) < 0) {
-        pool->def = NULL;
-        virStoragePoolObjUnlock(pool);
-        virStoragePoolObjFree(pool);
-        return NULL;
+    virUUIDFormat(def->uuid, uuidstr);
+    if ((!pools->byName && !(pools->byName = virHashCreate(32, NULL))) ||
+        (!pools->byUUID && !(pools->byUUID = virHashCreate(32, NULL))) ||
+        VIR_REALLOC_N(pools->objs, pools->count+1) < 0)
+        goto error;
+
+    if (virHashAddEntry(pools->byName, def->name, pool) < 0)
+        goto error;
+    if (virHashUpdateEntry(pools->byUUID, uuidstr, pool) < 0) {
+        ignore_value(virHashRemoveEntry(pools->byName, def->name));
+        goto error;
     }
     pools->objs[pools->count++] = pool;
 
     return pool;
+
+error:
+    pool->def = NULL;
+    virStoragePoolObjUnlock(pool);
+    virStoragePoolObjFree(pool);
+    return NULL;
 }
 
 static virStoragePoolObjPtr
@@ -28,6 +28,8 @@
 # include "storage_encryption_conf.h"
 # include "virbitmap.h"
 # include "virthread.h"
+# include "virhash.h"
+# include "object_event.h"
 
 # include <libxml/tree.h>
 
@@ -100,6 +102,7 @@ struct _virStorageVolDef {
     int type; /* enum virStorageVolType */
 
     unsigned int building;
+    unsigned int in_use; /* number of clones reading from the volume */
 
     unsigned long long allocation; /* bytes */
     unsigned long long capacity; /* bytes */
@@ -114,6 +117,11 @@ typedef virStorageVolDefList *virStorageVolDefListPtr;
 struct _virStorageVolDefList {
     size_t count;
     virStorageVolDefPtr *objs;
+
+    /* Lookup indexes, kept in sync by virStoragePoolObjAddVol & co. */
+    virHashTablePtr byName;
+    virHashTablePtr byKey;
+    virHashTablePtr byPath;
 };
 
 VIR_ENUM_DECL(virStorageVol)
@@ -156,6 +164,15 @@ enum virStoragePoolAuthType {
 };
 VIR_ENUM_DECL(virStoragePoolAuthType)
 
+enum virStoragePoolRefreshMode {
+    VIR_STORAGE_POOL_REFRESH_DEFAULT = 0,
+    VIR_STORAGE_POOL_REFRESH_FULL,        /* rebuild all volumes */
+    VIR_STORAGE_POOL_REFRESH_INCREMENTAL, /* only look up new volumes */
+
+    VIR_STORAGE_POOL_REFRESH_LAST,
+};
+VIR_ENUM_DECL(virStoragePoolRefreshMode)
+
 typedef struct _virStoragePoolAuthSecret virStoragePoolAuthSecret;
 typedef virStoragePoolAuthSecret *virStoragePoolAuthSecretPtr;
 struct _virStoragePoolAuthSecret {
@@ -322,6 +339,10 @@ struct _virStoragePoolDef {
 
     virStoragePoolSource source;
     virStoragePoolTarget target;
+
+    /* Upper bound of concurrent volume refreshes, 0 for backend default */
+    unsigned int refreshWorkers;
+    int refreshMode; /* enum virStoragePoolRefreshMode */
 };
 
 typedef struct _virStoragePoolObj virStoragePoolObj;
@@ -335,11 +356,24 @@ struct _virStoragePoolObj {
     int active;
     int autostart;
     unsigned int asyncjobs;
+    /* Set while a refresh runs without the pool lock; the volume list
+     * must not be changed meanwhile */
+    bool refreshing;
+    /* Held for write by a refresh while it is running, so that calls
+     * changing volumes can wait for it to finish */
+    virRWLock refreshLock;
 
     virStoragePoolDefPtr def;
     virStoragePoolDefPtr newDef;
 
     virStorageVolDefList volumes;
+
+    /* Backend specific state, released together with the pool */
+    void *privateData;
+    void (*privateDataFreeFunc)(void *);
+
+    /* Live pool object, if this is a refresh shadow of it */
+    virStoragePoolObjPtr origin;
 };
 
 typedef struct _virStoragePoolObjList virStoragePoolObjList;
@@ -347,6 +381,11 @@ typedef virStoragePoolObjList *virStoragePoolObjListPtr;
 struct _virStoragePoolObjList {
     size_t count;
     virStoragePoolObjPtr *objs;
+
+    /* Lookup indexes, kept in sync by virStoragePoolObjAssignDef and
+     * virStoragePoolObjRemove */
+    virHashTablePtr byName;
+    virHashTablePtr byUUID;
 };
 
 typedef struct _virStorageDriverState virStorageDriverState;
@@ -360,6 +399,9 @@ struct _virStorageDriverState {
     char *configDir;
     char *autostartDir;
     bool privileged;
+
+    /* Immutable pointer, self-locking APIs */
+    virObjectEventStatePtr storageEventState;
 };
 
 typedef struct _virStoragePoolSourceList virStoragePoolSourceList;
@@ -404,6 +446,24 @@ virStorageVolDefFindByName(virStoragePoolObjPtr pool,
                            const char *name);
 
 void virStoragePoolObjClearVols(virStoragePoolObjPtr pool);
+int virStoragePoolObjAddVol(virStoragePoolObjPtr pool,
+                            virStorageVolDefPtr vol);
+void virStoragePoolObjRemoveVol(virStoragePoolObjPtr pool,
+                                virStorageVolDefPtr vol);
+int virStoragePoolObjReindexVol(virStoragePoolObjPtr pool,
+                                virStorageVolDefPtr vol);
+void virStoragePoolObjDropVol(virStoragePoolObjPtr pool,
+                              virStorageVolDefPtr vol);
+
+virStoragePoolObjPtr virStoragePoolObjNewShadow(virStoragePoolObjPtr pool,
+                                                bool borrowVols);
+void virStoragePoolObjFreeShadow(virStoragePoolObjPtr shadow);
+void virStoragePoolObjCommitShadow(virStoragePoolObjPtr pool,
+                                   virStoragePoolObjPtr shadow);
+int virStoragePoolObjSyncVols(virStoragePoolObjPtr pool,
+                              char *const *names,
+                              size_t nnames,
+                              virStorageVolDefPtr *vols);
 
 virStoragePoolDefPtr virStoragePoolDefParseString(const char *xml);
 virStoragePoolDefPtr virStoragePoolDefParseFile(const char *filename);
@@ -0,0 +1,252 @@
+/*
+ * storage_event.c: storage pool event queue processing helpers
+ *
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "storage_event.h"
+#include "object_event.h"
+#include "object_event_private.h"
+#include "datatypes.h"
+#include "viralloc.h"
+#include "virlog.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_STORAGE
+
+struct _virStoragePoolEvent {
+    virObjectEvent parent;
+
+    /* Unused attribute to allow for subclass creation */
+    bool dummy;
+};
+typedef struct _virStoragePoolEvent virStoragePoolEvent;
+typedef virStoragePoolEvent *virStoragePoolEventPtr;
+
+struct _virStoragePoolEventJobCompleted {
+    virStoragePoolEvent parent;
+
+    char *volume;
+    unsigned int job;
+    int type;
+    int state;
+};
+typedef struct _virStoragePoolEventJobCompleted virStoragePoolEventJobCompleted;
+typedef virStoragePoolEventJobCompleted *virStoragePoolEventJobCompletedPtr;
+
+static virClassPtr virStoragePoolEventClass;
+static virClassPtr virStoragePoolEventJobCompletedClass;
+static void virStoragePoolEventDispose(void *obj);
+static void virStoragePoolEventJobCompletedDispose(void *obj);
+
+static int
+virStoragePoolEventsOnceInit(void)
+{
+    if (!(virStoragePoolEventClass =
+          virClassNew(virClassForObjectEvent(),
+                      "virStoragePoolEvent",
+                      sizeof(virStoragePoolEvent),
+                      virStoragePoolEventDispose)))
+        return -1;
+    if (!(virStoragePoolEventJobCompletedClass =
+          virClassNew(virStoragePoolEventClass,
+                      "virStoragePoolEventJobCompleted",
+                      sizeof(virStoragePoolEventJobCompleted),
+                      virStoragePoolEventJobCompletedDispose)))
+        return -1;
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStoragePoolEvents)
+
+static void
+virStoragePoolEventDispose(void *obj)
+{
+    virStoragePoolEventPtr event = obj;
+    VIR_DEBUG("obj=%p", event);
+}
+
+
+static void
+virStoragePoolEventJobCompletedDispose(void *obj)
+{
+    virStoragePoolEventJobCompletedPtr event = obj;
+    VIR_DEBUG("obj=%p", event);
+
+    VIR_FREE(event->volume);
+}
+
+
+static void
+virStoragePoolEventDispatchDefaultFunc(virConnectPtr conn,
+                                       virObjectEventPtr event,
+                                       virConnectObjectEventGenericCallback cb,
+                                       void *cbopaque)
+{
+    virStoragePoolPtr pool = virGetStoragePool(conn,
+                                               event->meta.name,
+                                               event->meta.uuid,
+                                               NULL, NULL);
+    if (!pool)
+        return;
+
+    switch ((virStoragePoolEventID)event->eventID) {
+    case VIR_STORAGE_POOL_EVENT_ID_JOB_COMPLETED:
+        {
+            virStoragePoolEventJobCompletedPtr jobEvent;
+
+            jobEvent = (virStoragePoolEventJobCompletedPtr)event;
+            ((virConnectStoragePoolEventJobCompletedCallback)cb)(conn, pool,
+                                                                 jobEvent->volume,
+                                                                 jobEvent->job,
+                                                                 jobEvent->type,
+                                                                 jobEvent->state,
+                                                                 cbopaque);
+            goto cleanup;
+        }
+
+    case VIR_STORAGE_POOL_EVENT_ID_LAST:
+        break;
+    }
+    VIR_WARN("Unexpected event ID %d", event->eventID);
+
+cleanup:
+    virStoragePoolFree(pool);
+}
+
+
+/**
+ * virStoragePoolEventStateRegisterID:
+ * @conn: connection to associate with callback
+ * @state: object event state
+ * @pool: storage pool to filter on or NULL for all storage pools
+ * @eventID: ID of the event type to register for
+ * @cb: function to invoke when event occurs
+ * @opaque: data blob to pass to @callback
+ * @freecb: callback to free @opaque
+ * @callbackID: filled with callback ID
+ *
+ * Register the function @cb with connection @conn, from @state, for
+ * events of type @eventID, and return the registration handle in
+ * @callbackID.
+ *
+ * Returns: the number of callbacks now registered, or -1 on error
+ */
+int
+virStoragePoolEventStateRegisterID(virConnectPtr conn,
+                                   virObjectEventStatePtr state,
+                                   virStoragePoolPtr pool,
+                                   int eventID,
+                                   virConnectStoragePoolEventGenericCallback cb,
+                                   void *opaque,
+                                   virFreeCallback freecb,
+                                   int *callbackID)
+{
+    if (virStoragePoolEventsInitialize() < 0)
+        return -1;
+
+    return virObjectEventStateRegisterID(conn, state, pool ? pool->uuid : NULL,
+                                         NULL, NULL,
+                                         virStoragePoolEventClass, eventID,
+                                         VIR_OBJECT_EVENT_CALLBACK(cb),
+                                         opaque, freecb,
+                                         false, callbackID, false);
+}
+
+
+/**
+ * virStoragePoolEventStateRegisterClient:
+ * @conn: connection to associate with callback
+ * @state: object event state
+ * @pool: storage pool to filter on or NULL for all storage pools
+ * @eventID: ID of the event type to register for
+ * @cb: function to invoke when event occurs
+ * @opaque: data blob to pass to @callback
+ * @freecb: callback to free @opaque
+ * @callbackID: filled with callback ID
+ *
+ * Register the function @cb with connection @conn, from @state, for
+ * events of type @eventID, and return the registration handle in
+ * @callbackID.  This version is intended for use on the client side
+ * of RPC.
+ *
+ * Returns: the number of callbacks now registered, or -1 on error
+ */
+int
+virStoragePoolEventStateRegisterClient(virConnectPtr conn,
+                                       virObjectEventStatePtr state,
+                                       virStoragePoolPtr pool,
+                                       int eventID,
+                                       virConnectStoragePoolEventGenericCallback cb,
+                                       void *opaque,
+                                       virFreeCallback freecb,
+                                       int *callbackID)
+{
+    if (virStoragePoolEventsInitialize() < 0)
+        return -1;
+
+    return virObjectEventStateRegisterID(conn, state, pool ? pool->uuid : NULL,
+                                         NULL, NULL,
+                                         virStoragePoolEventClass, eventID,
+                                         VIR_OBJECT_EVENT_CALLBACK(cb),
+                                         opaque, freecb,
+                                         false, callbackID, true);
+}
+
+
+/**
+ * virStoragePoolEventJobCompletedNew:
+ * @name: name of the storage pool the job ran in
+ * @uuid: uuid of the storage pool the job ran in
+ * @volume: name of the volume the job worked on, or NULL
+ * @job: identifier of the job
+ * @type: type of the job
+ * @state: final state of the job
+ *
+ * Create a new storage job completion event.
+ */
+virObjectEventPtr
+virStoragePoolEventJobCompletedNew(const char *name,
+                                   const unsigned char *uuid,
+                                   const char *volume,
+                                   unsigned int job,
+                                   int type,
+                                   int state)
+{
+    virStoragePoolEventJobCompletedPtr event;
+
+    if (virStoragePoolEventsInitialize() < 0)
+        return NULL;
+
+    if (!(event = virObjectEventNew(virStoragePoolEventJobCompletedClass,
+                                    virStoragePoolEventDispatchDefaultFunc,
+                                    VIR_STORAGE_POOL_EVENT_ID_JOB_COMPLETED,
+                                    0, name, uuid)))
+        return NULL;
+
+    if (VIR_STRDUP(event->volume, volume) < 0) {
+        virObjectUnref(event);
+        return NULL;
+    }
+    event->job = job;
+    event->type = type;
+    event->state = state;
+
+    return (virObjectEventPtr)event;
+}
@@ -0,0 +1,60 @@
+/*
+ * storage_event.h: storage pool event queue processing helpers
+ *
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+#include "object_event.h"
+#include "object_event_private.h"
+
+#ifndef __STORAGE_EVENT_H__
+# define __STORAGE_EVENT_H__
+
+int
+virStoragePoolEventStateRegisterID(virConnectPtr conn,
+                                   virObjectEventStatePtr state,
+                                   virStoragePoolPtr pool,
+                                   int eventID,
+                                   virConnectStoragePoolEventGenericCallback cb,
+                                   void *opaque,
+                                   virFreeCallback freecb,
+                                   int *callbackID)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5)
+    ATTRIBUTE_NONNULL(8);
+
+int
+virStoragePoolEventStateRegisterClient(virConnectPtr conn,
+                                       virObjectEventStatePtr state,
+                                       virStoragePoolPtr pool,
+                                       int eventID,
+                                       virConnectStoragePoolEventGenericCallback cb,
+                                       void *opaque,
+                                       virFreeCallback freecb,
+                                       int *callbackID)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5)
+    ATTRIBUTE_NONNULL(8);
+
+virObjectEventPtr
+virStoragePoolEventJobCompletedNew(const char *name,
+                                   const unsigned char *uuid,
+                                   const char *volume,
+                                   unsigned int job,
+                                   int type,
+                                   int state);
+
+#endif
@@ -1130,6 +1130,38 @@ typedef int
                                      unsigned int flags,
                                      int cancelled);
 
+typedef int
+(*virDrvConnectGetAllDomainStats)(virConnectPtr conn,
+                                  virDomainPtr *doms,
+                                  unsigned int ndoms,
+                                  unsigned int stats,
+                                  virDomainStatsRecordPtr **retStats,
+                                  unsigned int flags);
+
+typedef int
+(*virDrvDomainGetInfoAsync)(virDomainPtr domain,
+                            virDomainInfoPtr info,
+                            virConnectAsyncCallback cb,
+                            void *opaque,
+                            virFreeCallback freecb);
+
+typedef int
+(*virDrvDomainGetXMLDescAsync)(virDomainPtr domain,
+                               unsigned int flags,
+                               char **xml,
+                               virConnectAsyncCallback cb,
+                               void *opaque,
+                               virFreeCallback freecb);
+
+typedef int
+(*virDrvConnectGetAllDomainStatsAsync)(virConnectPtr conn,
+                                       unsigned int stats,
+                                       virDomainStatsRecordPtr **retStats,
+                                       unsigned int flags,
+                                       virConnectAsyncCallback cb,
+                                       void *opaque,
+                                       virFreeCallback freecb);
+
 typedef struct _virDriver virDriver;
 typedef virDriver *virDriverPtr;
 
@@ -1341,6 +1373,10 @@ struct _virDriver {
     virDrvDomainMigrateFinish3Params domainMigrateFinish3Params;
     virDrvDomainMigrateConfirm3Params domainMigrateConfirm3Params;
     virDrvConnectGetCPUModelNames connectGetCPUModelNames;
+    virDrvConnectGetAllDomainStats connectGetAllDomainStats;
+    virDrvDomainGetInfoAsync domainGetInfoAsync;
+    virDrvDomainGetXMLDescAsync domainGetXMLDescAsync;
+    virDrvConnectGetAllDomainStatsAsync connectGetAllDomainStatsAsync;
 };
 
 
@@ -1749,6 +1785,29 @@ typedef int
                           unsigned long long capacity,
                           unsigned int flags);
 
+typedef int
+(*virDrvStorageVolGetJobStats)(virStorageVolPtr vol,
+                               int *type,
+                               virTypedParameterPtr *params,
+                               int *nparams,
+                               unsigned int flags);
+
+typedef int
+(*virDrvStorageVolAbortJob)(virStorageVolPtr vol,
+                            unsigned int flags);
+
+typedef int
+(*virDrvConnectStoragePoolEventRegisterAny)(virConnectPtr conn,
+                                            virStoragePoolPtr pool,
+                                            int eventID,
+                                            virConnectStoragePoolEventGenericCallback cb,
+                                            void *opaque,
+                                            virFreeCallback freecb);
+
+typedef int
+(*virDrvConnectStoragePoolEventDeregisterAny)(virConnectPtr conn,
+                                              int callbackID);
+
 typedef int
 (*virDrvStoragePoolIsActive)(virStoragePoolPtr pool);
 
@@ -1814,6 +1873,10 @@ struct _virStorageDriver {
     virDrvStorageVolResize storageVolResize;
     virDrvStoragePoolIsActive storagePoolIsActive;
     virDrvStoragePoolIsPersistent storagePoolIsPersistent;
+    virDrvStorageVolGetJobStats storageVolGetJobStats;
+    virDrvStorageVolAbortJob storageVolAbortJob;
+    virDrvConnectStoragePoolEventRegisterAny connectStoragePoolEventRegisterAny;
+    virDrvConnectStoragePoolEventDeregisterAny connectStoragePoolEventDeregisterAny;
 };
 
 # ifdef WITH_LIBVIRTD
@@ -2028,6 +2091,27 @@ typedef int
                     char *data,
                     size_t nbytes);
 
+typedef int
+(*virDrvStreamRecvFlags)(virStreamPtr st,
+                         char *data,
+                         size_t nbytes,
+                         unsigned int flags);
+
+typedef int
+(*virDrvStreamSendHole)(virStreamPtr st,
+                        long long length,
+                        unsigned int flags);
+
+typedef int
+(*virDrvStreamRecvHole)(virStreamPtr st,
+                        long long *length,
+                        unsigned int flags);
+
+typedef int
+(*virDrvStreamInData)(virStreamPtr st,
+                      int *inData,
+                      long long *length);
+
 typedef int
 (*virDrvStreamEventAddCallback)(virStreamPtr stream,
                                 int events,
@@ -2054,6 +2138,10 @@ typedef virStreamDriver *virStreamDriverPtr;
 struct _virStreamDriver {
     virDrvStreamSend streamSend;
     virDrvStreamRecv streamRecv;
+    virDrvStreamRecvFlags streamRecvFlags;
+    virDrvStreamSendHole streamSendHole;
+    virDrvStreamRecvHole streamRecvHole;
+    virDrvStreamInData streamInData;
     virDrvStreamEventAddCallback streamEventAddCallback;
     virDrvStreamEventUpdateCallback streamEventUpdateCallback;
     virDrvStreamEventRemoveCallback streamEventRemoveCallback;
@@ -31,6 +31,7 @@
 # include <sys/un.h>
 #endif
 #include <netinet/in.h>
+#include <sys/ioctl.h>
 
 #include "fdstream.h"
 #include "virerror.h"
@@ -41,9 +42,58 @@
 #include "virfile.h"
 #include "configmake.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_STREAMS
 
+#if defined(SEEK_DATA) && defined(SEEK_HOLE) && defined(MSG_NOSIGNAL)
+# define WITH_SPARSE_STREAM 1
+#else
+# define MSG_NOSIGNAL 0
+#endif
+
+/* Size of the chunks the sparse stream thread moves between the
+ * file and the socket */
+#define SPARSE_STREAM_BUF_SIZE (1024 * 1024)
+
+/* A stretch of the stream data, either real bytes that travel
+ * through the socket pair or a hole of which only the length is
+ * known. The queue of these tells the reader where holes sit in
+ * between the bytes it gets from the socket. */
+typedef struct virFDStreamSegment virFDStreamSegment;
+struct virFDStreamSegment {
+    bool hole;
+    unsigned long long length;
+};
+
+/* State of the in-process pump used for sparse files and block
+ * devices. It replaces the iohelper, because holes need to be
+ * reported in-band with the data. */
+struct virFDStreamSparse {
+    virMutex lock;
+    virCond cond;
+    virThread thread;
+    bool threadActive;
+
+    char *path;
+    int fd;             /* the file or block device */
+    int sock;           /* thread end of the socket pair */
+    bool upload;
+    bool isblock;
+    unsigned long long offset;  /* current position in @fd */
+    unsigned long long end;     /* upper limit of the transfer */
+
+    /* segments queued between the stream and the thread,
+     * protected by @lock */
+    virFDStreamSegment *segs;
+    size_t nsegs;
+
+    bool quit;          /* no more segments will be queued */
+    bool abort;         /* drop any queued segments */
+    bool done;          /* thread has finished */
+    virErrorPtr err;    /* error the thread finished with */
+};
+
 /* Tunnelled migration stream support */
 struct virFDStreamData {
     int fd;
@@ -71,6 +121,13 @@ struct virFDStreamData {
     virFDStreamInternalCloseCbFreeOpaque icbFreeOpaque;
     void *icbOpaque;
 
+    /* internal finish callback, reaps an in-process data pump */
+    virFDStreamInternalFinishCb finishCb;
+    void *finishOpaque;
+
+    /* pump for hole-aware transfers, NULL otherwise */
+    struct virFDStreamSparse *sparse;
+
     virMutex lock;
 };
 
@@ -249,6 +306,409 @@ cleanup:
 }
 
 
+static void
+virFDStreamSparseFree(struct virFDStreamSparse *sp)
+{
+    if (!sp)
+        return;
+
+    VIR_FORCE_CLOSE(sp->fd);
+    VIR_FORCE_CLOSE(sp->sock);
+    VIR_FREE(sp->segs);
+    VIR_FREE(sp->path);
+    virFreeError(sp->err);
+    virCondDestroy(&sp->cond);
+    virMutexDestroy(&sp->lock);
+    VIR_FREE(sp);
+}
+
+
+/* Must be called with sp->lock held */
+static int
+virFDStreamSparsePush(struct virFDStreamSparse *sp,
+                      bool hole,
+                      unsigned long long length)
+{
+    virFDStreamSegment seg = { .hole = hole, .length = length };
+
+    if (!length)
+        return 0;
+
+    if (sp->nsegs && sp->segs[sp->nsegs - 1].hole == hole) {
+        sp->segs[sp->nsegs - 1].length += length;
+    } else if (VIR_APPEND_ELEMENT(sp->segs, sp->nsegs, seg) < 0) {
+        return -1;
+    }
+
+    virCondBroadcast(&sp->cond);
+    return 0;
+}
+
+
+/* Must be called with sp->lock held */
+static void
+virFDStreamSparsePop(struct virFDStreamSparse *sp,
+                     unsigned long long length)
+{
+    if (!sp->nsegs)
+        return;
+
+    if (sp->segs[0].length > length)
+        sp->segs[0].length -= length;
+    else
+        VIR_DELETE_ELEMENT(sp->segs, 0, sp->nsegs);
+}
+
+
+#ifdef WITH_SPARSE_STREAM
+static int
+virFDStreamSparseSendAll(int fd, const char *buf, size_t len)
+{
+    while (len) {
+        ssize_t done = send(fd, buf, len, MSG_NOSIGNAL);
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += done;
+        len -= done;
+    }
+    return 0;
+}
+
+
+/* Walk the data and hole extents of the file and feed them to the
+ * stream: holes are only queued, data is queued and then written to
+ * the socket pair */
+static int
+virFDStreamSparseDownload(struct virFDStreamSparse *sp, char *buf)
+{
+    while (sp->offset < sp->end) {
+        off_t data;
+        off_t hole;
+        bool stop;
+
+        virMutexLock(&sp->lock);
+        stop = sp->abort;
+        virMutexUnlock(&sp->lock);
+        if (stop)
+            return 0;
+
+        if ((data = lseek(sp->fd, sp->offset, SEEK_DATA)) < 0) {
+            if (errno == ENXIO) {
+                /* only a hole remains up to the end */
+                data = sp->end;
+            } else if (errno == EINVAL) {
+                /* no hole detection on this file system */
+                data = sp->offset;
+            } else {
+                virReportSystemError(errno,
+                                     _("unable to seek to data in '%s'"),
+                                     sp->path);
+                return -1;
+            }
+        }
+
+        if (data > sp->offset) {
+            unsigned long long len = MIN(data, sp->end) - sp->offset;
+
+            virMutexLock(&sp->lock);
+            if (virFDStreamSparsePush(sp, true, len) < 0) {
+                virMutexUnlock(&sp->lock);
+                return -1;
+            }
+            virMutexUnlock(&sp->lock);
+            sp->offset += len;
+            continue;
+        }
+
+        if ((hole = lseek(sp->fd, sp->offset, SEEK_HOLE)) < 0) {
+            if (errno != EINVAL && errno != ENXIO) {
+                virReportSystemError(errno,
+                                     _("unable to seek to hole in '%s'"),
+                                     sp->path);
+                return -1;
+            }
+            hole = sp->end;
+        }
+
+        while (sp->offset < MIN(hole, sp->end)) {
+            size_t want = MIN(SPARSE_STREAM_BUF_SIZE,
+                              MIN(hole, sp->end) - sp->offset);
+            ssize_t got;
+
+            if ((got = pread(sp->fd, buf, want, sp->offset)) < 0) {
+                if (errno == EINTR)
+                    continue;
+                virReportSystemError(errno, _("unable to read '%s'"),
+                                     sp->path);
+                return -1;
+            }
+
+            /* the file got truncated under our feet */
+            if (got == 0) {
+                sp->end = sp->offset;
+                break;
+            }
+
+            /* the segment must be queued before its bytes can be
+             * seen on the socket */
+            virMutexLock(&sp->lock);
+            if (virFDStreamSparsePush(sp, false, got) < 0) {
+                virMutexUnlock(&sp->lock);
+                return -1;
+            }
+            virMutexUnlock(&sp->lock);
+
+            if (virFDStreamSparseSendAll(sp->sock, buf, got) < 0) {
+                /* the reader went away, which is only an error if
+                 * the stream was not aborted */
+                if (errno == EPIPE || errno == ECONNRESET) {
+                    bool aborted;
+                    virMutexLock(&sp->lock);
+                    aborted = sp->abort;
+                    virMutexUnlock(&sp->lock);
+                    if (aborted)
+                        return 0;
+                }
+                virReportSystemError(errno, "%s",
+                                     _("unable to write to stream"));
+                return -1;
+            }
+            sp->offset += got;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Write @length bytes at the current offset and move past them */
+static int
+virFDStreamSparseWrite(struct virFDStreamSparse *sp,
+                       const char *buf,
+                       size_t length)
+{
+    while (length) {
+        ssize_t done;
+
+        if (sp->end && sp->offset + length > sp->end) {
+            virReportSystemError(ENOSPC, _("unable to write to '%s'"),
+                                 sp->path);
+            return -1;
+        }
+
+        if ((done = pwrite(sp->fd, buf, length, sp->offset)) < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, _("unable to write to '%s'"),
+                                 sp->path);
+            return -1;
+        }
+        buf += done;
+        length -= done;
+        sp->offset += done;
+    }
+
+    return 0;
+}
+
+
+static int
+virFDStreamSparseWriteZeros(struct virFDStreamSparse *sp,
+                            char *buf,
+                            unsigned long long offset,
+                            unsigned long long length)
+{
+    memset(buf, 0, MIN(length, SPARSE_STREAM_BUF_SIZE));
+
+    while (length) {
+        size_t want = MIN(length, SPARSE_STREAM_BUF_SIZE);
+        ssize_t done;
+
+        if ((done = pwrite(sp->fd, buf, want, offset)) < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, _("unable to write to '%s'"),
+                                 sp->path);
+            return -1;
+        }
+        offset += done;
+        length -= done;
+    }
+
+    return 0;
+}
+
+
+/* Recreate a hole received from the stream at the current offset.
+ * Within the current size of a file the range is deallocated, past
+ * it the file is merely extended. Block devices, and file systems
+ * without hole punching, get the range zeroed out instead. */
+static int
+virFDStreamSparseHole(struct virFDStreamSparse *sp,
+                      char *buf,
+                      unsigned long long length)
+{
+    unsigned long long inside = length;
+    struct stat sb;
+
+    if (!sp->isblock) {
+        if (fstat(sp->fd, &sb) < 0) {
+            virReportSystemError(errno, _("unable to stat '%s'"), sp->path);
+            return -1;
+        }
+
+        if (sp->offset >= sb.st_size)
+            inside = 0;
+        else
+            inside = MIN(length, sb.st_size - sp->offset);
+    }
+
+    if (inside) {
+        int rc = -1;
+# if HAVE_FALLOCATE - 0 && defined(FALLOC_FL_PUNCH_HOLE)
+        rc = fallocate(sp->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                       sp->offset, inside);
+# endif
+        if (rc < 0 &&
+            virFDStreamSparseWriteZeros(sp, buf, sp->offset, inside) < 0)
+            return -1;
+    }
+
+    if (inside < length &&
+        ftruncate(sp->fd, sp->offset + length) < 0) {
+        virReportSystemError(errno, _("unable to extend '%s'"), sp->path);
+        return -1;
+    }
+
+    sp->offset += length;
+    return 0;
+}
+
+
+/* Take the queued segments one at a time: data is read from the
+ * socket pair and written at the current offset, holes are punched */
+static int
+virFDStreamSparseUpload(struct virFDStreamSparse *sp, char *buf)
+{
+    for (;;) {
+        virFDStreamSegment seg;
+
+        virMutexLock(&sp->lock);
+        while (!sp->nsegs && !sp->quit)
+            ignore_value(virCondWait(&sp->cond, &sp->lock));
+        if (!sp->nsegs || sp->abort) {
+            virMutexUnlock(&sp->lock);
+            return 0;
+        }
+        seg = sp->segs[0];
+        VIR_DELETE_ELEMENT(sp->segs, 0, sp->nsegs);
+        virMutexUnlock(&sp->lock);
+
+        if (seg.hole) {
+            if (virFDStreamSparseHole(sp, buf, seg.length) < 0)
+                return -1;
+            continue;
+        }
+
+        while (seg.length) {
+            size_t want = MIN(seg.length, SPARSE_STREAM_BUF_SIZE);
+            ssize_t got;
+
+            if ((got = saferead(sp->sock, buf, want)) < 0) {
+                virReportSystemError(errno, "%s",
+                                     _("unable to read from stream"));
+                return -1;
+            }
+            if (got == 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("stream data ended unexpectedly"));
+                return -1;
+            }
+
+            if (virFDStreamSparseWrite(sp, buf, got) < 0)
+                return -1;
+            seg.length -= got;
+        }
+    }
+}
+
+
+static void
+virFDStreamSparseThread(void *opaque)
+{
+    struct virFDStreamSparse *sp = opaque;
+    char *buf = NULL;
+    int rc = -1;
+
+    if (VIR_ALLOC_N(buf, SPARSE_STREAM_BUF_SIZE) < 0)
+        goto cleanup;
+
+    if (sp->upload)
+        rc = virFDStreamSparseUpload(sp, buf);
+    else
+        rc = virFDStreamSparseDownload(sp, buf);
+
+cleanup:
+    VIR_FREE(buf);
+
+    virMutexLock(&sp->lock);
+    if (rc < 0)
+        sp->err = virSaveLastError();
+    sp->done = true;
+    /* wakes up the reader with EOF or the writer with EPIPE; a full
+     * close would raise a hangup on the stream before all the data
+     * queued in the socket was read */
+    ignore_value(shutdown(sp->sock, sp->upload ? SHUT_RD : SHUT_WR));
+    virCondBroadcast(&sp->cond);
+    virMutexUnlock(&sp->lock);
+}
+#endif /* WITH_SPARSE_STREAM */
+
+
+/* Tell the pump that no more segments follow and wait for it to
+ * finish. Returns -1 with the error set if it failed. */
+static int
+virFDStreamSparseStop(struct virFDStreamSparse *sp, bool streamAbort)
+{
+    int ret = 0;
+
+    virMutexLock(&sp->lock);
+    sp->quit = true;
+    if (streamAbort)
+        sp->abort = true;
+    virCondBroadcast(&sp->cond);
+    virMutexUnlock(&sp->lock);
+
+    if (sp->threadActive) {
+        virThreadJoin(&sp->thread);
+        sp->threadActive = false;
+    }
+
+    if (sp->err && !streamAbort) {
+        virSetError(sp->err);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+
+/* Report the error the pump finished with, if any.
+ * Must be called with sp->lock held */
+static int
+virFDStreamSparseCheckError(struct virFDStreamSparse *sp)
+{
+    if (!sp->err)
+        return 0;
+
+    virSetError(sp->err);
+    return -1;
+}
+
+
 static int
 virFDStreamCloseInt(virStreamPtr st, bool streamAbort)
 {
@@ -293,6 +753,12 @@ virFDStreamCloseInt(virStreamPtr st, bool streamAbort)
 
     /* mutex locked */
     ret = VIR_CLOSE(fdst->fd);
+    if (fdst->sparse) {
+        if (virFDStreamSparseStop(fdst->sparse, streamAbort) < 0)
+            ret = -1;
+        virFDStreamSparseFree(fdst->sparse);
+        fdst->sparse = NULL;
+    }
     if (fdst->cmd) {
         char buf[1024];
         ssize_t len;
@@ -327,6 +793,12 @@ virFDStreamCloseInt(virStreamPtr st, bool streamAbort)
     if (VIR_CLOSE(fdst->errfd) < 0)
         VIR_DEBUG("ignoring failed close on fd %d", fdst->errfd);
 
+    if (fdst->finishCb) {
+        if ((fdst->finishCb)(st, streamAbort, fdst->finishOpaque) < 0)
+            ret = -1;
+        fdst->finishCb = NULL;
+    }
+
     st->privateData = NULL;
 
     /* call the internal stream closing callback */
@@ -393,31 +865,104 @@ static int virFDStreamWrite(virStreamPtr st, const char *bytes, size_t nbytes)
     }
 
 retry:
-    ret = write(fdst->fd, bytes, nbytes);
+    if (fdst->sparse)
+        ret = send(fdst->fd, bytes, nbytes, MSG_NOSIGNAL);
+    else
+        ret = write(fdst->fd, bytes, nbytes);
     if (ret < 0) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
             ret = -2;
         } else if (errno == EINTR) {
             goto retry;
         } else {
+            int saved_errno = errno;
             ret = -1;
-            virReportSystemError(errno, "%s",
-                                 _("cannot write to stream"));
+            if (fdst->sparse) {
+                /* the pump quit, tell why */
+                virMutexLock(&fdst->sparse->lock);
+                if (virFDStreamSparseCheckError(fdst->sparse) < 0)
+                    saved_errno = 0;
+                virMutexUnlock(&fdst->sparse->lock);
+            }
+            if (saved_errno)
+                virReportSystemError(saved_errno, "%s",
+                                     _("cannot write to stream"));
         }
-    } else if (fdst->length) {
-        fdst->offset += ret;
+    } else {
+        if (fdst->length)
+            fdst->offset += ret;
+
+        if (fdst->sparse) {
+            virMutexLock(&fdst->sparse->lock);
+            if (virFDStreamSparsePush(fdst->sparse, false, ret) < 0)
+                ret = -1;
+            virMutexUnlock(&fdst->sparse->lock);
+        }
+    }
+
+    virMutexUnlock(&fdst->lock);
+    return ret;
+}
+
+
+static int
+virFDStreamSendHole(virStreamPtr st,
+                    long long length,
+                    unsigned int flags)
+{
+    struct virFDStreamData *fdst = st->privateData;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!fdst) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("stream is not open"));
+        return -1;
+    }
+
+    virMutexLock(&fdst->lock);
+
+    if (!fdst->sparse || !fdst->sparse->upload) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("stream does not support holes"));
+        goto cleanup;
+    }
+
+    if (fdst->length &&
+        (fdst->length - fdst->offset) < length) {
+        virReportSystemError(ENOSPC, "%s",
+                             _("cannot write to stream"));
+        goto cleanup;
     }
 
+    virMutexLock(&fdst->sparse->lock);
+    if (virFDStreamSparseCheckError(fdst->sparse) == 0 &&
+        virFDStreamSparsePush(fdst->sparse, true, length) == 0)
+        ret = 0;
+    virMutexUnlock(&fdst->sparse->lock);
+
+    if (ret == 0 && fdst->length)
+        fdst->offset += length;
+
+cleanup:
     virMutexUnlock(&fdst->lock);
     return ret;
 }
 
 
-static int virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
+static int
+virFDStreamReadFlags(virStreamPtr st,
+                     char *bytes,
+                     size_t nbytes,
+                     unsigned int flags)
 {
     struct virFDStreamData *fdst = st->privateData;
+    struct virFDStreamSparse *sp;
     int ret;
 
+    virCheckFlags(VIR_STREAM_RECV_STOP_AT_HOLE, -1);
+
     if (nbytes > INT_MAX) {
         virReportSystemError(ERANGE, "%s",
                              _("Too many bytes to read from stream"));
@@ -442,6 +987,42 @@ static int virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
             nbytes = fdst->length - fdst->offset;
     }
 
+    if ((sp = fdst->sparse)) {
+        virMutexLock(&sp->lock);
+
+        while (!sp->nsegs && !sp->done &&
+               !(st->flags & VIR_STREAM_NONBLOCK))
+            ignore_value(virCondWait(&sp->cond, &sp->lock));
+
+        if (!sp->nsegs) {
+            if (!sp->done)
+                ret = -2;
+            else if (virFDStreamSparseCheckError(sp) < 0)
+                ret = -1;
+            else
+                ret = 0;
+            virMutexUnlock(&sp->lock);
+            goto cleanup;
+        }
+
+        if (sp->segs[0].hole) {
+            if (flags & VIR_STREAM_RECV_STOP_AT_HOLE) {
+                ret = -3;
+            } else {
+                /* caller is not hole-aware, hand out zeros */
+                ret = MIN(nbytes, sp->segs[0].length);
+                memset(bytes, 0, ret);
+                virFDStreamSparsePop(sp, ret);
+            }
+            virMutexUnlock(&sp->lock);
+            goto cleanup;
+        }
+
+        /* never read past the data the segment covers */
+        nbytes = MIN(nbytes, sp->segs[0].length);
+        virMutexUnlock(&sp->lock);
+    }
+
 retry:
     ret = read(fdst->fd, bytes, nbytes);
     if (ret < 0) {
@@ -454,11 +1035,95 @@ retry:
             virReportSystemError(errno, "%s",
                                  _("cannot read from stream"));
         }
-    } else if (fdst->length) {
+    } else if (sp) {
+        virMutexLock(&sp->lock);
+        if (ret == 0 && virFDStreamSparseCheckError(sp) < 0)
+            ret = -1;
+        else
+            virFDStreamSparsePop(sp, ret);
+        virMutexUnlock(&sp->lock);
+    }
+
+cleanup:
+    if (ret > 0 && fdst->length)
         fdst->offset += ret;
+
+    virMutexUnlock(&fdst->lock);
+    return ret;
+}
+
+
+static int
+virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
+{
+    return virFDStreamReadFlags(st, bytes, nbytes, 0);
+}
+
+
+static int
+virFDStreamRecvHole(virStreamPtr st,
+                    long long *length,
+                    unsigned int flags)
+{
+    struct virFDStreamData *fdst = st->privateData;
+    struct virFDStreamSparse *sp;
+
+    virCheckFlags(0, -1);
+
+    if (!fdst) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("stream is not open"));
+        return -1;
     }
 
+    *length = 0;
+
+    virMutexLock(&fdst->lock);
+    if ((sp = fdst->sparse)) {
+        virMutexLock(&sp->lock);
+        if (sp->nsegs && sp->segs[0].hole) {
+            *length = sp->segs[0].length;
+            virFDStreamSparsePop(sp, *length);
+        }
+        virMutexUnlock(&sp->lock);
+    }
     virMutexUnlock(&fdst->lock);
+
+    return 0;
+}
+
+
+static int
+virFDStreamInData(virStreamPtr st,
+                  int *inData,
+                  long long *length)
+{
+    struct virFDStreamData *fdst = st->privateData;
+    struct virFDStreamSparse *sp;
+    int ret = 0;
+
+    if (!fdst) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("stream is not open"));
+        return -1;
+    }
+
+    *inData = 1;
+    *length = 0;
+
+    virMutexLock(&fdst->lock);
+    if ((sp = fdst->sparse)) {
+        virMutexLock(&sp->lock);
+        if (sp->nsegs) {
+            *inData = !sp->segs[0].hole;
+            *length = sp->segs[0].length;
+        } else if (sp->done) {
+            ret = virFDStreamSparseCheckError(sp);
+        }
+        virMutexUnlock(&sp->lock);
+    }
+    virMutexUnlock(&fdst->lock);
+
     return ret;
 }
 
@@ -466,6 +1131,10 @@ retry:
 static virStreamDriver virFDStreamDrv = {
     .streamSend = virFDStreamWrite,
     .streamRecv = virFDStreamRead,
+    .streamRecvFlags = virFDStreamReadFlags,
+    .streamSendHole = virFDStreamSendHole,
+    .streamRecvHole = virFDStreamRecvHole,
+    .streamInData = virFDStreamInData,
     .streamFinish = virFDStreamClose,
     .streamAbort = virFDStreamAbort,
     .streamEventAddCallback = virFDStreamAddCallback,
@@ -473,6 +1142,78 @@ static virStreamDriver virFDStreamDrv = {
     .streamEventRemoveCallback = virFDStreamRemoveCallback
 };
 
+/**
+ * virFDStreamRecvSplice:
+ * @st: the stream
+ * @nbytes: maximum number of bytes to hand out
+ * @fd: filled with the pipe to take the bytes from
+ *
+ * Lets the caller move stream data off the pipe the stream reads
+ * from, e.g. with splice(), instead of copying it out with
+ * virStreamRecv. Only bytes already waiting in the pipe are handed
+ * out; they count as read from the stream. @fd is a duplicate
+ * which the caller has to close.
+ *
+ * Returns the number of bytes to take from @fd, 0 if the stream
+ * is not backed by a readable pipe or has nothing buffered (use
+ * virStreamRecv then), -1 on error.
+ */
+int
+virFDStreamRecvSplice(virStreamPtr st,
+                      size_t nbytes,
+                      int *fd)
+{
+    struct virFDStreamData *fdst = st->privateData;
+    struct stat sb;
+    int avail;
+    int ret = 0;
+
+    *fd = -1;
+
+    if (st->driver != &virFDStreamDrv || !fdst)
+        return 0;
+
+    virMutexLock(&fdst->lock);
+
+    /* sparse streams have holes to report in between the data */
+    if (fdst->sparse)
+        goto cleanup;
+
+    if (fstat(fdst->fd, &sb) < 0 || !S_ISFIFO(sb.st_mode) ||
+        (fcntl(fdst->fd, F_GETFL) & O_ACCMODE) != O_RDONLY)
+        goto cleanup;
+
+    if (ioctl(fdst->fd, FIONREAD, &avail) < 0 || avail <= 0)
+        goto cleanup;
+
+    if (fdst->length) {
+        if (fdst->length == fdst->offset)
+            goto cleanup;
+
+        if ((fdst->length - fdst->offset) < nbytes)
+            nbytes = fdst->length - fdst->offset;
+    }
+
+    if (nbytes > (size_t) avail)
+        nbytes = avail;
+
+    if ((*fd = dup(fdst->fd)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to duplicate stream pipe"));
+        ret = -1;
+        goto cleanup;
+    }
+
+    if (fdst->length)
+        fdst->offset += nbytes;
+    ret = nbytes;
+
+cleanup:
+    virMutexUnlock(&fdst->lock);
+    return ret;
+}
+
+
 static int virFDStreamOpenInternal(virStreamPtr st,
                                    int fd,
                                    virCommandPtr cmd,
@@ -576,22 +1317,131 @@ int virFDStreamConnectUNIX(virStreamPtr st ATTRIBUTE_UNUSED,
 }
 #endif
 
+static struct virFDStreamSparse *
+virFDStreamSparseNew(const char *path,
+                     int fd,
+                     struct stat *sb,
+                     int oflags,
+                     unsigned long long offset,
+                     unsigned long long length)
+{
+    struct virFDStreamSparse *sp;
+    unsigned long long size = sb->st_size;
+
+    if ((oflags & O_ACCMODE) == O_RDWR) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("%s: Cannot request read and write flags together"),
+                       path);
+        return NULL;
+    }
+
+    if (S_ISBLK(sb->st_mode)) {
+        off_t end;
+
+        if ((end = lseek(fd, 0, SEEK_END)) < 0) {
+            virReportSystemError(errno,
+                                 _("Unable to get size of '%s'"), path);
+            return NULL;
+        }
+        size = end;
+    }
+
+    if (VIR_ALLOC(sp) < 0)
+        return NULL;
+
+    sp->fd = -1;
+    sp->sock = -1;
+
+    if (virMutexInit(&sp->lock) < 0) {
+        VIR_FREE(sp);
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize mutex"));
+        return NULL;
+    }
+
+    if (virCondInit(&sp->cond) < 0) {
+        virMutexDestroy(&sp->lock);
+        VIR_FREE(sp);
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize condition variable"));
+        return NULL;
+    }
+
+    if (VIR_STRDUP(sp->path, path) < 0) {
+        virFDStreamSparseFree(sp);
+        return NULL;
+    }
+
+    sp->fd = fd;
+    sp->upload = (oflags & O_ACCMODE) == O_WRONLY;
+    sp->isblock = S_ISBLK(sb->st_mode);
+    sp->offset = offset;
+    if (!sp->upload) {
+        if (length && offset + length < size)
+            sp->end = offset + length;
+        else
+            sp->end = size;
+    }
+
+    return sp;
+}
+
+
+/* Create the socket pair the data travels through and start the
+ * pump. On success, @fd is the stream end of the pair. */
+static int
+virFDStreamSparseStart(struct virFDStreamSparse *sp,
+                       int *fd)
+{
+#ifdef WITH_SPARSE_STREAM
+    int fds[2] = { -1, -1 };
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create socket pair"));
+        return -1;
+    }
+
+    sp->sock = fds[1];
+
+    if (virThreadCreate(&sp->thread, true,
+                        virFDStreamSparseThread, sp) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create sparse stream thread"));
+        VIR_FORCE_CLOSE(fds[0]);
+        return -1;
+    }
+    sp->threadActive = true;
+
+    *fd = fds[0];
+    return 0;
+#else
+    virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                   _("sparse streams are not supported on this platform"));
+    *fd = -1;
+    return -1;
+#endif
+}
+
+
 static int
 virFDStreamOpenFileInternal(virStreamPtr st,
                             const char *path,
                             unsigned long long offset,
                             unsigned long long length,
                             int oflags,
-                            int mode)
+                            int mode,
+                            bool sparse)
 {
     int fd = -1;
     int childfd = -1;
     struct stat sb;
     virCommandPtr cmd = NULL;
     int errfd = -1;
+    struct virFDStreamSparse *sp = NULL;
 
-    VIR_DEBUG("st=%p path=%s oflags=%x offset=%llu length=%llu mode=%o",
-              st, path, oflags, offset, length, mode);
+    VIR_DEBUG("st=%p path=%s oflags=%x offset=%llu length=%llu mode=%o sparse=%d",
+              st, path, oflags, offset, length, mode, sparse);
 
     oflags |= O_NOCTTY | O_BINARY;
 
@@ -621,12 +1471,23 @@ virFDStreamOpenFileInternal(virStreamPtr st,
         goto error;
     }
 
-    /* Thanks to the POSIX i/o model, we can't reliably get
-     * non-blocking I/O on block devs/regular files. To
-     * support those we need to fork a helper process to do
-     * the I/O so we just have a fifo. Or use AIO :-(
-     */
-    if ((st->flags & VIR_STREAM_NONBLOCK) &&
+    /* Holes can only be told apart on regular files and block
+     * devices. The iohelper cannot pass them on through its pipe,
+     * so a thread of ours does the I/O instead */
+    if (sparse &&
+        (S_ISREG(sb.st_mode) || S_ISBLK(sb.st_mode))) {
+        if (!(sp = virFDStreamSparseNew(path, fd, &sb, oflags,
+                                        offset, length)))
+            goto error;
+        fd = -1;
+
+        if (virFDStreamSparseStart(sp, &fd) < 0)
+            goto error;
+
+        /* the pump enforces the range itself for downloads */
+        if (!sp->upload)
+            length = 0;
+    } else if ((st->flags & VIR_STREAM_NONBLOCK) &&
         (!S_ISCHR(sb.st_mode) &&
          !S_ISFIFO(sb.st_mode))) {
         int fds[2] = { -1, -1 };
@@ -644,6 +1505,12 @@ virFDStreamOpenFileInternal(virStreamPtr st,
             goto error;
         }
 
+#ifdef F_SETPIPE_SZ
+        /* Let the pipe hold a whole iohelper buffer, so that large
+         * stream packets fill up in one go. Not fatal if refused. */
+        ignore_value(fcntl(fds[0], F_SETPIPE_SZ, 1024 * 1024));
+#endif
+
         cmd = virCommandNewArgList(iohelper_path,
                                    path,
                                    NULL);
@@ -672,11 +1539,20 @@ virFDStreamOpenFileInternal(virStreamPtr st,
     if (virFDStreamOpenInternal(st, fd, cmd, errfd, length) < 0)
         goto error;
 
+    if (sp) {
+        struct virFDStreamData *fdst = st->privateData;
+        fdst->sparse = sp;
+    }
+
     return 0;
 
 error:
     virCommandFree(cmd);
     VIR_FORCE_CLOSE(fd);
+    if (sp) {
+        ignore_value(virFDStreamSparseStop(sp, true));
+        virFDStreamSparseFree(sp);
+    }
     VIR_FORCE_CLOSE(childfd);
     VIR_FORCE_CLOSE(errfd);
     if (oflags & O_CREAT)
@@ -698,7 +1574,24 @@ int virFDStreamOpenFile(virStreamPtr st,
     }
     return virFDStreamOpenFileInternal(st, path,
                                        offset, length,
-                                       oflags, 0);
+                                       oflags, 0, false);
+}
+
+int virFDStreamOpenSparseFile(virStreamPtr st,
+                              const char *path,
+                              unsigned long long offset,
+                              unsigned long long length,
+                              int oflags)
+{
+    if (oflags & O_CREAT) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Attempt to create %s without specifying mode"),
+                       path);
+        return -1;
+    }
+    return virFDStreamOpenFileInternal(st, path,
+                                       offset, length,
+                                       oflags, 0, true);
 }
 
 int virFDStreamCreateFile(virStreamPtr st,
@@ -710,7 +1603,7 @@ int virFDStreamCreateFile(virStreamPtr st,
 {
     return virFDStreamOpenFileInternal(st, path,
                                        offset, length,
-                                       oflags | O_CREAT, mode);
+                                       oflags | O_CREAT, mode, false);
 }
 
 int virFDStreamSetInternalCloseCb(virStreamPtr st,
@@ -732,3 +1625,16 @@ int virFDStreamSetInternalCloseCb(virStreamPtr st,
     virMutexUnlock(&fdst->lock);
     return 0;
 }
+
+int virFDStreamSetInternalFinishCb(virStreamPtr st,
+                                   virFDStreamInternalFinishCb cb,
+                                   void *opaque)
+{
+    struct virFDStreamData *fdst = st->privateData;
+
+    virMutexLock(&fdst->lock);
+    fdst->finishCb = cb;
+    fdst->finishOpaque = opaque;
+    virMutexUnlock(&fdst->lock);
+    return 0;
+}
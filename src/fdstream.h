@@ -32,6 +32,13 @@ typedef void (*virFDStreamInternalCloseCb)(virStreamPtr st, void *opaque);
 
 typedef void (*virFDStreamInternalCloseCbFreeOpaque)(void *opaque);
 
+/* finish callback, called once the stream fd is closed, for streams
+ * whose data is pumped by some in-process helper instead of the
+ * iohelper; a negative return value fails the stream finish */
+typedef int (*virFDStreamInternalFinishCb)(virStreamPtr st,
+                                           bool streamAbort,
+                                           void *opaque);
+
 
 /* Only for use by test suite */
 void virFDStreamSetIOHelper(const char *path);
@@ -48,6 +55,11 @@ int virFDStreamOpenFile(virStreamPtr st,
                         unsigned long long offset,
                         unsigned long long length,
                         int oflags);
+int virFDStreamOpenSparseFile(virStreamPtr st,
+                              const char *path,
+                              unsigned long long offset,
+                              unsigned long long length,
+                              int oflags);
 int virFDStreamCreateFile(virStreamPtr st,
                           const char *path,
                           unsigned long long offset,
@@ -55,8 +67,16 @@ int virFDStreamCreateFile(virStreamPtr st,
                           int oflags,
                           mode_t mode);
 
+int virFDStreamRecvSplice(virStreamPtr st,
+                          size_t nbytes,
+                          int *fd);
+
 int virFDStreamSetInternalCloseCb(virStreamPtr st,
                                   virFDStreamInternalCloseCb cb,
                                   void *opaque,
                                   virFDStreamInternalCloseCbFreeOpaque fcb);
+
+int virFDStreamSetInternalFinishCb(virStreamPtr st,
+                                   virFDStreamInternalFinishCb cb,
+                                   void *opaque);
 #endif /* __VIR_FDSTREAM_H_ */
@@ -110,6 +110,10 @@
 
 #define MAX_DRIVERS 20
 
+/* Chunk size used by the virStream*All helpers. Remote streams
+ * split it further if the server takes only small packets. */
+#define VIR_STREAM_ALL_CHUNK (4 * 1024 * 1024)
+
 #define virDriverCheckTabMaxReturn(count, ret)                          \
     do {                                                                \
         if ((count) >= MAX_DRIVERS) {                                   \
@@ -4127,6 +4131,69 @@ error:
 }
 
 
+/**
+ * virDomainGetInfoAsync:
+ * @domain: a domain object
+ * @info: pointer to a virDomainInfo structure allocated by the user
+ * @cb: callback to invoke once the call completes
+ * @opaque: opaque data to pass to @cb
+ * @freecb: optional function to free @opaque after @cb was invoked
+ *
+ * Like virDomainGetInfo, but only sends the request and returns,
+ * without waiting for the reply. Once it arrives, @info is filled in
+ * and @cb is invoked from the event loop with the return value of
+ * virDomainGetInfo. @info must remain valid until then.
+ *
+ * This requires an event loop to have been registered with
+ * virEventRegisterImpl or virEventRegisterDefaultImpl and to be
+ * running. Only a bounded number of asynchronous calls may be
+ * outstanding on a connection at any time; once the limit is reached
+ * further calls fail until some complete.
+ *
+ * Returns 0 if the request was sent, in which case @cb will be
+ * invoked exactly once, and -1 in case of failure, in which case
+ * neither @cb nor @freecb are invoked.
+ */
+int
+virDomainGetInfoAsync(virDomainPtr domain,
+                      virDomainInfoPtr info,
+                      virConnectAsyncCallback cb,
+                      void *opaque,
+                      virFreeCallback freecb)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(domain, "info=%p, cb=%p, opaque=%p, freecb=%p",
+                     info, cb, opaque, freecb);
+
+    virResetLastError();
+
+    if (info)
+        memset(info, 0, sizeof(*info));
+
+    virCheckDomainReturn(domain, -1);
+    virCheckNonNullArgGoto(info, error);
+    virCheckNonNullArgGoto(cb, error);
+
+    conn = domain->conn;
+
+    if (conn->driver->domainGetInfoAsync) {
+        int ret;
+        ret = conn->driver->domainGetInfoAsync(domain, info,
+                                               cb, opaque, freecb);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(domain->conn);
+    return -1;
+}
+
+
 /**
  * virDomainGetState:
  * @domain: a domain object
@@ -4270,6 +4337,72 @@ error:
 }
 
 
+/**
+ * virDomainGetXMLDescAsync:
+ * @domain: a domain object
+ * @flags: bitwise-OR of virDomainXMLFlags
+ * @xml: pointer filled with the XML description
+ * @cb: callback to invoke once the call completes
+ * @opaque: opaque data to pass to @cb
+ * @freecb: optional function to free @opaque after @cb was invoked
+ *
+ * Like virDomainGetXMLDesc, but only sends the request and returns,
+ * without waiting for the reply. Once it arrives, @xml is set to the
+ * description, which the caller must free(), and @cb is invoked from
+ * the event loop with 0, or -1 in case of error. @xml must remain
+ * valid until then. See virDomainGetInfoAsync for the requirements
+ * on the event loop.
+ *
+ * Returns 0 if the request was sent, in which case @cb will be
+ * invoked exactly once, and -1 in case of failure, in which case
+ * neither @cb nor @freecb are invoked.
+ */
+int
+virDomainGetXMLDescAsync(virDomainPtr domain,
+                         unsigned int flags,
+                         char **xml,
+                         virConnectAsyncCallback cb,
+                         void *opaque,
+                         virFreeCallback freecb)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(domain, "flags=%x, xml=%p, cb=%p, opaque=%p, freecb=%p",
+                     flags, xml, cb, opaque, freecb);
+
+    virResetLastError();
+
+    virCheckDomainReturn(domain, -1);
+    virCheckNonNullArgGoto(xml, error);
+    virCheckNonNullArgGoto(cb, error);
+
+    *xml = NULL;
+    conn = domain->conn;
+
+    if ((conn->flags & VIR_CONNECT_RO) &&
+        (flags & (VIR_DOMAIN_XML_SECURE | VIR_DOMAIN_XML_MIGRATABLE))) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("virDomainGetXMLDescAsync with secure flag"));
+        goto error;
+    }
+
+    if (conn->driver->domainGetXMLDescAsync) {
+        int ret;
+        ret = conn->driver->domainGetXMLDescAsync(domain, flags, xml,
+                                                  cb, opaque, freecb);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(domain->conn);
+    return -1;
+}
+
+
 /**
  * virConnectDomainXMLFromNative:
  * @conn: a connection object
@@ -8829,6 +8962,328 @@ error:
 }
 
 
+/**
+ * virConnectGetAllDomainStats:
+ * @conn: pointer to the hypervisor connection
+ * @stats: stats to return, binary-OR of virDomainStatsTypes
+ * @retStats: Pointer that will be filled with the array of returned stats
+ * @flags: extra flags; binary-OR of virConnectGetAllDomainStatsFlags
+ *
+ * Query statistics for all domains on a given connection in a single call,
+ * instead of one call per domain and per kind of statistics.
+ *
+ * Report statistics of various parameters for a running VM according to
+ * @stats field. The statistics are returned as an array of structures for
+ * each queried domain. The structure contains an array of typed parameters
+ * containing the individual statistics. The typed parameter name for each
+ * statistic field consists of a dot-separated string containing name of the
+ * requested group followed by a group specific description of the statistic
+ * value.
+ *
+ * The statistic groups are enabled using the @stats parameter which is a
+ * binary-OR of enum virDomainStatsTypes. The following groups are available
+ * (although not necessarily implemented for each hypervisor):
+ *
+ * VIR_DOMAIN_STATS_STATE: Return domain state and reason for entering that
+ * state. The typed parameter keys are in this format:
+ * "state.state" - state of the VM, returned as int from virDomainState enum
+ * "state.reason" - reason for entering given state, returned as int from
+ *                  virDomain*Reason enum corresponding to given state.
+ *
+ * VIR_DOMAIN_STATS_CPU_TOTAL: Return CPU statistics and usage information.
+ * The typed parameter keys are in this format:
+ * "cpu.time" - total cpu time spent for this domain in nanoseconds
+ *              as unsigned long long.
+ * "cpu.user" - user cpu time spent in nanoseconds as unsigned long long.
+ * "cpu.system" - system cpu time spent in nanoseconds as unsigned long long.
+ *
+ * VIR_DOMAIN_STATS_BALLOON: Return memory balloon device information.
+ * The typed parameter keys are in this format:
+ * "balloon.current" - the memory in kiB currently used
+ *                     as unsigned long long.
+ * "balloon.maximum" - the maximum memory in kiB allowed
+ *                     as unsigned long long.
+ *
+ * VIR_DOMAIN_STATS_VCPU: Return virtual CPU statistics.
+ * The typed parameter keys are in this format:
+ * "vcpu.current" - current number of online virtual CPUs as unsigned int.
+ * "vcpu.maximum" - maximum number of online virtual CPUs as unsigned int.
+ * "vcpu.<num>.state" - state of the virtual CPU <num>, as int
+ *                      from virVcpuState enum.
+ * "vcpu.<num>.time" - virtual cpu time spent by virtual CPU <num>
+ *                     as unsigned long long.
+ *
+ * VIR_DOMAIN_STATS_INTERFACE: Return network interface statistics.
+ * The typed parameter keys are in this format:
+ * "net.count" - number of network interfaces on this domain
+ *               as unsigned int.
+ * "net.<num>.name" - name of the interface <num> as string.
+ * "net.<num>.rx.bytes" - bytes received as unsigned long long.
+ * "net.<num>.rx.pkts" - packets received as unsigned long long.
+ * "net.<num>.rx.errs" - receive errors as unsigned long long.
+ * "net.<num>.rx.drop" - receive packets dropped as unsigned long long.
+ * "net.<num>.tx.bytes" - bytes transmitted as unsigned long long.
+ * "net.<num>.tx.pkts" - packets transmitted as unsigned long long.
+ * "net.<num>.tx.errs" - transmission errors as unsigned long long.
+ * "net.<num>.tx.drop" - transmit packets dropped as unsigned long long.
+ *
+ * VIR_DOMAIN_STATS_BLOCK: Return block devices statistics.
+ * The typed parameter keys are in this format:
+ * "block.count" - number of block devices on this domain
+ *                 as unsigned int.
+ * "block.<num>.name" - name of the block device <num> as string.
+ *                      matches the target name (vda/sda/hda) of the
+ *                      block device.
+ * "block.<num>.rd.reqs" - number of read requests as unsigned long long.
+ * "block.<num>.rd.bytes" - number of read bytes as unsigned long long.
+ * "block.<num>.rd.times" - total time (ns) spent on reads as
+ *                          unsigned long long.
+ * "block.<num>.wr.reqs" - number of write requests as unsigned long long.
+ * "block.<num>.wr.bytes" - number of written bytes as unsigned long long.
+ * "block.<num>.wr.times" - total time (ns) spent on writes as
+ *                          unsigned long long.
+ * "block.<num>.fl.reqs" - total flush requests as unsigned long long.
+ * "block.<num>.fl.times" - total time (ns) spent on cache flushing as
+ *                          unsigned long long.
+ *
+ * Fields which the hypervisor cannot provide are simply omitted from the
+ * record, as are groups which cannot be gathered for a particular domain,
+ * for instance the monitor based statistics of an inactive domain.
+ *
+ * Using 0 for @stats returns all stats groups supported by the given
+ * hypervisor.
+ *
+ * Specifying VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS as @flags makes
+ * the function return error in case some of the stat types in @stats were
+ * not recognized by the daemon.
+ *
+ * Similarly to virConnectListAllDomains, @flags can contain various flags to
+ * filter the list of domains to provide stats for.
+ *
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_ACTIVE selects online domains while
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_INACTIVE selects offline ones.
+ *
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_PERSISTENT and
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_TRANSIENT allow to filter the list
+ * according to their persistence.
+ *
+ * To filter the list of VMs by domain state @flags can contain
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_RUNNING,
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_PAUSED,
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_SHUTOFF and/or
+ * VIR_CONNECT_GET_ALL_DOMAINS_STATS_OTHER for all other states.
+ *
+ * Returns the count of returned statistics structures on success, -1 on error.
+ * The requested data are returned in the @retStats parameter. The returned
+ * array should be freed by the caller. See virDomainStatsRecordListFree.
+ */
+int
+virConnectGetAllDomainStats(virConnectPtr conn,
+                            unsigned int stats,
+                            virDomainStatsRecordPtr **retStats,
+                            unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, stats=0x%x, retStats=%p, flags=0x%x",
+              conn, stats, retStats, flags);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(retStats, cleanup);
+
+    *retStats = NULL;
+
+    if (!conn->driver->connectGetAllDomainStats) {
+        virReportUnsupportedError();
+        goto cleanup;
+    }
+
+    ret = conn->driver->connectGetAllDomainStats(conn, NULL, 0, stats,
+                                                 retStats, flags);
+
+cleanup:
+    if (ret < 0)
+        virDispatchError(conn);
+
+    return ret;
+}
+
+
+/**
+ * virDomainListGetStats:
+ * @doms: NULL terminated array of domains
+ * @stats: stats to return, binary-OR of virDomainStatsTypes
+ * @retStats: Pointer that will be filled with the array of returned stats
+ * @flags: extra flags; binary-OR of virConnectGetAllDomainStatsFlags
+ *
+ * Query statistics for domains provided by @doms. Note that all domains in
+ * @doms must share the same connection.
+ *
+ * Report statistics of various parameters for a running VM according to
+ * @stats field. The statistics are returned as an array of structures for
+ * each queried domain. See virConnectGetAllDomainStats for the description
+ * of the statistic groups and of the returned fields.
+ *
+ * The domain state filtering flags of virConnectGetAllDomainStats are not
+ * supported by this API, only VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS
+ * is accepted in @flags.
+ *
+ * Returns the count of returned statistics structures on success, -1 on error.
+ * The requested data are returned in the @retStats parameter. The returned
+ * array should be freed by the caller. See virDomainStatsRecordListFree.
+ * Note that the count of returned stats may be less than the domain count
+ * provided via @doms.
+ */
+int
+virDomainListGetStats(virDomainPtr *doms,
+                      unsigned int stats,
+                      virDomainStatsRecordPtr **retStats,
+                      unsigned int flags)
+{
+    virConnectPtr conn = NULL;
+    virDomainPtr *nextdom = doms;
+    unsigned int ndoms = 0;
+    int ret = -1;
+
+    VIR_DEBUG("doms=%p, stats=0x%x, retStats=%p, flags=0x%x",
+              doms, stats, retStats, flags);
+
+    virResetLastError();
+
+    virCheckNonNullArgGoto(doms, cleanup);
+    virCheckNonNullArgGoto(retStats, cleanup);
+
+    if (!*doms) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("doms array in %s must contain at least one domain"),
+                       __FUNCTION__);
+        goto cleanup;
+    }
+
+    *retStats = NULL;
+
+    conn = doms[0]->conn;
+    virCheckConnectReturn(conn, -1);
+
+    if (!conn->driver->connectGetAllDomainStats) {
+        virReportUnsupportedError();
+        goto cleanup;
+    }
+
+    while (*nextdom) {
+        virDomainPtr dom = *nextdom;
+
+        virCheckDomainGoto(dom, cleanup);
+
+        if (dom->conn != conn) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("domains in 'doms' array must belong to a "
+                             "single connection in %s"), __FUNCTION__);
+            goto cleanup;
+        }
+
+        ndoms++;
+        nextdom++;
+    }
+
+    ret = conn->driver->connectGetAllDomainStats(conn, doms, ndoms,
+                                                 stats, retStats, flags);
+
+cleanup:
+    if (ret < 0)
+        virDispatchError(conn);
+    return ret;
+}
+
+
+/**
+ * virConnectGetAllDomainStatsAsync:
+ * @conn: pointer to the hypervisor connection
+ * @stats: stats to return, binary-OR of virDomainStatsTypes
+ * @retStats: Pointer that will be filled with the array of returned stats
+ * @flags: extra flags; binary-OR of virConnectGetAllDomainStatsFlags
+ * @cb: callback to invoke once the call completes
+ * @opaque: opaque data to pass to @cb
+ * @freecb: optional function to free @opaque after @cb was invoked
+ *
+ * Like virConnectGetAllDomainStats, but only sends the request and
+ * returns, without waiting for the reply. Once it arrives, @retStats
+ * is filled in and @cb is invoked from the event loop with the return
+ * value of virConnectGetAllDomainStats. @retStats must remain valid
+ * until then. See virDomainGetInfoAsync for the requirements on the
+ * event loop.
+ *
+ * Returns 0 if the request was sent, in which case @cb will be
+ * invoked exactly once, and -1 in case of failure, in which case
+ * neither @cb nor @freecb are invoked.
+ */
+int
+virConnectGetAllDomainStatsAsync(virConnectPtr conn,
+                                 unsigned int stats,
+                                 virDomainStatsRecordPtr **retStats,
+                                 unsigned int flags,
+                                 virConnectAsyncCallback cb,
+                                 void *opaque,
+                                 virFreeCallback freecb)
+{
+    int ret = -1;
+
+    VIR_DEBUG("conn=%p, stats=0x%x, retStats=%p, flags=0x%x, "
+              "cb=%p, opaque=%p, freecb=%p",
+              conn, stats, retStats, flags, cb, opaque, freecb);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(retStats, cleanup);
+    virCheckNonNullArgGoto(cb, cleanup);
+
+    *retStats = NULL;
+
+    if (!conn->driver->connectGetAllDomainStatsAsync) {
+        virReportUnsupportedError();
+        goto cleanup;
+    }
+
+    ret = conn->driver->connectGetAllDomainStatsAsync(conn, stats, retStats,
+                                                      flags, cb, opaque,
+                                                      freecb);
+
+cleanup:
+    if (ret < 0)
+        virDispatchError(conn);
+
+    return ret;
+}
+
+
+/**
+ * virDomainStatsRecordListFree:
+ * @stats: NULL terminated array of virDomainStatsRecords to free
+ *
+ * Convenience function to free a list of domain stats returned by
+ * virDomainListGetStats and virConnectGetAllDomainStats.
+ */
+void
+virDomainStatsRecordListFree(virDomainStatsRecordPtr *stats)
+{
+    virDomainStatsRecordPtr *next;
+
+    if (!stats)
+        return;
+
+    for (next = stats; *next; next++) {
+        virTypedParamsFree((*next)->params, (*next)->nparams);
+        virDomainFree((*next)->dom);
+        VIR_FREE(*next);
+    }
+
+    VIR_FREE(stats);
+}
+
+
 /**
  * virDomainCreate:
  * @domain: pointer to a defined domain
@@ -12731,6 +13186,12 @@ error:
  *
  * Build the underlying storage pool
  *
+ * With VIR_STORAGE_POOL_BUILD_ASYNC in @flags, the call returns as soon
+ * as the build has been queued as a storage job. The pool reports
+ * VIR_STORAGE_POOL_BUILDING from virStoragePoolGetInfo() until the job
+ * finishes, which is announced by the
+ * VIR_STORAGE_POOL_EVENT_ID_JOB_COMPLETED event.
+ *
  * Returns 0 on success, or -1 upon failure
  */
 int
@@ -13577,6 +14038,11 @@ virStorageVolGetKey(virStorageVolPtr vol)
  * qcow2 image files which don't support full preallocation,
  * by creating a sparse image file with metadata.
  *
+ * With VIR_STORAGE_VOL_CREATE_ASYNC in @flags, the volume is returned
+ * as soon as it is defined and its allocation continues as a storage
+ * job, see virStorageVolGetJobStats(). If the job fails or is aborted,
+ * the volume is deleted again.
+ *
  * Returns the storage volume, or NULL on error
  */
 virStorageVolPtr
@@ -13625,6 +14091,11 @@ error:
  * qcow2 image files which don't support full preallocation,
  * by creating a sparse image file with metadata.
  *
+ * With VIR_STORAGE_VOL_CREATE_ASYNC in @flags, the volume is returned
+ * as soon as it is defined and the copy continues as a storage job,
+ * see virStorageVolGetJobStats(). If the job fails or is aborted, the
+ * volume is deleted again.
+ *
  * Returns the storage volume, or NULL on error
  */
 virStorageVolPtr
@@ -13667,12 +14138,19 @@ error:
  * @stream: stream to use as output
  * @offset: position in @vol to start reading from
  * @length: limit on amount of data to download
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virStorageVolDownloadFlags
  *
  * Download the content of the volume as a stream. If @length
  * is zero, then the remaining contents of the volume after
  * @offset will be downloaded.
  *
+ * If VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM is set in @flags,
+ * holes in the volume are not transferred as zeros but announced
+ * as holes on the stream, to be consumed with virStreamRecvFlags()
+ * and virStreamRecvHole() or virStreamSparseRecvAll(). Callers
+ * which read the stream with plain virStreamRecv() receive the
+ * holes as zeros.
+ *
  * This call sets up an asynchronous stream; subsequent use of
  * stream APIs is necessary to transfer the actual data,
  * determine how much data is successfully transferred, and
@@ -13731,7 +14209,7 @@ error:
  * @stream: stream to use as input
  * @offset: position to start writing to
  * @length: limit on amount of data to upload
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virStorageVolUploadFlags
  *
  * Upload new content to the volume from a stream. This call
  * will fail if @offset + @length exceeds the size of the
@@ -13739,6 +14217,11 @@ error:
  * will be raised if an attempt is made to upload greater
  * than @length bytes of data.
  *
+ * If VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM is set in @flags,
+ * the stream accepts holes sent with virStreamSendHole() or
+ * virStreamSparseSendAll(), which are punched into the volume
+ * instead of being written out as zeros.
+ *
  * This call sets up an asynchronous stream; subsequent use of
  * stream APIs is necessary to transfer the actual data,
  * determine how much data is successfully transferred, and
@@ -13833,10 +14316,14 @@ error:
 /**
  * virStorageVolWipe:
  * @vol: pointer to storage volume
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virStorageVolWipeFlags
  *
  * Ensure data previously on a volume is not accessible to future reads
  *
+ * With VIR_STORAGE_VOL_WIPE_ASYNC in @flags, the call returns as soon
+ * as the wipe has been queued as a storage job, see
+ * virStorageVolGetJobStats().
+ *
  * Returns 0 on success, or -1 on error
  */
 int
@@ -13874,7 +14361,7 @@ error:
  * virStorageVolWipePattern:
  * @vol: pointer to storage volume
  * @algorithm: one of virStorageVolWipeAlgorithm
- * @flags: future flags, use 0 for now
+ * @flags: bitwise-OR of virStorageVolWipeFlags
  *
  * Similar to virStorageVolWipe, but one can choose
  * between different wiping algorithms.
@@ -14164,30 +14651,48 @@ error:
 
 
 /**
- * virNodeNumOfDevices:
- * @conn: pointer to the hypervisor connection
- * @cap: capability name
+ * virStorageVolGetJobStats:
+ * @vol: pointer to storage volume
+ * @type: where to store the job type (one of virStorageJobType)
+ * @params: where to store job statistics
+ * @nparams: number of items in @params
  * @flags: extra flags; not used yet, so callers should always pass 0
  *
- * Provides the number of node devices.
- *
- * If the optional 'cap'  argument is non-NULL, then the count
- * will be restricted to devices with the specified capability
+ * Extract information about the storage job working on @vol, that is
+ * the allocation of a new volume, a clone into it or a wipe. If no job
+ * is queued or running for the volume, @type is set to
+ * VIR_STORAGE_JOB_NONE and no statistics are returned. Possible fields
+ * returned in @params are defined by VIR_STORAGE_JOB_* macros and new
+ * fields will likely be introduced in the future so callers may receive
+ * fields that they do not understand in case they talk to a newer
+ * server. The caller must free @params with virTypedParamsFree().
  *
- * Returns the number of node devices or -1 in case of error
+ * Returns 0 in case of success and -1 in case of failure.
  */
 int
-virNodeNumOfDevices(virConnectPtr conn, const char *cap, unsigned int flags)
+virStorageVolGetJobStats(virStorageVolPtr vol,
+                         int *type,
+                         virTypedParameterPtr *params,
+                         int *nparams,
+                         unsigned int flags)
 {
-    VIR_DEBUG("conn=%p, cap=%s, flags=%x", conn, NULLSTR(cap), flags);
+    virConnectPtr conn;
+    VIR_DEBUG("vol=%p, type=%p, params=%p, nparams=%p, flags=%x",
+              vol, type, params, nparams, flags);
 
     virResetLastError();
 
-    virCheckConnectReturn(conn, -1);
+    virCheckStorageVolReturn(vol, -1);
+    virCheckNonNullArgGoto(type, error);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNullArgGoto(nparams, error);
 
-    if (conn->nodeDeviceDriver && conn->nodeDeviceDriver->nodeNumOfDevices) {
+    conn = vol->conn;
+
+    if (conn->storageDriver && conn->storageDriver->storageVolGetJobStats) {
         int ret;
-        ret = conn->nodeDeviceDriver->nodeNumOfDevices(conn, cap, flags);
+        ret = conn->storageDriver->storageVolGetJobStats(vol, type, params,
+                                                         nparams, flags);
         if (ret < 0)
             goto error;
         return ret;
@@ -14196,44 +14701,125 @@ virNodeNumOfDevices(virConnectPtr conn, const char *cap, unsigned int flags)
     virReportUnsupportedError();
 
 error:
-    virDispatchError(conn);
+    virDispatchError(vol->conn);
     return -1;
 }
 
 
 /**
- * virConnectListAllNodeDevices:
- * @conn: Pointer to the hypervisor connection.
- * @devices: Pointer to a variable to store the array containing the node
- *           device objects or NULL if the list is not required (just returns
- *           number of node devices).
- * @flags: bitwise-OR of virConnectListAllNodeDevices.
- *
- * Collect the list of node devices, and allocate an array to store those
- * objects.
- *
- * Normally, all node devices are returned; however, @flags can be used to
- * filter the results for a smaller list of targeted node devices.  The valid
- * flags are divided into groups, where each group contains bits that
- * describe mutually exclusive attributes of a node device, and where all bits
- * within a group describe all possible node devices.
+ * virStorageVolAbortJob:
+ * @vol: pointer to storage volume
+ * @flags: extra flags; not used yet, so callers should always pass 0
  *
- * Only one group of the @flags is provided to filter the node devices by
- * capability type, flags include:
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SYSTEM
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_PCI_DEV
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_USB_DEV
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_USB_INTERFACE
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_NET
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI_HOST
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI_TARGET
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_STORAGE
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_FC_HOST
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_VPORTS
- *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI_GENERIC
+ * Requests that the storage job working on @vol be aborted at the
+ * soonest opportunity. A job which is still queued never starts. An
+ * aborted allocation or clone deletes the new volume, an aborted wipe
+ * leaves the volume partially wiped. Jobs handed to external tools
+ * only notice the request once the tool finishes.
  *
- * Returns the number of node devices found or -1 and sets @devices to NULL in
+ * Returns 0 in case of success and -1 in case of failure.
+ */
+int
+virStorageVolAbortJob(virStorageVolPtr vol,
+                      unsigned int flags)
+{
+    virConnectPtr conn;
+    VIR_DEBUG("vol=%p, flags=%x", vol, flags);
+
+    virResetLastError();
+
+    virCheckStorageVolReturn(vol, -1);
+    conn = vol->conn;
+
+    virCheckReadOnlyGoto(conn->flags, error);
+
+    if (conn->storageDriver && conn->storageDriver->storageVolAbortJob) {
+        int ret;
+        ret = conn->storageDriver->storageVolAbortJob(vol, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(vol->conn);
+    return -1;
+}
+
+
+/**
+ * virNodeNumOfDevices:
+ * @conn: pointer to the hypervisor connection
+ * @cap: capability name
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Provides the number of node devices.
+ *
+ * If the optional 'cap'  argument is non-NULL, then the count
+ * will be restricted to devices with the specified capability
+ *
+ * Returns the number of node devices or -1 in case of error
+ */
+int
+virNodeNumOfDevices(virConnectPtr conn, const char *cap, unsigned int flags)
+{
+    VIR_DEBUG("conn=%p, cap=%s, flags=%x", conn, NULLSTR(cap), flags);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+
+    if (conn->nodeDeviceDriver && conn->nodeDeviceDriver->nodeNumOfDevices) {
+        int ret;
+        ret = conn->nodeDeviceDriver->nodeNumOfDevices(conn, cap, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
+/**
+ * virConnectListAllNodeDevices:
+ * @conn: Pointer to the hypervisor connection.
+ * @devices: Pointer to a variable to store the array containing the node
+ *           device objects or NULL if the list is not required (just returns
+ *           number of node devices).
+ * @flags: bitwise-OR of virConnectListAllNodeDevices.
+ *
+ * Collect the list of node devices, and allocate an array to store those
+ * objects.
+ *
+ * Normally, all node devices are returned; however, @flags can be used to
+ * filter the results for a smaller list of targeted node devices.  The valid
+ * flags are divided into groups, where each group contains bits that
+ * describe mutually exclusive attributes of a node device, and where all bits
+ * within a group describe all possible node devices.
+ *
+ * Only one group of the @flags is provided to filter the node devices by
+ * capability type, flags include:
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SYSTEM
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_PCI_DEV
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_USB_DEV
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_USB_INTERFACE
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_NET
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI_HOST
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI_TARGET
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_STORAGE
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_FC_HOST
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_VPORTS
+ *   VIR_CONNECT_LIST_NODE_DEVICES_CAP_SCSI_GENERIC
+ *
+ * Returns the number of node devices found or -1 and sets @devices to NULL in
  * case of error.  On success, the array stored into @devices is guaranteed to
  * have an extra allocated element set to NULL but not included in the return
  * count, to make iteration easier.  The caller is responsible for calling
@@ -15872,39 +16458,391 @@ virStreamRecv(virStreamPtr stream,
     virResetLastError();
 
     virCheckStreamReturn(stream, -1);
-    virCheckNonNullArgGoto(data, error);
+    virCheckNonNullArgGoto(data, error);
+
+    if (stream->driver &&
+        stream->driver->streamRecv) {
+        int ret;
+        ret = (stream->driver->streamRecv)(stream, data, nbytes);
+        if (ret == -2)
+            return -2;
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
+
+/**
+ * virStreamRecvFlags:
+ * @stream: pointer to the stream object
+ * @data: buffer to read into from stream
+ * @nbytes: size of @data buffer
+ * @flags: bitwise-OR of virStreamRecvFlagsValues
+ *
+ * Reads a series of bytes from the stream. This method may
+ * block the calling application for an arbitrary amount
+ * of time.
+ *
+ * This is just like virStreamRecv except this one has extra
+ * @flags. Calling this function with no @flags set is equivalent
+ * to calling virStreamRecv(stream, data, nbytes).
+ *
+ * If flag VIR_STREAM_RECV_STOP_AT_HOLE is set, this function will
+ * stop reading from stream if it has reached a hole. In that case,
+ * -3 is returned and virStreamRecvHole() should be called to get
+ * the hole size. An example using this flag might look like this:
+ *
+ *     while (1) {
+ *         char buf[4096];
+ *         long long len;
+ *
+ *         int got = virStreamRecvFlags(st, buf, sizeof(buf),
+ *                                      VIR_STREAM_RECV_STOP_AT_HOLE);
+ *         if (got == -3) {
+ *             if (virStreamRecvHole(st, &len, 0) < 0)
+ *                 goto error;
+ *             lseek(fd, len, SEEK_CUR);
+ *             continue;
+ *         }
+ *         if (got <= 0)
+ *             break;
+ *         ... write the @got bytes to fd ...
+ *     }
+ *
+ * Without VIR_STREAM_RECV_STOP_AT_HOLE, holes in the stream are
+ * returned as zeros.
+ *
+ * Returns the number of bytes read, which may be less
+ * than requested.
+ *
+ * Returns 0 when the end of the stream is reached, at
+ * which time the caller should invoke virStreamFinish()
+ * to get confirmation of stream completion.
+ *
+ * Returns -1 upon error, at which time the stream will
+ * be marked as aborted, and the caller should now release
+ * the stream with virStreamFree.
+ *
+ * Returns -2 if there is no data pending to be read & the
+ * stream is marked as non-blocking.
+ *
+ * Returns -3 if there is a hole in stream and caller requested
+ * to stop at a hole.
+ */
+int
+virStreamRecvFlags(virStreamPtr stream,
+                   char *data,
+                   size_t nbytes,
+                   unsigned int flags)
+{
+    VIR_DEBUG("stream=%p, data=%p, nbytes=%zu, flags=%x",
+              stream, data, nbytes, flags);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    virCheckNonNullArgGoto(data, error);
+
+    if (stream->driver &&
+        stream->driver->streamRecvFlags) {
+        int ret;
+        ret = (stream->driver->streamRecvFlags)(stream, data, nbytes, flags);
+        if (ret == -2 || ret == -3)
+            return ret;
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    /* A driver without hole support never stops at a hole, so
+     * plain reads are all we need */
+    if (stream->driver &&
+        stream->driver->streamRecv) {
+        int ret;
+        virCheckFlagsGoto(VIR_STREAM_RECV_STOP_AT_HOLE, error);
+        ret = (stream->driver->streamRecv)(stream, data, nbytes);
+        if (ret == -2)
+            return -2;
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
+
+/**
+ * virStreamSendHole:
+ * @stream: pointer to the stream object
+ * @length: number of bytes to skip
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Rather than transmitting empty file space, this API directs
+ * the @stream target to create @length bytes of empty space.
+ * This API would be used when uploading or downloading sparsely
+ * populated files to avoid the needless copy of empty file
+ * space.
+ *
+ * The stream must have been set up with a sparse upload, see
+ * VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStreamSendHole(virStreamPtr stream,
+                  long long length,
+                  unsigned int flags)
+{
+    VIR_DEBUG("stream=%p, length=%lld flags=%x",
+              stream, length, flags);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    if (length < 0) {
+        virReportInvalidArg(length,
+                            _("length in %s must be non-negative"),
+                            __FUNCTION__);
+        goto error;
+    }
+
+    if (stream->driver &&
+        stream->driver->streamSendHole) {
+        int ret;
+        ret = (stream->driver->streamSendHole)(stream, length, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
+
+/**
+ * virStreamRecvHole:
+ * @stream: pointer to the stream object
+ * @length: number of bytes to skip
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * This API is used to determine the @length in bytes of the
+ * empty space to be created in a @stream's target file when
+ * uploading or downloading sparsely populated files. This is the
+ * counterpart to virStreamSendHole(). The hole is consumed from
+ * the stream, so the next read continues with the data following
+ * it. If the stream is not currently positioned at a hole, @length
+ * is set to 0.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStreamRecvHole(virStreamPtr stream,
+                  long long *length,
+                  unsigned int flags)
+{
+    VIR_DEBUG("stream=%p, length=%p flags=%x",
+              stream, length, flags);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    virCheckNonNullArgGoto(length, error);
+
+    if (stream->driver &&
+        stream->driver->streamRecvHole) {
+        int ret;
+        ret = (stream->driver->streamRecvHole)(stream, length, flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
+
+/**
+ * virStreamInData:
+ * @stream: stream
+ * @inData: are we in data or hole
+ * @length: length to next section
+ *
+ * This function checks the underlying stream (typically a file)
+ * to learn whether the current stream position lies within a
+ * data section or a hole. Upon return @inData is set to a
+ * nonzero value if the former is the case, or to zero otherwise.
+ * Moreover, @length is updated to tell caller how many bytes can
+ * be read from stream until current section changes (from data
+ * to a hole or vice versa). A @length of zero means the size of
+ * the current section is not known yet, e.g. because no data has
+ * been produced so far or the end of the stream was reached.
+ *
+ * As a special case, streams which do not track holes always
+ * report to be in data with unknown @length.
+ *
+ * Returns 0 on success,
+ *        -1 otherwise
+ */
+int
+virStreamInData(virStreamPtr stream,
+                int *inData,
+                long long *length)
+{
+    VIR_DEBUG("stream=%p, inData=%p, length=%p", stream, inData, length);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    virCheckNonNullArgGoto(inData, error);
+    virCheckNonNullArgGoto(length, error);
+
+    if (stream->driver &&
+        stream->driver->streamInData) {
+        int ret;
+        ret = (stream->driver->streamInData)(stream, inData, length);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    *inData = 1;
+    *length = 0;
+    return 0;
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
+
+/**
+ * virStreamSendAll:
+ * @stream: pointer to the stream object
+ * @handler: source callback for reading data from application
+ * @opaque: application defined data
+ *
+ * Send the entire data stream, reading the data from the
+ * requested data source. This is simply a convenient alternative
+ * to virStreamSend, for apps that do blocking-I/O.
+ *
+ * An example using this with a hypothetical file upload
+ * API looks like
+ *
+ *   int mysource(virStreamPtr st, char *buf, int nbytes, void *opaque) {
+ *       int *fd = opaque;
+ *
+ *       return read(*fd, buf, nbytes);
+ *   }
+ *
+ *   virStreamPtr st = virStreamNew(conn, 0);
+ *   int fd = open("demo.iso", O_RDONLY);
+ *
+ *   virConnectUploadFile(conn, st);
+ *   if (virStreamSendAll(st, mysource, &fd) < 0) {
+ *      ...report an error ...
+ *      goto done;
+ *   }
+ *   if (virStreamFinish(st) < 0)
+ *      ...report an error...
+ *   virStreamFree(st);
+ *   close(fd);
+ *
+ * Returns 0 if all the data was successfully sent. The caller
+ * should invoke virStreamFinish(st) to flush the stream upon
+ * success and then virStreamFree
+ *
+ * Returns -1 upon any error, with virStreamAbort() already
+ * having been called,  so the caller need only call
+ * virStreamFree()
+ */
+int
+virStreamSendAll(virStreamPtr stream,
+                 virStreamSourceFunc handler,
+                 void *opaque)
+{
+    char *bytes = NULL;
+    int want = VIR_STREAM_ALL_CHUNK;
+    int ret = -1;
+    VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    virCheckNonNullArgGoto(handler, cleanup);
 
-    if (stream->driver &&
-        stream->driver->streamRecv) {
-        int ret;
-        ret = (stream->driver->streamRecv)(stream, data, nbytes);
-        if (ret == -2)
-            return -2;
-        if (ret < 0)
-            goto error;
-        return ret;
+    if (stream->flags & VIR_STREAM_NONBLOCK) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("data sources cannot be used for non-blocking streams"));
+        goto cleanup;
     }
 
-    virReportUnsupportedError();
+    if (VIR_ALLOC_N(bytes, want) < 0)
+        goto cleanup;
 
-error:
-    virDispatchError(stream->conn);
-    return -1;
+    for (;;) {
+        int got, offset = 0;
+        got = (handler)(stream, bytes, want, opaque);
+        if (got < 0) {
+            virStreamAbort(stream);
+            goto cleanup;
+        }
+        if (got == 0)
+            break;
+        while (offset < got) {
+            int done;
+            done = virStreamSend(stream, bytes + offset, got - offset);
+            if (done < 0)
+                goto cleanup;
+            offset += done;
+        }
+    }
+    ret = 0;
+
+cleanup:
+    VIR_FREE(bytes);
+
+    if (ret != 0)
+        virDispatchError(stream->conn);
+
+    return ret;
 }
 
 
 /**
- * virStreamSendAll:
+ * virStreamSparseSendAll:
  * @stream: pointer to the stream object
  * @handler: source callback for reading data from application
+ * @holeHandler: source callback for determining holes
+ * @skipHandler: skip holes as reported by @holeHandler
  * @opaque: application defined data
  *
  * Send the entire data stream, reading the data from the
  * requested data source. This is simply a convenient alternative
- * to virStreamSend, for apps that do blocking-I/O.
+ * to virStreamSend, for apps that do blocking-I/O and want to
+ * preserve the sparseness of the source.
  *
- * An example using this with a hypothetical file upload
- * API looks like
+ * An example using this with a hypothetical file upload API
+ * looks like:
  *
  *   int mysource(virStreamPtr st, char *buf, int nbytes, void *opaque) {
  *       int *fd = opaque;
@@ -15912,11 +16850,37 @@ error:
  *       return read(*fd, buf, nbytes);
  *   }
  *
+ *   int myskip(virStreamPtr st, long long offset, void *opaque) {
+ *       int *fd = opaque;
+ *
+ *       return lseek(*fd, offset, SEEK_CUR) == (off_t) -1 ? -1 : 0;
+ *   }
+ *
+ *   int myindata(virStreamPtr st, int *inData,
+ *                long long *offset, void *opaque) {
+ *       int *fd = opaque;
+ *
+ *       if (@fd in hole) {
+ *           *inData = 0;
+ *           *offset = holeSize;
+ *       } else {
+ *           *inData = 1;
+ *           *offset = dataSize;
+ *       }
+ *
+ *       return 0;
+ *   }
+ *
  *   virStreamPtr st = virStreamNew(conn, 0);
  *   int fd = open("demo.iso", O_RDONLY);
  *
- *   virConnectUploadFile(conn, st);
- *   if (virStreamSendAll(st, mysource, &fd) < 0) {
+ *   virStorageVolUpload(vol, st, 0, 0,
+ *                       VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM);
+ *   if (virStreamSparseSendAll(st,
+ *                              mysource,
+ *                              myindata,
+ *                              myskip,
+ *                              &fd) < 0) {
  *      ...report an error ...
  *      goto done;
  *   }
@@ -15925,28 +16889,38 @@ error:
  *   virStreamFree(st);
  *   close(fd);
  *
+ * Note that @holeHandler is expected to return the size of the
+ * current section, and the data handler is never asked for more
+ * bytes than that.
+ *
  * Returns 0 if all the data was successfully sent. The caller
  * should invoke virStreamFinish(st) to flush the stream upon
- * success and then virStreamFree
+ * success and then virStreamFree.
  *
  * Returns -1 upon any error, with virStreamAbort() already
- * having been called,  so the caller need only call
- * virStreamFree()
+ * having been called, so the caller need only call
+ * virStreamFree().
  */
 int
-virStreamSendAll(virStreamPtr stream,
-                 virStreamSourceFunc handler,
-                 void *opaque)
+virStreamSparseSendAll(virStreamPtr stream,
+                       virStreamSourceFunc handler,
+                       virStreamSourceHoleFunc holeHandler,
+                       virStreamSourceSkipFunc skipHandler,
+                       void *opaque)
 {
     char *bytes = NULL;
-    int want = 1024*64;
+    size_t want = VIR_STREAM_ALL_CHUNK;
     int ret = -1;
-    VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
+    long long dataLen = 0;
+    VIR_DEBUG("stream=%p, handler=%p, holeHandler=%p, skipHandler=%p, opaque=%p",
+              stream, handler, holeHandler, skipHandler, opaque);
 
     virResetLastError();
 
     virCheckStreamReturn(stream, -1);
     virCheckNonNullArgGoto(handler, cleanup);
+    virCheckNonNullArgGoto(holeHandler, cleanup);
+    virCheckNonNullArgGoto(skipHandler, cleanup);
 
     if (stream->flags & VIR_STREAM_NONBLOCK) {
         virReportError(VIR_ERR_OPERATION_INVALID, "%s",
@@ -15958,8 +16932,37 @@ virStreamSendAll(virStreamPtr stream,
         goto cleanup;
 
     for (;;) {
-        int got, offset = 0;
-        got = (handler)(stream, bytes, want, opaque);
+        int inData, got, offset = 0;
+        long long sectionLen;
+        size_t len;
+
+        if (!dataLen) {
+            if (holeHandler(stream, &inData, &sectionLen, opaque) < 0) {
+                virStreamAbort(stream);
+                goto cleanup;
+            }
+
+            if (!inData && sectionLen) {
+                if (virStreamSendHole(stream, sectionLen, 0) < 0)
+                    goto cleanup;
+
+                if (skipHandler(stream, sectionLen, opaque) < 0) {
+                    virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                                   _("unable to skip hole"));
+                    virStreamAbort(stream);
+                    goto cleanup;
+                }
+                continue;
+            } else {
+                dataLen = sectionLen;
+            }
+        }
+
+        len = want;
+        if (dataLen && len > dataLen)
+            len = dataLen;
+
+        got = (handler)(stream, bytes, len, opaque);
         if (got < 0) {
             virStreamAbort(stream);
             goto cleanup;
@@ -15973,6 +16976,8 @@ virStreamSendAll(virStreamPtr stream,
                 goto cleanup;
             offset += done;
         }
+        if (dataLen)
+            dataLen -= got;
     }
     ret = 0;
 
@@ -16032,7 +17037,7 @@ virStreamRecvAll(virStreamPtr stream,
                  void *opaque)
 {
     char *bytes = NULL;
-    int want = 1024*64;
+    int want = VIR_STREAM_ALL_CHUNK;
     int ret = -1;
     VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
 
@@ -16080,6 +17085,130 @@ cleanup:
 }
 
 
+/**
+ * virStreamSparseRecvAll:
+ * @stream: pointer to the stream object
+ * @handler: sink callback for writing data to application
+ * @holeHandler: stream hole callback for skipping holes
+ * @opaque: application defined data
+ *
+ * Receive the entire data stream, sending the data to the
+ * requested data sink @handler and calling the skip @holeHandler
+ * to generate holes for sparse stream targets. This is simply a
+ * convenient alternative to virStreamRecvFlags, for apps that do
+ * blocking-I/O.
+ *
+ * An example using this with a hypothetical file download
+ * API looks like:
+ *
+ *   int mysink(virStreamPtr st, const char *buf, int nbytes, void *opaque) {
+ *       int *fd = opaque;
+ *
+ *       return write(*fd, buf, nbytes);
+ *   }
+ *
+ *   int myskip(virStreamPtr st, long long offset, void *opaque) {
+ *       int *fd = opaque;
+ *
+ *       return lseek(*fd, offset, SEEK_CUR) == (off_t) -1 ? -1 : 0;
+ *   }
+ *
+ *   virStreamPtr st = virStreamNew(conn, 0);
+ *   int fd = open("demo.iso", O_WRONLY);
+ *
+ *   virStorageVolDownload(vol, st, 0, 0,
+ *                         VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM);
+ *   if (virStreamSparseRecvAll(st, mysink, myskip, &fd) < 0) {
+ *      ...report an error ...
+ *      goto done;
+ *   }
+ *   if (virStreamFinish(st) < 0)
+ *      ...report an error...
+ *   virStreamFree(st);
+ *   close(fd);
+ *
+ * Note that the application is responsible for extending the
+ * target to its full size if the stream ends with a hole, e.g.
+ * by calling ftruncate() once this function returns.
+ *
+ * Returns 0 if all the data was successfully received. The caller
+ * should invoke virStreamFinish(st) to flush the stream upon
+ * success and then virStreamFree.
+ *
+ * Returns -1 upon any error, with virStreamAbort() already
+ * having been called, so the caller need only call
+ * virStreamFree().
+ */
+int
+virStreamSparseRecvAll(virStreamPtr stream,
+                       virStreamSinkFunc handler,
+                       virStreamSinkHoleFunc holeHandler,
+                       void *opaque)
+{
+    char *bytes = NULL;
+    int want = VIR_STREAM_ALL_CHUNK;
+    int ret = -1;
+    VIR_DEBUG("stream=%p, handler=%p, holeHandler=%p, opaque=%p",
+              stream, handler, holeHandler, opaque);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    virCheckNonNullArgGoto(handler, cleanup);
+    virCheckNonNullArgGoto(holeHandler, cleanup);
+
+    if (stream->flags & VIR_STREAM_NONBLOCK) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("data sinks cannot be used for non-blocking streams"));
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(bytes, want) < 0)
+        goto cleanup;
+
+    for (;;) {
+        int got, offset = 0;
+        long long holeLen;
+
+        got = virStreamRecvFlags(stream, bytes, want,
+                                 VIR_STREAM_RECV_STOP_AT_HOLE);
+        if (got == -3) {
+            if (virStreamRecvHole(stream, &holeLen, 0) < 0)
+                goto cleanup;
+
+            if (holeLen &&
+                (holeHandler)(stream, holeLen, opaque) < 0) {
+                virStreamAbort(stream);
+                goto cleanup;
+            }
+            continue;
+        }
+        if (got < 0)
+            goto cleanup;
+        if (got == 0)
+            break;
+        while (offset < got) {
+            int done;
+            done = (handler)(stream, bytes + offset, got - offset, opaque);
+            if (done < 0) {
+                virStreamAbort(stream);
+                goto cleanup;
+            }
+            offset += done;
+        }
+    }
+    ret = 0;
+
+cleanup:
+    VIR_FREE(bytes);
+
+    if (ret != 0)
+        virDispatchError(stream->conn);
+
+    return ret;
+}
+
+
 /**
  * virStreamEventAddCallback:
  * @stream: pointer to the stream object
@@ -17846,6 +18975,133 @@ error:
 }
 
 
+/**
+ * virConnectStoragePoolEventRegisterAny:
+ * @conn: pointer to the connection
+ * @pool: pointer to the storage pool
+ * @eventID: the event type to receive
+ * @cb: callback to the function handling storage pool events
+ * @opaque: opaque data to pass on to the callback
+ * @freecb: optional function to deallocate opaque when not used anymore
+ *
+ * Adds a callback to receive notifications of arbitrary storage pool
+ * events occurring on a storage pool.  This function requires that an
+ * event loop has been previously registered with virEventRegisterImpl()
+ * or virEventRegisterDefaultImpl().
+ *
+ * If @pool is NULL, then events will be monitored for any storage pool.
+ * If @pool is non-NULL, then only the specific storage pool will be
+ * monitored.
+ *
+ * Most types of event have a callback providing a custom set of parameters
+ * for the event. When registering an event, it is thus necessary to use
+ * the VIR_STORAGE_POOL_EVENT_CALLBACK() macro to cast the supplied function
+ * pointer to match the signature of this method.
+ *
+ * The virStoragePoolPtr object handle passed into the callback upon
+ * delivery of an event is only valid for the duration of execution of the
+ * callback. If the callback wishes to keep the storage pool object after
+ * the callback returns, it shall take a reference to it, by calling
+ * virStoragePoolRef(). The reference can be released once the object is
+ * no longer required by calling virStoragePoolFree().
+ *
+ * The return value from this method is a positive integer identifier
+ * for the callback. To unregister a callback, this callback ID should
+ * be passed to the virConnectStoragePoolEventDeregisterAny() method.
+ *
+ * Returns a callback identifier on success, -1 on failure.
+ */
+int
+virConnectStoragePoolEventRegisterAny(virConnectPtr conn,
+                                      virStoragePoolPtr pool,
+                                      int eventID,
+                                      virConnectStoragePoolEventGenericCallback cb,
+                                      void *opaque,
+                                      virFreeCallback freecb)
+{
+    VIR_DEBUG("conn=%p, pool=%p, eventID=%d, cb=%p, opaque=%p, freecb=%p",
+              conn, pool, eventID, cb, opaque, freecb);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    if (pool) {
+        virCheckStoragePoolGoto(pool, error);
+        if (pool->conn != conn) {
+            virReportInvalidArg(pool,
+                                _("storage pool '%s' in %s must match connection"),
+                                pool->name, __FUNCTION__);
+            goto error;
+        }
+    }
+    virCheckNonNullArgGoto(cb, error);
+    virCheckNonNegativeArgGoto(eventID, error);
+
+    if (eventID >= VIR_STORAGE_POOL_EVENT_ID_LAST) {
+        virReportInvalidArg(eventID,
+                            _("eventID in %s must be less than %d"),
+                            __FUNCTION__, VIR_STORAGE_POOL_EVENT_ID_LAST);
+        goto error;
+    }
+
+    if (conn->storageDriver &&
+        conn->storageDriver->connectStoragePoolEventRegisterAny) {
+        int ret;
+        ret = conn->storageDriver->connectStoragePoolEventRegisterAny(conn, pool,
+                                                                      eventID,
+                                                                      cb, opaque,
+                                                                      freecb);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
+/**
+ * virConnectStoragePoolEventDeregisterAny:
+ * @conn: pointer to the connection
+ * @callbackID: the callback identifier
+ *
+ * Removes an event callback. The callbackID parameter should be the
+ * value obtained from a previous virConnectStoragePoolEventRegisterAny()
+ * method.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+virConnectStoragePoolEventDeregisterAny(virConnectPtr conn,
+                                        int callbackID)
+{
+    VIR_DEBUG("conn=%p, callbackID=%d", conn, callbackID);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    virCheckNonNegativeArgGoto(callbackID, error);
+
+    if (conn->storageDriver &&
+        conn->storageDriver->connectStoragePoolEventDeregisterAny) {
+        int ret;
+        ret = conn->storageDriver->connectStoragePoolEventDeregisterAny(conn,
+                                                                        callbackID);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
 /**
  * virDomainManagedSave:
  * @dom: pointer to the domain
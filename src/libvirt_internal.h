@@ -120,6 +120,12 @@ enum {
      * Support for server-side event filtering via callback ids in events.
      */
     VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK = 14,
+
+    /*
+     * Remote party accepts stream data packets of up to
+     * VIR_NET_MESSAGE_LARGE_STREAM_PAYLOAD_MAX bytes.
+     */
+    VIR_DRV_FEATURE_PROGRAM_LARGE_STREAM = 15,
 };
 
 
@@ -285,4 +291,8 @@ int virDomainMigrateConfirm3Params(virDomainPtr domain,
                                    int cookieinlen,
                                    unsigned int flags,
                                    int cancelled);
+
+int virStreamInData(virStreamPtr st,
+                    int *inData,
+                    long long *length);
 #endif
@@ -1,4 +1,4 @@
-/* Automatically generated from ./locking/lock_protocol.x by gendispatch.pl.
+/* Automatically generated from ../../src/locking/lock_protocol.x by gendispatch.pl.
  * Do not edit this file.  Any changes you make will be lost.
  */
 static int virLockSpaceProtocolDispatchAcquireResource(
@@ -2040,7 +2040,7 @@ virLXCControllerEventSend(virLXCControllerPtr ctrl,
     }
 
     VIR_DEBUG("Send event %d client=%p", procnr, ctrl->client);
-    if (!(msg = virNetMessageNew(false)))
+    if (!(msg = virNetServerClientNewMessage(ctrl->client)))
         goto error;
 
     msg->header.prog = virNetServerProgramGetID(ctrl->prog);
@@ -1,4 +1,4 @@
-/* Automatically generated from ./lxc/lxc_monitor_protocol.x by gendispatch.pl.
+/* Automatically generated from ../../src/lxc/lxc_monitor_protocol.x by gendispatch.pl.
  * Do not edit this file.  Any changes you make will be lost.
  */
 virNetServerProgramProc virLXCMonitorProcs[] = {
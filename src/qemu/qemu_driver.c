@@ -16324,6 +16324,554 @@ cleanup:
     return ret;
 }
 
+/* Data gathered from the monitor of a single domain for
+ * qemuConnectGetAllDomainStats, all under a single job */
+typedef struct _qemuDomainStatsMonitorData qemuDomainStatsMonitorData;
+typedef qemuDomainStatsMonitorData *qemuDomainStatsMonitorDataPtr;
+struct _qemuDomainStatsMonitorData {
+    virHashTablePtr blockstats; /* qemuBlockStats keyed by disk alias */
+    bool haveBalloon;
+    unsigned long long balloon;
+};
+
+typedef int
+(*qemuDomainGetStatsFunc)(virDomainObjPtr dom,
+                          qemuDomainStatsMonitorDataPtr mondata,
+                          virDomainStatsRecordPtr record,
+                          int *maxparams);
+
+struct qemuDomainGetStatsWorker {
+    qemuDomainGetStatsFunc func;
+    unsigned int stats;
+};
+
+
+static int
+qemuDomainStatsAddULLong(virDomainStatsRecordPtr record,
+                         int *maxparams,
+                         const char *prefix,
+                         size_t num,
+                         const char *name,
+                         unsigned long long value)
+{
+    char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+
+    snprintf(field, sizeof(field), "%s.%zu.%s", prefix, num, name);
+    return virTypedParamsAddULLong(&record->params, &record->nparams,
+                                   maxparams, field, value);
+}
+
+
+static int
+qemuDomainStatsAddName(virDomainStatsRecordPtr record,
+                       int *maxparams,
+                       const char *prefix,
+                       size_t num,
+                       const char *name)
+{
+    char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+
+    snprintf(field, sizeof(field), "%s.%zu.name", prefix, num);
+    return virTypedParamsAddString(&record->params, &record->nparams,
+                                   maxparams, field, name);
+}
+
+
+static int
+qemuDomainGetStatsState(virDomainObjPtr dom,
+                        qemuDomainStatsMonitorDataPtr mondata ATTRIBUTE_UNUSED,
+                        virDomainStatsRecordPtr record,
+                        int *maxparams)
+{
+    int state;
+    int reason;
+
+    state = virDomainObjGetState(dom, &reason);
+
+    if (virTypedParamsAddInt(&record->params, &record->nparams, maxparams,
+                             "state.state", state) < 0 ||
+        virTypedParamsAddInt(&record->params, &record->nparams, maxparams,
+                             "state.reason", reason) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+qemuDomainGetStatsCpu(virDomainObjPtr dom,
+                      qemuDomainStatsMonitorDataPtr mondata ATTRIBUTE_UNUSED,
+                      virDomainStatsRecordPtr record,
+                      int *maxparams)
+{
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+    unsigned long long cpu_time = 0;
+    unsigned long long user_time = 0;
+    unsigned long long sys_time = 0;
+
+    if (!virDomainObjIsActive(dom))
+        return 0;
+
+    /* Statistics which cannot be read are left out of the record
+     * instead of failing the whole call. */
+    if (!virCgroupHasController(priv->cgroup, VIR_CGROUP_CONTROLLER_CPUACCT)) {
+        if (qemuGetProcessInfo(&cpu_time, NULL, NULL, dom->pid, 0) < 0)
+            return 0;
+
+        return virTypedParamsAddULLong(&record->params, &record->nparams,
+                                       maxparams, "cpu.time", cpu_time);
+    }
+
+    if (virCgroupGetCpuacctUsage(priv->cgroup, &cpu_time) < 0) {
+        virResetLastError();
+    } else if (virTypedParamsAddULLong(&record->params, &record->nparams,
+                                       maxparams, "cpu.time", cpu_time) < 0) {
+        return -1;
+    }
+
+    if (virCgroupGetCpuacctStat(priv->cgroup, &user_time, &sys_time) < 0) {
+        virResetLastError();
+    } else if (virTypedParamsAddULLong(&record->params, &record->nparams,
+                                       maxparams, "cpu.user", user_time) < 0 ||
+               virTypedParamsAddULLong(&record->params, &record->nparams,
+                                       maxparams, "cpu.system", sys_time) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+qemuDomainGetStatsBalloon(virDomainObjPtr dom,
+                          qemuDomainStatsMonitorDataPtr mondata,
+                          virDomainStatsRecordPtr record,
+                          int *maxparams)
+{
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+    unsigned long long cur_balloon = dom->def->mem.cur_balloon;
+
+    if (virDomainObjIsActive(dom)) {
+        if (dom->def->memballoon &&
+            dom->def->memballoon->model == VIR_DOMAIN_MEMBALLOON_MODEL_NONE)
+            cur_balloon = dom->def->mem.max_balloon;
+        else if (!virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_BALLOON_EVENT) &&
+                 mondata->haveBalloon)
+            cur_balloon = mondata->balloon;
+    }
+
+    if (virTypedParamsAddULLong(&record->params, &record->nparams, maxparams,
+                                "balloon.current", cur_balloon) < 0 ||
+        virTypedParamsAddULLong(&record->params, &record->nparams, maxparams,
+                                "balloon.maximum",
+                                dom->def->mem.max_balloon) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+qemuDomainGetStatsVcpu(virDomainObjPtr dom,
+                       qemuDomainStatsMonitorDataPtr mondata ATTRIBUTE_UNUSED,
+                       virDomainStatsRecordPtr record,
+                       int *maxparams)
+{
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+    char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+    size_t i;
+
+    if (virTypedParamsAddUInt(&record->params, &record->nparams, maxparams,
+                              "vcpu.current", dom->def->vcpus) < 0 ||
+        virTypedParamsAddUInt(&record->params, &record->nparams, maxparams,
+                              "vcpu.maximum", dom->def->maxvcpus) < 0)
+        return -1;
+
+    if (!virDomainObjIsActive(dom) || !priv->vcpupids)
+        return 0;
+
+    for (i = 0; i < priv->nvcpupids; i++) {
+        unsigned long long cpu_time;
+
+        snprintf(field, sizeof(field), "vcpu.%zu.state", i);
+        if (virTypedParamsAddInt(&record->params, &record->nparams, maxparams,
+                                 field, VIR_VCPU_RUNNING) < 0)
+            return -1;
+
+        if (qemuGetProcessInfo(&cpu_time, NULL, NULL,
+                               dom->pid, priv->vcpupids[i]) < 0)
+            continue;
+
+        if (qemuDomainStatsAddULLong(record, maxparams, "vcpu", i,
+                                     "time", cpu_time) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+qemuDomainGetStatsInterface(virDomainObjPtr dom,
+                            qemuDomainStatsMonitorDataPtr mondata ATTRIBUTE_UNUSED,
+                            virDomainStatsRecordPtr record,
+                            int *maxparams)
+{
+    size_t i;
+
+    if (!virDomainObjIsActive(dom))
+        return 0;
+
+    if (virTypedParamsAddUInt(&record->params, &record->nparams, maxparams,
+                              "net.count", dom->def->nnets) < 0)
+        return -1;
+
+    for (i = 0; i < dom->def->nnets; i++) {
+        virDomainNetDefPtr net = dom->def->nets[i];
+#ifdef __linux__
+        struct _virDomainInterfaceStats tmp;
+#endif
+
+        if (!net->ifname)
+            continue;
+
+        if (qemuDomainStatsAddName(record, maxparams, "net", i,
+                                   net->ifname) < 0)
+            return -1;
+
+#ifdef __linux__
+        if (linuxDomainInterfaceStats(net->ifname, &tmp) < 0) {
+            virResetLastError();
+            continue;
+        }
+
+# define QEMU_ADD_NET_PARAM(name, value)                                \
+        if (value >= 0 &&                                               \
+            qemuDomainStatsAddULLong(record, maxparams, "net", i,       \
+                                     name, value) < 0)                  \
+            return -1
+
+        QEMU_ADD_NET_PARAM("rx.bytes", tmp.rx_bytes);
+        QEMU_ADD_NET_PARAM("rx.pkts", tmp.rx_packets);
+        QEMU_ADD_NET_PARAM("rx.errs", tmp.rx_errs);
+        QEMU_ADD_NET_PARAM("rx.drop", tmp.rx_drop);
+        QEMU_ADD_NET_PARAM("tx.bytes", tmp.tx_bytes);
+        QEMU_ADD_NET_PARAM("tx.pkts", tmp.tx_packets);
+        QEMU_ADD_NET_PARAM("tx.errs", tmp.tx_errs);
+        QEMU_ADD_NET_PARAM("tx.drop", tmp.tx_drop);
+
+# undef QEMU_ADD_NET_PARAM
+#endif
+    }
+
+    return 0;
+}
+
+
+static int
+qemuDomainGetStatsBlock(virDomainObjPtr dom,
+                        qemuDomainStatsMonitorDataPtr mondata,
+                        virDomainStatsRecordPtr record,
+                        int *maxparams)
+{
+    size_t i;
+
+    if (!mondata->blockstats)
+        return 0;
+
+    if (virTypedParamsAddUInt(&record->params, &record->nparams, maxparams,
+                              "block.count", dom->def->ndisks) < 0)
+        return -1;
+
+    for (i = 0; i < dom->def->ndisks; i++) {
+        virDomainDiskDefPtr disk = dom->def->disks[i];
+        qemuBlockStatsPtr entry;
+
+        if (qemuDomainStatsAddName(record, maxparams, "block", i,
+                                   disk->dst) < 0)
+            return -1;
+
+        if (!disk->info.alias ||
+            !(entry = virHashLookup(mondata->blockstats, disk->info.alias)))
+            continue;
+
+#define QEMU_ADD_BLOCK_PARAM(name, value)                               \
+        if (value >= 0 &&                                               \
+            qemuDomainStatsAddULLong(record, maxparams, "block", i,     \
+                                     name, value) < 0)                  \
+            return -1
+
+        QEMU_ADD_BLOCK_PARAM("rd.reqs", entry->rd_req);
+        QEMU_ADD_BLOCK_PARAM("rd.bytes", entry->rd_bytes);
+        QEMU_ADD_BLOCK_PARAM("rd.times", entry->rd_total_times);
+        QEMU_ADD_BLOCK_PARAM("wr.reqs", entry->wr_req);
+        QEMU_ADD_BLOCK_PARAM("wr.bytes", entry->wr_bytes);
+        QEMU_ADD_BLOCK_PARAM("wr.times", entry->wr_total_times);
+        QEMU_ADD_BLOCK_PARAM("fl.reqs", entry->flush_req);
+        QEMU_ADD_BLOCK_PARAM("fl.times", entry->flush_total_times);
+
+#undef QEMU_ADD_BLOCK_PARAM
+    }
+
+    return 0;
+}
+
+
+static struct qemuDomainGetStatsWorker qemuDomainGetStatsWorkers[] = {
+    { qemuDomainGetStatsState, VIR_DOMAIN_STATS_STATE },
+    { qemuDomainGetStatsCpu, VIR_DOMAIN_STATS_CPU_TOTAL },
+    { qemuDomainGetStatsBalloon, VIR_DOMAIN_STATS_BALLOON },
+    { qemuDomainGetStatsVcpu, VIR_DOMAIN_STATS_VCPU },
+    { qemuDomainGetStatsInterface, VIR_DOMAIN_STATS_INTERFACE },
+    { qemuDomainGetStatsBlock, VIR_DOMAIN_STATS_BLOCK },
+    { NULL, 0 }
+};
+
+
+static int
+qemuDomainGetStatsCheckSupport(unsigned int *stats,
+                               bool enforce)
+{
+    unsigned int supportedstats = 0;
+    size_t i;
+
+    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++)
+        supportedstats |= qemuDomainGetStatsWorkers[i].stats;
+
+    if (*stats == 0) {
+        *stats = supportedstats;
+        return 0;
+    }
+
+    if (enforce &&
+        *stats & ~supportedstats) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED,
+                       _("Stats types bits 0x%x are not supported by this daemon"),
+                       *stats & ~supportedstats);
+        return -1;
+    }
+
+    *stats &= supportedstats;
+    return 0;
+}
+
+
+/* Query the monitor for everything @stats needs from it: a single
+ * query-blockstats and, unless balloon events keep the current
+ * balloon size up to date, a single query-balloon. Failures are not
+ * fatal, the affected statistics are just left out. Returns -1 if
+ * the domain went away meanwhile, 0 otherwise. */
+static int
+qemuDomainGetStatsMonitor(virQEMUDriverPtr driver,
+                          virDomainObjPtr dom,
+                          unsigned int stats,
+                          qemuDomainStatsMonitorDataPtr mondata)
+{
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+    bool needBalloon = false;
+    bool needBlock = false;
+    int rc;
+
+    if (!virDomainObjIsActive(dom))
+        return 0;
+
+    if (stats & VIR_DOMAIN_STATS_BALLOON &&
+        !virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_BALLOON_EVENT) &&
+        !(dom->def->memballoon &&
+          dom->def->memballoon->model == VIR_DOMAIN_MEMBALLOON_MODEL_NONE))
+        needBalloon = true;
+
+    if (stats & VIR_DOMAIN_STATS_BLOCK)
+        needBlock = true;
+
+    if (!needBalloon && !needBlock)
+        return 0;
+
+    if (qemuDomainObjBeginJob(driver, dom, QEMU_JOB_QUERY) < 0) {
+        virResetLastError();
+        return 0;
+    }
+
+    if (virDomainObjIsActive(dom)) {
+        qemuDomainObjEnterMonitor(driver, dom);
+
+        if (needBlock &&
+            !(mondata->blockstats = qemuMonitorGetAllBlockStatsInfo(priv->mon)))
+            virResetLastError();
+
+        if (needBalloon) {
+            rc = qemuMonitorGetBalloonInfo(priv->mon, &mondata->balloon);
+            if (rc < 0) {
+                virResetLastError();
+            } else {
+                /* Balloon not supported, so maxmem is always the allocation */
+                if (rc == 0)
+                    mondata->balloon = dom->def->mem.max_balloon;
+                mondata->haveBalloon = true;
+            }
+        }
+
+        qemuDomainObjExitMonitor(driver, dom);
+    }
+
+    if (!qemuDomainObjEndJob(driver, dom))
+        return -1;
+
+    return 0;
+}
+
+
+/* Gather the statistics of @dom into a new @record. The domain must be
+ * locked on entry and is unlocked on return. If the domain goes away
+ * meanwhile, 0 is returned and @record is left NULL. */
+static int
+qemuDomainGetStats(virConnectPtr conn,
+                   virQEMUDriverPtr driver,
+                   virDomainObjPtr *dom,
+                   unsigned int stats,
+                   virDomainStatsRecordPtr *record)
+{
+    int maxparams = 0;
+    virDomainStatsRecordPtr tmp;
+    qemuDomainStatsMonitorData mondata;
+    size_t i;
+    int ret = -1;
+
+    memset(&mondata, 0, sizeof(mondata));
+
+    if (VIR_ALLOC(tmp) < 0)
+        goto cleanup;
+
+    *record = NULL;
+
+    if (qemuDomainGetStatsMonitor(driver, *dom, stats, &mondata) < 0) {
+        *dom = NULL;
+        ret = 0;
+        goto cleanup;
+    }
+
+    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
+        if (stats & qemuDomainGetStatsWorkers[i].stats) {
+            if (qemuDomainGetStatsWorkers[i].func(*dom, &mondata,
+                                                  tmp, &maxparams) < 0)
+                goto cleanup;
+        }
+    }
+
+    if (!(tmp->dom = virGetDomain(conn, (*dom)->def->name,
+                                  (*dom)->def->uuid)))
+        goto cleanup;
+
+    tmp->dom->id = (*dom)->def->id;
+
+    *record = tmp;
+    tmp = NULL;
+    ret = 0;
+
+cleanup:
+    if (*dom)
+        virObjectUnlock(*dom);
+    virHashFree(mondata.blockstats);
+    if (tmp) {
+        virTypedParamsFree(tmp->params, tmp->nparams);
+        VIR_FREE(tmp);
+    }
+
+    return ret;
+}
+
+
+static int
+qemuConnectGetAllDomainStats(virConnectPtr conn,
+                             virDomainPtr *doms,
+                             unsigned int ndoms,
+                             unsigned int stats,
+                             virDomainStatsRecordPtr **retStats,
+                             unsigned int flags)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    virDomainPtr *domlist = NULL;
+    virDomainObjPtr vm = NULL;
+    virDomainStatsRecordPtr *tmpstats = NULL;
+    bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
+    int ntempdoms;
+    int nstats = 0;
+    size_t i;
+    int ret = -1;
+
+    if (ndoms)
+        virCheckFlags(VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS, -1);
+    else
+        virCheckFlags(VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
+                      VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
+                      VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE |
+                      VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS, -1);
+
+    if (virConnectGetAllDomainStatsEnsureACL(conn) < 0)
+        return -1;
+
+    if (qemuDomainGetStatsCheckSupport(&stats, enforce) < 0)
+        return -1;
+
+    if (!ndoms) {
+        unsigned int lflags = flags & (VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
+                                       VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
+                                       VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE);
+
+        if ((ntempdoms = virDomainObjListExport(driver->domains,
+                                                conn,
+                                                &domlist,
+                                                virConnectGetAllDomainStatsCheckACL,
+                                                lflags)) < 0)
+            goto cleanup;
+
+        ndoms = ntempdoms;
+        doms = domlist;
+    }
+
+    if (VIR_ALLOC_N(tmpstats, ndoms + 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ndoms; i++) {
+        virDomainStatsRecordPtr tmp = NULL;
+
+        /* Domains may vanish while the list is being processed */
+        if (!(vm = qemuDomObjFromDomain(doms[i]))) {
+            virResetLastError();
+            continue;
+        }
+
+        if (!domlist &&
+            !virConnectGetAllDomainStatsCheckACL(conn, vm->def)) {
+            virObjectUnlock(vm);
+            continue;
+        }
+
+        if (qemuDomainGetStats(conn, driver, &vm, stats, &tmp) < 0)
+            goto cleanup;
+
+        if (tmp)
+            tmpstats[nstats++] = tmp;
+    }
+
+    *retStats = tmpstats;
+    tmpstats = NULL;
+
+    ret = nstats;
+
+cleanup:
+    if (domlist) {
+        for (i = 0; i < ndoms; i++)
+            virDomainFree(domlist[i]);
+        VIR_FREE(domlist);
+    }
+
+    virDomainStatsRecordListFree(tmpstats);
+
+    return ret;
+}
+
+
 static char *
 qemuDomainQemuAgentCommand(virDomainPtr domain,
                            const char *cmd,
@@ -16775,6 +17323,7 @@ static virDriver qemuDriver = {
     .domainMigrateFinish3Params = qemuDomainMigrateFinish3Params, /* 1.1.0 */
     .domainMigrateConfirm3Params = qemuDomainMigrateConfirm3Params, /* 1.1.0 */
     .connectGetCPUModelNames = qemuConnectGetCPUModelNames, /* 1.1.3 */
+    .connectGetAllDomainStats = qemuConnectGetAllDomainStats, /* 1.2.3 */
 };
 
 
@@ -2958,7 +2958,7 @@ struct _qemuMigrationSpec {
     } fwd;
 };
 
-#define TUNNEL_SEND_BUF_SIZE 65536
+#define TUNNEL_SEND_BUF_SIZE (4 * 1024 * 1024)
 
 typedef struct _qemuMigrationIOThread qemuMigrationIOThread;
 typedef qemuMigrationIOThread *qemuMigrationIOThreadPtr;
@@ -3036,8 +3036,16 @@ static void qemuMigrationIOFunc(void *arg)
 
             nbytes = saferead(data->sock, buffer, TUNNEL_SEND_BUF_SIZE);
             if (nbytes > 0) {
-                if (virStreamSend(data->st, buffer, nbytes) < 0)
-                    goto error;
+                int offset = 0;
+
+                /* the stream may take less than a buffer per call */
+                while (offset < nbytes) {
+                    int done = virStreamSend(data->st, buffer + offset,
+                                             nbytes - offset);
+                    if (done < 0)
+                        goto error;
+                    offset += done;
+                }
             } else if (nbytes < 0) {
                 virReportSystemError(errno, "%s",
                         _("tunnelled migration failed to read from qemu"));
@@ -1687,6 +1687,40 @@ qemuMonitorBlockInfoLookup(virHashTablePtr blockInfo,
     return info;
 }
 
+/* Return a table of qemuBlockStats of all block devices of the domain,
+ * keyed by the device alias, gathered with a single monitor command.
+ * Only supported with the JSON monitor. */
+virHashTablePtr
+qemuMonitorGetAllBlockStatsInfo(qemuMonitorPtr mon)
+{
+    virHashTablePtr table;
+
+    VIR_DEBUG("mon=%p", mon);
+
+    if (!mon) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("monitor must not be NULL"));
+        return NULL;
+    }
+
+    if (!mon->json) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("block statistics of all devices require "
+                         "the JSON monitor"));
+        return NULL;
+    }
+
+    if (!(table = virHashCreate(32, (virHashDataFree) free)))
+        return NULL;
+
+    if (qemuMonitorJSONGetAllBlockStatsInfo(mon, table) < 0) {
+        virHashFree(table);
+        return NULL;
+    }
+
+    return table;
+}
+
 int qemuMonitorGetBlockStatsInfo(qemuMonitorPtr mon,
                                  const char *dev_name,
                                  long long *rd_req,
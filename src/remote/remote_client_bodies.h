@@ -6144,6 +6144,31 @@ done:
     return rv;
 }
 
+static int
+remoteStorageVolAbortJob(virStorageVolPtr vol, unsigned int flags)
+{
+    int rv = -1;
+    struct private_data *priv = vol->conn->storagePrivateData;
+    remote_storage_vol_abort_job_args args;
+
+    remoteDriverLock(priv);
+
+    make_nonnull_storage_vol(&args.vol, vol);
+    args.flags = flags;
+
+    if (call(vol->conn, priv, 0, REMOTE_PROC_STORAGE_VOL_ABORT_JOB,
+             (xdrproc_t)xdr_remote_storage_vol_abort_job_args, (char *)&args,
+             (xdrproc_t)xdr_void, (char *)NULL) == -1) {
+        goto done;
+    }
+
+    rv = 0;
+
+done:
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
 static virStorageVolPtr
 remoteStorageVolCreateXML(virStoragePoolPtr pool, const char *xml, unsigned int flags)
 {
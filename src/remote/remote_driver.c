@@ -34,6 +34,7 @@
 #include "datatypes.h"
 #include "domain_event.h"
 #include "network_event.h"
+#include "storage_event.h"
 #include "driver.h"
 #include "virbuffer.h"
 #include "remote_driver.h"
@@ -93,6 +94,7 @@ struct private_data {
     char *hostname;             /* Original hostname */
     bool serverKeepAlive;       /* Does server support keepalive protocol? */
     bool serverEventFilter;     /* Does server support modern event filtering */
+    bool serverLargeStream;     /* Does server take large stream packets */
 
     virObjectEventStatePtr eventState;
 };
@@ -354,6 +356,11 @@ remoteNetworkBuildEventLifecycle(virNetClientProgramPtr prog ATTRIBUTE_UNUSED,
                                  virNetClientPtr client ATTRIBUTE_UNUSED,
                                  void *evdata, void *opaque);
 
+static void
+remoteStoragePoolBuildEventJobCompleted(virNetClientProgramPtr prog ATTRIBUTE_UNUSED,
+                                        virNetClientPtr client ATTRIBUTE_UNUSED,
+                                        void *evdata, void *opaque);
+
 static virNetClientProgramEvent remoteEvents[] = {
     { REMOTE_PROC_DOMAIN_EVENT_LIFECYCLE,
       remoteDomainBuildEventLifecycle,
@@ -496,6 +503,10 @@ static virNetClientProgramEvent remoteEvents[] = {
       remoteDomainBuildEventCallbackDeviceRemoved,
       sizeof(remote_domain_event_callback_device_removed_msg),
       (xdrproc_t)xdr_remote_domain_event_callback_device_removed_msg },
+    { REMOTE_PROC_STORAGE_POOL_EVENT_JOB_COMPLETED,
+      remoteStoragePoolBuildEventJobCompleted,
+      sizeof(remote_storage_pool_event_job_completed_msg),
+      (xdrproc_t)xdr_remote_storage_pool_event_job_completed_msg },
 };
 
 enum virDrvOpenRemoteFlags {
@@ -1059,6 +1070,24 @@ doRemoteOpen(virConnectPtr conn,
         }
     }
 
+    {
+        remote_connect_supports_feature_args args =
+            { VIR_DRV_FEATURE_PROGRAM_LARGE_STREAM };
+        remote_connect_supports_feature_ret ret = { 0 };
+        int rc;
+
+        rc = call(conn, priv, 0, REMOTE_PROC_CONNECT_SUPPORTS_FEATURE,
+                  (xdrproc_t)xdr_remote_connect_supports_feature_args, (char *) &args,
+                  (xdrproc_t)xdr_remote_connect_supports_feature_ret, (char *) &ret);
+
+        if (rc != -1 && ret.supported) {
+            priv->serverLargeStream = true;
+        } else {
+            VIR_INFO("Sending small stream packets since large ones are "
+                     "not supported by the server");
+        }
+    }
+
     /* Successful. */
     retcode = VIR_DRV_OPEN_SUCCESS;
 
@@ -3173,6 +3202,101 @@ done:
 }
 
 
+static int
+remoteConnectStoragePoolEventRegisterAny(virConnectPtr conn,
+                                         virStoragePoolPtr pool,
+                                         int eventID,
+                                         virConnectStoragePoolEventGenericCallback callback,
+                                         void *opaque,
+                                         virFreeCallback freecb)
+{
+    int rv = -1;
+    struct private_data *priv = conn->privateData;
+    remote_connect_storage_pool_event_register_any_args args;
+    remote_connect_storage_pool_event_register_any_ret ret;
+    int callbackID;
+    int count;
+    remote_nonnull_storage_pool storage_pool;
+
+    remoteDriverLock(priv);
+
+    if ((count = virStoragePoolEventStateRegisterClient(conn, priv->eventState,
+                                                        pool, eventID, callback,
+                                                        opaque, freecb,
+                                                        &callbackID)) < 0)
+        goto done;
+
+    /* If this is the first callback for this eventID, we need to enable
+     * events on the server */
+    if (count == 1) {
+        args.eventID = eventID;
+        if (pool) {
+            make_nonnull_storage_pool(&storage_pool, pool);
+            args.pool = &storage_pool;
+        } else {
+            args.pool = NULL;
+        }
+
+        memset(&ret, 0, sizeof(ret));
+        if (call(conn, priv, 0, REMOTE_PROC_CONNECT_STORAGE_POOL_EVENT_REGISTER_ANY,
+                 (xdrproc_t) xdr_remote_connect_storage_pool_event_register_any_args, (char *) &args,
+                 (xdrproc_t) xdr_remote_connect_storage_pool_event_register_any_ret, (char *) &ret) == -1) {
+            virObjectEventStateDeregisterID(conn, priv->eventState,
+                                            callbackID);
+            goto done;
+        }
+        virObjectEventStateSetRemote(conn, priv->eventState, callbackID,
+                                     ret.callbackID);
+    }
+
+    rv = callbackID;
+
+done:
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
+
+static int
+remoteConnectStoragePoolEventDeregisterAny(virConnectPtr conn,
+                                           int callbackID)
+{
+    struct private_data *priv = conn->privateData;
+    int rv = -1;
+    remote_connect_storage_pool_event_deregister_any_args args;
+    int eventID;
+    int remoteID;
+    int count;
+
+    remoteDriverLock(priv);
+
+    if ((eventID = virObjectEventStateEventID(conn, priv->eventState,
+                                              callbackID, &remoteID)) < 0)
+        goto done;
+
+    if ((count = virObjectEventStateDeregisterID(conn, priv->eventState,
+                                                 callbackID)) < 0)
+        goto done;
+
+    /* If that was the last callback for this eventID, we need to disable
+     * events on the server */
+    if (count == 0) {
+        args.callbackID = remoteID;
+
+        if (call(conn, priv, 0, REMOTE_PROC_CONNECT_STORAGE_POOL_EVENT_DEREGISTER_ANY,
+                 (xdrproc_t) xdr_remote_connect_storage_pool_event_deregister_any_args, (char *) &args,
+                 (xdrproc_t) xdr_void, (char *) NULL) == -1)
+            goto done;
+    }
+
+    rv = 0;
+
+done:
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
+
 static int
 remoteConnectListAllInterfaces(virConnectPtr conn,
                                virInterfacePtr **ifaces,
@@ -5408,6 +5532,31 @@ remoteNetworkBuildEventLifecycle(virNetClientProgramPtr prog ATTRIBUTE_UNUSED,
 }
 
 
+static void
+remoteStoragePoolBuildEventJobCompleted(virNetClientProgramPtr prog ATTRIBUTE_UNUSED,
+                                        virNetClientPtr client ATTRIBUTE_UNUSED,
+                                        void *evdata, void *opaque)
+{
+    virConnectPtr conn = opaque;
+    struct private_data *priv = conn->privateData;
+    remote_storage_pool_event_job_completed_msg *msg = evdata;
+    virStoragePoolPtr pool;
+    virObjectEventPtr event = NULL;
+
+    pool = get_nonnull_storage_pool(conn, msg->pool);
+    if (!pool)
+        return;
+
+    event = virStoragePoolEventJobCompletedNew(pool->name, pool->uuid,
+                                               msg->vol ? *msg->vol : NULL,
+                                               msg->job, msg->type,
+                                               msg->state);
+    virStoragePoolFree(pool);
+
+    remoteEventQueue(priv, event, msg->callbackID);
+}
+
+
 static virDrvOpenStatus ATTRIBUTE_NONNULL(1)
 remoteSecretOpen(virConnectPtr conn, virConnectAuthPtr auth,
                  unsigned int flags)
@@ -5469,6 +5618,13 @@ remoteStreamSend(virStreamPtr st,
     if (virNetClientStreamRaiseError(privst))
         return -1;
 
+    /* Older servers cannot take more than that in one packet,
+     * the caller has to send the rest with another call */
+    if (priv->serverLargeStream)
+        nbytes = MIN(nbytes, VIR_NET_MESSAGE_LARGE_STREAM_PAYLOAD_MAX);
+    else
+        nbytes = MIN(nbytes, VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX);
+
     remoteDriverLock(priv);
     priv->localUses++;
     remoteDriverUnlock(priv);
@@ -5487,15 +5643,19 @@ remoteStreamSend(virStreamPtr st,
 
 
 static int
-remoteStreamRecv(virStreamPtr st,
-                 char *data,
-                 size_t nbytes)
+remoteStreamRecvFlags(virStreamPtr st,
+                      char *data,
+                      size_t nbytes,
+                      unsigned int flags)
 {
-    VIR_DEBUG("st=%p data=%p nbytes=%zu", st, data, nbytes);
+    VIR_DEBUG("st=%p data=%p nbytes=%zu flags=%x",
+              st, data, nbytes, flags);
     struct private_data *priv = st->conn->privateData;
     virNetClientStreamPtr privst = st->privateData;
     int rv;
 
+    virCheckFlags(VIR_STREAM_RECV_STOP_AT_HOLE, -1);
+
     if (virNetClientStreamRaiseError(privst))
         return -1;
 
@@ -5507,7 +5667,8 @@ remoteStreamRecv(virStreamPtr st,
                                       priv->client,
                                       data,
                                       nbytes,
-                                      (st->flags & VIR_STREAM_NONBLOCK));
+                                      (st->flags & VIR_STREAM_NONBLOCK),
+                                      flags);
 
     VIR_DEBUG("Done %d", rv);
 
@@ -5517,6 +5678,63 @@ remoteStreamRecv(virStreamPtr st,
     return rv;
 }
 
+
+static int
+remoteStreamRecv(virStreamPtr st,
+                 char *data,
+                 size_t nbytes)
+{
+    return remoteStreamRecvFlags(st, data, nbytes, 0);
+}
+
+
+static int
+remoteStreamSendHole(virStreamPtr st,
+                     long long length,
+                     unsigned int flags)
+{
+    VIR_DEBUG("st=%p length=%lld flags=%x", st, length, flags);
+    struct private_data *priv = st->conn->privateData;
+    virNetClientStreamPtr privst = st->privateData;
+    int rv;
+
+    virCheckFlags(0, -1);
+
+    if (virNetClientStreamRaiseError(privst))
+        return -1;
+
+    remoteDriverLock(priv);
+    priv->localUses++;
+    remoteDriverUnlock(priv);
+
+    rv = virNetClientStreamSendHole(privst,
+                                    priv->client,
+                                    length,
+                                    flags);
+
+    remoteDriverLock(priv);
+    priv->localUses--;
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
+
+static int
+remoteStreamRecvHole(virStreamPtr st,
+                     long long *length,
+                     unsigned int flags)
+{
+    VIR_DEBUG("st=%p length=%p flags=%x", st, length, flags);
+    virNetClientStreamPtr privst = st->privateData;
+
+    virCheckFlags(0, -1);
+
+    if (virNetClientStreamRaiseError(privst))
+        return -1;
+
+    return virNetClientStreamRecvHole(privst, length);
+}
+
 struct remoteStreamCallbackData {
     virStreamPtr st;
     virStreamEventCallback cb;
@@ -5689,7 +5907,10 @@ cleanup:
 
 static virStreamDriver remoteStreamDrv = {
     .streamRecv = remoteStreamRecv,
+    .streamRecvFlags = remoteStreamRecvFlags,
     .streamSend = remoteStreamSend,
+    .streamSendHole = remoteStreamSendHole,
+    .streamRecvHole = remoteStreamRecvHole,
     .streamFinish = remoteStreamFinish,
     .streamAbort = remoteStreamAbort,
     .streamEventAddCallback = remoteStreamEventAddCallback,
@@ -6402,6 +6623,18 @@ done:
 #include "lxc_client_bodies.h"
 #include "qemu_client_bodies.h"
 
+static virNetClientProgramPtr
+remoteGetProgram(struct private_data *priv,
+                 unsigned int flags)
+{
+    if (flags & REMOTE_CALL_QEMU)
+        return priv->qemuProgram;
+    else if (flags & REMOTE_CALL_LXC)
+        return priv->lxcProgram;
+    else
+        return priv->remoteProgram;
+}
+
 /*
  * Serial a set of arguments into a method call message,
  * send that to the server and wait for reply
@@ -6419,18 +6652,11 @@ callFull(virConnectPtr conn ATTRIBUTE_UNUSED,
          xdrproc_t ret_filter, char *ret)
 {
     int rv;
-    virNetClientProgramPtr prog;
+    virNetClientProgramPtr prog = remoteGetProgram(priv, flags);
     int counter = priv->counter++;
     virNetClientPtr client = priv->client;
     priv->localUses++;
 
-    if (flags & REMOTE_CALL_QEMU)
-        prog = priv->qemuProgram;
-    else if (flags & REMOTE_CALL_LXC)
-        prog = priv->lxcProgram;
-    else
-        prog = priv->remoteProgram;
-
     /* Unlock, so that if we get any async events/stream data
      * while processing the RPC, we don't deadlock when our
      * callbacks for those are invoked
@@ -6466,6 +6692,42 @@ call(virConnectPtr conn,
                     ret_filter, ret);
 }
 
+/*
+ * Like call(), but returns once the call is sent. @ret must stay
+ * valid until @cb is invoked from the event loop with the outcome.
+ * The caller must hold the driver lock, which is dropped while
+ * the call is queued, as callFull does.
+ */
+static int
+callAsync(virConnectPtr conn ATTRIBUTE_UNUSED,
+          struct private_data *priv,
+          unsigned int flags,
+          int proc_nr,
+          xdrproc_t args_filter, char *args,
+          xdrproc_t ret_filter, char *ret,
+          virNetClientProgramCallDoneFunc cb,
+          void *opaque)
+{
+    int rv;
+    virNetClientProgramPtr prog = remoteGetProgram(priv, flags);
+    int counter = priv->counter++;
+    virNetClientPtr client = priv->client;
+    priv->localUses++;
+
+    remoteDriverUnlock(priv);
+    rv = virNetClientProgramCallAsync(prog,
+                                      client,
+                                      counter,
+                                      proc_nr,
+                                      args_filter, args,
+                                      ret_filter, ret,
+                                      cb, opaque);
+    remoteDriverLock(priv);
+    priv->localUses--;
+
+    return rv;
+}
+
 
 static int
 remoteDomainGetInterfaceParameters(virDomainPtr domain,
@@ -6827,6 +7089,390 @@ done:
 }
 
 
+static int
+remoteStorageVolGetJobStats(virStorageVolPtr vol,
+                            int *type,
+                            virTypedParameterPtr *params,
+                            int *nparams,
+                            unsigned int flags)
+{
+    int rv = -1;
+    remote_storage_vol_get_job_stats_args args;
+    remote_storage_vol_get_job_stats_ret ret;
+    struct private_data *priv = vol->conn->storagePrivateData;
+
+    remoteDriverLock(priv);
+
+    make_nonnull_storage_vol(&args.vol, vol);
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+    if (call(vol->conn, priv, 0, REMOTE_PROC_STORAGE_VOL_GET_JOB_STATS,
+             (xdrproc_t) xdr_remote_storage_vol_get_job_stats_args, (char *) &args,
+             (xdrproc_t) xdr_remote_storage_vol_get_job_stats_ret, (char *) &ret) == -1)
+        goto done;
+
+    if (ret.params.params_len > REMOTE_STORAGE_VOL_JOB_STATS_MAX) {
+        virReportError(VIR_ERR_RPC,
+                       _("Too many job stats '%d' for limit '%d'"),
+                       ret.params.params_len,
+                       REMOTE_STORAGE_VOL_JOB_STATS_MAX);
+        goto cleanup;
+    }
+
+    *type = ret.type;
+
+    if (remoteDeserializeTypedParameters(ret.params.params_val,
+                                         ret.params.params_len,
+                                         0, params, nparams) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+cleanup:
+    xdr_free((xdrproc_t) xdr_remote_storage_vol_get_job_stats_ret,
+             (char *) &ret);
+done:
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
+
+static int
+remoteDomainStatsRecordsUnpack(virConnectPtr conn,
+                               remote_connect_get_all_domain_stats_ret *ret,
+                               virDomainStatsRecordPtr **retStats)
+{
+    int rv = -1;
+    size_t i;
+    virDomainStatsRecordPtr elem = NULL;
+    virDomainStatsRecordPtr *tmpret = NULL;
+
+    if (ret->retStats.retStats_len > REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX) {
+        virReportError(VIR_ERR_RPC,
+                       _("Too many domain stats records '%d' for limit '%d'"),
+                       ret->retStats.retStats_len,
+                       REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX);
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(tmpret, ret->retStats.retStats_len + 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ret->retStats.retStats_len; i++) {
+        remote_domain_stats_record *rec = ret->retStats.retStats_val + i;
+
+        if (VIR_ALLOC(elem) < 0)
+            goto cleanup;
+
+        if (!(elem->dom = get_nonnull_domain(conn, rec->dom)))
+            goto cleanup;
+
+        if (remoteDeserializeTypedParameters(rec->params.params_val,
+                                             rec->params.params_len,
+                                             REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX,
+                                             &elem->params,
+                                             &elem->nparams))
+            goto cleanup;
+
+        tmpret[i] = elem;
+        elem = NULL;
+    }
+
+    *retStats = tmpret;
+    tmpret = NULL;
+    rv = ret->retStats.retStats_len;
+
+cleanup:
+    if (elem) {
+        if (elem->dom)
+            virDomainFree(elem->dom);
+        VIR_FREE(elem);
+    }
+    virDomainStatsRecordListFree(tmpret);
+    return rv;
+}
+
+
+static int
+remoteConnectGetAllDomainStats(virConnectPtr conn,
+                               virDomainPtr *doms,
+                               unsigned int ndoms,
+                               unsigned int stats,
+                               virDomainStatsRecordPtr **retStats,
+                               unsigned int flags)
+{
+    struct private_data *priv = conn->privateData;
+    int rv = -1;
+    size_t i;
+    remote_connect_get_all_domain_stats_args args;
+    remote_connect_get_all_domain_stats_ret ret;
+
+    memset(&args, 0, sizeof(args));
+
+    if (ndoms) {
+        if (VIR_ALLOC_N(args.doms.doms_val, ndoms) < 0)
+            goto cleanup;
+
+        for (i = 0; i < ndoms; i++)
+            make_nonnull_domain(args.doms.doms_val + i, doms[i]);
+    }
+    args.doms.doms_len = ndoms;
+
+    args.stats = stats;
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+
+    remoteDriverLock(priv);
+    if (call(conn, priv, 0, REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS,
+             (xdrproc_t) xdr_remote_connect_get_all_domain_stats_args, (char *) &args,
+             (xdrproc_t) xdr_remote_connect_get_all_domain_stats_ret, (char *) &ret) == -1) {
+        remoteDriverUnlock(priv);
+        goto cleanup;
+    }
+    remoteDriverUnlock(priv);
+
+    rv = remoteDomainStatsRecordsUnpack(conn, &ret, retStats);
+
+cleanup:
+    VIR_FREE(args.doms.doms_val);
+    xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_stats_ret,
+             (char *) &ret);
+
+    return rv;
+}
+
+
+/*
+ * A call issued by one of the asynchronous APIs. The reply is decoded
+ * into @ret, then @finish converts it into the caller's @result and
+ * yields the value the synchronous API would have returned.
+ */
+typedef struct _remoteAsyncCall remoteAsyncCall;
+typedef remoteAsyncCall *remoteAsyncCallPtr;
+struct _remoteAsyncCall {
+    virConnectPtr conn;
+
+    xdrproc_t ret_filter;
+    union {
+        remote_domain_get_info_ret domainGetInfo;
+        remote_domain_get_xml_desc_ret domainGetXMLDesc;
+        remote_connect_get_all_domain_stats_ret connectGetAllDomainStats;
+    } ret;
+
+    int (*finish)(remoteAsyncCallPtr call);
+    void *result;
+
+    virConnectAsyncCallback cb;
+    void *opaque;
+    virFreeCallback freecb;
+};
+
+
+static remoteAsyncCallPtr
+remoteAsyncCallNew(virConnectPtr conn,
+                   xdrproc_t ret_filter,
+                   int (*finish)(remoteAsyncCallPtr call),
+                   void *result,
+                   virConnectAsyncCallback cb,
+                   void *opaque,
+                   virFreeCallback freecb)
+{
+    remoteAsyncCallPtr call;
+
+    if (VIR_ALLOC(call) < 0)
+        return NULL;
+
+    call->conn = virObjectRef(conn);
+    call->ret_filter = ret_filter;
+    call->finish = finish;
+    call->result = result;
+    call->cb = cb;
+    call->opaque = opaque;
+    call->freecb = freecb;
+
+    return call;
+}
+
+
+static void
+remoteAsyncCallFree(remoteAsyncCallPtr call)
+{
+    xdr_free(call->ret_filter, (char *) &call->ret);
+    virObjectUnref(call->conn);
+    VIR_FREE(call);
+}
+
+
+static void
+remoteAsyncCallDone(int ret, void *opaque)
+{
+    remoteAsyncCallPtr call = opaque;
+
+    if (ret == 0)
+        ret = call->finish(call);
+
+    /* Leave the error of this call, and nothing older, for the
+     * callback to look at, as a synchronous API would */
+    if (ret < 0)
+        virDispatchError(call->conn);
+    else
+        virResetLastError();
+
+    call->cb(call->conn, ret, call->opaque);
+    if (call->freecb)
+        call->freecb(call->opaque);
+
+    remoteAsyncCallFree(call);
+}
+
+
+static int
+remoteAsyncCallSend(remoteAsyncCallPtr call,
+                    int proc_nr,
+                    xdrproc_t args_filter, char *args)
+{
+    struct private_data *priv = call->conn->privateData;
+    int rv;
+
+    remoteDriverLock(priv);
+    rv = callAsync(call->conn, priv, 0, proc_nr,
+                   args_filter, args,
+                   call->ret_filter, (char *) &call->ret,
+                   remoteAsyncCallDone, call);
+    remoteDriverUnlock(priv);
+
+    if (rv < 0) {
+        remoteAsyncCallFree(call);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+remoteDomainGetInfoFinish(remoteAsyncCallPtr call)
+{
+    int rv = -1;
+    virDomainInfoPtr result = call->result;
+    remote_domain_get_info_ret *ret = &call->ret.domainGetInfo;
+
+    result->state = ret->state;
+    HYPER_TO_ULONG(result->maxMem, ret->maxMem);
+    HYPER_TO_ULONG(result->memory, ret->memory);
+    result->nrVirtCpu = ret->nrVirtCpu;
+    result->cpuTime = ret->cpuTime;
+    rv = 0;
+
+#if SIZEOF_LONG < 8
+    /* Target of HYPER_TO_ULONG on overflow */
+done:
+#endif
+    return rv;
+}
+
+
+static int
+remoteDomainGetInfoAsync(virDomainPtr dom,
+                         virDomainInfoPtr result,
+                         virConnectAsyncCallback cb,
+                         void *opaque,
+                         virFreeCallback freecb)
+{
+    remoteAsyncCallPtr call;
+    remote_domain_get_info_args args;
+
+    if (!(call = remoteAsyncCallNew(dom->conn,
+                                    (xdrproc_t) xdr_remote_domain_get_info_ret,
+                                    remoteDomainGetInfoFinish, result,
+                                    cb, opaque, freecb)))
+        return -1;
+
+    make_nonnull_domain(&args.dom, dom);
+
+    return remoteAsyncCallSend(call, REMOTE_PROC_DOMAIN_GET_INFO,
+                               (xdrproc_t) xdr_remote_domain_get_info_args,
+                               (char *) &args);
+}
+
+
+static int
+remoteDomainGetXMLDescFinish(remoteAsyncCallPtr call)
+{
+    char **xml = call->result;
+
+    *xml = call->ret.domainGetXMLDesc.xml;
+    call->ret.domainGetXMLDesc.xml = NULL;
+
+    return 0;
+}
+
+
+static int
+remoteDomainGetXMLDescAsync(virDomainPtr dom,
+                            unsigned int flags,
+                            char **xml,
+                            virConnectAsyncCallback cb,
+                            void *opaque,
+                            virFreeCallback freecb)
+{
+    remoteAsyncCallPtr call;
+    remote_domain_get_xml_desc_args args;
+
+    if (!(call = remoteAsyncCallNew(dom->conn,
+                                    (xdrproc_t) xdr_remote_domain_get_xml_desc_ret,
+                                    remoteDomainGetXMLDescFinish, xml,
+                                    cb, opaque, freecb)))
+        return -1;
+
+    make_nonnull_domain(&args.dom, dom);
+    args.flags = flags;
+
+    return remoteAsyncCallSend(call, REMOTE_PROC_DOMAIN_GET_XML_DESC,
+                               (xdrproc_t) xdr_remote_domain_get_xml_desc_args,
+                               (char *) &args);
+}
+
+
+static int
+remoteConnectGetAllDomainStatsFinish(remoteAsyncCallPtr call)
+{
+    return remoteDomainStatsRecordsUnpack(call->conn,
+                                          &call->ret.connectGetAllDomainStats,
+                                          call->result);
+}
+
+
+static int
+remoteConnectGetAllDomainStatsAsync(virConnectPtr conn,
+                                    unsigned int stats,
+                                    virDomainStatsRecordPtr **retStats,
+                                    unsigned int flags,
+                                    virConnectAsyncCallback cb,
+                                    void *opaque,
+                                    virFreeCallback freecb)
+{
+    remoteAsyncCallPtr call;
+    remote_connect_get_all_domain_stats_args args;
+
+    if (!(call = remoteAsyncCallNew(conn,
+                                    (xdrproc_t) xdr_remote_connect_get_all_domain_stats_ret,
+                                    remoteConnectGetAllDomainStatsFinish, retStats,
+                                    cb, opaque, freecb)))
+        return -1;
+
+    memset(&args, 0, sizeof(args));
+    args.stats = stats;
+    args.flags = flags;
+
+    return remoteAsyncCallSend(call, REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS,
+                               (xdrproc_t) xdr_remote_connect_get_all_domain_stats_args,
+                               (char *) &args);
+}
+
+
 static char *
 remoteDomainMigrateBegin3Params(virDomainPtr domain,
                                 virTypedParameterPtr params,
@@ -7660,6 +8306,10 @@ static virDriver remote_driver = {
     .domainMigrateFinish3Params = remoteDomainMigrateFinish3Params, /* 1.1.0 */
     .domainMigrateConfirm3Params = remoteDomainMigrateConfirm3Params, /* 1.1.0 */
     .connectGetCPUModelNames = remoteConnectGetCPUModelNames, /* 1.1.3 */
+    .connectGetAllDomainStats = remoteConnectGetAllDomainStats, /* 1.2.3 */
+    .domainGetInfoAsync = remoteDomainGetInfoAsync, /* 1.2.3 */
+    .domainGetXMLDescAsync = remoteDomainGetXMLDescAsync, /* 1.2.3 */
+    .connectGetAllDomainStatsAsync = remoteConnectGetAllDomainStatsAsync, /* 1.2.3 */
 };
 
 static virNetworkDriver network_driver = {
@@ -7721,6 +8371,8 @@ static virStorageDriver storage_driver = {
     .connectListDefinedStoragePools = remoteConnectListDefinedStoragePools, /* 0.4.1 */
     .connectListAllStoragePools = remoteConnectListAllStoragePools, /* 0.10.2 */
     .connectFindStoragePoolSources = remoteConnectFindStoragePoolSources, /* 0.4.5 */
+    .connectStoragePoolEventRegisterAny = remoteConnectStoragePoolEventRegisterAny, /* 1.2.3 */
+    .connectStoragePoolEventDeregisterAny = remoteConnectStoragePoolEventDeregisterAny, /* 1.2.3 */
     .storagePoolLookupByName = remoteStoragePoolLookupByName, /* 0.4.1 */
     .storagePoolLookupByUUID = remoteStoragePoolLookupByUUID, /* 0.4.1 */
     .storagePoolLookupByVolume = remoteStoragePoolLookupByVolume, /* 0.4.1 */
@@ -7754,6 +8406,8 @@ static virStorageDriver storage_driver = {
     .storageVolGetXMLDesc = remoteStorageVolGetXMLDesc, /* 0.4.1 */
     .storageVolGetPath = remoteStorageVolGetPath, /* 0.4.1 */
     .storageVolResize = remoteStorageVolResize, /* 0.9.10 */
+    .storageVolGetJobStats = remoteStorageVolGetJobStats, /* 1.2.3 */
+    .storageVolAbortJob = remoteStorageVolAbortJob, /* 1.2.3 */
     .storagePoolIsActive = remoteStoragePoolIsActive, /* 0.7.3 */
     .storagePoolIsPersistent = remoteStoragePoolIsPersistent, /* 0.7.3 */
 };
@@ -78,7 +78,9 @@ typedef remote_nonnull_string *remote_string;
 #define REMOTE_NODE_MEMORY_PARAMETERS_MAX 64
 #define REMOTE_DOMAIN_MIGRATE_PARAM_LIST_MAX 64
 #define REMOTE_DOMAIN_JOB_STATS_MAX 64
+#define REMOTE_STORAGE_VOL_JOB_STATS_MAX 64
 #define REMOTE_CONNECT_CPU_MODELS_MAX 8192
+#define REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX 4096
 
 typedef char remote_uuid[VIR_UUID_BUFLEN];
 
@@ -2093,6 +2095,27 @@ struct remote_storage_vol_resize_args {
 };
 typedef struct remote_storage_vol_resize_args remote_storage_vol_resize_args;
 
+struct remote_storage_vol_get_job_stats_args {
+        remote_nonnull_storage_vol vol;
+        u_int flags;
+};
+typedef struct remote_storage_vol_get_job_stats_args remote_storage_vol_get_job_stats_args;
+
+struct remote_storage_vol_get_job_stats_ret {
+        int type;
+        struct {
+                u_int params_len;
+                remote_typed_param *params_val;
+        } params;
+};
+typedef struct remote_storage_vol_get_job_stats_ret remote_storage_vol_get_job_stats_ret;
+
+struct remote_storage_vol_abort_job_args {
+        remote_nonnull_storage_vol vol;
+        u_int flags;
+};
+typedef struct remote_storage_vol_abort_job_args remote_storage_vol_abort_job_args;
+
 struct remote_node_num_of_devices_args {
         remote_string cap;
         u_int flags;
@@ -3547,6 +3570,59 @@ struct remote_network_event_lifecycle_msg {
         int detail;
 };
 typedef struct remote_network_event_lifecycle_msg remote_network_event_lifecycle_msg;
+
+struct remote_connect_storage_pool_event_register_any_args {
+        int eventID;
+        remote_storage_pool pool;
+};
+typedef struct remote_connect_storage_pool_event_register_any_args remote_connect_storage_pool_event_register_any_args;
+
+struct remote_connect_storage_pool_event_register_any_ret {
+        int callbackID;
+};
+typedef struct remote_connect_storage_pool_event_register_any_ret remote_connect_storage_pool_event_register_any_ret;
+
+struct remote_connect_storage_pool_event_deregister_any_args {
+        int callbackID;
+};
+typedef struct remote_connect_storage_pool_event_deregister_any_args remote_connect_storage_pool_event_deregister_any_args;
+
+struct remote_storage_pool_event_job_completed_msg {
+        int callbackID;
+        remote_nonnull_storage_pool pool;
+        remote_string vol;
+        u_int job;
+        int type;
+        int state;
+};
+typedef struct remote_storage_pool_event_job_completed_msg remote_storage_pool_event_job_completed_msg;
+
+struct remote_domain_stats_record {
+        remote_nonnull_domain dom;
+        struct {
+                u_int params_len;
+                remote_typed_param *params_val;
+        } params;
+};
+typedef struct remote_domain_stats_record remote_domain_stats_record;
+
+struct remote_connect_get_all_domain_stats_args {
+        struct {
+                u_int doms_len;
+                remote_nonnull_domain *doms_val;
+        } doms;
+        u_int stats;
+        u_int flags;
+};
+typedef struct remote_connect_get_all_domain_stats_args remote_connect_get_all_domain_stats_args;
+
+struct remote_connect_get_all_domain_stats_ret {
+        struct {
+                u_int retStats_len;
+                remote_domain_stats_record *retStats_val;
+        } retStats;
+};
+typedef struct remote_connect_get_all_domain_stats_ret remote_connect_get_all_domain_stats_ret;
 #define REMOTE_PROGRAM 0x20008086
 #define REMOTE_PROTOCOL_VERSION 1
 
@@ -3884,6 +3960,12 @@ enum remote_procedure {
         REMOTE_PROC_DOMAIN_EVENT_CALLBACK_BALLOON_CHANGE = 331,
         REMOTE_PROC_DOMAIN_EVENT_CALLBACK_PMSUSPEND_DISK = 332,
         REMOTE_PROC_DOMAIN_EVENT_CALLBACK_DEVICE_REMOVED = 333,
+        REMOTE_PROC_STORAGE_VOL_GET_JOB_STATS = 334,
+        REMOTE_PROC_STORAGE_VOL_ABORT_JOB = 335,
+        REMOTE_PROC_CONNECT_STORAGE_POOL_EVENT_REGISTER_ANY = 336,
+        REMOTE_PROC_CONNECT_STORAGE_POOL_EVENT_DEREGISTER_ANY = 337,
+        REMOTE_PROC_STORAGE_POOL_EVENT_JOB_COMPLETED = 338,
+        REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS = 339,
 };
 typedef enum remote_procedure remote_procedure;
 
@@ -4205,6 +4287,9 @@ extern  bool_t xdr_remote_storage_vol_get_info_ret (XDR *, remote_storage_vol_ge
 extern  bool_t xdr_remote_storage_vol_get_path_args (XDR *, remote_storage_vol_get_path_args*);
 extern  bool_t xdr_remote_storage_vol_get_path_ret (XDR *, remote_storage_vol_get_path_ret*);
 extern  bool_t xdr_remote_storage_vol_resize_args (XDR *, remote_storage_vol_resize_args*);
+extern  bool_t xdr_remote_storage_vol_get_job_stats_args (XDR *, remote_storage_vol_get_job_stats_args*);
+extern  bool_t xdr_remote_storage_vol_get_job_stats_ret (XDR *, remote_storage_vol_get_job_stats_ret*);
+extern  bool_t xdr_remote_storage_vol_abort_job_args (XDR *, remote_storage_vol_abort_job_args*);
 extern  bool_t xdr_remote_node_num_of_devices_args (XDR *, remote_node_num_of_devices_args*);
 extern  bool_t xdr_remote_node_num_of_devices_ret (XDR *, remote_node_num_of_devices_ret*);
 extern  bool_t xdr_remote_node_list_devices_args (XDR *, remote_node_list_devices_args*);
@@ -4419,6 +4504,13 @@ extern  bool_t xdr_remote_connect_network_event_register_any_args (XDR *, remote
 extern  bool_t xdr_remote_connect_network_event_register_any_ret (XDR *, remote_connect_network_event_register_any_ret*);
 extern  bool_t xdr_remote_connect_network_event_deregister_any_args (XDR *, remote_connect_network_event_deregister_any_args*);
 extern  bool_t xdr_remote_network_event_lifecycle_msg (XDR *, remote_network_event_lifecycle_msg*);
+extern  bool_t xdr_remote_connect_storage_pool_event_register_any_args (XDR *, remote_connect_storage_pool_event_register_any_args*);
+extern  bool_t xdr_remote_connect_storage_pool_event_register_any_ret (XDR *, remote_connect_storage_pool_event_register_any_ret*);
+extern  bool_t xdr_remote_connect_storage_pool_event_deregister_any_args (XDR *, remote_connect_storage_pool_event_deregister_any_args*);
+extern  bool_t xdr_remote_storage_pool_event_job_completed_msg (XDR *, remote_storage_pool_event_job_completed_msg*);
+extern  bool_t xdr_remote_domain_stats_record (XDR *, remote_domain_stats_record*);
+extern  bool_t xdr_remote_connect_get_all_domain_stats_args (XDR *, remote_connect_get_all_domain_stats_args*);
+extern  bool_t xdr_remote_connect_get_all_domain_stats_ret (XDR *, remote_connect_get_all_domain_stats_ret*);
 extern  bool_t xdr_remote_procedure (XDR *, remote_procedure*);
 
 #else /* K&R C */
@@ -4737,6 +4829,9 @@ extern bool_t xdr_remote_storage_vol_get_info_ret ();
 extern bool_t xdr_remote_storage_vol_get_path_args ();
 extern bool_t xdr_remote_storage_vol_get_path_ret ();
 extern bool_t xdr_remote_storage_vol_resize_args ();
+extern bool_t xdr_remote_storage_vol_get_job_stats_args ();
+extern bool_t xdr_remote_storage_vol_get_job_stats_ret ();
+extern bool_t xdr_remote_storage_vol_abort_job_args ();
 extern bool_t xdr_remote_node_num_of_devices_args ();
 extern bool_t xdr_remote_node_num_of_devices_ret ();
 extern bool_t xdr_remote_node_list_devices_args ();
@@ -4951,6 +5046,13 @@ extern bool_t xdr_remote_connect_network_event_register_any_args ();
 extern bool_t xdr_remote_connect_network_event_register_any_ret ();
 extern bool_t xdr_remote_connect_network_event_deregister_any_args ();
 extern bool_t xdr_remote_network_event_lifecycle_msg ();
+extern bool_t xdr_remote_connect_storage_pool_event_register_any_args ();
+extern bool_t xdr_remote_connect_storage_pool_event_register_any_ret ();
+extern bool_t xdr_remote_connect_storage_pool_event_deregister_any_args ();
+extern bool_t xdr_remote_storage_pool_event_job_completed_msg ();
+extern bool_t xdr_remote_domain_stats_record ();
+extern bool_t xdr_remote_connect_get_all_domain_stats_args ();
+extern bool_t xdr_remote_connect_get_all_domain_stats_ret ();
 extern bool_t xdr_remote_procedure ();
 
 #endif /* K&R C */
@@ -232,9 +232,16 @@ const REMOTE_DOMAIN_MIGRATE_PARAM_LIST_MAX = 64;
 /* Upper limit on number of job stats */
 const REMOTE_DOMAIN_JOB_STATS_MAX = 64;
 
+/* Upper limit on number of storage job stats */
+const REMOTE_STORAGE_VOL_JOB_STATS_MAX = 64;
+
 /* Upper limit on number of CPU models */
 const REMOTE_CONNECT_CPU_MODELS_MAX = 8192;
 
+/* Upper limit on number of domain stats records and on the number of
+ * typed parameters in a single record */
+const REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX = 4096;
+
 /* UUID.  VIR_UUID_BUFLEN definition comes from libvirt.h */
 typedef opaque remote_uuid[VIR_UUID_BUFLEN];
 
@@ -1848,6 +1855,21 @@ struct remote_storage_vol_resize_args {
     unsigned int flags;
 };
 
+struct remote_storage_vol_get_job_stats_args {
+    remote_nonnull_storage_vol vol;
+    unsigned int flags;
+};
+
+struct remote_storage_vol_get_job_stats_ret {
+    int type;
+    remote_typed_param params<REMOTE_STORAGE_VOL_JOB_STATS_MAX>;
+};
+
+struct remote_storage_vol_abort_job_args {
+    remote_nonnull_storage_vol vol;
+    unsigned int flags;
+};
+
 /* Node driver calls: */
 
 struct remote_node_num_of_devices_args {
@@ -2952,6 +2974,43 @@ struct remote_network_event_lifecycle_msg {
     int detail;
 };
 
+struct remote_connect_storage_pool_event_register_any_args {
+    int eventID;
+    remote_storage_pool pool;
+};
+
+struct remote_connect_storage_pool_event_register_any_ret {
+    int callbackID;
+};
+
+struct remote_connect_storage_pool_event_deregister_any_args {
+    int callbackID;
+};
+
+struct remote_storage_pool_event_job_completed_msg {
+    int callbackID;
+    remote_nonnull_storage_pool pool;
+    remote_string vol;
+    unsigned int job;
+    int type;
+    int state;
+};
+
+struct remote_domain_stats_record {
+    remote_nonnull_domain dom;
+    remote_typed_param params<REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX>;
+};
+
+struct remote_connect_get_all_domain_stats_args {
+    remote_nonnull_domain doms<REMOTE_DOMAIN_LIST_MAX>;
+    unsigned int stats;
+    unsigned int flags;
+};
+
+struct remote_connect_get_all_domain_stats_ret {
+    remote_domain_stats_record retStats<REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX>;
+};
+
 
 
 /*----- Protocol. -----*/
@@ -5265,5 +5324,45 @@ enum remote_procedure {
      * @generate: both
      * @acl: none
      */
-    REMOTE_PROC_DOMAIN_EVENT_CALLBACK_DEVICE_REMOVED = 333
+    REMOTE_PROC_DOMAIN_EVENT_CALLBACK_DEVICE_REMOVED = 333,
+
+    /**
+     * @generate: none
+     * @acl: storage_vol:read
+     */
+    REMOTE_PROC_STORAGE_VOL_GET_JOB_STATS = 334,
+
+    /**
+     * @generate: both
+     * @acl: storage_vol:delete
+     */
+    REMOTE_PROC_STORAGE_VOL_ABORT_JOB = 335,
+
+    /**
+     * @generate: none
+     * @priority: high
+     * @acl: connect:search_storage_pools
+     * @aclfilter: storage_pool:getattr
+     */
+    REMOTE_PROC_CONNECT_STORAGE_POOL_EVENT_REGISTER_ANY = 336,
+
+    /**
+     * @generate: none
+     * @priority: high
+     * @acl: connect:read
+     */
+    REMOTE_PROC_CONNECT_STORAGE_POOL_EVENT_DEREGISTER_ANY = 337,
+
+    /**
+     * @generate: both
+     * @acl: none
+     */
+    REMOTE_PROC_STORAGE_POOL_EVENT_JOB_COMPLETED = 338,
+
+    /**
+     * @generate: none
+     * @acl: connect:search_domains
+     * @aclfilter: domain:read
+     */
+    REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS = 339
 };
@@ -40,6 +40,12 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* Upper bound on the memory kept around for recycled outgoing messages */
+#define VIR_NET_CLIENT_POOL_MAX (256 * 1024)
+
+/* Upper bound on the asynchronous calls awaiting their reply */
+#define VIR_NET_CLIENT_ASYNC_MAX 64
+
 typedef struct _virNetClientCall virNetClientCall;
 typedef virNetClientCall *virNetClientCallPtr;
 
@@ -57,6 +63,10 @@ struct _virNetClientCall {
     bool nonBlock;
     bool haveThread;
 
+    /* Set for calls sent with virNetClientSendWithReplyAsync */
+    virNetClientCallDoneFunc doneCb;
+    void *doneOpaque;
+
     virCond cond;
 
     virNetClientCallPtr next;
@@ -80,6 +90,9 @@ struct _virNetClient {
     /* For incoming message packets */
     virNetMessage msg;
 
+    /* Recycles outgoing messages and their buffers, immutable */
+    virNetMessagePoolPtr msgPool;
+
 #if WITH_SASL
     virNetSASLSessionPtr sasl;
 #endif
@@ -98,6 +111,12 @@ struct _virNetClient {
     /* True if a thread holds the buck */
     bool haveTheBuck;
 
+    /* Asynchronous calls not yet completed, and those completed
+     * whose callbacks are yet to be run from the event loop */
+    size_t nasync;
+    virNetClientCallPtr asyncDone;
+    int asyncTimer;
+
     size_t nstreams;
     virNetClientStreamPtr *streams;
 
@@ -317,10 +336,15 @@ static virNetClientPtr virNetClientNew(virNetSocketPtr sock,
     client->wakeupReadFD = wakeupFD[0];
     client->wakeupSendFD = wakeupFD[1];
     wakeupFD[0] = wakeupFD[1] = -1;
+    client->msg.spliceFD = -1;
+    client->asyncTimer = -1;
 
     if (VIR_STRDUP(client->hostname, hostname) < 0)
         goto error;
 
+    if (!(client->msgPool = virNetMessagePoolNew(VIR_NET_CLIENT_POOL_MAX)))
+        goto error;
+
     PROBE(RPC_CLIENT_NEW,
           "client=%p sock=%p",
           client, client->sock);
@@ -621,6 +645,7 @@ void virNetClientDispose(void *obj)
 #endif
 
     virNetMessageClear(&client->msg);
+    virObjectUnref(client->msgPool);
 
     virObjectUnlock(client);
 }
@@ -638,6 +663,96 @@ virNetClientMarkClose(virNetClientPtr client,
 }
 
 
+/*
+ * Move the asynchronous calls which got their reply, or which never
+ * will because the connection is closed, over to the list of calls
+ * whose callbacks are to be run.
+ */
+static bool
+virNetClientIOEventLoopRemoveAsync(virNetClientCallPtr call,
+                                   void *opaque)
+{
+    virNetClientPtr client = opaque;
+
+    if (!call->doneCb)
+        return false;
+
+    if (call->mode != VIR_NET_CLIENT_MODE_COMPLETE && client->sock)
+        return false;
+
+    VIR_DEBUG("Async call %p done, mode=%d", call, call->mode);
+    client->nasync--;
+    virNetClientCallQueue(&client->asyncDone, call);
+    return true;
+}
+
+
+/*
+ * Run the callbacks of completed asynchronous calls. Must be
+ * called without the client lock, since the callbacks are free
+ * to make further calls.
+ */
+static void
+virNetClientAsyncComplete(virNetClientPtr client,
+                          virNetClientCallPtr calls)
+{
+    while (calls) {
+        virNetClientCallPtr call = calls;
+        calls = call->next;
+
+        virResetLastError();
+        if (call->mode == VIR_NET_CLIENT_MODE_COMPLETE) {
+            call->doneCb(client, call->msg, 0, call->doneOpaque);
+        } else {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("client socket is closed"));
+            call->doneCb(client, call->msg, -1, call->doneOpaque);
+        }
+
+        virNetMessageFree(call->msg);
+        virCondDestroy(&call->cond);
+        VIR_FREE(call);
+        virObjectUnref(client);
+    }
+}
+
+
+static void
+virNetClientAsyncTimer(int timer ATTRIBUTE_UNUSED,
+                       void *opaque)
+{
+    virNetClientPtr client = opaque;
+    virNetClientCallPtr calls;
+
+    virObjectLock(client);
+    calls = client->asyncDone;
+    client->asyncDone = NULL;
+    if (client->asyncTimer >= 0) {
+        if (client->sock) {
+            virEventUpdateTimeout(client->asyncTimer, -1);
+        } else {
+            virEventRemoveTimeout(client->asyncTimer);
+            client->asyncTimer = -1;
+        }
+    }
+    virObjectUnlock(client);
+
+    virNetClientAsyncComplete(client, calls);
+}
+
+
+/*
+ * Have the event loop run the callbacks of asynchronous calls
+ * completed by a thread other than the event loop one.
+ */
+static void
+virNetClientAsyncSchedule(virNetClientPtr client)
+{
+    if (client->asyncDone && client->asyncTimer >= 0)
+        virEventUpdateTimeout(client->asyncTimer, 0);
+}
+
+
 static void
 virNetClientCloseLocked(virNetClientPtr client)
 {
@@ -650,6 +765,17 @@ virNetClientCloseLocked(virNetClientPtr client)
 
     virObjectUnref(client->sock);
     client->sock = NULL;
+
+    /* Pending asynchronous calls fail now */
+    virNetClientCallRemovePredicate(&client->waitDispatch,
+                                    virNetClientIOEventLoopRemoveAsync,
+                                    client);
+    if (client->asyncDone) {
+        virNetClientAsyncSchedule(client);
+    } else if (client->asyncTimer >= 0) {
+        virEventRemoveTimeout(client->asyncTimer);
+        client->asyncTimer = -1;
+    }
 #if WITH_GNUTLS
     virObjectUnref(client->tls);
     client->tls = NULL;
@@ -980,12 +1106,11 @@ virNetClientCallDispatchReply(virNetClientPtr client)
         return -1;
     }
 
-    if (VIR_REALLOC_N(thecall->msg->buffer, client->msg.bufferLength) < 0)
+    if (virNetMessageResizeBuffer(thecall->msg, client->msg.bufferLength) < 0)
         return -1;
 
     memcpy(thecall->msg->buffer, client->msg.buffer, client->msg.bufferLength);
     memcpy(&thecall->msg->header, &client->msg.header, sizeof(client->msg.header));
-    thecall->msg->bufferLength = client->msg.bufferLength;
     thecall->msg->bufferOffset = client->msg.bufferOffset;
 
     thecall->msg->nfds = client->msg.nfds;
@@ -1058,7 +1183,8 @@ static int virNetClientCallDispatchStream(virNetClientPtr client)
     /* Status is either
      *   - REMOTE_OK - no payload for streams
      *   - REMOTE_ERROR - followed by a remote_error struct
-     *   - REMOTE_CONTINUE - followed by a raw data packet
+     *   - REMOTE_CONTINUE - followed by a raw data packet, or a
+     *                       virNetStreamHole for hole packets
      */
     switch (client->msg.header.status) {
     case VIR_NET_CONTINUE: {
@@ -1140,6 +1266,7 @@ virNetClientCallDispatch(virNetClientPtr client)
         return virNetClientCallDispatchMessage(client);
 
     case VIR_NET_STREAM: /* Stream protocol */
+    case VIR_NET_STREAM_HOLE: /* Sparse stream protocol */
         return virNetClientCallDispatchStream(client);
 
     default:
@@ -1181,7 +1308,7 @@ virNetClientIOWriteMessage(virNetClientPtr client,
         thecall->msg->donefds = 0;
         thecall->msg->bufferOffset = thecall->msg->bufferLength = 0;
         VIR_FREE(thecall->msg->fds);
-        VIR_FREE(thecall->msg->buffer);
+        /* keep the buffer, the reply is going to be copied into it */
         if (thecall->expectReply)
             thecall->mode = VIR_NET_CLIENT_MODE_WAIT_RX;
         else
@@ -1229,8 +1356,7 @@ virNetClientIOReadMessage(virNetClientPtr client)
 
     /* Start by reading length word */
     if (client->msg.bufferLength == 0) {
-        client->msg.bufferLength = 4;
-        if (VIR_ALLOC_N(client->msg.buffer, client->msg.bufferLength) < 0)
+        if (virNetMessageResizeBuffer(&client->msg, 4) < 0)
             return -ENOMEM;
     }
 
@@ -1310,7 +1436,7 @@ virNetClientIOHandleInput(virNetClientPtr client)
                 }
 
                 ret = virNetClientCallDispatch(client);
-                virNetMessageClear(&client->msg);
+                virNetMessageReset(&client->msg);
                 /*
                  * We've completed one call, but we don't want to
                  * spin around the loop forever if there are many
@@ -1362,6 +1488,10 @@ static bool virNetClientIOEventLoopRemoveDone(virNetClientCallPtr call,
     if (call->mode != VIR_NET_CLIENT_MODE_COMPLETE)
         return false;
 
+    /* Handed over to the event loop by virNetClientIOEventLoopRemoveAsync */
+    if (call->doneCb)
+        return false;
+
     /*
      * ...if the call being removed from the list
      * still has a thread, then wake that thread up,
@@ -1580,6 +1710,10 @@ static int virNetClientIOEventLoop(virNetClientPtr client,
         virNetClientCallRemovePredicate(&client->waitDispatch,
                                         virNetClientIOEventLoopRemoveDone,
                                         thiscall);
+        virNetClientCallRemovePredicate(&client->waitDispatch,
+                                        virNetClientIOEventLoopRemoveAsync,
+                                        client);
+        virNetClientAsyncSchedule(client);
 
         /* Now see if *we* are done */
         if (thiscall->mode == VIR_NET_CLIENT_MODE_COMPLETE) {
@@ -1694,6 +1828,11 @@ static void virNetClientIOUpdateCallback(virNetClientPtr client,
  *   - waitDispatch == NULL,
  *   - waitDispatch != NULL, waitDispatch.nonBlock == true
  *
+ * In addition, any of these states may include asynchronous calls
+ * (doneCb != NULL), which never have a thread. Whoever processes
+ * their reply hands them over to the event loop, which runs their
+ * callback.
+ *
  * NB(7) Don't Panic!
  *
  * Returns 1 if the call was queued and will be completed later (only
@@ -1810,6 +1949,7 @@ void virNetClientIncomingEvent(virNetSocketPtr sock,
                                void *opaque)
 {
     virNetClientPtr client = opaque;
+    virNetClientCallPtr asyncDone;
 
     virObjectLock(client);
 
@@ -1847,6 +1987,9 @@ void virNetClientIncomingEvent(virNetSocketPtr sock,
     virNetClientCallRemovePredicate(&client->waitDispatch,
                                     virNetClientIOEventLoopRemoveDone,
                                     NULL);
+    virNetClientCallRemovePredicate(&client->waitDispatch,
+                                    virNetClientIOEventLoopRemoveAsync,
+                                    client);
     virNetClientIOUpdateCallback(client, true);
 
 done:
@@ -1856,7 +1999,12 @@ done:
                                         virNetClientIOEventLoopRemoveAll,
                                         NULL);
     }
+    /* We are the event loop, so run the callbacks right away */
+    asyncDone = client->asyncDone;
+    client->asyncDone = NULL;
     virObjectUnlock(client);
+
+    virNetClientAsyncComplete(client, asyncDone);
 }
 
 
@@ -1997,6 +2145,116 @@ int virNetClientSendWithReply(virNetClientPtr client,
 }
 
 
+/*
+ * @msg: a message allocated on the heap
+ * @cb: called with the reply
+ * @opaque: data for @cb
+ *
+ * Send a message and return without waiting for the reply. Once
+ * the reply is received, or the connection is closed, @cb is called
+ * from the event loop. It is passed @msg filled with the reply and 0,
+ * or -1 with the error set, and must not free @msg. The number of
+ * such calls awaiting a reply on one client is bounded.
+ *
+ * The client takes over @msg on success, while on failure @cb is
+ * never called and @msg is left to the caller.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int virNetClientSendWithReplyAsync(virNetClientPtr client,
+                                   virNetMessagePtr msg,
+                                   virNetClientCallDoneFunc cb,
+                                   void *opaque)
+{
+    virNetClientCallPtr call;
+    int ret = -1;
+
+    virObjectLock(client);
+
+    PROBE(RPC_CLIENT_MSG_TX_QUEUE,
+          "client=%p len=%zu prog=%u vers=%u proc=%u type=%u status=%u serial=%u",
+          client, msg->bufferLength,
+          msg->header.prog, msg->header.vers, msg->header.proc,
+          msg->header.type, msg->header.status, msg->header.serial);
+
+    if (!client->sock || client->wantClose) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("client socket is closed"));
+        goto cleanup;
+    }
+
+    if (!client->asyncIO) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("asynchronous calls need an event loop"));
+        goto cleanup;
+    }
+
+    if (client->nasync >= VIR_NET_CLIENT_ASYNC_MAX) {
+        virReportError(VIR_ERR_OPERATION_FAILED,
+                       _("too many asynchronous calls in progress (%d)"),
+                       VIR_NET_CLIENT_ASYNC_MAX);
+        goto cleanup;
+    }
+
+    if (client->asyncTimer < 0) {
+        virObjectRef(client);
+        if ((client->asyncTimer = virEventAddTimeout(-1,
+                                                     virNetClientAsyncTimer,
+                                                     client,
+                                                     virObjectFreeCallback)) < 0) {
+            virObjectUnref(client);
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Unable to register async call timer"));
+            goto cleanup;
+        }
+    }
+
+    if (!(call = virNetClientCallNew(msg, true, false)))
+        goto cleanup;
+
+    call->doneCb = cb;
+    call->doneOpaque = opaque;
+    virNetClientCallQueue(&client->waitDispatch, call);
+
+    if (client->haveTheBuck) {
+        char ignore = 1;
+
+        /* The thread polling the socket takes care of sending it */
+        if (safewrite(client->wakeupSendFD, &ignore, sizeof(ignore)) != sizeof(ignore)) {
+            virNetClientCallRemove(&client->waitDispatch, call);
+            virCondDestroy(&call->cond);
+            VIR_FREE(call);
+            virReportSystemError(errno, "%s",
+                                 _("failed to wake up polling thread"));
+            goto cleanup;
+        }
+    } else {
+        virNetClientIOUpdateCallback(client, true);
+    }
+
+    client->nasync++;
+    virObjectRef(client);
+    ret = 0;
+
+cleanup:
+    virObjectUnlock(client);
+    return ret;
+}
+
+
+/*
+ * Allocate a message for sending to the server. Its buffer is
+ * recycled once the message is freed, so the steady state of
+ * a busy connection doesn't need to hit the allocator.
+ *
+ * Returns the new message or NULL on failure
+ */
+virNetMessagePtr virNetClientNewMessage(virNetClientPtr client)
+{
+    return virNetMessagePoolGet(client->msgPool, false);
+}
+
+
 /*
  * @msg: a message allocated on heap or stack
  *
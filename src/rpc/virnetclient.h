@@ -70,6 +70,11 @@ virNetClientPtr virNetClientNewExternal(const char **cmdargv);
 int virNetClientRegisterAsyncIO(virNetClientPtr client);
 int virNetClientRegisterKeepAlive(virNetClientPtr client);
 
+typedef void (*virNetClientCallDoneFunc)(virNetClientPtr client,
+                                         virNetMessagePtr msg,
+                                         int ret,
+                                         void *opaque);
+
 typedef void (*virNetClientCloseFunc)(virNetClientPtr client,
                                       int reason,
                                       void *opaque);
@@ -93,9 +98,16 @@ int virNetClientAddStream(virNetClientPtr client,
 void virNetClientRemoveStream(virNetClientPtr client,
                               virNetClientStreamPtr st);
 
+virNetMessagePtr virNetClientNewMessage(virNetClientPtr client);
+
 int virNetClientSendWithReply(virNetClientPtr client,
                               virNetMessagePtr msg);
 
+int virNetClientSendWithReplyAsync(virNetClientPtr client,
+                                   virNetMessagePtr msg,
+                                   virNetClientCallDoneFunc cb,
+                                   void *opaque);
+
 int virNetClientSendNoReply(virNetClientPtr client,
                             virNetMessagePtr msg);
 
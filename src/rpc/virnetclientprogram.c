@@ -266,27 +266,24 @@ cleanup:
 }
 
 
-int virNetClientProgramCall(virNetClientProgramPtr prog,
-                            virNetClientPtr client,
-                            unsigned serial,
-                            int proc,
-                            size_t noutfds,
-                            int *outfds,
-                            size_t *ninfds,
-                            int **infds,
-                            xdrproc_t args_filter, void *args,
-                            xdrproc_t ret_filter, void *ret)
+/*
+ * Build the message for a call of @proc with @args, passing
+ * @noutfds file descriptors from @outfds along
+ */
+static virNetMessagePtr
+virNetClientProgramNewCall(virNetClientProgramPtr prog,
+                           virNetClientPtr client,
+                           unsigned serial,
+                           int proc,
+                           size_t noutfds,
+                           int *outfds,
+                           xdrproc_t args_filter, void *args)
 {
     virNetMessagePtr msg;
     size_t i;
 
-    if (infds)
-        *infds = NULL;
-    if (ninfds)
-        *ninfds = 0;
-
-    if (!(msg = virNetMessageNew(false)))
-        return -1;
+    if (!(msg = virNetClientNewMessage(client)))
+        return NULL;
 
     msg->header.prog = prog->program;
     msg->header.vers = prog->version;
@@ -324,9 +321,24 @@ int virNetClientProgramCall(virNetClientProgramPtr prog,
     if (virNetMessageEncodePayload(msg, args_filter, args) < 0)
         goto error;
 
-    if (virNetClientSendWithReply(client, msg) < 0)
-        goto error;
+    return msg;
+
+error:
+    virNetMessageFree(msg);
+    return NULL;
+}
 
+
+/*
+ * Check that @msg is a successful reply to the call of @proc with
+ * @serial, reporting the remote error if it is not
+ */
+static int
+virNetClientProgramCheckReply(virNetClientProgramPtr prog,
+                              virNetMessagePtr msg,
+                              unsigned serial,
+                              int proc)
+{
     /* None of these 3 should ever happen here, because
      * virNetClientSend should have validated the reply,
      * but it doesn't hurt to check again.
@@ -335,59 +347,92 @@ int virNetClientProgramCall(virNetClientProgramPtr prog,
         msg->header.type != VIR_NET_REPLY_WITH_FDS) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message type %d"), msg->header.type);
-        goto error;
+        return -1;
     }
     if (msg->header.proc != proc) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message proc %d != %d"),
                        msg->header.proc, proc);
-        goto error;
+        return -1;
     }
     if (msg->header.serial != serial) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message serial %d != %d"),
                        msg->header.serial, serial);
-        goto error;
+        return -1;
     }
 
     switch (msg->header.status) {
     case VIR_NET_OK:
-        if (infds && ninfds) {
-            *ninfds = msg->nfds;
-            if (VIR_ALLOC_N(*infds, *ninfds) < 0)
-                goto error;
-            for (i = 0; i < *ninfds; i++)
-                (*infds)[i] = -1;
-            for (i = 0; i < *ninfds; i++) {
-                if (((*infds)[i] = dup(msg->fds[i])) < 0) {
-                    virReportSystemError(errno,
-                                         _("Cannot duplicate FD %d"),
-                                         msg->fds[i]);
-                    goto error;
-                }
-                if (virSetInherit((*infds)[i], false) < 0) {
-                    virReportSystemError(errno,
-                                         _("Cannot set close-on-exec %d"),
-                                         (*infds)[i]);
-                    goto error;
-                }
-            }
-
-        }
-        if (virNetMessageDecodePayload(msg, ret_filter, ret) < 0)
-            goto error;
-        break;
+        return 0;
 
     case VIR_NET_ERROR:
         virNetClientProgramDispatchError(prog, msg);
-        goto error;
+        return -1;
 
     default:
         virReportError(VIR_ERR_RPC,
                        _("Unexpected message status %d"), msg->header.status);
+        return -1;
+    }
+}
+
+
+int virNetClientProgramCall(virNetClientProgramPtr prog,
+                            virNetClientPtr client,
+                            unsigned serial,
+                            int proc,
+                            size_t noutfds,
+                            int *outfds,
+                            size_t *ninfds,
+                            int **infds,
+                            xdrproc_t args_filter, void *args,
+                            xdrproc_t ret_filter, void *ret)
+{
+    virNetMessagePtr msg;
+    size_t i;
+
+    if (infds)
+        *infds = NULL;
+    if (ninfds)
+        *ninfds = 0;
+
+    if (!(msg = virNetClientProgramNewCall(prog, client, serial, proc,
+                                           noutfds, outfds,
+                                           args_filter, args)))
+        return -1;
+
+    if (virNetClientSendWithReply(client, msg) < 0)
+        goto error;
+
+    if (virNetClientProgramCheckReply(prog, msg, serial, proc) < 0)
         goto error;
+
+    if (infds && ninfds) {
+        *ninfds = msg->nfds;
+        if (VIR_ALLOC_N(*infds, *ninfds) < 0)
+            goto error;
+        for (i = 0; i < *ninfds; i++)
+            (*infds)[i] = -1;
+        for (i = 0; i < *ninfds; i++) {
+            if (((*infds)[i] = dup(msg->fds[i])) < 0) {
+                virReportSystemError(errno,
+                                     _("Cannot duplicate FD %d"),
+                                     msg->fds[i]);
+                goto error;
+            }
+            if (virSetInherit((*infds)[i], false) < 0) {
+                virReportSystemError(errno,
+                                     _("Cannot set close-on-exec %d"),
+                                     (*infds)[i]);
+                goto error;
+            }
+        }
     }
 
+    if (virNetMessageDecodePayload(msg, ret_filter, ret) < 0)
+        goto error;
+
     virNetMessageFree(msg);
 
     return 0;
@@ -400,3 +445,87 @@ error:
     }
     return -1;
 }
+
+
+struct virNetClientProgramAsyncCall {
+    virNetClientProgramPtr prog;
+    unsigned serial;
+    int proc;
+    xdrproc_t ret_filter;
+    void *ret;
+    virNetClientProgramCallDoneFunc cb;
+    void *opaque;
+};
+
+static void
+virNetClientProgramCallAsyncDone(virNetClientPtr client ATTRIBUTE_UNUSED,
+                                 virNetMessagePtr msg,
+                                 int ret,
+                                 void *opaque)
+{
+    struct virNetClientProgramAsyncCall *call = opaque;
+
+    if (ret == 0 &&
+        (virNetClientProgramCheckReply(call->prog, msg,
+                                       call->serial, call->proc) < 0 ||
+         virNetMessageDecodePayload(msg, call->ret_filter, call->ret) < 0))
+        ret = -1;
+
+    call->cb(ret, call->opaque);
+
+    virObjectUnref(call->prog);
+    VIR_FREE(call);
+}
+
+
+/*
+ * Like virNetClientProgramCall, but returns as soon as the call is
+ * sent and without passing file descriptors. @ret must stay valid
+ * until @cb is called from the event loop, with 0 once @ret is
+ * filled with the reply or -1 on error, see
+ * virNetClientSendWithReplyAsync.
+ *
+ * Returns 0 if the call was sent, -1 otherwise, in which case
+ * @cb is not called
+ */
+int virNetClientProgramCallAsync(virNetClientProgramPtr prog,
+                                 virNetClientPtr client,
+                                 unsigned serial,
+                                 int proc,
+                                 xdrproc_t args_filter, void *args,
+                                 xdrproc_t ret_filter, void *ret,
+                                 virNetClientProgramCallDoneFunc cb,
+                                 void *opaque)
+{
+    virNetMessagePtr msg;
+    struct virNetClientProgramAsyncCall *call;
+
+    if (VIR_ALLOC(call) < 0)
+        return -1;
+
+    if (!(msg = virNetClientProgramNewCall(prog, client, serial, proc,
+                                           0, NULL,
+                                           args_filter, args))) {
+        VIR_FREE(call);
+        return -1;
+    }
+
+    call->prog = virObjectRef(prog);
+    call->serial = serial;
+    call->proc = proc;
+    call->ret_filter = ret_filter;
+    call->ret = ret;
+    call->cb = cb;
+    call->opaque = opaque;
+
+    if (virNetClientSendWithReplyAsync(client, msg,
+                                       virNetClientProgramCallAsyncDone,
+                                       call) < 0) {
+        virNetMessageFree(msg);
+        virObjectUnref(call->prog);
+        VIR_FREE(call);
+        return -1;
+    }
+
+    return 0;
+}
@@ -31,6 +31,13 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+typedef struct _virNetClientStreamHole virNetClientStreamHole;
+typedef virNetClientStreamHole *virNetClientStreamHolePtr;
+struct _virNetClientStreamHole {
+    size_t offset;
+    long long length;
+};
+
 struct _virNetClientStream {
     virObjectLockable parent;
 
@@ -48,10 +55,16 @@ struct _virNetClientStream {
      * off the socket....
      */
     char *incoming;
-    size_t incomingOffset;
+    size_t incomingStart;   /* already consumed bytes at the front */
+    size_t incomingOffset;  /* pending bytes after incomingStart */
     size_t incomingLength;
     bool incomingEOF;
 
+    /* Holes received on a sparse stream, in stream order. Each one
+     * sits right after the first @offset bytes of @incoming. */
+    virNetClientStreamHolePtr holes;
+    size_t nholes;
+
     virNetClientStreamEventCallback cb;
     void *cbOpaque;
     virFreeCallback cbFree;
@@ -86,7 +99,7 @@ virNetClientStreamEventTimerUpdate(virNetClientStreamPtr st)
 
     VIR_DEBUG("Check timer offset=%zu %d", st->incomingOffset, st->cbEvents);
 
-    if (((st->incomingOffset || st->incomingEOF) &&
+    if (((st->incomingOffset || st->incomingEOF || st->nholes) &&
          (st->cbEvents & VIR_STREAM_EVENT_READABLE)) ||
         (st->cbEvents & VIR_STREAM_EVENT_WRITABLE)) {
         VIR_DEBUG("Enabling event timer");
@@ -108,7 +121,7 @@ virNetClientStreamEventTimer(int timer ATTRIBUTE_UNUSED, void *opaque)
 
     if (st->cb &&
         (st->cbEvents & VIR_STREAM_EVENT_READABLE) &&
-        (st->incomingOffset || st->incomingEOF))
+        (st->incomingOffset || st->incomingEOF || st->nholes))
         events |= VIR_STREAM_EVENT_READABLE;
     if (st->cb &&
         (st->cbEvents & VIR_STREAM_EVENT_WRITABLE))
@@ -160,6 +173,7 @@ void virNetClientStreamDispose(void *obj)
 
     virResetError(&st->err);
     VIR_FREE(st->incoming);
+    VIR_FREE(st->holes);
     virObjectUnref(st->prog);
 }
 
@@ -259,6 +273,38 @@ cleanup:
 }
 
 
+static int
+virNetClientStreamQueueHole(virNetClientStreamPtr st,
+                            virNetMessagePtr msg)
+{
+    virNetStreamHole data;
+    virNetClientStreamHole hole;
+
+    memset(&data, 0, sizeof(data));
+
+    if (virNetMessageDecodePayload(msg, (xdrproc_t)xdr_virNetStreamHole,
+                                   &data) < 0)
+        return -1;
+
+    if (data.length < 0) {
+        virReportError(VIR_ERR_RPC,
+                       _("invalid stream hole length %lld"),
+                       (long long) data.length);
+        return -1;
+    }
+
+    if (st->nholes &&
+        st->holes[st->nholes - 1].offset == st->incomingOffset) {
+        st->holes[st->nholes - 1].length += data.length;
+        return 0;
+    }
+
+    hole.offset = st->incomingOffset;
+    hole.length = data.length;
+    return VIR_APPEND_ELEMENT(st->holes, st->nholes, hole);
+}
+
+
 int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
                                   virNetMessagePtr msg)
 {
@@ -266,9 +312,27 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
     size_t need;
 
     virObjectLock(st);
+
+    if (msg->header.type == VIR_NET_STREAM_HOLE) {
+        if (virNetClientStreamQueueHole(st, msg) < 0)
+            goto cleanup;
+        VIR_DEBUG("Stream hole queued at offset %zu, %zu holes",
+                  st->incomingOffset, st->nholes);
+        virNetClientStreamEventTimerUpdate(st);
+        ret = 0;
+        goto cleanup;
+    }
+
     need = msg->bufferLength - msg->bufferOffset;
     if (need) {
         size_t avail = st->incomingLength - st->incomingOffset;
+        /* The buffer is kept across packets, so only move the pending
+         * bytes to its front when the new ones would not fit after */
+        if (need > avail - st->incomingStart && st->incomingStart) {
+            memmove(st->incoming, st->incoming + st->incomingStart,
+                    st->incomingOffset);
+            st->incomingStart = 0;
+        }
         if (need > avail) {
             size_t extra = need - avail;
             if (VIR_REALLOC_N(st->incoming,
@@ -279,7 +343,7 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
             st->incomingLength += extra;
         }
 
-        memcpy(st->incoming + st->incomingOffset,
+        memcpy(st->incoming + st->incomingStart + st->incomingOffset,
                msg->buffer + msg->bufferOffset,
                msg->bufferLength - msg->bufferOffset);
         st->incomingOffset += (msg->bufferLength - msg->bufferOffset);
@@ -309,7 +373,7 @@ int virNetClientStreamSendPacket(virNetClientStreamPtr st,
     virNetMessagePtr msg;
     VIR_DEBUG("st=%p status=%d data=%p nbytes=%zu", st, status, data, nbytes);
 
-    if (!(msg = virNetMessageNew(false)))
+    if (!(msg = virNetClientNewMessage(client)))
         return -1;
 
     virObjectLock(st);
@@ -353,17 +417,88 @@ error:
     return -1;
 }
 
+int virNetClientStreamSendHole(virNetClientStreamPtr st,
+                               virNetClientPtr client,
+                               long long length,
+                               unsigned int flags)
+{
+    virNetMessagePtr msg;
+    virNetStreamHole data;
+
+    VIR_DEBUG("st=%p length=%lld flags=%x", st, length, flags);
+
+    memset(&data, 0, sizeof(data));
+    data.length = length;
+    data.flags = flags;
+
+    if (!(msg = virNetClientNewMessage(client)))
+        return -1;
+
+    virObjectLock(st);
+
+    msg->header.prog = virNetClientProgramGetProgram(st->prog);
+    msg->header.vers = virNetClientProgramGetVersion(st->prog);
+    msg->header.status = VIR_NET_CONTINUE;
+    msg->header.type = VIR_NET_STREAM_HOLE;
+    msg->header.serial = st->serial;
+    msg->header.proc = st->proc;
+
+    virObjectUnlock(st);
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto error;
+
+    if (virNetMessageEncodePayload(msg, (xdrproc_t)xdr_virNetStreamHole,
+                                   &data) < 0)
+        goto error;
+
+    if (virNetClientSendNoReply(client, msg) < 0)
+        goto error;
+
+    virNetMessageFree(msg);
+    return 0;
+
+error:
+    virNetMessageFree(msg);
+    return -1;
+}
+
+
+int virNetClientStreamRecvHole(virNetClientStreamPtr st,
+                               long long *length)
+{
+    virObjectLock(st);
+
+    *length = 0;
+    if (st->nholes && st->holes[0].offset == 0) {
+        *length = st->holes[0].length;
+        VIR_DELETE_ELEMENT(st->holes, 0, st->nholes);
+    }
+
+    VIR_DEBUG("st=%p length=%lld", st, *length);
+
+    virNetClientStreamEventTimerUpdate(st);
+    virObjectUnlock(st);
+    return 0;
+}
+
+
 int virNetClientStreamRecvPacket(virNetClientStreamPtr st,
                                  virNetClientPtr client,
                                  char *data,
                                  size_t nbytes,
-                                 bool nonblock)
+                                 bool nonblock,
+                                 unsigned int flags)
 {
     int rv = -1;
-    VIR_DEBUG("st=%p client=%p data=%p nbytes=%zu nonblock=%d",
-              st, client, data, nbytes, nonblock);
+    size_t i;
+    VIR_DEBUG("st=%p client=%p data=%p nbytes=%zu nonblock=%d flags=%x",
+              st, client, data, nbytes, nonblock, flags);
+
+    virCheckFlags(VIR_STREAM_RECV_STOP_AT_HOLE, -1);
+
     virObjectLock(st);
-    if (!st->incomingOffset && !st->incomingEOF) {
+    if (!st->incomingOffset && !st->incomingEOF && !st->nholes) {
         virNetMessagePtr msg;
         int ret;
 
@@ -373,7 +508,7 @@ int virNetClientStreamRecvPacket(virNetClientStreamPtr st,
             goto cleanup;
         }
 
-        if (!(msg = virNetMessageNew(false)))
+        if (!(msg = virNetClientNewMessage(client)))
             goto cleanup;
 
         msg->header.prog = virNetClientProgramGetProgram(st->prog);
@@ -394,18 +529,33 @@ int virNetClientStreamRecvPacket(virNetClientStreamPtr st,
     }
 
     VIR_DEBUG("After IO %zu", st->incomingOffset);
-    if (st->incomingOffset) {
+    if (st->nholes && st->holes[0].offset == 0) {
+        if (flags & VIR_STREAM_RECV_STOP_AT_HOLE) {
+            rv = -3;
+        } else {
+            /* caller is not hole-aware, hand out zeros */
+            int want = MIN(nbytes, st->holes[0].length);
+            memset(data, 0, want);
+            st->holes[0].length -= want;
+            if (!st->holes[0].length)
+                VIR_DELETE_ELEMENT(st->holes, 0, st->nholes);
+            rv = want;
+        }
+    } else if (st->incomingOffset) {
         int want = st->incomingOffset;
         if (want > nbytes)
             want = nbytes;
-        memcpy(data, st->incoming, want);
-        if (want < st->incomingOffset) {
-            memmove(st->incoming, st->incoming + want, st->incomingOffset - want);
-            st->incomingOffset -= want;
-        } else {
-            VIR_FREE(st->incoming);
-            st->incomingOffset = st->incomingLength = 0;
-        }
+        /* data stops at the next hole */
+        if (st->nholes && want > st->holes[0].offset)
+            want = st->holes[0].offset;
+        memcpy(data, st->incoming + st->incomingStart, want);
+        st->incomingOffset -= want;
+        if (st->incomingOffset)
+            st->incomingStart += want;
+        else
+            st->incomingStart = 0;
+        for (i = 0; i < st->nholes; i++)
+            st->holes[i].offset -= want;
         rv = want;
     } else {
         rv = 0;
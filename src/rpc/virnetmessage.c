@@ -30,9 +30,43 @@
 #include "virfile.h"
 #include "virutil.h"
 #include "virstring.h"
+#include "virobject.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* Idle messages are kept by the size of their buffer, following
+ * the steps virNetMessageEncodePayload grows buffers by. Larger
+ * buffers are rare enough to just be freed. */
+static const size_t virNetMessagePoolSizes[] = {
+    VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX,
+    VIR_NET_MESSAGE_INITIAL * 4 + VIR_NET_MESSAGE_LEN_MAX,
+    VIR_NET_MESSAGE_INITIAL * 16 + VIR_NET_MESSAGE_LEN_MAX,
+};
+
+struct _virNetMessagePool {
+    virObjectLockable parent;
+
+    size_t maxBytes;    /* cap on memory held by idle messages */
+    size_t idleBytes;
+    virNetMessagePtr idle[ARRAY_CARDINALITY(virNetMessagePoolSizes)];
+};
+
+static virClassPtr virNetMessagePoolClass;
+static void virNetMessagePoolDispose(void *obj);
+
+static int virNetMessageOnceInit(void)
+{
+    if (!(virNetMessagePoolClass = virClassNew(virClassForObjectLockable(),
+                                               "virNetMessagePool",
+                                               sizeof(virNetMessagePool),
+                                               virNetMessagePoolDispose)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virNetMessage)
+
 virNetMessagePtr virNetMessageNew(bool tracked)
 {
     virNetMessagePtr msg;
@@ -41,6 +75,7 @@ virNetMessagePtr virNetMessageNew(bool tracked)
         return NULL;
 
     msg->tracked = tracked;
+    msg->spliceFD = -1;
     VIR_DEBUG("msg=%p tracked=%d", msg, tracked);
 
     return msg;
@@ -50,6 +85,7 @@ virNetMessagePtr virNetMessageNew(bool tracked)
 void virNetMessageClear(virNetMessagePtr msg)
 {
     bool tracked = msg->tracked;
+    virNetMessagePoolPtr pool = msg->pool;
     size_t i;
 
     VIR_DEBUG("msg=%p nfds=%zu", msg, msg->nfds);
@@ -57,14 +93,75 @@ void virNetMessageClear(virNetMessagePtr msg)
     for (i = 0; i < msg->nfds; i++)
         VIR_FORCE_CLOSE(msg->fds[i]);
     VIR_FREE(msg->fds);
+    VIR_FORCE_CLOSE(msg->spliceFD);
     VIR_FREE(msg->buffer);
     memset(msg, 0, sizeof(*msg));
     msg->tracked = tracked;
+    msg->pool = pool;
+    msg->spliceFD = -1;
+}
+
+
+/*
+ * Like virNetMessageClear, but keeps the buffer allocated
+ * for the next message to be read or encoded into, unless
+ * it grew too large to be worth keeping
+ */
+void virNetMessageReset(virNetMessagePtr msg)
+{
+    char *buffer = msg->buffer;
+    size_t bufferAlloc = msg->bufferAlloc;
+
+    if (bufferAlloc >
+        virNetMessagePoolSizes[ARRAY_CARDINALITY(virNetMessagePoolSizes) - 1]) {
+        virNetMessageClear(msg);
+        return;
+    }
+
+    msg->buffer = NULL;
+    virNetMessageClear(msg);
+    msg->buffer = buffer;
+    msg->bufferAlloc = bufferAlloc;
+}
+
+
+/*
+ * Returns true if @pool took @msg as idle message
+ */
+static bool
+virNetMessagePoolPut(virNetMessagePoolPtr pool,
+                     virNetMessagePtr msg)
+{
+    size_t size = sizeof(*msg) + msg->bufferAlloc;
+    size_t i;
+    bool ret = false;
+
+    for (i = 0; i < ARRAY_CARDINALITY(virNetMessagePoolSizes); i++) {
+        if (msg->bufferAlloc <= virNetMessagePoolSizes[i])
+            break;
+    }
+    if (i == ARRAY_CARDINALITY(virNetMessagePoolSizes))
+        return false;
+
+    virNetMessageReset(msg);
+    msg->pool = NULL;
+
+    virObjectLock(pool);
+    if (pool->idleBytes + size <= pool->maxBytes) {
+        msg->next = pool->idle[i];
+        pool->idle[i] = msg;
+        pool->idleBytes += size;
+        ret = true;
+    }
+    virObjectUnlock(pool);
+
+    return ret;
 }
 
 
 void virNetMessageFree(virNetMessagePtr msg)
 {
+    virNetMessagePoolPtr pool;
     size_t i;
     if (!msg)
         return;
@@ -74,13 +171,147 @@ void virNetMessageFree(virNetMessagePtr msg)
     if (msg->cb)
         msg->cb(msg, msg->opaque);
 
+    if ((pool = msg->pool)) {
+        bool kept = virNetMessagePoolPut(pool, msg);
+        virObjectUnref(pool);
+        if (kept)
+            return;
+    }
+
     for (i = 0; i < msg->nfds; i++)
         VIR_FORCE_CLOSE(msg->fds[i]);
+    VIR_FORCE_CLOSE(msg->spliceFD);
     VIR_FREE(msg->buffer);
     VIR_FREE(msg->fds);
     VIR_FREE(msg);
 }
 
+
+/*
+ * @msg: the message
+ * @len: the new length
+ *
+ * Sets bufferLength to @len, growing the buffer if it has
+ * not got that much allocated yet, keeping its content
+ *
+ * returns 0 on success, -1 on OOM
+ */
+int virNetMessageResizeBuffer(virNetMessagePtr msg,
+                              size_t len)
+{
+    if (len > msg->bufferAlloc) {
+        size_t alloc = len;
+
+        /* a pooled message will be reused, so make it
+         * big enough for most messages right away */
+        if (msg->pool && alloc < virNetMessagePoolSizes[0])
+            alloc = virNetMessagePoolSizes[0];
+
+        if (VIR_REALLOC_N(msg->buffer, alloc) < 0)
+            return -1;
+        msg->bufferAlloc = alloc;
+    }
+
+    msg->bufferLength = len;
+    return 0;
+}
+
+
+/**
+ * virNetMessagePoolNew:
+ * @maxBytes: memory the pool may hold on to
+ *
+ * Creates a pool of idle messages. Messages taken from it by
+ * virNetMessagePoolGet return into it on virNetMessageFree,
+ * together with their buffer, as long as the memory held by
+ * the idle messages stays within @maxBytes.
+ *
+ * Returns the new pool, NULL on error
+ */
+virNetMessagePoolPtr virNetMessagePoolNew(size_t maxBytes)
+{
+    virNetMessagePoolPtr pool;
+
+    if (virNetMessageInitialize() < 0)
+        return NULL;
+
+    if (!(pool = virObjectLockableNew(virNetMessagePoolClass)))
+        return NULL;
+
+    pool->maxBytes = maxBytes;
+
+    return pool;
+}
+
+
+static void virNetMessagePoolDispose(void *obj)
+{
+    virNetMessagePoolPtr pool = obj;
+    size_t i;
+
+    for (i = 0; i < ARRAY_CARDINALITY(pool->idle); i++) {
+        while (pool->idle[i]) {
+            virNetMessagePtr msg = virNetMessageQueueServe(&pool->idle[i]);
+            VIR_FREE(msg->buffer);
+            VIR_FREE(msg);
+        }
+    }
+}
+
+
+/**
+ * virNetMessagePoolGet:
+ * @pool: the pool, or NULL
+ * @tracked: whether the message is tracked
+ *
+ * Takes an idle message out of @pool, preferring those with the
+ * smallest buffer, or allocates a new one. Without a @pool this
+ * is the same as virNetMessageNew.
+ *
+ * Returns the message, NULL on OOM
+ */
+virNetMessagePtr virNetMessagePoolGet(virNetMessagePoolPtr pool,
+                                      bool tracked)
+{
+    virNetMessagePtr msg = NULL;
+    size_t i;
+
+    if (!pool)
+        return virNetMessageNew(tracked);
+
+    virObjectLock(pool);
+    for (i = 0; i < ARRAY_CARDINALITY(pool->idle); i++) {
+        if ((msg = virNetMessageQueueServe(&pool->idle[i]))) {
+            pool->idleBytes -= sizeof(*msg) + msg->bufferAlloc;
+            break;
+        }
+    }
+    virObjectUnlock(pool);
+
+    if (msg) {
+        msg->tracked = tracked;
+        VIR_DEBUG("msg=%p tracked=%d reused", msg, tracked);
+    } else if (!(msg = virNetMessageNew(tracked))) {
+        return NULL;
+    }
+
+    msg->pool = virObjectRef(pool);
+    return msg;
+}
+
+
+size_t virNetMessagePoolGetIdleBytes(virNetMessagePoolPtr pool)
+{
+    size_t ret;
+
+    virObjectLock(pool);
+    ret = pool->idleBytes;
+    virObjectUnlock(pool);
+
+    return ret;
+}
+
+
 void virNetMessageQueuePush(virNetMessagePtr *queue, virNetMessagePtr msg)
 {
     virNetMessagePtr tmp = *queue;
@@ -141,8 +372,7 @@ int virNetMessageDecodeLength(virNetMessagePtr msg)
 
     /* Extend our declared buffer length and carry
        on reading the header + payload */
-    msg->bufferLength += len;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+    if (virNetMessageResizeBuffer(msg, msg->bufferLength + len) < 0)
         goto cleanup;
 
     VIR_DEBUG("Got length, now need %zu total (%u more)",
@@ -218,8 +448,8 @@ int virNetMessageEncodeHeader(virNetMessagePtr msg)
     int ret = -1;
     unsigned int len = 0;
 
-    msg->bufferLength = VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+    if (virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_INITIAL +
+                                  VIR_NET_MESSAGE_LEN_MAX) < 0)
         return ret;
     msg->bufferOffset = 0;
 
@@ -355,9 +585,7 @@ int virNetMessageEncodePayload(virNetMessagePtr msg,
 
         xdr_destroy(&xdr);
 
-        msg->bufferLength = newlen + VIR_NET_MESSAGE_LEN_MAX;
-
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+        if (virNetMessageResizeBuffer(msg, newlen + VIR_NET_MESSAGE_LEN_MAX) < 0)
             goto error;
 
         xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
@@ -439,9 +667,7 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
             return -1;
         }
 
-        msg->bufferLength = msg->bufferOffset + len;
-
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+        if (virNetMessageResizeBuffer(msg, msg->bufferOffset + len) < 0)
             return -1;
 
         VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
@@ -495,6 +721,96 @@ error:
 }
 
 
+/*
+ * Like virNetMessageEncodePayloadRaw, but the @len payload bytes
+ * are not copied into the buffer. They are spliced from the pipe
+ * @fd right after the buffer was sent. The message takes over
+ * @fd, even on failure.
+ */
+int virNetMessageEncodePayloadSplice(virNetMessagePtr msg,
+                                     int fd,
+                                     size_t len)
+{
+    XDR xdr;
+    unsigned int msglen;
+
+    if ((msg->bufferOffset + len) >
+        (VIR_NET_MESSAGE_MAX + VIR_NET_MESSAGE_LEN_MAX)) {
+        virReportError(VIR_ERR_RPC,
+                       _("Stream data too long to send "
+                         "(%zu bytes needed, %zu bytes available)"),
+                       len,
+                       VIR_NET_MESSAGE_MAX +
+                       VIR_NET_MESSAGE_LEN_MAX -
+                       msg->bufferOffset);
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    /* Encode the length word covering the spliced payload too. */
+    VIR_DEBUG("Encode length as %zu", msg->bufferOffset + len);
+    xdrmem_create(&xdr, msg->buffer, VIR_NET_MESSAGE_HEADER_XDR_LEN, XDR_ENCODE);
+    msglen = msg->bufferOffset + len;
+    if (!xdr_u_int(&xdr, &msglen)) {
+        virReportError(VIR_ERR_RPC, "%s", _("Unable to encode message length"));
+        goto error;
+    }
+    xdr_destroy(&xdr);
+
+    VIR_FORCE_CLOSE(msg->spliceFD);
+    msg->spliceFD = fd;
+    msg->spliceLength = len;
+    msg->spliceOffset = 0;
+
+    msg->bufferLength = msg->bufferOffset;
+    msg->bufferOffset = 0;
+    return 0;
+
+error:
+    xdr_destroy(&xdr);
+    VIR_FORCE_CLOSE(fd);
+    return -1;
+}
+
+
+/*
+ * Reads the part of the spliced payload which was not sent yet
+ * into the buffer, for sockets which cannot be spliced into. The
+ * rest of the message is then written out like any other one.
+ */
+int virNetMessageCopySplice(virNetMessagePtr msg)
+{
+    size_t len = msg->spliceLength - msg->spliceOffset;
+    size_t offset = msg->bufferLength;
+    ssize_t got;
+
+    VIR_DEBUG("Copying %zu spliced bytes into the buffer", len);
+
+    if (virNetMessageResizeBuffer(msg, offset + len) < 0)
+        return -1;
+
+    /* The bytes were waiting in the pipe already when the
+     * message was encoded, so this does not block */
+    if ((got = saferead(msg->spliceFD, msg->buffer + offset, len)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to read spliced stream data"));
+        msg->bufferLength = offset;
+        return -1;
+    }
+    if (got != len) {
+        virReportError(VIR_ERR_RPC,
+                       _("Spliced stream data ended after %zd of %zu bytes"),
+                       got, len);
+        msg->bufferLength = offset;
+        return -1;
+    }
+
+    VIR_FORCE_CLOSE(msg->spliceFD);
+    msg->spliceLength = msg->spliceOffset = 0;
+    return 0;
+}
+
+
 void virNetMessageSaveError(virNetMessageErrorPtr rerr)
 {
     /* This func may be called several times & the first
@@ -29,6 +29,9 @@ typedef struct virNetMessageError *virNetMessageErrorPtr;
 typedef struct _virNetMessage virNetMessage;
 typedef virNetMessage *virNetMessagePtr;
 
+typedef struct _virNetMessagePool virNetMessagePool;
+typedef virNetMessagePool *virNetMessagePoolPtr;
+
 typedef void (*virNetMessageFreeCallback)(virNetMessagePtr msg, void *opaque);
 
 struct _virNetMessage {
@@ -38,6 +41,7 @@ struct _virNetMessage {
                   /* Maximum   VIR_NET_MESSAGE_MAX     + VIR_NET_MESSAGE_LEN_MAX */
     size_t bufferLength;
     size_t bufferOffset;
+    size_t bufferAlloc; /* allocated size of @buffer */
 
     virNetMessageHeader header;
 
@@ -48,6 +52,15 @@ struct _virNetMessage {
     int *fds;
     size_t donefds;
 
+    /* Stream payload which follows the buffer on the wire,
+     * spliced straight from a pipe; -1 if none */
+    int spliceFD;
+    size_t spliceLength;
+    size_t spliceOffset;
+
+    /* Pool the message goes back to when freed, if any */
+    virNetMessagePoolPtr pool;
+
     virNetMessagePtr next;
 };
 
@@ -55,9 +68,21 @@ struct _virNetMessage {
 virNetMessagePtr virNetMessageNew(bool tracked);
 
 void virNetMessageClear(virNetMessagePtr);
+void virNetMessageReset(virNetMessagePtr msg)
+    ATTRIBUTE_NONNULL(1);
 
 void virNetMessageFree(virNetMessagePtr msg);
 
+int virNetMessageResizeBuffer(virNetMessagePtr msg,
+                              size_t len)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
+
+virNetMessagePoolPtr virNetMessagePoolNew(size_t maxBytes);
+virNetMessagePtr virNetMessagePoolGet(virNetMessagePoolPtr pool,
+                                      bool tracked);
+size_t virNetMessagePoolGetIdleBytes(virNetMessagePoolPtr pool)
+    ATTRIBUTE_NONNULL(1);
+
 virNetMessagePtr virNetMessageQueueServe(virNetMessagePtr *queue)
     ATTRIBUTE_NONNULL(1);
 void virNetMessageQueuePush(virNetMessagePtr *queue,
@@ -89,6 +114,12 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
 int virNetMessageEncodePayloadEmpty(virNetMessagePtr msg)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
+int virNetMessageEncodePayloadSplice(virNetMessagePtr msg,
+                                     int fd,
+                                     size_t len)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
+int virNetMessageCopySplice(virNetMessagePtr msg)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
 
 void virNetMessageSaveError(virNetMessageErrorPtr rerr)
     ATTRIBUTE_NONNULL(1);
@@ -33,6 +33,7 @@
 #include "virerror.h"
 #include "virthread.h"
 #include "virthreadpool.h"
+#include "virtime.h"
 #include "virutil.h"
 #include "virfile.h"
 #include "virnetservermdns.h"
@@ -63,6 +64,7 @@ struct _virNetServerJob {
     virNetServerClientPtr client;
     virNetMessagePtr msg;
     virNetServerProgramPtr prog;
+    unsigned long long queued;
 };
 
 struct _virNetServer {
@@ -180,10 +182,15 @@ static void virNetServerHandleJob(void *jobOpaque, void *opaque)
 {
     virNetServerPtr srv = opaque;
     virNetServerJobPtr job = jobOpaque;
+    unsigned long long now;
 
     VIR_DEBUG("server=%p client=%p message=%p prog=%p",
               srv, job->client, job->msg, job->prog);
 
+    if (!job->queued || virTimeMillisNow(&now) < 0 || now < job->queued)
+        now = job->queued;
+    virNetServerClientJobStarted(job->client, now - job->queued);
+
     if (virNetServerProcessMsg(srv, job->client, job->prog, job->msg) < 0)
         goto error;
 
@@ -229,6 +236,8 @@ static int virNetServerDispatchNewMessage(virNetServerClientPtr client,
 
         job->client = client;
         job->msg = msg;
+        if (virTimeMillisNow(&job->queued) < 0)
+            job->queued = 0;
 
         if (prog) {
             virObjectRef(prog);
@@ -236,11 +245,14 @@ static int virNetServerDispatchNewMessage(virNetServerClientPtr client,
             priority = virNetServerProgramGetPriority(prog, msg->header.proc);
         }
 
-        ret = virThreadPoolSendJob(srv->workers, priority, job);
-
-        if (ret < 0) {
+        /* Calls are queued per client, so that a client with
+         * plenty of them in flight can't starve the others */
+        if (virThreadPoolSendJobFull(srv->workers, priority,
+                                     client, job) < 0) {
             VIR_FREE(job);
             virObjectUnref(prog);
+        } else {
+            ret = 1;
         }
     } else {
         ret = virNetServerProcessMsg(srv, client, prog, msg);
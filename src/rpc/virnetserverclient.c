@@ -37,9 +37,19 @@
 #include "virkeepalive.h"
 #include "virstring.h"
 #include "virutil.h"
+#include "virfile.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* Memory each client may keep in idle messages for reuse */
+#define VIR_NET_SERVER_CLIENT_POOL_MAX (256 * 1024)
+
+/* Size of the buffer incoming requests are read ahead into */
+#define VIR_NET_SERVER_CLIENT_READ_AHEAD (16 * 1024)
+
+/* Most tx messages to go out with a single write */
+#define VIR_NET_SERVER_CLIENT_WRITEV_MAX 64
+
 /* Allow for filtering of incoming messages to a custom
  * dispatch processing queue, instead of the workers.
  * This allows for certain types of messages to be handled
@@ -94,6 +104,19 @@ struct _virNetServerClient
      * back to client, including async events */
     virNetMessagePtr tx;
 
+    /* Data read from the socket ahead of the 'rx' message,
+     * so that a burst of small requests takes a single read */
+    char *rxBuffer;
+    size_t rxBufferOffset;
+    size_t rxBufferLength;
+    /* Passed by the client along the last byte of rxBuffer */
+    int rxBufferFD;
+
+    /* Recycles messages and their buffers, immutable */
+    virNetMessagePoolPtr msgPool;
+
+    virNetServerClientJobStats jobStats;
+
     /* Filters to capture messages that would otherwise
      * end up on the 'dx' queue */
     virNetServerClientFilterPtr filters;
@@ -228,7 +251,9 @@ static void virNetServerClientUpdateEvent(virNetServerClientPtr client)
 
     virNetSocketUpdateIOCallback(client->sock, mode);
 
-    if (client->rx && virNetSocketHasCachedData(client->sock))
+    if (client->rx &&
+        (virNetSocketHasCachedData(client->sock) ||
+         client->rxBufferOffset < client->rxBufferLength))
         virEventUpdateTimeout(client->sockTimer, 0);
 }
 
@@ -305,15 +330,14 @@ virNetServerClientCheckAccess(virNetServerClientPtr client)
         return -1;
     }
 
-    if (!(confirm = virNetMessageNew(false)))
+    if (!(confirm = virNetMessagePoolGet(client->msgPool, false)))
         return -1;
 
     /* Checks have succeeded.  Write a '\1' byte back to the client to
      * indicate this (otherwise the socket is abruptly closed).
      * (NB. The '\1' byte is sent in an encrypted record).
      */
-    confirm->bufferLength = 1;
-    if (VIR_ALLOC_N(confirm->buffer, confirm->bufferLength) < 0) {
+    if (virNetMessageResizeBuffer(confirm, 1) < 0) {
         virNetMessageFree(confirm);
         return -1;
     }
@@ -365,17 +389,23 @@ virNetServerClientNewInternal(virNetSocketPtr sock,
     client->tlsCtxt = virObjectRef(tls);
 #endif
     client->nrequests_max = nrequests_max;
+    client->rxBufferFD = -1;
+
+    if (VIR_ALLOC_N(client->rxBuffer, VIR_NET_SERVER_CLIENT_READ_AHEAD) < 0)
+        goto error;
 
     client->sockTimer = virEventAddTimeout(-1, virNetServerClientSockTimerFunc,
                                            client, NULL);
     if (client->sockTimer < 0)
         goto error;
 
+    if (!(client->msgPool = virNetMessagePoolNew(VIR_NET_SERVER_CLIENT_POOL_MAX)))
+        goto error;
+
     /* Prepare one for packet receive */
-    if (!(client->rx = virNetMessageNew(true)))
+    if (!(client->rx = virNetMessagePoolGet(client->msgPool, true)))
         goto error;
-    client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_ALLOC_N(client->rx->buffer, client->rx->bufferLength) < 0)
+    if (virNetMessageResizeBuffer(client->rx, VIR_NET_MESSAGE_LEN_MAX) < 0)
         goto error;
     client->nrequests = 1;
 
@@ -577,6 +607,30 @@ bool virNetServerClientGetReadonly(virNetServerClientPtr client)
     return readonly;
 }
 
+void virNetServerClientGetJobStats(virNetServerClientPtr client,
+                                   virNetServerClientJobStatsPtr stats)
+{
+    virObjectLock(client);
+    *stats = client->jobStats;
+    virObjectUnlock(client);
+}
+
+/*
+ * Account for a call of the client leaving the worker pool
+ * queue after @waited milliseconds
+ */
+void virNetServerClientJobStarted(virNetServerClientPtr client,
+                                  unsigned long long waited)
+{
+    virObjectLock(client);
+    client->jobStats.queued--;
+    client->jobStats.started++;
+    client->jobStats.waitTotal += waited;
+    if (waited > client->jobStats.waitMax)
+        client->jobStats.waitMax = waited;
+    virObjectUnlock(client);
+}
+
 
 #ifdef WITH_GNUTLS
 bool virNetServerClientHasTLSSession(virNetServerClientPtr client)
@@ -812,6 +866,29 @@ int virNetServerClientGetSELinuxContext(virNetServerClientPtr client,
 }
 
 
+/*
+ * Whether stream data may be spliced straight into the client
+ * socket, i.e. nothing encrypts the connection
+ */
+bool virNetServerClientCanSplice(virNetServerClientPtr client)
+{
+    bool canSplice = false;
+    virObjectLock(client);
+    if (client->sock && virNetSocketCanSplice(client->sock))
+        canSplice = true;
+#if WITH_GNUTLS
+    if (client->tls)
+        canSplice = false;
+#endif
+#if WITH_SASL
+    if (client->sasl)
+        canSplice = false;
+#endif
+    virObjectUnlock(client);
+    return canSplice;
+}
+
+
 bool virNetServerClientIsSecure(virNetServerClientPtr client)
 {
     bool secure = false;
@@ -926,6 +1003,9 @@ void virNetServerClientDispose(void *obj)
     virObjectUnref(client->tlsCtxt);
 #endif
     virObjectUnref(client->sock);
+    virObjectUnref(client->msgPool);
+    VIR_FREE(client->rxBuffer);
+    VIR_FORCE_CLOSE(client->rxBufferFD);
     virObjectUnlock(client);
 }
 
@@ -950,6 +1030,10 @@ void virNetServerClientClose(virNetServerClientPtr client)
         return;
     }
 
+    VIR_DEBUG("client=%p jobs queued=%zu started=%llu wait total=%llums max=%llums",
+              client, client->jobStats.queued, client->jobStats.started,
+              client->jobStats.waitTotal, client->jobStats.waitMax);
+
     if (client->keepalive) {
         virKeepAliveStop(client->keepalive);
         ka = client->keepalive;
@@ -1099,6 +1183,7 @@ error:
  */
 static ssize_t virNetServerClientRead(virNetServerClientPtr client)
 {
+    size_t want;
     ssize_t ret;
 
     if (client->rx->bufferLength <= client->rx->bufferOffset) {
@@ -1109,18 +1194,72 @@ static ssize_t virNetServerClientRead(virNetServerClientPtr client)
         return -1;
     }
 
-    ret = virNetSocketRead(client->sock,
-                           client->rx->buffer + client->rx->bufferOffset,
-                           client->rx->bufferLength - client->rx->bufferOffset);
+    want = client->rx->bufferLength - client->rx->bufferOffset;
 
-    if (ret <= 0)
-        return ret;
+    if (client->rxBufferOffset == client->rxBufferLength) {
+        int fd;
+
+        /* Bulk payloads are read straight into the message */
+        if (want >= VIR_NET_SERVER_CLIENT_READ_AHEAD) {
+            ret = virNetSocketRead(client->sock,
+                                   client->rx->buffer + client->rx->bufferOffset,
+                                   want);
+            if (ret <= 0)
+                return ret;
+
+            client->rx->bufferOffset += ret;
+            return ret;
+        }
+
+        ret = virNetSocketReadWithFD(client->sock, client->rxBuffer,
+                                     VIR_NET_SERVER_CLIENT_READ_AHEAD, &fd);
+        if (ret <= 0)
+            return ret;
+
+        VIR_FORCE_CLOSE(client->rxBufferFD);
+        client->rxBufferFD = fd;
+        client->rxBufferOffset = 0;
+        client->rxBufferLength = ret;
+    }
 
+    ret = MIN(want, client->rxBufferLength - client->rxBufferOffset);
+    memcpy(client->rx->buffer + client->rx->bufferOffset,
+           client->rxBuffer + client->rxBufferOffset, ret);
+    client->rxBufferOffset += ret;
     client->rx->bufferOffset += ret;
     return ret;
 }
 
 
+/*
+ * Receive a file descriptor following client->rx
+ *
+ * Returns:
+ *   -1 on error
+ *    0 on EAGAIN
+ *    1 on success
+ */
+static int virNetServerClientRecvFD(virNetServerClientPtr client, int *fd)
+{
+    /* The byte carrying it might have been read ahead already */
+    if (client->rxBufferOffset < client->rxBufferLength) {
+        if (client->rxBufferFD == -1 ||
+            client->rxBufferOffset + 1 != client->rxBufferLength) {
+            virReportError(VIR_ERR_RPC, "%s",
+                           _("client did not pass the announced file descriptor"));
+            return -1;
+        }
+
+        client->rxBufferOffset++;
+        *fd = client->rxBufferFD;
+        client->rxBufferFD = -1;
+        return 1;
+    }
+
+    return virNetSocketRecvFD(client->sock, fd);
+}
+
+
 /*
  * Read data until we get a complete message to process
  */
@@ -1178,7 +1317,7 @@ readmore:
         /* Try getting the file descriptors (may fail if blocking) */
         for (i = msg->donefds; i < msg->nfds; i++) {
             int rv;
-            if ((rv = virNetSocketRecvFD(client->sock, &(msg->fds[i]))) < 0) {
+            if ((rv = virNetServerClientRecvFD(client, &(msg->fds[i]))) < 0) {
                 virNetMessageQueueServe(&client->rx);
                 virNetMessageFree(msg);
                 client->wantClose = true;
@@ -1240,24 +1379,28 @@ readmore:
 
         /* Send off to for normal dispatch to workers */
         if (msg) {
+            int rv = -1;
+
             virObjectRef(client);
             if (!client->dispatchFunc ||
-                client->dispatchFunc(client, msg, client->dispatchOpaque) < 0) {
+                (rv = client->dispatchFunc(client, msg,
+                                           client->dispatchOpaque)) < 0) {
                 virNetMessageFree(msg);
                 client->wantClose = true;
                 virObjectUnref(client);
                 return;
             }
+            if (rv > 0)
+                client->jobStats.queued++;
         }
 
         /* Possibly need to create another receive buffer */
         if (client->nrequests < client->nrequests_max) {
-            if (!(client->rx = virNetMessageNew(true))) {
+            if (!(client->rx = virNetMessagePoolGet(client->msgPool, true))) {
                 client->wantClose = true;
             } else {
-                client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                if (VIR_ALLOC_N(client->rx->buffer,
-                                client->rx->bufferLength) < 0) {
+                if (virNetMessageResizeBuffer(client->rx,
+                                              VIR_NET_MESSAGE_LEN_MAX) < 0) {
                     client->wantClose = true;
                 } else {
                     client->nrequests++;
@@ -1265,12 +1408,19 @@ readmore:
             }
         }
         virNetServerClientUpdateEvent(client);
+
+        /* Pick up any further requests that were read ahead
+         * along with this one before going back to poll() */
+        if (client->rx && !client->wantClose &&
+            client->rxBufferOffset < client->rxBufferLength)
+            goto readmore;
     }
 }
 
 
 /*
- * Send client->tx using no encoding
+ * Send client->tx using no encoding, together with as many of
+ * the messages queued behind it as can share the same write
  *
  * Returns:
  *   -1 on error or EOF
@@ -1279,6 +1429,10 @@ readmore:
  */
 static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
 {
+    struct iovec iov[VIR_NET_SERVER_CLIENT_WRITEV_MAX];
+    virNetMessagePtr msg;
+    size_t left;
+    int niov = 0;
     ssize_t ret;
 
     if (client->tx->bufferLength < client->tx->bufferOffset) {
@@ -1292,13 +1446,34 @@ static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
     if (client->tx->bufferLength == client->tx->bufferOffset)
         return 1;
 
-    ret = virNetSocketWrite(client->sock,
-                            client->tx->buffer + client->tx->bufferOffset,
-                            client->tx->bufferLength - client->tx->bufferOffset);
+    for (msg = client->tx;
+         msg && niov < VIR_NET_SERVER_CLIENT_WRITEV_MAX;
+         msg = msg->next) {
+        iov[niov].iov_base = msg->buffer + msg->bufferOffset;
+        iov[niov].iov_len = msg->bufferLength - msg->bufferOffset;
+        niov++;
+
+        /* File descriptors and spliced data have to follow their
+         * own message on the wire, and a pending SASL session
+         * applies to whatever is sent after the current message */
+        if (msg->nfds || msg->spliceLength)
+            break;
+#if WITH_SASL
+        if (client->sasl)
+            break;
+#endif
+    }
+
+    ret = virNetSocketWriteV(client->sock, iov, niov);
     if (ret <= 0)
         return ret; /* -1 error, 0 = egain */
 
-    client->tx->bufferOffset += ret;
+    left = ret;
+    for (msg = client->tx; msg && left; msg = msg->next) {
+        size_t len = MIN(left, msg->bufferLength - msg->bufferOffset);
+        msg->bufferOffset += len;
+        left -= len;
+    }
     return ret;
 }
 
@@ -1322,6 +1497,33 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
                 return; /* Would block on write EAGAIN */
         }
 
+        if (client->tx->bufferOffset == client->tx->bufferLength &&
+            client->tx->spliceOffset < client->tx->spliceLength) {
+            ssize_t ret;
+            ret = virNetSocketSplice(client->sock,
+                                     client->tx->spliceFD,
+                                     client->tx->spliceLength -
+                                     client->tx->spliceOffset);
+            if (ret == -2) {
+                /* Not a socket splice() can write to after all,
+                 * send the data from the message buffer instead */
+                if (virNetMessageCopySplice(client->tx) < 0) {
+                    client->wantClose = true;
+                    return;
+                }
+                continue;
+            }
+            if (ret < 0) {
+                client->wantClose = true;
+                return;
+            }
+            if (ret == 0)
+                return; /* Would block on write EAGAIN */
+            client->tx->spliceOffset += ret;
+            if (client->tx->spliceOffset < client->tx->spliceLength)
+                return;
+        }
+
         if (client->tx->bufferOffset == client->tx->bufferLength) {
             virNetMessagePtr msg;
             size_t i;
@@ -1357,9 +1559,9 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
                 if (!client->rx &&
                     client->nrequests < client->nrequests_max) {
                     /* Ready to recv more messages */
-                    virNetMessageClear(msg);
-                    msg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                    if (VIR_ALLOC_N(msg->buffer, msg->bufferLength) < 0) {
+                    virNetMessageReset(msg);
+                    if (virNetMessageResizeBuffer(msg,
+                                                  VIR_NET_MESSAGE_LEN_MAX) < 0) {
                         virNetMessageFree(msg);
                         return;
                     }
@@ -1472,6 +1674,16 @@ virNetServerClientSendMessageLocked(virNetServerClientPtr client,
     return ret;
 }
 
+/*
+ * Returns a new untracked message to be sent to @client,
+ * recycled from an earlier one if possible
+ */
+virNetMessagePtr virNetServerClientNewMessage(virNetServerClientPtr client)
+{
+    return virNetMessagePoolGet(client->msgPool, false);
+}
+
+
 int virNetServerClientSendMessage(virNetServerClientPtr client,
                                   virNetMessagePtr msg)
 {
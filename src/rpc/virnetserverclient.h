@@ -33,6 +33,22 @@
 typedef struct _virNetServerClient virNetServerClient;
 typedef virNetServerClient *virNetServerClientPtr;
 
+typedef struct _virNetServerClientJobStats virNetServerClientJobStats;
+typedef virNetServerClientJobStats *virNetServerClientJobStatsPtr;
+
+/* Calls of the client that went through the worker pool */
+struct _virNetServerClientJobStats {
+    size_t queued;                /* waiting for a worker right now */
+    unsigned long long started;   /* picked up by a worker so far */
+    unsigned long long waitTotal; /* time spent waiting, in milliseconds */
+    unsigned long long waitMax;   /* longest single wait, in milliseconds */
+};
+
+/*
+ * Returns -1 on error, 0 if @msg was processed straight away,
+ * or 1 if it was queued up for a worker, which is going to call
+ * virNetServerClientJobStarted once it picks it up
+ */
 typedef int (*virNetServerClientDispatchFunc)(virNetServerClientPtr client,
                                               virNetMessagePtr msg,
                                               void *opaque);
@@ -79,6 +95,10 @@ void virNetServerClientRemoveFilter(virNetServerClientPtr client,
 int virNetServerClientGetAuth(virNetServerClientPtr client);
 void virNetServerClientSetAuth(virNetServerClientPtr client, int auth);
 bool virNetServerClientGetReadonly(virNetServerClientPtr client);
+void virNetServerClientGetJobStats(virNetServerClientPtr client,
+                                   virNetServerClientJobStatsPtr stats);
+void virNetServerClientJobStarted(virNetServerClientPtr client,
+                                  unsigned long long waited);
 
 # ifdef WITH_GNUTLS
 bool virNetServerClientHasTLSSession(virNetServerClientPtr client);
@@ -96,6 +116,8 @@ int virNetServerClientGetFD(virNetServerClientPtr client);
 
 bool virNetServerClientIsSecure(virNetServerClientPtr client);
 
+bool virNetServerClientCanSplice(virNetServerClientPtr client);
+
 bool virNetServerClientIsLocal(virNetServerClientPtr client);
 
 int virNetServerClientGetUNIXIdentity(virNetServerClientPtr client,
@@ -136,6 +158,8 @@ int virNetServerClientStartKeepAlive(virNetServerClientPtr client);
 const char *virNetServerClientLocalAddrString(virNetServerClientPtr client);
 const char *virNetServerClientRemoteAddrString(virNetServerClientPtr client);
 
+virNetMessagePtr virNetServerClientNewMessage(virNetServerClientPtr client);
+
 int virNetServerClientSendMessage(virNetServerClientPtr client,
                                   virNetMessagePtr msg);
 
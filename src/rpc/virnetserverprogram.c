@@ -205,7 +205,9 @@ virNetServerProgramSendReplyError(virNetServerProgramPtr prog,
                                         msg,
                                         rerr,
                                         req->proc,
-                                        req->type == VIR_NET_STREAM ? VIR_NET_STREAM : VIR_NET_REPLY,
+                                        (req->type == VIR_NET_STREAM ||
+                                         req->type == VIR_NET_STREAM_HOLE) ?
+                                        VIR_NET_STREAM : VIR_NET_REPLY,
                                         req->serial);
 }
 
@@ -306,6 +308,7 @@ int virNetServerProgramDispatch(virNetServerProgramPtr prog,
         break;
 
     case VIR_NET_STREAM:
+    case VIR_NET_STREAM_HOLE:
         /* Since stream data is non-acked, async, we may continue to receive
          * stream packets after we closed down a stream. Just drop & ignore
          * these.
@@ -546,6 +549,75 @@ int virNetServerProgramSendStreamData(virNetServerProgramPtr prog,
 }
 
 
+/*
+ * Sends @len bytes of stream data which are spliced from the
+ * pipe @fd into the client socket. @msg takes over @fd.
+ */
+int virNetServerProgramSendStreamSplice(virNetServerProgramPtr prog,
+                                        virNetServerClientPtr client,
+                                        virNetMessagePtr msg,
+                                        int procedure,
+                                        int serial,
+                                        int fd,
+                                        size_t len)
+{
+    VIR_DEBUG("client=%p msg=%p fd=%d len=%zu", client, msg, fd, len);
+
+    msg->header.prog = prog->program;
+    msg->header.vers = prog->version;
+    msg->header.proc = procedure;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = serial;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0) {
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    if (virNetMessageEncodePayloadSplice(msg, fd, len) < 0)
+        return -1;
+    VIR_DEBUG("Total %zu", msg->bufferLength + len);
+
+    return virNetServerClientSendMessage(client, msg);
+}
+
+
+int virNetServerProgramSendStreamHole(virNetServerProgramPtr prog,
+                                      virNetServerClientPtr client,
+                                      virNetMessagePtr msg,
+                                      int procedure,
+                                      int serial,
+                                      long long length,
+                                      unsigned int flags)
+{
+    virNetStreamHole data;
+
+    VIR_DEBUG("client=%p msg=%p length=%lld", client, msg, length);
+
+    memset(&data, 0, sizeof(data));
+    data.length = length;
+    data.flags = flags;
+
+    msg->header.prog = prog->program;
+    msg->header.vers = prog->version;
+    msg->header.proc = procedure;
+    msg->header.type = VIR_NET_STREAM_HOLE;
+    msg->header.serial = serial;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        return -1;
+
+    if (virNetMessageEncodePayload(msg,
+                                   (xdrproc_t) xdr_virNetStreamHole,
+                                   &data) < 0)
+        return -1;
+
+    return virNetServerClientSendMessage(client, msg);
+}
+
+
 void virNetServerProgramDispose(void *obj ATTRIBUTE_UNUSED)
 {
 }
@@ -25,6 +25,7 @@
 
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <signal.h>
@@ -61,6 +62,10 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* Vectored writes through a session layer are coalesced into a
+ * buffer of this size, which is also the largest TLS record */
+#define VIR_NET_SOCKET_WRITEV_COALESCE_MAX (16 * 1024)
+
 
 struct _virNetSocket {
     virObjectLockable parent;
@@ -70,6 +75,7 @@ struct _virNetSocket {
     pid_t pid;
     int errfd;
     bool client;
+    bool noSplice;              /* splice() refused to write to fd */
 
     /* Event callback fields */
     virNetSocketIOFunc func;
@@ -94,10 +100,14 @@ struct _virNetSocket {
     const char *saslEncoded;
     size_t saslEncodedLength;
     size_t saslEncodedOffset;
+    size_t saslEncodedRawLength; /* raw bytes that went into saslEncoded */
 #endif
 #if WITH_SSH2
     virNetSSHSessionPtr sshSession;
 #endif
+
+    /* Staging area for virNetSocketWriteV */
+    char *writevBuffer;
 };
 
 
@@ -1053,6 +1063,7 @@ void virNetSocketDispose(void *obj)
 
     VIR_FREE(sock->localAddrStr);
     VIR_FREE(sock->remoteAddrStr);
+    VIR_FREE(sock->writevBuffer);
 }
 
 
@@ -1105,6 +1116,44 @@ bool virNetSocketHasPassFD(virNetSocketPtr sock)
 }
 
 
+/*
+ * Whether data goes through a session layer which transforms
+ * it on the way to and from the wire
+ */
+static bool virNetSocketHasSessionLocked(virNetSocketPtr sock ATTRIBUTE_UNUSED)
+{
+#if WITH_GNUTLS
+    if (sock->tlsSession)
+        return true;
+#endif
+#if WITH_SASL
+    if (sock->saslSession)
+        return true;
+#endif
+#if WITH_SSH2
+    if (sock->sshSession)
+        return true;
+#endif
+    return false;
+}
+
+
+/*
+ * Data can only be spliced straight into the socket if nothing
+ * has to transform it on the way to the wire
+ */
+bool virNetSocketCanSplice(virNetSocketPtr sock)
+{
+    bool canSplice = false;
+#ifdef __linux__
+    virObjectLock(sock);
+    canSplice = !sock->noSplice && !virNetSocketHasSessionLocked(sock);
+    virObjectUnlock(sock);
+#endif
+    return canSplice;
+}
+
+
 int virNetSocketGetPort(virNetSocketPtr sock)
 {
     int port;
@@ -1567,6 +1616,7 @@ static ssize_t virNetSocketWriteSASL(virNetSocketPtr sock, const char *buf, size
             return -1;
 
         sock->saslEncodedOffset = 0;
+        sock->saslEncodedRawLength = tosend;
     }
 
     /* Send some of the encoded stuff out on the wire */
@@ -1582,8 +1632,12 @@ static ssize_t virNetSocketWriteSASL(virNetSocketPtr sock, const char *buf, size
 
     /* Sent all encoded, so update raw buffer to indicate completion */
     if (sock->saslEncodedOffset == sock->saslEncodedLength) {
+        /* The caller may have queued more data behind the pending
+         * packet since it was encoded, so report only what went in */
+        tosend = sock->saslEncodedRawLength;
         sock->saslEncoded = NULL;
         sock->saslEncodedOffset = sock->saslEncodedLength = 0;
+        sock->saslEncodedRawLength = 0;
 
         /* Mark as complete, so caller detects completion */
         return tosend;
@@ -1628,6 +1682,213 @@ ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len)
 }
 
 
+/*
+ * Writes out as much of @iov as the socket accepts in one go.
+ * Plain sockets hand the vector straight to writev(), while
+ * sockets with a session layer get it coalesced into a single
+ * buffer, so that several small messages share one TLS record
+ * or SASL packet rather than being framed one by one.
+ *
+ * Returns number of bytes written, 0 on EAGAIN, -1 on error
+ */
+ssize_t virNetSocketWriteV(virNetSocketPtr sock,
+                           const struct iovec *iov,
+                           int iovcnt)
+{
+    ssize_t ret = -1;
+    size_t len = 0;
+    int i;
+
+    if (iovcnt == 1 ||
+        iov[0].iov_len >= VIR_NET_SOCKET_WRITEV_COALESCE_MAX)
+        return virNetSocketWrite(sock, iov[0].iov_base, iov[0].iov_len);
+
+    virObjectLock(sock);
+
+    if (virNetSocketHasSessionLocked(sock)) {
+        if (!sock->writevBuffer &&
+            VIR_ALLOC_N(sock->writevBuffer,
+                        VIR_NET_SOCKET_WRITEV_COALESCE_MAX) < 0)
+            goto cleanup;
+
+        /* A retry after EAGAIN is given at least the same leading
+         * bytes again, which is what TLS and SASL rely on */
+        for (i = 0; i < iovcnt && len < VIR_NET_SOCKET_WRITEV_COALESCE_MAX; i++) {
+            size_t n = MIN(iov[i].iov_len,
+                           VIR_NET_SOCKET_WRITEV_COALESCE_MAX - len);
+            memcpy(sock->writevBuffer + len, iov[i].iov_base, n);
+            len += n;
+        }
+
+#if WITH_SASL
+        if (sock->saslSession)
+            ret = virNetSocketWriteSASL(sock, sock->writevBuffer, len);
+        else
+#endif
+            ret = virNetSocketWriteWire(sock, sock->writevBuffer, len);
+        goto cleanup;
+    }
+
+rewrite:
+    ret = writev(sock->fd, iov, iovcnt);
+    if (ret < 0) {
+        if (errno == EINTR)
+            goto rewrite;
+        if (errno == EAGAIN) {
+            ret = 0;
+        } else {
+            virReportSystemError(errno, "%s",
+                                 _("Cannot write data"));
+        }
+    } else if (ret == 0) {
+        virReportSystemError(EIO, "%s",
+                             _("End of file while writing data"));
+        ret = -1;
+    }
+
+cleanup:
+    virObjectUnlock(sock);
+    return ret;
+}
+
+
+/*
+ * Like virNetSocketRead, except that a file descriptor passed
+ * by the peer along with the data is stored in @fd instead of
+ * being discarded by the kernel. Reading stops right after the
+ * byte that carried it, so the caller can tell where it belongs
+ * in the stream. @fd is set to -1 if none was received.
+ *
+ * Returns number of bytes read, 0 on EAGAIN, -1 on error or EOF
+ */
+ssize_t virNetSocketReadWithFD(virNetSocketPtr sock,
+                               char *buf,
+                               size_t len,
+                               int *fd)
+{
+#ifdef SCM_RIGHTS
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr cmsg;
+        char control[CMSG_SPACE(sizeof(int))];
+    } u;
+    struct cmsghdr *cmsg;
+    ssize_t ret;
+
+    *fd = -1;
+
+    virObjectLock(sock);
+    if (sock->localAddr.data.sa.sa_family != AF_UNIX ||
+        virNetSocketHasSessionLocked(sock)) {
+        virObjectUnlock(sock);
+        return virNetSocketRead(sock, buf, len);
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&u, 0, sizeof(u));
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = u.control;
+    msg.msg_controllen = sizeof(u.control);
+
+reread:
+    ret = recvmsg(sock->fd, &msg, 0);
+    if (ret < 0) {
+        if (errno == EINTR)
+            goto reread;
+        if (errno == EAGAIN) {
+            ret = 0;
+        } else {
+            virReportSystemError(errno, "%s",
+                                 _("Cannot recv data"));
+        }
+        goto cleanup;
+    } else if (ret == 0) {
+        virReportSystemError(EIO, "%s",
+                             _("End of file while reading data"));
+        ret = -1;
+        goto cleanup;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+            if (virSetCloseExec(*fd) < 0) {
+                virReportSystemError(errno, "%s",
+                                     _("Failed to set close-on-exec flag"));
+                VIR_FORCE_CLOSE(*fd);
+                ret = -1;
+                goto cleanup;
+            }
+            PROBE(RPC_SOCKET_RECV_FD,
+                  "sock=%p fd=%d", sock, *fd);
+        }
+    }
+
+cleanup:
+    virObjectUnlock(sock);
+    return ret;
+#else
+    *fd = -1;
+    return virNetSocketRead(sock, buf, len);
+#endif
+}
+
+
+/*
+ * Moves up to @len bytes from the pipe @fd to the socket
+ * without copying them through user space
+ *
+ * Returns number of bytes moved, 0 if it would block, -1 on error,
+ * -2 without an error reported if the data cannot be spliced into
+ * this socket, in which case the caller has to copy it instead
+ */
+#ifdef __linux__
+ssize_t virNetSocketSplice(virNetSocketPtr sock, int fd, size_t len)
+{
+    ssize_t ret;
+
+    virObjectLock(sock);
+resplice:
+    ret = splice(fd, NULL, sock->fd, NULL, len,
+                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (ret < 0) {
+        if (errno == EINTR)
+            goto resplice;
+        if (errno == EAGAIN) {
+            ret = 0;
+        } else if (errno == EINVAL || errno == ENOSYS) {
+            VIR_DEBUG("Cannot splice into socket %p (errno=%d), "
+                      "copying instead", sock, errno);
+            sock->noSplice = true;
+            ret = -2;
+        } else {
+            virReportSystemError(errno, "%s",
+                                 _("Cannot splice data"));
+        }
+    } else if (ret == 0) {
+        virReportSystemError(EIO, "%s",
+                             _("End of file while splicing data"));
+        ret = -1;
+    }
+    virObjectUnlock(sock);
+    return ret;
+}
+#else
+ssize_t virNetSocketSplice(virNetSocketPtr sock ATTRIBUTE_UNUSED,
+                           int fd ATTRIBUTE_UNUSED,
+                           size_t len ATTRIBUTE_UNUSED)
+{
+    return -2;
+}
+#endif
+
+
 /*
  * Returns 1 if an FD was sent, 0 if it would block, -1 on error
  */
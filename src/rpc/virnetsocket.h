@@ -24,6 +24,8 @@
 #ifndef __VIR_NET_SOCKET_H__
 # define __VIR_NET_SOCKET_H__
 
+# include <sys/uio.h>
+
 # include "virsocketaddr.h"
 # include "vircommand.h"
 # ifdef WITH_GNUTLS
@@ -111,6 +113,8 @@ bool virNetSocketIsLocal(virNetSocketPtr sock);
 
 bool virNetSocketHasPassFD(virNetSocketPtr sock);
 
+bool virNetSocketCanSplice(virNetSocketPtr sock);
+
 int virNetSocketGetPort(virNetSocketPtr sock);
 
 int virNetSocketGetUNIXIdentity(virNetSocketPtr sock,
@@ -126,6 +130,15 @@ int virNetSocketSetBlocking(virNetSocketPtr sock,
 
 ssize_t virNetSocketRead(virNetSocketPtr sock, char *buf, size_t len);
 ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len);
+ssize_t virNetSocketWriteV(virNetSocketPtr sock,
+                           const struct iovec *iov,
+                           int iovcnt);
+ssize_t virNetSocketReadWithFD(virNetSocketPtr sock,
+                               char *buf,
+                               size_t len,
+                               int *fd);
+
+ssize_t virNetSocketSplice(virNetSocketPtr sock, int fd, size_t len);
 
 int virNetSocketSendFD(virNetSocketPtr sock, int fd);
 int virNetSocketRecvFD(virNetSocketPtr sock, int *fd);
@@ -34,10 +34,15 @@
 #include <sys/param.h>
 #include <dirent.h>
 #include "dirname.h"
+#include "intprops.h"
 #ifdef __linux__
 # include <sys/ioctl.h>
+# include <sys/sendfile.h>
 # include <linux/fs.h>
 #endif
+#if HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 
 #if WITH_SELINUX
 # include <selinux/selinux.h>
@@ -51,6 +56,7 @@
 #include "viruuid.h"
 #include "virstoragefile.h"
 #include "storage_backend.h"
+#include "storage_job.h"
 #include "virlog.h"
 #include "virfile.h"
 #include "stat-time.h"
@@ -148,26 +154,323 @@ enum {
     TOOL_QCOW_CREATE,
 };
 
-#define READ_BLOCK_SIZE_DEFAULT  (1024 * 1024)
+#define READ_BLOCK_SIZE_DEFAULT  (4 * 1024 * 1024)
 #define WRITE_BLOCK_SIZE_DEFAULT (4 * 1024)
+/* Largest range handed to the kernel in one copy_file_range/sendfile
+ * call, so that a huge volume does not get stuck in a single syscall */
+#define KERNEL_COPY_CHUNK_SIZE   (1024 * 1024 * 1024)
+
+typedef struct _virStorageBackendCopyState virStorageBackendCopyState;
+typedef virStorageBackendCopyState *virStorageBackendCopyStatePtr;
+struct _virStorageBackendCopyState {
+    virStorageVolDefPtr vol;
+    virStorageVolDefPtr inputvol;
+    int inputfd;
+    int fd;
+    bool want_sparse;
+    virStorageJobPtr job;   /* job reporting the progress, or NULL */
+
+    bool noCopyRange;       /* copy_file_range is not usable for this pair */
+    bool noSendfile;        /* neither is sendfile */
+
+    char *buf;
+    size_t bufsize;
+    char *zerobuf;
+    size_t wbytes;
+};
+
+
+/* Tell the storage job doing the copy, if any, that everything up to
+ * @offset is done. Returns 0, or -ECANCELED with an error reported if
+ * the job was asked to abort. */
+static int
+virStorageBackendCopyProgress(virStorageBackendCopyStatePtr state,
+                              off_t offset)
+{
+    virStorageJobSetProcessed(state->job, offset);
+    if (virStorageJobCheckAborted(state->job) < 0)
+        return -ECANCELED;
+    return 0;
+}
+
+
+/* errno values telling that an in-kernel copy method is not supported
+ * for the given pair of files, rather than that the copy failed */
+static bool
+virStorageBackendCopyUnsupported(int err)
+{
+    return err == ENOSYS || err == EOPNOTSUPP || err == EXDEV ||
+           err == EINVAL || err == EBADF || err == ETXTBSY;
+}
+
+
+/*
+ * Replace the whole content of @state->fd with a reflink of the input
+ * file, sharing all its extents (and holes). Only regular files on a
+ * filesystem supporting FICLONE (btrfs, XFS with reflink=1, ...) qualify.
+ * Returns 0 on success, 1 if the caller should copy the data instead.
+ */
+#if defined(__linux__) && defined(FICLONE)
+static int
+virStorageBackendCopyReflink(virStorageBackendCopyStatePtr state,
+                             off_t inputsize)
+{
+    struct stat st;
+
+    if (fstat(state->fd, &st) < 0 || !S_ISREG(st.st_mode))
+        return 1;
+
+    if (ioctl(state->fd, FICLONE, state->inputfd) < 0) {
+        VIR_DEBUG("reflink from '%s' to '%s' not possible: %d",
+                  state->inputvol->target.path, state->vol->target.path,
+                  errno);
+        return 1;
+    }
+
+    /* The clone takes over the size of the input file; restore the
+     * capacity the caller set up front */
+    if (st.st_size > inputsize &&
+        ftruncate(state->fd, st.st_size) < 0) {
+        int ret = -errno;
+        virReportSystemError(errno,
+                             _("cannot extend file '%s'"),
+                             state->vol->target.path);
+        return ret;
+    }
+
+    VIR_DEBUG("reflinked '%s' to '%s'",
+              state->inputvol->target.path, state->vol->target.path);
+    return 0;
+}
+#else
+static int
+virStorageBackendCopyReflink(virStorageBackendCopyStatePtr state ATTRIBUTE_UNUSED,
+                             off_t inputsize ATTRIBUTE_UNUSED)
+{
+    return 1;
+}
+#endif
+
+
+/*
+ * Copy [*offset, end) with copy_file_range, which lets the filesystem
+ * share extents or do a server side copy, or with sendfile, which at
+ * least avoids bouncing the data through userspace. On return *offset
+ * tells how far the copy got. Returns 0 when done (or on EOF), 1 if
+ * neither method works for these files and the caller has to continue
+ * by other means, or -errno on failure.
+ */
+#ifdef __linux__
+static int
+virStorageBackendCopyKernel(virStorageBackendCopyStatePtr state,
+                            off_t *offset,
+                            off_t end)
+{
+    ssize_t n;
+    int ret;
+
+# if HAVE_SYS_SYSCALL_H && defined(SYS_copy_file_range)
+    while (!state->noCopyRange && *offset < end) {
+        loff_t inoff = *offset;
+        loff_t outoff = *offset;
+
+        n = syscall(SYS_copy_file_range,
+                    state->inputfd, &inoff, state->fd, &outoff,
+                    (size_t) MIN(end - *offset, KERNEL_COPY_CHUNK_SIZE), 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (virStorageBackendCopyUnsupported(errno)) {
+                VIR_DEBUG("copy_file_range not usable for '%s': %d",
+                          state->vol->target.path, errno);
+                state->noCopyRange = true;
+                break;
+            }
+            goto error;
+        }
+        if (n == 0)
+            return 0;
+        *offset += n;
+        if ((ret = virStorageBackendCopyProgress(state, *offset)) < 0)
+            return ret;
+    }
+    if (*offset >= end)
+        return 0;
+# endif
+
+    if (state->noSendfile)
+        return 1;
+
+    if (lseek(state->fd, *offset, SEEK_SET) < 0) {
+        ret = -errno;
+        virReportSystemError(errno,
+                             _("cannot seek in file '%s'"),
+                             state->vol->target.path);
+        return ret;
+    }
 
-static int ATTRIBUTE_NONNULL(2)
+    while (*offset < end) {
+        off_t inoff = *offset;
+
+        n = sendfile(state->fd, state->inputfd, &inoff,
+                     (size_t) MIN(end - *offset, KERNEL_COPY_CHUNK_SIZE));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (virStorageBackendCopyUnsupported(errno)) {
+                VIR_DEBUG("sendfile not usable for '%s': %d",
+                          state->vol->target.path, errno);
+                state->noSendfile = true;
+                return 1;
+            }
+            goto error;
+        }
+        if (n == 0)
+            return 0;
+        *offset += n;
+        if ((ret = virStorageBackendCopyProgress(state, *offset)) < 0)
+            return ret;
+    }
+    return 0;
+
+ error:
+    ret = -errno;
+    virReportSystemError(errno,
+                         _("failed copying '%s' to '%s'"),
+                         state->inputvol->target.path,
+                         state->vol->target.path);
+    return ret;
+}
+#else
+static int
+virStorageBackendCopyKernel(virStorageBackendCopyStatePtr state ATTRIBUTE_UNUSED,
+                            off_t *offset ATTRIBUTE_UNUSED,
+                            off_t end ATTRIBUTE_UNUSED)
+{
+    return 1;
+}
+#endif
+
+
+/*
+ * Copy [*offset, end) through a userspace buffer. When sparse output is
+ * wanted, blocks full of zeros are skipped rather than written. Stops
+ * early on EOF. Returns 0 on success, -errno on failure.
+ */
+static int
+virStorageBackendCopyReadWrite(virStorageBackendCopyStatePtr state,
+                               off_t *offset,
+                               off_t end)
+{
+    int ret;
+
+    if (lseek(state->inputfd, *offset, SEEK_SET) < 0 ||
+        lseek(state->fd, *offset, SEEK_SET) < 0) {
+        ret = -errno;
+        virReportSystemError(errno,
+                             _("cannot seek in file '%s'"),
+                             state->vol->target.path);
+        return ret;
+    }
+
+    while (*offset < end) {
+        size_t rbytes = MIN(state->bufsize, end - *offset);
+        ssize_t amtread;
+        size_t pos;
+
+        if ((amtread = saferead(state->inputfd, state->buf, rbytes)) < 0) {
+            ret = -errno;
+            virReportSystemError(errno,
+                                 _("failed reading from file '%s'"),
+                                 state->inputvol->target.path);
+            return ret;
+        }
+        if (amtread == 0)
+            break;
+
+        /* Loop over amt read in wbytes increments, looking for sparse
+         * blocks */
+        for (pos = 0; pos < (size_t) amtread; pos += state->wbytes) {
+            size_t interval = MIN(state->wbytes, amtread - pos);
+
+            if (state->want_sparse &&
+                memcmp(state->buf + pos, state->zerobuf, interval) == 0) {
+                if (lseek(state->fd, interval, SEEK_CUR) < 0) {
+                    ret = -errno;
+                    virReportSystemError(errno,
+                                         _("cannot extend file '%s'"),
+                                         state->vol->target.path);
+                    return ret;
+                }
+            } else if (safewrite(state->fd, state->buf + pos, interval) < 0) {
+                ret = -errno;
+                virReportSystemError(errno,
+                                     _("failed writing to file '%s'"),
+                                     state->vol->target.path);
+                return ret;
+            }
+        }
+        *offset += amtread;
+
+        if ((ret = virStorageBackendCopyProgress(state, *offset)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Copy one range of the input, which is known to contain data, to the
+ * same range of the output. In-kernel copies are preferred when sparse
+ * output is wanted; they are only used for regular input files, where
+ * the caller already skipped the holes.
+ */
+static int
+virStorageBackendCopyRange(virStorageBackendCopyStatePtr state,
+                           bool kernelCopy,
+                           off_t *offset,
+                           off_t end)
+{
+    int rc;
+
+    if (kernelCopy &&
+        (rc = virStorageBackendCopyKernel(state, offset, end)) <= 0)
+        return rc;
+
+    return virStorageBackendCopyReadWrite(state, offset, end);
+}
+
+
+/*
+ * Copy at most *total bytes of @inputvol into @fd, which must be positioned
+ * at the start, and subtract the number of bytes covered from *total.
+ *
+ * With @want_sparse, the cheapest method that works is used: a reflink
+ * of the whole file, then copy_file_range/sendfile on the data extents
+ * found with SEEK_DATA/SEEK_HOLE, and a read/write loop as the last
+ * resort. Otherwise every byte is written with the read/write loop, as
+ * in-kernel copies may share extents or keep holes and the new volume
+ * must get its whole allocation.
+ */
+int
 virStorageBackendCopyToFD(virStorageVolDefPtr vol,
                           virStorageVolDefPtr inputvol,
                           int fd,
                           unsigned long long *total,
                           bool want_sparse)
 {
+    virStorageBackendCopyState state;
     int inputfd = -1;
-    int amtread = -1;
     int ret = 0;
-    size_t rbytes = READ_BLOCK_SIZE_DEFAULT;
     int wbytes = 0;
-    int interval;
-    char *zerobuf = NULL;
-    char *buf = NULL;
+    bool regular;
+    off_t offset = 0;
+    off_t end;
     struct stat st;
 
+    memset(&state, 0, sizeof(state));
+
     if ((inputfd = open(inputvol->target.path, O_RDONLY)) < 0) {
         ret = -errno;
         virReportSystemError(errno,
@@ -186,56 +489,87 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
     if (wbytes < WRITE_BLOCK_SIZE_DEFAULT)
         wbytes = WRITE_BLOCK_SIZE_DEFAULT;
 
-    if (VIR_ALLOC_N(zerobuf, wbytes) < 0) {
-        ret = -errno;
-        goto cleanup;
-    }
+    state.vol = vol;
+    state.inputvol = inputvol;
+    state.inputfd = inputfd;
+    state.fd = fd;
+    state.want_sparse = want_sparse;
+    state.job = virStorageJobGetCurrent();
+    state.wbytes = wbytes;
+    state.bufsize = READ_BLOCK_SIZE_DEFAULT;
 
-    if (VIR_ALLOC_N(buf, rbytes) < 0) {
+    if (fstat(inputfd, &st) < 0) {
         ret = -errno;
+        virReportSystemError(errno,
+                             _("cannot stat file '%s'"),
+                             inputvol->target.path);
         goto cleanup;
     }
 
-    while (amtread != 0) {
-        int amtleft;
+    /* Block devices and the like don't report a useful size, so they are
+     * simply read until EOF */
+    regular = S_ISREG(st.st_mode);
+    end = MIN(*total, (unsigned long long) TYPE_MAXIMUM(off_t));
+    if (regular && st.st_size < end)
+        end = st.st_size;
+    if (regular)
+        virStorageJobSetTotal(state.job, end);
 
-        if (*total < rbytes)
-            rbytes = *total;
-
-        if ((amtread = saferead(inputfd, buf, rbytes)) < 0) {
-            ret = -errno;
-            virReportSystemError(errno,
-                                 _("failed reading from file '%s'"),
-                                 inputvol->target.path);
+    if (regular && want_sparse && end == st.st_size) {
+        if ((ret = virStorageBackendCopyReflink(&state, st.st_size)) < 0)
             goto cleanup;
+        if (ret == 0) {
+            offset = end;
+            goto done;
         }
-        *total -= amtread;
+        ret = 0;
+    }
 
-        /* Loop over amt read in 512 byte increments, looking for sparse
-         * blocks */
-        amtleft = amtread;
-        do {
-            interval = ((wbytes > amtleft) ? amtleft : wbytes);
-            int offset = amtread - amtleft;
+    if (VIR_ALLOC_N(state.zerobuf, state.wbytes) < 0 ||
+        VIR_ALLOC_N(state.buf, state.bufsize) < 0) {
+        ret = -errno;
+        goto cleanup;
+    }
 
-            if (want_sparse && memcmp(buf+offset, zerobuf, interval) == 0) {
-                if (lseek(fd, interval, SEEK_CUR) < 0) {
-                    ret = -errno;
-                    virReportSystemError(errno,
-                                         _("cannot extend file '%s'"),
-                                         vol->target.path);
-                    goto cleanup;
+    if (!regular || !want_sparse) {
+        ret = virStorageBackendCopyRange(&state, false, &offset, end);
+    } else {
+        /* Walk the data extents; whatever lies in between stays a hole
+         * in the output as well */
+        while (ret == 0 && offset < end) {
+            off_t data = lseek(inputfd, offset, SEEK_DATA);
+            off_t hole;
+
+            if (data < 0) {
+                if (errno == ENXIO) {
+                    /* Nothing but a hole up to EOF */
+                    offset = end;
+                    break;
                 }
-            } else if (safewrite(fd, buf+offset, interval) < 0) {
-                ret = -errno;
-                virReportSystemError(errno,
-                                     _("failed writing to file '%s'"),
-                                     vol->target.path);
-                goto cleanup;
-
+                /* No SEEK_DATA support, treat everything as data */
+                ret = virStorageBackendCopyRange(&state, true, &offset, end);
+                break;
             }
-        } while ((amtleft -= interval) > 0);
+            if (data >= end) {
+                offset = end;
+                break;
+            }
+
+            if ((hole = lseek(inputfd, data, SEEK_HOLE)) < 0 || hole > end)
+                hole = end;
+
+            offset = data;
+            ret = virStorageBackendCopyRange(&state, true, &offset, hole);
+            if (ret == 0 && offset < hole)
+                break; /* file shrank underneath us */
+        }
     }
+    if (ret < 0)
+        goto cleanup;
+
+ done:
+    *total -= offset;
+    virStorageJobSetProcessed(state.job, offset);
 
     if (fdatasync(fd) < 0) {
         ret = -errno;
@@ -257,8 +591,8 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
 cleanup:
     VIR_FORCE_CLOSE(inputfd);
 
-    VIR_FREE(zerobuf);
-    VIR_FREE(buf);
+    VIR_FREE(state.zerobuf);
+    VIR_FREE(state.buf);
 
     return ret;
 }
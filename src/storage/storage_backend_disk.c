@@ -48,17 +48,17 @@ virStorageBackendDiskMakeDataVol(virStoragePoolObjPtr pool,
                                  virStorageVolDefPtr vol)
 {
     char *tmp, *devpath;
+    bool isNewVol = false;
 
     if (vol == NULL) {
         if (VIR_ALLOC(vol) < 0)
             return -1;
 
-        if (VIR_REALLOC_N(pool->volumes.objs,
-                          pool->volumes.count+1) < 0) {
+        if (virStoragePoolObjAddVol(pool, vol) < 0) {
             virStorageVolDefFree(vol);
             return -1;
         }
-        pool->volumes.objs[pool->volumes.count++] = vol;
+        isNewVol = true;
 
         /* Prepended path will be same for all partitions, so we can
          * strip the path to form a reasonable pool-unique name
@@ -140,6 +140,11 @@ virStorageBackendDiskMakeDataVol(virStoragePoolObjPtr pool,
     if (vol->source.extents[0].end > pool->def->capacity)
         pool->def->capacity = vol->source.extents[0].end;
 
+    /* Name, key and path were only filled in after the volume was
+     * added to the pool */
+    if (isNewVol && virStoragePoolObjReindexVol(pool, vol) < 0)
+        return -1;
+
     return 0;
 }
 
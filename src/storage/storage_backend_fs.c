@@ -51,6 +51,7 @@
 #include "virfile.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "stat-time.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -59,16 +60,287 @@
 #define VIR_STORAGE_VOL_FS_REFRESH_FLAGS    (VIR_STORAGE_VOL_FS_OPEN_FLAGS  &\
                                              ~VIR_STORAGE_VOL_OPEN_ERROR)
 
+typedef struct _virStorageBackendFSCacheEntry virStorageBackendFSCacheEntry;
+typedef virStorageBackendFSCacheEntry *virStorageBackendFSCacheEntryPtr;
+
+/* Header probing results for one file, valid as long as the file's
+ * identity, size and timestamps are unchanged */
+struct _virStorageBackendFSCacheEntry {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+    unsigned int generation;    /* last refresh which saw the file */
+
+    int format;
+    char *backingStore;
+    int backingStoreFormat;
+    unsigned long long capacity;
+    bool encrypted;
+    virBitmapPtr features;
+    char *compat;
+};
+
+typedef struct _virStorageBackendFSCache virStorageBackendFSCache;
+typedef virStorageBackendFSCache *virStorageBackendFSCachePtr;
+
+/* Per pool metadata cache, stored in the pool object's privateData. It
+ * lets a refresh skip reading and parsing the header of every image
+ * which has not changed since the previous refresh. */
+struct _virStorageBackendFSCache {
+    virMutex lock;
+    virHashTablePtr entries;    /* keyed by path */
+    unsigned int generation;    /* bumped by every refresh */
+
+    unsigned long long hits;
+    unsigned long long misses;
+};
+
+
+static void
+virStorageBackendFSCacheEntryFree(void *payload,
+                                  const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageBackendFSCacheEntryPtr entry = payload;
+
+    if (!entry)
+        return;
+
+    VIR_FREE(entry->backingStore);
+    virBitmapFree(entry->features);
+    VIR_FREE(entry->compat);
+    VIR_FREE(entry);
+}
+
+
+static void
+virStorageBackendFSCacheFree(void *opaque)
+{
+    virStorageBackendFSCachePtr cache = opaque;
+
+    if (!cache)
+        return;
+
+    virHashFree(cache->entries);
+    virMutexDestroy(&cache->lock);
+    VIR_FREE(cache);
+}
+
+
+static virStorageBackendFSCachePtr
+virStorageBackendFSCacheGet(virStoragePoolObjPtr pool)
+{
+    virStorageBackendFSCachePtr cache;
+
+    if (pool->privateData)
+        return pool->privateData;
+
+    if (VIR_ALLOC(cache) < 0)
+        return NULL;
+
+    if (virMutexInit(&cache->lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        VIR_FREE(cache);
+        return NULL;
+    }
+
+    if (!(cache->entries = virHashCreate(64,
+                                         virStorageBackendFSCacheEntryFree))) {
+        virStorageBackendFSCacheFree(cache);
+        return NULL;
+    }
+
+    pool->privateData = cache;
+    pool->privateDataFreeFunc = virStorageBackendFSCacheFree;
+    return cache;
+}
+
+
+static bool
+virStorageBackendFSCacheEntryMatch(virStorageBackendFSCacheEntryPtr entry,
+                                   struct stat *sb)
+{
+    struct timespec mtime = get_stat_mtime(sb);
+    struct timespec ctime = get_stat_ctime(sb);
+
+    return entry->dev == sb->st_dev &&
+        entry->ino == sb->st_ino &&
+        entry->size == sb->st_size &&
+        entry->mtime.tv_sec == mtime.tv_sec &&
+        entry->mtime.tv_nsec == mtime.tv_nsec &&
+        entry->ctime.tv_sec == ctime.tv_sec &&
+        entry->ctime.tv_nsec == ctime.tv_nsec;
+}
+
+
+/*
+ * Look up the cached metadata of the file at @path described by @sb.
+ * On a hit, @format and @meta are filled in as if the header had been
+ * probed, with the backing store format already resolved.
+ *
+ * Returns 1 on a hit, 0 on a miss, -1 on error.
+ */
+static int
+virStorageBackendFSCacheLookup(virStorageBackendFSCachePtr cache,
+                               const char *path,
+                               struct stat *sb,
+                               int *format,
+                               virStorageFileMetadataPtr *meta)
+{
+    virStorageBackendFSCacheEntryPtr entry;
+    virStorageFileMetadataPtr ret = NULL;
+    int rc = -1;
+
+    virMutexLock(&cache->lock);
+
+    if (!(entry = virHashLookup(cache->entries, path)) ||
+        !virStorageBackendFSCacheEntryMatch(entry, sb)) {
+        cache->misses++;
+        rc = 0;
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC(ret) < 0 ||
+        VIR_STRDUP(ret->backingStore, entry->backingStore) < 0 ||
+        VIR_STRDUP(ret->compat, entry->compat) < 0)
+        goto cleanup;
+    if (entry->features &&
+        !(ret->features = virBitmapNewCopy(entry->features)))
+        goto cleanup;
+    ret->backingStoreFormat = entry->backingStoreFormat;
+    ret->capacity = entry->capacity;
+    ret->encrypted = entry->encrypted;
+
+    entry->generation = cache->generation;
+    cache->hits++;
+
+    *format = entry->format;
+    *meta = ret;
+    ret = NULL;
+    rc = 1;
+
+ cleanup:
+    virMutexUnlock(&cache->lock);
+    virStorageFileFreeMetadata(ret);
+    return rc;
+}
+
+
+static int
+virStorageBackendFSCacheStore(virStorageBackendFSCachePtr cache,
+                              virStorageVolTargetPtr target,
+                              struct stat *sb,
+                              const char *backingStore,
+                              int backingStoreFormat,
+                              virStorageFileMetadataPtr meta)
+{
+    virStorageBackendFSCacheEntryPtr entry = NULL;
+    int ret = -1;
+
+    if (VIR_ALLOC(entry) < 0 ||
+        VIR_STRDUP(entry->backingStore, backingStore) < 0 ||
+        VIR_STRDUP(entry->compat, target->compat) < 0)
+        goto cleanup;
+    if (target->features &&
+        !(entry->features = virBitmapNewCopy(target->features)))
+        goto cleanup;
+
+    entry->dev = sb->st_dev;
+    entry->ino = sb->st_ino;
+    entry->size = sb->st_size;
+    entry->mtime = get_stat_mtime(sb);
+    entry->ctime = get_stat_ctime(sb);
+    entry->format = target->format;
+    entry->backingStoreFormat = backingStoreFormat;
+    entry->capacity = meta->capacity;
+    entry->encrypted = meta->encrypted;
+
+    virMutexLock(&cache->lock);
+    entry->generation = cache->generation;
+    ret = virHashUpdateEntry(cache->entries, target->path, entry);
+    virMutexUnlock(&cache->lock);
+    if (ret == 0)
+        entry = NULL;
+
+ cleanup:
+    virStorageBackendFSCacheEntryFree(entry, NULL);
+    return ret;
+}
+
+
+static int
+virStorageBackendFSCacheIsStale(const void *payload,
+                                const void *name ATTRIBUTE_UNUSED,
+                                const void *opaque)
+{
+    const virStorageBackendFSCacheEntry *entry = payload;
+    const unsigned int *generation = opaque;
+
+    return entry->generation != *generation;
+}
+
+
+/* Drop the entries of files which the current refresh did not see */
+static void
+virStorageBackendFSCachePrune(virStorageBackendFSCachePtr cache)
+{
+    virMutexLock(&cache->lock);
+    virHashRemoveSet(cache->entries, virStorageBackendFSCacheIsStale,
+                     &cache->generation);
+    virMutexUnlock(&cache->lock);
+}
+
+
+/**
+ * virStorageBackendFSCacheGetStats:
+ * @pool: file system based pool
+ * @hits: filled with the number of lookups answered from the cache
+ * @misses: filled with the number of lookups which had to probe
+ * @entries: filled with the number of files currently cached
+ *
+ * Report the metadata cache counters of @pool, accumulated over all
+ * of its refreshes since the pool was started.
+ *
+ * Returns 0 on success, -1 if @pool was not refreshed yet.
+ */
+int
+virStorageBackendFSCacheGetStats(virStoragePoolObjPtr pool,
+                                 unsigned long long *hits,
+                                 unsigned long long *misses,
+                                 size_t *entries)
+{
+    virStorageBackendFSCachePtr cache = pool->privateData;
+
+    if (!cache || pool->privateDataFreeFunc != virStorageBackendFSCacheFree) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("storage pool '%s' has no metadata cache"),
+                       pool->def->name);
+        return -1;
+    }
+
+    virMutexLock(&cache->lock);
+    *hits = cache->hits;
+    *misses = cache->misses;
+    *entries = virHashSize(cache->entries);
+    virMutexUnlock(&cache->lock);
+    return 0;
+}
+
+
 static int ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3)
 virStorageBackendProbeTarget(virStorageVolTargetPtr target,
                              char **backingStore,
                              int *backingStoreFormat,
                              unsigned long long *allocation,
                              unsigned long long *capacity,
-                             virStorageEncryptionPtr *encryption)
+                             virStorageEncryptionPtr *encryption,
+                             virStorageBackendFSCachePtr cache)
 {
     int fd = -1;
     int ret = -1;
+    int hit = 0;
     virStorageFileMetadata *meta = NULL;
     struct stat sb;
     char *header = NULL;
@@ -92,6 +364,14 @@ virStorageBackendProbeTarget(virStorageVolTargetPtr target,
 
     if (S_ISDIR(sb.st_mode)) {
         target->format = VIR_STORAGE_FILE_DIR;
+    } else if (cache && S_ISREG(sb.st_mode) &&
+               (hit = virStorageBackendFSCacheLookup(cache, target->path,
+                                                     &sb, &target->format,
+                                                     &meta)) != 0) {
+        if (hit < 0) {
+            ret = -1;
+            goto error;
+        }
     } else {
         if ((len = virFileReadHeaderFD(fd, len, &header)) < 0) {
             virReportSystemError(errno, _("cannot read header '%s'"),
@@ -176,6 +456,11 @@ virStorageBackendProbeTarget(virStorageVolTargetPtr target,
         meta->compat = NULL;
     }
 
+    if (cache && !hit && meta && ret == 0 && S_ISREG(sb.st_mode) &&
+        virStorageBackendFSCacheStore(cache, target, &sb, *backingStore,
+                                      *backingStoreFormat, meta) < 0)
+        ret = -1;
+
     goto cleanup;
 
 error:
@@ -829,6 +1114,18 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
     struct dirent *ent;
     struct statvfs sb;
     virStorageVolDefPtr vol = NULL;
+    virStorageBackendFSCachePtr cache;
+    unsigned long long hits;
+    unsigned long long misses;
+
+    if (!(cache = virStorageBackendFSCacheGet(pool)))
+        return -1;
+
+    virMutexLock(&cache->lock);
+    cache->generation++;
+    hits = cache->hits;
+    misses = cache->misses;
+    virMutexUnlock(&cache->lock);
 
     if (!(dir = opendir(pool->def->target.path))) {
         virReportSystemError(errno,
@@ -863,7 +1160,8 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
                                                 &backingStoreFormat,
                                                 &vol->allocation,
                                                 &vol->capacity,
-                                                &vol->target.encryption)) < 0) {
+                                                &vol->target.encryption,
+                                                cache)) < 0) {
             if (ret == -2) {
                 /* Silently ignore non-regular files,
                  * eg '.' '..', 'lost+found', dangling symbolic link */
@@ -905,14 +1203,20 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
         }
 
 
-        if (VIR_REALLOC_N(pool->volumes.objs,
-                          pool->volumes.count+1) < 0)
+        if (virStoragePoolObjAddVol(pool, vol) < 0)
             goto cleanup;
-        pool->volumes.objs[pool->volumes.count++] = vol;
         vol = NULL;
     }
     closedir(dir);
 
+    virStorageBackendFSCachePrune(cache);
+
+    virMutexLock(&cache->lock);
+    VIR_INFO("Refreshed storage pool '%s': %llu metadata cache hits, "
+             "%llu misses (%llu/%llu in total)",
+             pool->def->name, cache->hits - hits, cache->misses - misses,
+             cache->hits, cache->misses);
+    virMutexUnlock(&cache->lock);
 
     if (statvfs(pool->def->target.path, &sb) < 0) {
         virReportSystemError(errno,
@@ -38,6 +38,11 @@ typedef enum {
 } virStoragePoolProbeResult;
 extern virStorageBackend virStorageBackendDirectory;
 
+int virStorageBackendFSCacheGetStats(virStoragePoolObjPtr pool,
+                                     unsigned long long *hits,
+                                     unsigned long long *misses,
+                                     size_t *entries);
+
 extern virStorageFileBackend virStorageFileBackendFile;
 extern virStorageFileBackend virStorageFileBackendBlock;
 #endif /* __VIR_STORAGE_BACKEND_FS_H__ */
@@ -31,6 +31,7 @@
 #include "virstoragefile.h"
 #include "virstring.h"
 #include "viruri.h"
+#include "stat-time.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -328,6 +329,37 @@ cleanup:
     return ret;
 }
 
+/* Whether @vol was looked up from the file @st still describes */
+static bool
+virStorageBackendGlusterVolUnchanged(virStorageVolDefPtr vol,
+                                     struct stat *st)
+{
+    virStorageTimestampsPtr ts = vol->target.timestamps;
+    struct timespec mtime = get_stat_mtime(st);
+    struct timespec ctime = get_stat_ctime(st);
+
+    return ts &&
+           ts->mtime.tv_sec == mtime.tv_sec &&
+           ts->mtime.tv_nsec == mtime.tv_nsec &&
+           ts->ctime.tv_sec == ctime.tv_sec &&
+           ts->ctime.tv_nsec == ctime.tv_nsec;
+}
+
+/* Replace @oldvol in @pool by @newvol, or drop it if @newvol is NULL */
+static int
+virStorageBackendGlusterReplaceVol(virStoragePoolObjPtr pool,
+                                   virStorageVolDefPtr oldvol,
+                                   virStorageVolDefPtr newvol)
+{
+    virStoragePoolObjDropVol(pool, oldvol);
+
+    if (newvol && virStoragePoolObjAddVol(pool, newvol) < 0) {
+        virStorageVolDefFree(newvol);
+        return -1;
+    }
+    return 0;
+}
+
 static int
 virStorageBackendGlusterRefreshPool(virConnectPtr conn ATTRIBUTE_UNUSED,
                                     virStoragePoolObjPtr pool)
@@ -344,6 +376,12 @@ virStorageBackendGlusterRefreshPool(virConnectPtr conn ATTRIBUTE_UNUSED,
     glfs_fd_t *dir = NULL;
     struct stat st;
     struct statvfs sb;
+    char **names = NULL;
+    struct stat *stats = NULL;
+    virStorageVolDefPtr *known = NULL;
+    size_t nnames = 0;
+    size_t nstats = 0;
+    size_t i;
 
     if (!(state = virStorageBackendGlusterOpen(pool)))
         goto cleanup;
@@ -369,15 +407,15 @@ virStorageBackendGlusterRefreshPool(virConnectPtr conn ATTRIBUTE_UNUSED,
         goto cleanup;
     }
     while (!(errno = glfs_readdirplus_r(dir, &st, &de.ent, &ent)) && ent) {
-        virStorageVolDefPtr vol;
-        int okay = virStorageBackendGlusterRefreshVol(state,
-                                                      ent->d_name, &st,
-                                                      &vol);
+        char *name;
 
-        if (okay < 0)
+        if (VIR_STRDUP(name, ent->d_name) < 0)
             goto cleanup;
-        if (vol && VIR_APPEND_ELEMENT(pool->volumes.objs, pool->volumes.count,
-                                      vol) < 0)
+        if (VIR_APPEND_ELEMENT(names, nnames, name) < 0) {
+            VIR_FREE(name);
+            goto cleanup;
+        }
+        if (VIR_APPEND_ELEMENT(stats, nstats, st) < 0)
             goto cleanup;
     }
     if (errno) {
@@ -386,6 +424,36 @@ virStorageBackendGlusterRefreshPool(virConnectPtr conn ATTRIBUTE_UNUSED,
         goto cleanup;
     }
 
+    if (VIR_ALLOC_N(known, nnames) < 0)
+        goto cleanup;
+
+    if (pool->def->refreshMode == VIR_STORAGE_POOL_REFRESH_INCREMENTAL &&
+        virStoragePoolObjSyncVols(pool, names, nnames, known) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nnames; i++) {
+        virStorageVolDefPtr vol;
+
+        /* Skip files whose header cannot have changed since the last
+         * refresh, and never replace a volume that is being built */
+        if (known[i] &&
+            (known[i]->building ||
+             virStorageBackendGlusterVolUnchanged(known[i], &stats[i])))
+            continue;
+
+        if (virStorageBackendGlusterRefreshVol(state, names[i], &stats[i],
+                                               &vol) < 0)
+            goto cleanup;
+
+        if (known[i]) {
+            if (virStorageBackendGlusterReplaceVol(pool, known[i], vol) < 0)
+                goto cleanup;
+        } else if (vol && virStoragePoolObjAddVol(pool, vol) < 0) {
+            virStorageVolDefFree(vol);
+            goto cleanup;
+        }
+    }
+
     if (glfs_statvfs(state->vol, state->dir, &sb) < 0) {
         virReportSystemError(errno, _("cannot statvfs path '%s' in '%s'"),
                              state->dir, state->volname);
@@ -403,6 +471,11 @@ cleanup:
     if (dir)
         glfs_closedir(dir);
     virStorageBackendGlusterClose(state);
+    for (i = 0; i < nnames; i++)
+        VIR_FREE(names[i]);
+    VIR_FREE(names);
+    VIR_FREE(stats);
+    VIR_FREE(known);
     if (ret < 0)
         virStoragePoolObjClearVols(pool);
     return ret;
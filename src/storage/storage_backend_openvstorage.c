@@ -30,64 +30,88 @@
 #include "base64.h"
 #include "viruuid.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "virfile.h"
+#include "fdstream.h"
 
 #include <sys/types.h>
 #include <fcntl.h>
-#include <assert.h>
 #include <openvstorage/volumedriver.h>
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 #define OPENVSTORAGE_DFL_PORT   21321
 
-static int
-virStorageBackendOpenvStorageCreateVol(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                       virStoragePoolObjPtr pool ATTRIBUTE_UNUSED,
-                                       virStorageVolDefPtr vol)
-{
-    if (vol->target.encryption != NULL)
-    {
-        virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
-                       _("OpenvStorage does not support encrypted volumes"));
-        return -1;
-    }
+/* Upper bound of idle connected contexts kept around per pool */
+#define OPENVSTORAGE_CTX_POOL_MAX       16
+/* Idle contexts older than this (in seconds) are disconnected */
+#define OPENVSTORAGE_CTX_IDLE_TIMEOUT   60
+/* Default number of volumes stat'ed concurrently on pool refresh */
+#define OPENVSTORAGE_REFRESH_WORKERS    8
+/* Requests in flight, and their size, on volume upload/download */
+#define OPENVSTORAGE_STREAM_DEPTH       8
+#define OPENVSTORAGE_STREAM_BUFSIZE     (1024 * 1024)
+/* Seconds to wait for a snapshot to be synced to the backend */
+#define OPENVSTORAGE_SNAPSHOT_TIMEOUT   120
 
-    vol->type = VIR_STORAGE_VOL_NETWORK;
-    vol->target.format = VIR_STORAGE_FILE_RAW;
+typedef struct _virStorageBackendOpenvStorageState virStorageBackendOpenvStorageState;
+typedef virStorageBackendOpenvStorageState *virStorageBackendOpenvStorageStatePtr;
 
-    VIR_FREE(vol->key);
-    if (virAsprintf(&vol->key, "/%s",
-                    vol->name) == -1)
-    {
-        return -1;
-    }
+/* Per pool state, stored in the pool object's privateData while the
+ * pool is active */
+struct _virStorageBackendOpenvStorageState {
+    virMutex lock;
+    ovs_ctx_attr_t *attr;
 
-    VIR_FREE(vol->target.path);
-    if (VIR_STRDUP(vol->target.path, vol->name) < 0)
-    {
-        return -1;
+    /* Idle contexts, least recently used first, along with the volume
+     * each of them was last opened on, if any */
+    size_t nctxs;
+    ovs_ctx_t *ctxs[OPENVSTORAGE_CTX_POOL_MAX];
+    char *volnames[OPENVSTORAGE_CTX_POOL_MAX];
+    time_t lastUsed[OPENVSTORAGE_CTX_POOL_MAX];
+};
+
+typedef int (*virStorageBackendOpenvStorageCtxFunc)(ovs_ctx_t *ctx,
+                                                    void *opaque);
+
+static void
+virStorageBackendOpenvStorageStateFree(void *opaque)
+{
+    virStorageBackendOpenvStorageStatePtr state = opaque;
+    size_t i;
+
+    if (!state)
+        return;
+
+    for (i = 0; i < state->nctxs; i++) {
+        ignore_value(ovs_ctx_destroy(state->ctxs[i]));
+        VIR_FREE(state->volnames[i]);
     }
-    return 0;
+    if (state->attr)
+        ovs_ctx_attr_destroy(state->attr);
+    virMutexDestroy(&state->lock);
+    VIR_FREE(state);
 }
 
-static int
-virStorageBackendOpenvStorageBuildVolHelper(virStoragePoolObjPtr pool,
-                                            virStorageVolDefPtr vol,
-                                            unsigned int flags,
-                                            const char *transport,
-                                            bool is_network)
+static ovs_ctx_attr_t *
+virStorageBackendOpenvStorageAttrNew(virStoragePoolObjPtr pool,
+                                     const char *transport,
+                                     bool is_network)
 {
-    int ret;
+    ovs_ctx_attr_t *ctx_attr;
     int port = OPENVSTORAGE_DFL_PORT;
-    virCheckFlags(0, -1);
+    int ret;
 
-    if (is_network) {
-        if (pool->def->source.nhost > 0 && pool->def->source.nhost != 1) {
-            return -1;
-        }
+    if (is_network && pool->def->source.nhost != 1) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
+                       _("OpenvStorage network pools require exactly "
+                         "one source host"));
+        return NULL;
     }
 
-    ovs_ctx_attr_t *ctx_attr = ovs_ctx_attr_new();
-    assert(ctx_attr != NULL);
+    if (!(ctx_attr = ovs_ctx_attr_new())) {
+        virReportOOMError();
+        return NULL;
+    }
 
     if (is_network) {
         const char *hostname = pool->def->source.hosts[0].name;
@@ -108,435 +132,1385 @@ virStorageBackendOpenvStorageBuildVolHelper(virStoragePoolObjPtr pool,
         virReportSystemError(errno, "%s",
                              _("failed to set transport type"));
         ovs_ctx_attr_destroy(ctx_attr);
-        return ret;
-    }
-    ovs_ctx_t *ctx = ovs_ctx_new(ctx_attr);
-    if (ctx == NULL) {
-        virReportSystemError(errno, "%s",
-                             _("cannot create context"));
-        ovs_ctx_attr_destroy(ctx_attr);
-        return -1;
+        return NULL;
     }
-    ret = ovs_create_volume(ctx, vol->name, vol->capacity);
-    ovs_ctx_destroy(ctx);
-    ovs_ctx_attr_destroy(ctx_attr);
-    return ret;
+    return ctx_attr;
 }
 
-static int
-virStorageBackendOpenvStorageBuildVolTCP(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                         virStoragePoolObjPtr pool,
-                                         virStorageVolDefPtr vol,
-                                         unsigned int flags)
+static virStorageBackendOpenvStorageStatePtr
+virStorageBackendOpenvStorageGetState(virStoragePoolObjPtr pool)
 {
-    return virStorageBackendOpenvStorageBuildVolHelper(pool,
-                                                       vol,
-                                                       flags,
-                                                       "tcp",
-                                                       true);
+    if (!pool->privateData) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("storage pool '%s' is not connected"),
+                       pool->def->name);
+        return NULL;
+    }
+    return pool->privateData;
 }
 
-static int
-virStorageBackendOpenvStorageBuildVolRDMA(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                         virStoragePoolObjPtr pool,
-                                         virStorageVolDefPtr vol,
-                                         unsigned int flags)
+/* Errors after which a context must not be handed out again */
+static bool
+virStorageBackendOpenvStorageIsConnError(int err)
 {
-    return virStorageBackendOpenvStorageBuildVolHelper(pool,
-                                                       vol,
-                                                       flags,
-                                                       "rdma",
-                                                       true);
+    return err == ECONNRESET || err == ECONNREFUSED ||
+           err == ECONNABORTED || err == ENOTCONN ||
+           err == EPIPE || err == ETIMEDOUT;
 }
 
-static int
-virStorageBackendOpenvStorageBuildVol(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                      virStoragePoolObjPtr pool,
-                                      virStorageVolDefPtr vol,
-                                      unsigned int flags)
+/* Take the idle context at @idx out of the pool, handing back the name
+ * of the volume it is opened on. Must be called with the lock held. */
+static ovs_ctx_t *
+virStorageBackendOpenvStorageCtxTake(virStorageBackendOpenvStorageStatePtr state,
+                                     size_t idx,
+                                     char **volname)
 {
-    return virStorageBackendOpenvStorageBuildVolHelper(pool,
-                                                       vol,
-                                                       flags,
-                                                       "shm",
-                                                       false);
+    ovs_ctx_t *ctx = state->ctxs[idx];
+    size_t n = state->nctxs - idx - 1;
+
+    *volname = state->volnames[idx];
+    memmove(state->ctxs + idx, state->ctxs + idx + 1,
+            sizeof(*state->ctxs) * n);
+    memmove(state->volnames + idx, state->volnames + idx + 1,
+            sizeof(*state->volnames) * n);
+    memmove(state->lastUsed + idx, state->lastUsed + idx + 1,
+            sizeof(*state->lastUsed) * n);
+    state->nctxs--;
+    return ctx;
 }
 
-static int
-virStorageBackendOpenvStorageDeleteVolHelper(virStoragePoolObjPtr pool,
-                                             virStorageVolDefPtr vol,
-                                             int flags,
-                                             const char* transport,
-                                             bool is_network)
+/*
+ * Get a connected context of the pool, opened on @volname unless that
+ * is NULL. An idle context already opened on @volname is preferred,
+ * otherwise the most recently used one is opened on the volume. Should
+ * the library refuse to move a context over to another volume, a new
+ * one is connected instead.
+ */
+static ovs_ctx_t *
+virStorageBackendOpenvStorageCtxAcquire(virStorageBackendOpenvStorageStatePtr state,
+                                        const char *volname)
 {
-    int ret;
-    int port = OPENVSTORAGE_DFL_PORT;
-    virCheckFlags(0, -1);
+    ovs_ctx_t *expired[OPENVSTORAGE_CTX_POOL_MAX];
+    char *name = NULL;
+    size_t nexpired = 0;
+    ovs_ctx_t *ctx = NULL;
+    time_t now = time(NULL);
+    size_t i;
 
-    if (is_network) {
-        if (pool->def->source.nhost > 0 && pool->def->source.nhost != 1) {
-            return -1;
+    virMutexLock(&state->lock);
+    while (state->nctxs &&
+           now - state->lastUsed[0] > OPENVSTORAGE_CTX_IDLE_TIMEOUT) {
+        expired[nexpired++] = virStorageBackendOpenvStorageCtxTake(state, 0,
+                                                                   &name);
+        VIR_FREE(name);
+    }
+    for (i = state->nctxs; volname && i > 0; i--) {
+        if (STREQ_NULLABLE(state->volnames[i - 1], volname)) {
+            ctx = virStorageBackendOpenvStorageCtxTake(state, i - 1, &name);
+            break;
         }
     }
+    if (!ctx && state->nctxs > 0)
+        ctx = virStorageBackendOpenvStorageCtxTake(state, state->nctxs - 1,
+                                                   &name);
+    virMutexUnlock(&state->lock);
 
-    ovs_ctx_attr_t *ctx_attr = ovs_ctx_attr_new();
-    assert(ctx_attr != NULL);
+    if (nexpired)
+        VIR_DEBUG("Disconnecting %zu idle contexts", nexpired);
+    for (i = 0; i < nexpired; i++)
+        ignore_value(ovs_ctx_destroy(expired[i]));
 
-    if (is_network) {
-        const char *hostname = pool->def->source.hosts[0].name;
-        if (pool->def->source.hosts[0].port) {
-            port = pool->def->source.hosts[0].port;
-        }
-        ret = ovs_ctx_attr_set_transport(ctx_attr,
-                                         transport,
-                                         hostname,
-                                         port);
-    } else {
-        ret = ovs_ctx_attr_set_transport(ctx_attr,
-                                         transport,
-                                         NULL,
-                                         0);
-    }
-    if (ret < 0) {
-        virReportSystemError(errno, "%s",
-                             _("cannot set transport type"));
-        ovs_ctx_attr_destroy(ctx_attr);
-        return ret;
+    if (ctx && volname && STRNEQ_NULLABLE(name, volname) &&
+        ovs_ctx_init(ctx, volname, O_RDWR) < 0) {
+        VIR_DEBUG("Cannot reopen context on volume '%s': %d",
+                  volname, errno);
+        ignore_value(ovs_ctx_destroy(ctx));
+        ctx = NULL;
     }
-    ovs_ctx_t *ctx = ovs_ctx_new(ctx_attr);
-    if (ctx == NULL) {
+    VIR_FREE(name);
+    if (ctx)
+        return ctx;
+
+    if (!(ctx = ovs_ctx_new(state->attr))) {
         virReportSystemError(errno, "%s",
                              _("failed to create context"));
-        ovs_ctx_attr_destroy(ctx_attr);
-        return -1;
+        return NULL;
     }
-    ret = ovs_remove_volume(ctx, vol->name);
-    ovs_ctx_destroy(ctx);
-    ovs_ctx_attr_destroy(ctx_attr);
-    return ret;
+    if (volname && ovs_ctx_init(ctx, volname, O_RDWR) < 0) {
+        virReportSystemError(errno,
+                             _("failed to create context for volume '%s'"),
+                             volname);
+        ignore_value(ovs_ctx_destroy(ctx));
+        return NULL;
+    }
+    return ctx;
 }
 
-static int
-virStorageBackendOpenvStorageDeleteVolTCP(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                          virStoragePoolObjPtr pool,
-                                          virStorageVolDefPtr vol,
-                                          unsigned int flags)
+/* Hand a context acquired for @volname back to the pool */
+static void
+virStorageBackendOpenvStorageCtxRelease(virStorageBackendOpenvStorageStatePtr state,
+                                        ovs_ctx_t *ctx,
+                                        const char *volname,
+                                        bool broken)
 {
-    return virStorageBackendOpenvStorageDeleteVolHelper(pool,
-                                                        vol,
-                                                        flags,
-                                                        "tcp",
-                                                        true);
-}
+    ovs_ctx_t *stale[OPENVSTORAGE_CTX_POOL_MAX];
+    char *name = NULL;
+    size_t nstale = 0;
+    size_t i;
 
-static int
-virStorageBackendOpenvStorageDeleteVolRDMA(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                          virStoragePoolObjPtr pool,
-                                          virStorageVolDefPtr vol,
-                                          unsigned int flags)
-{
-    return virStorageBackendOpenvStorageDeleteVolHelper(pool,
-                                                        vol,
-                                                        flags,
-                                                        "rdma",
-                                                        true);
+    if (!broken && volname && VIR_STRDUP_QUIET(name, volname) < 0)
+        broken = true;
+
+    virMutexLock(&state->lock);
+    if (broken) {
+        /* Idle contexts talk to the same endpoint, drop them as well
+         * so that the retry reconnects */
+        nstale = state->nctxs;
+        memcpy(stale, state->ctxs, sizeof(*stale) * nstale);
+        for (i = 0; i < nstale; i++)
+            VIR_FREE(state->volnames[i]);
+        state->nctxs = 0;
+    } else if (state->nctxs < OPENVSTORAGE_CTX_POOL_MAX) {
+        state->ctxs[state->nctxs] = ctx;
+        state->volnames[state->nctxs] = name;
+        state->lastUsed[state->nctxs] = time(NULL);
+        state->nctxs++;
+        ctx = NULL;
+        name = NULL;
+    }
+    virMutexUnlock(&state->lock);
+
+    VIR_FREE(name);
+    if (ctx)
+        ignore_value(ovs_ctx_destroy(ctx));
+    for (i = 0; i < nstale; i++)
+        ignore_value(ovs_ctx_destroy(stale[i]));
 }
 
-static int
-virStorageBackendOpenvStorageDeleteVol(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                       virStoragePoolObjPtr pool,
-                                       virStorageVolDefPtr vol,
-                                       unsigned int flags)
+/* Disconnect the idle contexts opened on @volname, which would
+ * otherwise keep it open once it is removed */
+static void
+virStorageBackendOpenvStorageCtxForget(virStorageBackendOpenvStorageStatePtr state,
+                                       const char *volname)
 {
-    return virStorageBackendOpenvStorageDeleteVolHelper(pool,
-                                                        vol,
-                                                        flags,
-                                                        "shm",
-                                                        false);
+    ovs_ctx_t *stale[OPENVSTORAGE_CTX_POOL_MAX];
+    char *name;
+    size_t nstale = 0;
+    size_t i;
+
+    virMutexLock(&state->lock);
+    for (i = state->nctxs; i > 0; i--) {
+        if (STREQ_NULLABLE(state->volnames[i - 1], volname)) {
+            stale[nstale++] = virStorageBackendOpenvStorageCtxTake(state, i - 1,
+                                                                   &name);
+            VIR_FREE(name);
+        }
+    }
+    virMutexUnlock(&state->lock);
+
+    for (i = 0; i < nstale; i++)
+        ignore_value(ovs_ctx_destroy(stale[i]));
 }
 
+/*
+ * Run @func on a pooled context of @pool, opened on @volname unless
+ * that is NULL. If the context turns out to be disconnected the call
+ * is retried once on a fresh connection. The return value and errno
+ * of @func are passed on to the caller.
+ */
 static int
-virStorageBackendOpenvStorageRefreshVolHelper(virStoragePoolObjPtr pool,
-                                              virStorageVolDefPtr vol,
-                                              const char *transport,
-                                              bool is_network)
+virStorageBackendOpenvStorageCtxRunVol(virStoragePoolObjPtr pool,
+                                       const char *volname,
+                                       virStorageBackendOpenvStorageCtxFunc func,
+                                       void *opaque)
 {
-    int r;
-    int port = OPENVSTORAGE_DFL_PORT;
-    struct stat st;
+    virStorageBackendOpenvStorageStatePtr state;
+    ovs_ctx_t *ctx;
+    bool broken;
+    size_t attempt;
+    int ret = -1;
+    int err = 0;
 
-    if (is_network) {
-        if (pool->def->source.nhost > 0 && pool->def->source.nhost != 1) {
+    if (!(state = virStorageBackendOpenvStorageGetState(pool)))
+        return -1;
+
+    for (attempt = 0; attempt < 2; attempt++) {
+        if (!(ctx = virStorageBackendOpenvStorageCtxAcquire(state, volname)))
             return -1;
-        }
-    }
 
-    ovs_ctx_attr_t *ctx_attr = ovs_ctx_attr_new();
-    assert(ctx_attr != NULL);
+        ret = func(ctx, opaque);
+        err = errno;
+        broken = ret < 0 && virStorageBackendOpenvStorageIsConnError(err);
 
-    if (is_network) {
-        const char *hostname = pool->def->source.hosts[0].name;
-        if (pool->def->source.hosts[0].port) {
-            port = pool->def->source.hosts[0].port;
-        }
-        r = ovs_ctx_attr_set_transport(ctx_attr,
-                                       transport,
-                                       hostname,
-                                       port);
-    } else {
-        r = ovs_ctx_attr_set_transport(ctx_attr,
-                                       transport,
-                                       NULL,
-                                       0);
+        virStorageBackendOpenvStorageCtxRelease(state, ctx, volname, broken);
+        if (!broken)
+            break;
+        VIR_DEBUG("Context of pool '%s' disconnected, retrying",
+                  pool->def->name);
     }
 
-    if (r < 0) {
-        virReportSystemError(errno, "%s",
-                             _("failed to set transport type"));
-        ovs_ctx_attr_destroy(ctx_attr);
-        return r;
-    }
+    errno = err;
+    return ret;
+}
 
-    ovs_ctx_t *ctx = ovs_ctx_new(ctx_attr);
-    if (ctx == NULL) {
-        ovs_ctx_attr_destroy(ctx_attr);
+static int
+virStorageBackendOpenvStorageCtxRun(virStoragePoolObjPtr pool,
+                                    virStorageBackendOpenvStorageCtxFunc func,
+                                    void *opaque)
+{
+    return virStorageBackendOpenvStorageCtxRunVol(pool, NULL, func, opaque);
+}
+
+static int
+virStorageBackendOpenvStorageStartPoolHelper(virStoragePoolObjPtr pool,
+                                             const char *transport,
+                                             bool is_network)
+{
+    virStorageBackendOpenvStorageStatePtr state;
+
+    if (VIR_ALLOC(state) < 0)
         return -1;
-    }
-    ovs_ctx_attr_destroy(ctx_attr);
-    r = ovs_ctx_init(ctx, vol->name, O_RDWR);
 
-    if (r < 0)
-    {
-        virReportSystemError(errno,
-                             _("failed to create context for volume '%s'"),
-                             vol->name);
-        ovs_ctx_destroy(ctx);
-        return r;
-    }
-    r = ovs_stat(ctx, &st);
-    if (r < 0)
-    {
-        virReportSystemError(errno, _("failed to stat volume '%s'"),
-                             vol->name);
-        ovs_ctx_destroy(ctx);
+    if (virMutexInit(&state->lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        VIR_FREE(state);
         return -1;
     }
-    ignore_value(ovs_ctx_destroy(ctx));
-    vol->capacity = st.st_size;
-    vol->allocation = st.st_blksize * st.st_blocks;
-    vol->type = VIR_STORAGE_VOL_NETWORK;
 
-    VIR_FREE(vol->key);
-    if (virAsprintf(&vol->key, "%s",
-                    vol->name) == -1)
-    {
-        virReportSystemError(0, _("cannot copy key for volume '%s'"),
-                             vol->name);
+    if (!(state->attr = virStorageBackendOpenvStorageAttrNew(pool,
+                                                              transport,
+                                                              is_network))) {
+        virStorageBackendOpenvStorageStateFree(state);
         return -1;
     }
 
-    VIR_FREE(vol->target.path);
-    ignore_value(VIR_STRDUP(vol->target.path, vol->name));
+    if (pool->privateDataFreeFunc)
+        (pool->privateDataFreeFunc)(pool->privateData);
+    pool->privateData = state;
+    pool->privateDataFreeFunc = virStorageBackendOpenvStorageStateFree;
     return 0;
 }
 
 static int
-virStorageBackendOpenvStorageRefreshVolTCP(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                           virStoragePoolObjPtr pool,
-                                           virStorageVolDefPtr vol)
+virStorageBackendOpenvStorageStartPoolTCP(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                          virStoragePoolObjPtr pool)
 {
-    return virStorageBackendOpenvStorageRefreshVolHelper(pool,
-                                                         vol,
-                                                         "tcp",
-                                                         true);
+    return virStorageBackendOpenvStorageStartPoolHelper(pool, "tcp", true);
 }
 
 static int
-virStorageBackendOpenvStorageRefreshVolRDMA(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                            virStoragePoolObjPtr pool,
-                                            virStorageVolDefPtr vol)
+virStorageBackendOpenvStorageStartPoolRDMA(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                           virStoragePoolObjPtr pool)
 {
-    return virStorageBackendOpenvStorageRefreshVolHelper(pool,
-                                                         vol,
-                                                         "rdma",
-                                                         true);
+    return virStorageBackendOpenvStorageStartPoolHelper(pool, "rdma", true);
 }
 
 static int
-virStorageBackendOpenvStorageRefreshVol(virConnectPtr conn ATTRIBUTE_UNUSED,
-                                        virStoragePoolObjPtr pool,
-                                        virStorageVolDefPtr vol)
+virStorageBackendOpenvStorageStartPool(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                       virStoragePoolObjPtr pool)
 {
-    return virStorageBackendOpenvStorageRefreshVolHelper(pool,
-                                                         vol,
-                                                         "shm",
-                                                         false);
+    return virStorageBackendOpenvStorageStartPoolHelper(pool, "shm", false);
 }
 
 static int
-virStorageBackendOpenvStorageRefreshPoolHelper(virConnectPtr conn,
-                                               virStoragePoolObjPtr pool,
-                                               const char *transport,
-                                               bool is_network)
+virStorageBackendOpenvStorageStopPool(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                      virStoragePoolObjPtr pool)
 {
-    const uint64_t fs_size = 64ULL << 40;
-    size_t max_size = 1024;
-    char *name, *names = NULL;
-    int len = -1;
-    int r = -1;
-    int port = OPENVSTORAGE_DFL_PORT;
-    pool->def->capacity = fs_size;
-    pool->def->available = fs_size;
-    pool->def->capacity = fs_size;
+    if (pool->privateDataFreeFunc)
+        (pool->privateDataFreeFunc)(pool->privateData);
+    pool->privateData = NULL;
+    pool->privateDataFreeFunc = NULL;
+    return 0;
+}
 
-    if (is_network) {
-        if (pool->def->source.nhost > 0 && pool->def->source.nhost != 1) {
-            return -1;
-        }
+static int
+virStorageBackendOpenvStorageCreateVol(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                       virStoragePoolObjPtr pool ATTRIBUTE_UNUSED,
+                                       virStorageVolDefPtr vol)
+{
+    if (vol->target.encryption != NULL)
+    {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
+                       _("OpenvStorage does not support encrypted volumes"));
+        return -1;
     }
 
-    ovs_ctx_attr_t *ctx_attr = ovs_ctx_attr_new();
-    assert(ctx_attr != NULL);
-    if (is_network) {
-        const char *hostname = pool->def->source.hosts[0].name;
-        if (pool->def->source.hosts[0].port) {
-            port = pool->def->source.hosts[0].port;
-        }
-        r = ovs_ctx_attr_set_transport(ctx_attr,
-                                       transport,
-                                       hostname,
-                                       port);
-    } else {
-        r = ovs_ctx_attr_set_transport(ctx_attr,
-                                       transport,
-                                       NULL,
-                                       0);
-    }
-    if (r < 0) {
-        virReportSystemError(errno, "%s",
-                             _("failed to set transport type"));
-        ovs_ctx_attr_destroy(ctx_attr);
-        return r;
-    }
+    vol->type = VIR_STORAGE_VOL_NETWORK;
+    vol->target.format = VIR_STORAGE_FILE_RAW;
 
-    ovs_ctx_t *ctx = ovs_ctx_new(ctx_attr);
-    if (ctx == NULL) {
-        virReportSystemError(errno, "%s",
-                             _("failed to create context"));
-        ovs_ctx_attr_destroy(ctx_attr);
+    VIR_FREE(vol->key);
+    if (virAsprintf(&vol->key, "/%s",
+                    vol->name) == -1)
+    {
         return -1;
     }
-    ovs_ctx_attr_destroy(ctx_attr);
 
-    while (true)
+    VIR_FREE(vol->target.path);
+    if (VIR_STRDUP(vol->target.path, vol->name) < 0)
     {
-        if (VIR_ALLOC_N(names, max_size) < 0)
-            goto cleanup;
-        len = ovs_list_volumes(ctx, names, &max_size);
-        if (len >= 0)
-            break;
-        if (len == -1 && errno != ERANGE)
-        {
-            virReportSystemError(errno, "%s",
-                                 _("A problem occured while listing images"));
-            goto cleanup;
-        }
-        VIR_FREE(names);
-    }
-
-    ignore_value(ovs_ctx_destroy(ctx));
-    for (name = names; name < names + max_size;) {
-        virStorageVolDefPtr vol;
-
-        if (VIR_REALLOC_N(pool->volumes.objs, pool->volumes.count + 1) < 0) {
-            VIR_WARN("%s", _("cannot allocate volume objs"));
-            virStoragePoolObjClearVols(pool);
-            goto cleanup;
-        }
-
-        if (STREQ(name, ""))
-            break;
-
-        if (VIR_ALLOC(vol) < 0)
-            goto cleanup;
-
-        if (VIR_STRDUP(vol->name, name) < 0) {
-            VIR_FREE(vol);
-            goto cleanup;
-        }
-
-        name += strlen(name) + 1;
-
-        if (virStorageBackendOpenvStorageRefreshVol(conn, pool, vol) < 0) {
-            VIR_WARN("%s", _("cannot refresh volume info"));
-            virStorageVolDefFree(vol);
-            goto cleanup;
-        }
-        pool->volumes.objs[pool->volumes.count++] = vol;
+        return -1;
     }
-    r = 0;
-
-cleanup:
-    VIR_FREE(names);
-    return r;
+    return 0;
 }
 
 static int
-virStorageBackendOpenvStorageRefreshPoolTCP(virConnectPtr conn,
-                                            virStoragePoolObjPtr pool)
+virStorageBackendOpenvStorageCreateVolumeCb(ovs_ctx_t *ctx,
+                                            void *opaque)
 {
-    return virStorageBackendOpenvStorageRefreshPoolHelper(conn,
-                                                          pool,
-                                                          "tcp",
-                                                          true);
-}
+    virStorageVolDefPtr vol = opaque;
 
-static int
-virStorageBackendOpenvStorageRefreshPoolRDMA(virConnectPtr conn,
-                                             virStoragePoolObjPtr pool)
-{
-    return virStorageBackendOpenvStorageRefreshPoolHelper(conn,
-                                                          pool,
-                                                          "rdma",
-                                                          true);
+    return ovs_create_volume(ctx, vol->name, vol->capacity);
 }
 
 static int
-virStorageBackendOpenvStorageRefreshPool(virConnectPtr conn,
-                                         virStoragePoolObjPtr pool)
+virStorageBackendOpenvStorageBuildVol(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                      virStoragePoolObjPtr pool,
+                                      virStorageVolDefPtr vol,
+                                      unsigned int flags)
 {
-    return virStorageBackendOpenvStorageRefreshPoolHelper(conn,
-                                                          pool,
-                                                          "shm",
-                                                          false);
+    virCheckFlags(0, -1);
+
+    if (virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageCreateVolumeCb,
+                                            vol) < 0) {
+        virReportSystemError(errno, _("failed to create volume '%s'"),
+                             vol->name);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+virStorageBackendOpenvStorageRemoveVolumeCb(ovs_ctx_t *ctx,
+                                            void *opaque)
+{
+    virStorageVolDefPtr vol = opaque;
+
+    return ovs_remove_volume(ctx, vol->name);
+}
+
+struct virStorageBackendOpenvStorageCloneData {
+    const char *volname;
+    const char *parent;
+    const char *snapshot;
+    unsigned long long capacity;
+};
+
+static int
+virStorageBackendOpenvStorageSnapshotRemoveCb(ovs_ctx_t *ctx,
+                                              void *opaque)
+{
+    struct virStorageBackendOpenvStorageCloneData *data = opaque;
+
+    return ovs_snapshot_remove(ctx, data->parent, data->snapshot);
+}
+
+static char *
+virStorageBackendOpenvStorageCloneSnapshotName(const char *volname)
+{
+    char *snapshot;
+
+    ignore_value(virAsprintf(&snapshot, "libvirt-clone-%s", volname));
+    return snapshot;
+}
+
+static int
+virStorageBackendOpenvStorageDeleteVol(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                       virStoragePoolObjPtr pool,
+                                       virStorageVolDefPtr vol,
+                                       unsigned int flags)
+{
+    virStorageBackendOpenvStorageStatePtr state;
+    struct virStorageBackendOpenvStorageCloneData data;
+    char *snapshot;
+    size_t i;
+
+    virCheckFlags(0, -1);
+
+    if (!(state = virStorageBackendOpenvStorageGetState(pool)))
+        return -1;
+    virStorageBackendOpenvStorageCtxForget(state, vol->name);
+
+    if (virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageRemoveVolumeCb,
+                                            vol) < 0) {
+        virReportSystemError(errno, _("failed to remove volume '%s'"),
+                             vol->name);
+        return -1;
+    }
+
+    /* A clone pins the snapshot of its parent it was created from,
+     * which is no longer needed now */
+    if (!(snapshot = virStorageBackendOpenvStorageCloneSnapshotName(vol->name)))
+        return 0;
+
+    memset(&data, 0, sizeof(data));
+    data.snapshot = snapshot;
+
+    if (vol->backingStore.path) {
+        data.parent = vol->backingStore.path;
+        if (virStorageBackendOpenvStorageCtxRun(pool,
+                                                virStorageBackendOpenvStorageSnapshotRemoveCb,
+                                                &data) < 0 &&
+            errno != ENOENT)
+            VIR_WARN("failed to remove snapshot '%s' of volume '%s'",
+                     snapshot, data.parent);
+        VIR_FREE(snapshot);
+        return 0;
+    }
+
+    /* The parent is not recorded for volumes found by a refresh, but
+     * the snapshot is named after the clone, so look for it on the
+     * other volumes of the pool */
+    for (i = 0; i < pool->volumes.count; i++) {
+        virStorageVolDefPtr parent = pool->volumes.objs[i];
+
+        if (parent == vol || parent->building)
+            continue;
+
+        data.parent = parent->name;
+        if (virStorageBackendOpenvStorageCtxRun(pool,
+                                                virStorageBackendOpenvStorageSnapshotRemoveCb,
+                                                &data) == 0) {
+            VIR_DEBUG("Removed snapshot '%s' of volume '%s'",
+                      snapshot, data.parent);
+            break;
+        }
+        if (errno != ENOENT) {
+            VIR_WARN("failed to remove snapshot '%s' of volume '%s'",
+                     snapshot, data.parent);
+            break;
+        }
+    }
+    VIR_FREE(snapshot);
+    return 0;
+}
+
+static int
+virStorageBackendOpenvStorageSnapshotCreateCb(ovs_ctx_t *ctx,
+                                              void *opaque)
+{
+    struct virStorageBackendOpenvStorageCloneData *data = opaque;
+
+    return ovs_snapshot_create(ctx, data->parent, data->snapshot,
+                               OPENVSTORAGE_SNAPSHOT_TIMEOUT);
+}
+
+static int
+virStorageBackendOpenvStorageSnapshotIsSyncedCb(ovs_ctx_t *ctx,
+                                                void *opaque)
+{
+    struct virStorageBackendOpenvStorageCloneData *data = opaque;
+
+    return ovs_snapshot_is_synced(ctx, data->parent, data->snapshot);
+}
+
+static int
+virStorageBackendOpenvStorageCloneCb(ovs_ctx_t *ctx,
+                                     void *opaque)
+{
+    struct virStorageBackendOpenvStorageCloneData *data = opaque;
+
+    return ovs_clone_volume_from_snapshot(ctx, data->volname,
+                                          data->parent, data->snapshot);
+}
+
+static int
+virStorageBackendOpenvStorageTruncateCb(ovs_ctx_t *ctx,
+                                        void *opaque)
+{
+    struct virStorageBackendOpenvStorageCloneData *data = opaque;
+
+    return ovs_truncate_volume(ctx, data->volname, data->capacity);
+}
+
+/*
+ * Clones are thin: a snapshot of the source volume is taken and the
+ * new volume is created on top of it, so no data is copied.
+ *
+ * The snapshot is named after the clone and stays around as long as
+ * the clone references it. The parent is recorded as the backing
+ * store of the clone so deleting the clone can remove the snapshot
+ * right away. That record does not survive a full pool refresh or a
+ * daemon restart, deleting the clone then looks for the snapshot on
+ * the other volumes of the pool.
+ */
+static int
+virStorageBackendOpenvStorageBuildVolFrom(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                          virStoragePoolObjPtr pool,
+                                          virStorageVolDefPtr vol,
+                                          virStorageVolDefPtr inputvol,
+                                          unsigned int flags)
+{
+    struct virStorageBackendOpenvStorageCloneData data;
+    char *snapshot = NULL;
+    bool snapshotCreated = false;
+    time_t deadline;
+    int synced;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    /* The pool lock is dropped while building, but volumes cannot be
+     * removed from the pool meanwhile as asyncjobs is raised */
+    if (virStorageVolDefFindByName(pool, inputvol->name) != inputvol) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("volume '%s' can only be cloned from a volume "
+                         "of pool '%s'"),
+                       vol->name, pool->def->name);
+        return -1;
+    }
+
+    if (!(snapshot = virStorageBackendOpenvStorageCloneSnapshotName(vol->name)))
+        return -1;
+
+    VIR_FREE(vol->backingStore.path);
+    if (VIR_STRDUP(vol->backingStore.path, inputvol->name) < 0)
+        goto cleanup;
+
+    data.volname = vol->name;
+    data.parent = inputvol->name;
+    data.snapshot = snapshot;
+    data.capacity = vol->capacity;
+
+    /* Volume names are unique within the pool, so an existing
+     * snapshot of that name was left by a clone deleted earlier */
+    if (virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageSnapshotCreateCb,
+                                            &data) < 0 &&
+        (errno != EEXIST ||
+         virStorageBackendOpenvStorageCtxRun(pool,
+                                             virStorageBackendOpenvStorageSnapshotRemoveCb,
+                                             &data) < 0 ||
+         virStorageBackendOpenvStorageCtxRun(pool,
+                                             virStorageBackendOpenvStorageSnapshotCreateCb,
+                                             &data) < 0)) {
+        virReportSystemError(errno,
+                             _("failed to create snapshot '%s' of volume '%s'"),
+                             snapshot, inputvol->name);
+        goto cleanup;
+    }
+    snapshotCreated = true;
+
+    /* Volumes can only be cloned from snapshots that reached the
+     * backend */
+    deadline = time(NULL) + OPENVSTORAGE_SNAPSHOT_TIMEOUT;
+    while ((synced = virStorageBackendOpenvStorageCtxRun(pool,
+                                                         virStorageBackendOpenvStorageSnapshotIsSyncedCb,
+                                                         &data)) == 0) {
+        if (time(NULL) >= deadline) {
+            virReportError(VIR_ERR_OPERATION_TIMEOUT,
+                           _("timed out waiting for snapshot '%s' of "
+                             "volume '%s' to be synced"),
+                           snapshot, inputvol->name);
+            goto cleanup;
+        }
+        usleep(100 * 1000);
+    }
+    if (synced < 0) {
+        virReportSystemError(errno,
+                             _("failed to query snapshot '%s' of volume '%s'"),
+                             snapshot, inputvol->name);
+        goto cleanup;
+    }
+
+    if (virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageCloneCb,
+                                            &data) < 0) {
+        virReportSystemError(errno,
+                             _("failed to clone volume '%s' from '%s'"),
+                             vol->name, inputvol->name);
+        goto cleanup;
+    }
+    snapshotCreated = false;
+
+    if (vol->capacity > inputvol->capacity &&
+        virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageTruncateCb,
+                                            &data) < 0) {
+        virReportSystemError(errno, _("failed to resize volume '%s'"),
+                             vol->name);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    if (snapshotCreated &&
+        virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageSnapshotRemoveCb,
+                                            &data) < 0)
+        VIR_WARN("failed to remove snapshot '%s' of volume '%s'",
+                 snapshot, inputvol->name);
+    VIR_FREE(snapshot);
+    return ret;
+}
+
+static int
+virStorageBackendOpenvStorageResizeVol(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                       virStoragePoolObjPtr pool,
+                                       virStorageVolDefPtr vol,
+                                       unsigned long long capacity,
+                                       unsigned int flags)
+{
+    struct virStorageBackendOpenvStorageCloneData data;
+
+    virCheckFlags(0, -1);
+
+    memset(&data, 0, sizeof(data));
+    data.volname = vol->name;
+    data.capacity = capacity;
+
+    if (virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageTruncateCb,
+                                            &data) < 0) {
+        virReportSystemError(errno, _("failed to resize volume '%s'"),
+                             vol->name);
+        return -1;
+    }
+    return 0;
+}
+
+/* Streams keep a context opened on their volume for as long as they
+ * are open, so it does not come from the pool; the transport
+ * attributes are shared though */
+static ovs_ctx_t *
+virStorageBackendOpenvStorageVolCtxNew(virStoragePoolObjPtr pool,
+                                       const char *volname)
+{
+    virStorageBackendOpenvStorageStatePtr state;
+    ovs_ctx_t *ctx;
+
+    if (!(state = virStorageBackendOpenvStorageGetState(pool)))
+        return NULL;
+
+    if (!(ctx = ovs_ctx_new(state->attr))) {
+        virReportSystemError(errno, "%s",
+                             _("failed to create context"));
+        return NULL;
+    }
+
+    if (ovs_ctx_init(ctx, volname, O_RDWR) < 0) {
+        virReportSystemError(errno,
+                             _("failed to create context for volume '%s'"),
+                             volname);
+        ovs_ctx_destroy(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+static int
+virStorageBackendOpenvStorageStatCb(ovs_ctx_t *ctx,
+                                    void *opaque)
+{
+    struct stat *st = opaque;
+
+    return ovs_stat(ctx, st);
+}
+
+static int
+virStorageBackendOpenvStorageRefreshVol(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                        virStoragePoolObjPtr pool,
+                                        virStorageVolDefPtr vol)
+{
+    struct stat st;
+
+    if (virStorageBackendOpenvStorageCtxRunVol(pool, vol->name,
+                                               virStorageBackendOpenvStorageStatCb,
+                                               &st) < 0) {
+        virReportSystemError(errno, _("failed to stat volume '%s'"),
+                             vol->name);
+        return -1;
+    }
+    vol->capacity = st.st_size;
+    vol->allocation = st.st_blksize * st.st_blocks;
+    vol->type = VIR_STORAGE_VOL_NETWORK;
+
+    VIR_FREE(vol->key);
+    if (virAsprintf(&vol->key, "%s",
+                    vol->name) == -1)
+    {
+        virReportSystemError(0, _("cannot copy key for volume '%s'"),
+                             vol->name);
+        return -1;
+    }
+
+    VIR_FREE(vol->target.path);
+    ignore_value(VIR_STRDUP(vol->target.path, vol->name));
+    return 0;
+}
+
+/* Volume upload/download data path.
+ *
+ * The stream handed back to the caller is one end of a pipe; a worker
+ * thread owns the other end and moves the data from/to the volume with
+ * up to OPENVSTORAGE_STREAM_DEPTH requests in flight, reaped in
+ * submission order so the pipe sees the data sequentially. */
+typedef struct _virStorageBackendOpenvStorageStreamReq virStorageBackendOpenvStorageStreamReq;
+typedef virStorageBackendOpenvStorageStreamReq *virStorageBackendOpenvStorageStreamReqPtr;
+
+struct _virStorageBackendOpenvStorageStreamReq {
+    struct ovs_aiocb aiocb;
+    ovs_completion_t *completion;
+};
+
+typedef struct _virStorageBackendOpenvStorageStream virStorageBackendOpenvStorageStream;
+typedef virStorageBackendOpenvStorageStream *virStorageBackendOpenvStorageStreamPtr;
+
+struct _virStorageBackendOpenvStorageStream {
+    ovs_ctx_t *ctx;
+    char *volname;
+    bool upload;
+    int fd;                     /* worker end of the pipe */
+    unsigned long long offset;
+    unsigned long long end;     /* upload: 0 means until EOF on the pipe */
+
+    virThread thread;
+    virErrorPtr err;
+
+    virStorageBackendOpenvStorageStreamReq reqs[OPENVSTORAGE_STREAM_DEPTH];
+};
+
+static void
+virStorageBackendOpenvStorageStreamFree(virStorageBackendOpenvStorageStreamPtr data)
+{
+    size_t i;
+
+    if (!data)
+        return;
+
+    for (i = 0; i < OPENVSTORAGE_STREAM_DEPTH; i++)
+        VIR_FREE(data->reqs[i].aiocb.aio_buf);
+    if (data->ctx)
+        ignore_value(ovs_ctx_destroy(data->ctx));
+    VIR_FORCE_CLOSE(data->fd);
+    virFreeError(data->err);
+    VIR_FREE(data->volname);
+    VIR_FREE(data);
+}
+
+/* Completions are reaped with ovs_aio_wait_completion */
+static void
+virStorageBackendOpenvStorageStreamReqDone(ovs_completion_t *completion ATTRIBUTE_UNUSED,
+                                           void *opaque ATTRIBUTE_UNUSED)
+{
+}
+
+static int
+virStorageBackendOpenvStorageStreamReqSubmit(virStorageBackendOpenvStorageStreamPtr data,
+                                             virStorageBackendOpenvStorageStreamReqPtr req,
+                                             unsigned long long offset,
+                                             size_t nbytes)
+{
+    int r;
+
+    if (!(req->completion =
+          ovs_aio_create_completion(virStorageBackendOpenvStorageStreamReqDone,
+                                    NULL))) {
+        virReportSystemError(errno, "%s",
+                             _("failed to create I/O completion"));
+        return -1;
+    }
+
+    req->aiocb.aio_offset = offset;
+    req->aiocb.aio_nbytes = nbytes;
+
+    if (data->upload)
+        r = ovs_aio_writecb(data->ctx, &req->aiocb, req->completion);
+    else
+        r = ovs_aio_readcb(data->ctx, &req->aiocb, req->completion);
+
+    if (r < 0) {
+        virReportSystemError(errno,
+                             _("failed to submit I/O on volume '%s'"),
+                             data->volname);
+        ignore_value(ovs_aio_release_completion(req->completion));
+        req->completion = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Returns the number of bytes transferred by @req, -1 on error */
+static ssize_t
+virStorageBackendOpenvStorageStreamReqWait(virStorageBackendOpenvStorageStreamPtr data,
+                                           virStorageBackendOpenvStorageStreamReqPtr req)
+{
+    ssize_t ret = -1;
+
+    if (ovs_aio_wait_completion(req->completion, NULL) < 0 ||
+        (ret = ovs_aio_return_completion(req->completion)) < 0)
+        virReportSystemError(errno,
+                             _("I/O failed on volume '%s'"),
+                             data->volname);
+
+    ignore_value(ovs_aio_release_completion(req->completion));
+    req->completion = NULL;
+    return ret;
+}
+
+static int
+virStorageBackendOpenvStorageStreamUpload(virStorageBackendOpenvStorageStreamPtr data)
+{
+    virStorageBackendOpenvStorageStreamReqPtr req;
+    unsigned long long offset = data->offset;
+    size_t i = 0;
+    size_t want;
+    ssize_t got;
+    bool eof = false;
+
+    while (!eof) {
+        req = &data->reqs[i];
+        i = (i + 1) % OPENVSTORAGE_STREAM_DEPTH;
+
+        if (req->completion &&
+            virStorageBackendOpenvStorageStreamReqWait(data, req) < 0)
+            return -1;
+
+        want = OPENVSTORAGE_STREAM_BUFSIZE;
+        if (data->end && data->end - offset < want)
+            want = data->end - offset;
+        if (want == 0)
+            break;
+
+        if ((got = saferead(data->fd, req->aiocb.aio_buf, want)) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("failed to read stream data"));
+            return -1;
+        }
+        if (got == 0)
+            break;
+        if (got < want)
+            eof = true;
+
+        if (virStorageBackendOpenvStorageStreamReqSubmit(data, req,
+                                                         offset, got) < 0)
+            return -1;
+        offset += got;
+    }
+
+    for (i = 0; i < OPENVSTORAGE_STREAM_DEPTH; i++) {
+        req = &data->reqs[i];
+        if (req->completion &&
+            virStorageBackendOpenvStorageStreamReqWait(data, req) < 0)
+            return -1;
+    }
+
+    if (ovs_flush(data->ctx) < 0) {
+        virReportSystemError(errno, _("failed to flush volume '%s'"),
+                             data->volname);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+virStorageBackendOpenvStorageStreamDownload(virStorageBackendOpenvStorageStreamPtr data)
+{
+    virStorageBackendOpenvStorageStreamReqPtr req;
+    unsigned long long offset = data->offset;
+    size_t i;
+    ssize_t got;
+
+    for (i = 0; i < OPENVSTORAGE_STREAM_DEPTH && offset < data->end; i++) {
+        size_t want = MIN(data->end - offset, OPENVSTORAGE_STREAM_BUFSIZE);
+
+        if (virStorageBackendOpenvStorageStreamReqSubmit(data, &data->reqs[i],
+                                                         offset, want) < 0)
+            return -1;
+        offset += want;
+    }
+
+    i = 0;
+    while ((req = &data->reqs[i])->completion) {
+        size_t want = req->aiocb.aio_nbytes;
+
+        i = (i + 1) % OPENVSTORAGE_STREAM_DEPTH;
+
+        if ((got = virStorageBackendOpenvStorageStreamReqWait(data, req)) < 0)
+            return -1;
+
+        if (safewrite(data->fd, req->aiocb.aio_buf, got) != got) {
+            virReportSystemError(errno, "%s",
+                                 _("failed to write stream data"));
+            return -1;
+        }
+
+        /* Short read, the volume shrank under us */
+        if (got < want)
+            break;
+
+        if (offset < data->end) {
+            want = MIN(data->end - offset, OPENVSTORAGE_STREAM_BUFSIZE);
+            if (virStorageBackendOpenvStorageStreamReqSubmit(data, req,
+                                                             offset, want) < 0)
+                return -1;
+            offset += want;
+        }
+    }
+
+    return 0;
+}
+
+static void
+virStorageBackendOpenvStorageStreamWorker(void *opaque)
+{
+    virStorageBackendOpenvStorageStreamPtr data = opaque;
+    int r;
+    size_t i;
+
+    if (data->upload)
+        r = virStorageBackendOpenvStorageStreamUpload(data);
+    else
+        r = virStorageBackendOpenvStorageStreamDownload(data);
+
+    if (r < 0)
+        data->err = virSaveLastError();
+
+    /* Buffers must stay around until all requests are reaped */
+    for (i = 0; i < OPENVSTORAGE_STREAM_DEPTH; i++) {
+        if (data->reqs[i].completion) {
+            ignore_value(ovs_aio_wait_completion(data->reqs[i].completion, NULL));
+            ignore_value(ovs_aio_release_completion(data->reqs[i].completion));
+            data->reqs[i].completion = NULL;
+        }
+    }
+
+    /* Signals EOF to the stream on download */
+    VIR_FORCE_CLOSE(data->fd);
+}
+
+static int
+virStorageBackendOpenvStorageStreamFinish(virStreamPtr st ATTRIBUTE_UNUSED,
+                                          bool streamAbort,
+                                          void *opaque)
+{
+    virStorageBackendOpenvStorageStreamPtr data = opaque;
+    int ret = 0;
+
+    virThreadJoin(&data->thread);
+
+    if (data->err && !streamAbort) {
+        virSetError(data->err);
+        ret = -1;
+    }
+
+    virStorageBackendOpenvStorageStreamFree(data);
+    return ret;
+}
+
+static int
+virStorageBackendOpenvStorageStreamOpen(virStoragePoolObjPtr pool,
+                                        virStorageVolDefPtr vol,
+                                        virStreamPtr stream,
+                                        unsigned long long offset,
+                                        unsigned long long length,
+                                        bool upload)
+{
+    virStorageBackendOpenvStorageStreamPtr data = NULL;
+    struct stat sb;
+    int fds[2] = { -1, -1 };
+    int streamfd;
+    size_t i;
+
+    if (VIR_ALLOC(data) < 0)
+        return -1;
+    data->fd = -1;
+    data->upload = upload;
+
+    if (VIR_STRDUP(data->volname, vol->name) < 0)
+        goto error;
+
+    for (i = 0; i < OPENVSTORAGE_STREAM_DEPTH; i++) {
+        char *buf;
+
+        if (VIR_ALLOC_N(buf, OPENVSTORAGE_STREAM_BUFSIZE) < 0)
+            goto error;
+        data->reqs[i].aiocb.aio_buf = buf;
+    }
+
+    if (!(data->ctx = virStorageBackendOpenvStorageVolCtxNew(pool, vol->name)))
+        goto error;
+
+    if (ovs_stat(data->ctx, &sb) < 0) {
+        virReportSystemError(errno, _("failed to stat volume '%s'"),
+                             vol->name);
+        goto error;
+    }
+
+    if (offset > sb.st_size ||
+        (length && length > sb.st_size - offset)) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("range %llu+%llu is beyond the end of volume '%s'"),
+                       offset, length, vol->name);
+        goto error;
+    }
+
+    data->offset = offset;
+    if (length)
+        data->end = offset + length;
+    else if (!upload)
+        data->end = sb.st_size;
+
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        virReportSystemError(errno, "%s", _("unable to create pipe"));
+        goto error;
+    }
+
+    if (upload) {
+        data->fd = fds[0];
+        streamfd = fds[1];
+    } else {
+        data->fd = fds[1];
+        streamfd = fds[0];
+    }
+
+    if (virThreadCreate(&data->thread, true,
+                        virStorageBackendOpenvStorageStreamWorker, data) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to create stream worker thread"));
+        VIR_FORCE_CLOSE(streamfd);
+        goto error;
+    }
+
+    if (virFDStreamOpen(stream, streamfd) < 0) {
+        /* Closing our end makes the worker bail out */
+        VIR_FORCE_CLOSE(streamfd);
+        virThreadJoin(&data->thread);
+        goto error;
+    }
+
+    virFDStreamSetInternalFinishCb(stream,
+                                   virStorageBackendOpenvStorageStreamFinish,
+                                   data);
+    return 0;
+
+error:
+    virStorageBackendOpenvStorageStreamFree(data);
+    return -1;
+}
+
+static int
+virStorageBackendOpenvStorageUploadVol(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                       virStoragePoolObjPtr pool,
+                                       virStorageVolDefPtr vol,
+                                       virStreamPtr stream,
+                                       unsigned long long offset,
+                                       unsigned long long length,
+                                       unsigned int flags)
+{
+    virCheckFlags(0, -1);
+
+    return virStorageBackendOpenvStorageStreamOpen(pool, vol, stream,
+                                                   offset, length, true);
+}
+
+static int
+virStorageBackendOpenvStorageDownloadVol(virConnectPtr conn ATTRIBUTE_UNUSED,
+                                         virStoragePoolObjPtr pool,
+                                         virStorageVolDefPtr vol,
+                                         virStreamPtr stream,
+                                         unsigned long long offset,
+                                         unsigned long long length,
+                                         unsigned int flags)
+{
+    virCheckFlags(0, -1);
+
+    return virStorageBackendOpenvStorageStreamOpen(pool, vol, stream,
+                                                   offset, length, false);
+}
+
+struct virStorageBackendOpenvStorageListData {
+    char *names;
+    size_t size;
+};
+
+static int
+virStorageBackendOpenvStorageListVolumesCb(ovs_ctx_t *ctx,
+                                           void *opaque)
+{
+    struct virStorageBackendOpenvStorageListData *data = opaque;
+    int len;
+
+    while (true)
+    {
+        VIR_FREE(data->names);
+        if (VIR_ALLOC_N_QUIET(data->names, data->size) < 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+        len = ovs_list_volumes(ctx, data->names, &data->size);
+        if (len >= 0)
+            return len;
+        if (errno != ERANGE)
+            return -1;
+    }
+}
+
+struct virStorageBackendOpenvStorageRefreshData {
+    virMutex lock;
+    virConnectPtr conn;
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr *vols;
+    size_t nvols;
+    size_t next;
+    virErrorPtr err;
+};
+
+static void
+virStorageBackendOpenvStorageRefreshWorker(void *opaque)
+{
+    struct virStorageBackendOpenvStorageRefreshData *data = opaque;
+    virStorageVolDefPtr vol;
+
+    while (true) {
+        virMutexLock(&data->lock);
+        if (data->err || data->next == data->nvols) {
+            virMutexUnlock(&data->lock);
+            return;
+        }
+        vol = data->vols[data->next++];
+        virMutexUnlock(&data->lock);
+
+        if (virStorageBackendOpenvStorageRefreshVol(data->conn,
+                                                    data->pool, vol) < 0) {
+            VIR_WARN("cannot refresh volume info of '%s'", vol->name);
+            virMutexLock(&data->lock);
+            if (!data->err)
+                data->err = virSaveLastError();
+            virMutexUnlock(&data->lock);
+            return;
+        }
+    }
+}
+
+/*
+ * Stat all of @nvols volumes in @vols using up to @nworkers threads,
+ * the calling thread being one of them.
+ */
+static int
+virStorageBackendOpenvStorageRefreshVols(virConnectPtr conn,
+                                         virStoragePoolObjPtr pool,
+                                         virStorageVolDefPtr *vols,
+                                         size_t nvols,
+                                         size_t nworkers)
+{
+    struct virStorageBackendOpenvStorageRefreshData data;
+    virThreadPtr threads = NULL;
+    size_t nthreads = 0;
+    size_t i;
+    int ret = -1;
+
+    memset(&data, 0, sizeof(data));
+    if (virMutexInit(&data.lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        return -1;
+    }
+    data.conn = conn;
+    data.pool = pool;
+    data.vols = vols;
+    data.nvols = nvols;
+
+    if (nworkers > nvols)
+        nworkers = nvols;
+
+    if (nworkers > 1 &&
+        VIR_ALLOC_N(threads, nworkers - 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i + 1 < nworkers; i++) {
+        if (virThreadCreate(&threads[nthreads], true,
+                            virStorageBackendOpenvStorageRefreshWorker,
+                            &data) < 0) {
+            char ebuf[1024];
+            /* Carry on with the workers we already have */
+            VIR_WARN("Failed to create refresh worker thread: %s",
+                     virStrerror(errno, ebuf, sizeof(ebuf)));
+            break;
+        }
+        nthreads++;
+    }
+
+    VIR_DEBUG("Refreshing %zu volumes of pool '%s' with %zu workers",
+              nvols, pool->def->name, nthreads + 1);
+
+    virStorageBackendOpenvStorageRefreshWorker(&data);
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+
+    if (data.err) {
+        virSetError(data.err);
+        virFreeError(data.err);
+        goto cleanup;
+    }
+    ret = 0;
+
+cleanup:
+    VIR_FREE(threads);
+    virMutexDestroy(&data.lock);
+    return ret;
+}
+
+static int
+virStorageBackendOpenvStorageRefreshPool(virConnectPtr conn,
+                                         virStoragePoolObjPtr pool)
+{
+    const uint64_t fs_size = 64ULL << 40;
+    struct virStorageBackendOpenvStorageListData list = { NULL, 1024 };
+    virStorageVolDefPtr *vols = NULL;
+    virStorageVolDefPtr *known = NULL;
+    virStorageVolDefPtr *prev = NULL;
+    char **names = NULL;
+    size_t nvols = 0;
+    size_t nnames = 0;
+    size_t nupdated = 0;
+    size_t nworkers;
+    size_t i;
+    char *name;
+    int r = -1;
+    pool->def->capacity = fs_size;
+    pool->def->available = fs_size;
+
+    if (virStorageBackendOpenvStorageCtxRun(pool,
+                                            virStorageBackendOpenvStorageListVolumesCb,
+                                            &list) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("A problem occured while listing images"));
+        goto cleanup;
+    }
+
+    for (name = list.names;
+         name < list.names + list.size && STRNEQ(name, "");
+         name += strlen(name) + 1)
+        nnames++;
+
+    if (VIR_ALLOC_N(names, nnames) < 0 ||
+        VIR_ALLOC_N(known, nnames) < 0 ||
+        VIR_ALLOC_N(prev, nnames) < 0 ||
+        VIR_ALLOC_N(vols, nnames) < 0)
+        goto cleanup;
+
+    for (i = 0, name = list.names; i < nnames; i++, name += strlen(name) + 1)
+        names[i] = name;
+
+    if (pool->def->refreshMode == VIR_STORAGE_POOL_REFRESH_INCREMENTAL &&
+        virStoragePoolObjSyncVols(pool, names, nnames, known) < 0)
+        goto cleanup;
+
+    /* The listing carries nothing but names, so known volumes are
+     * stat'ed as well to find out which of them changed. That is a
+     * single request on a pooled context each; volumes being built
+     * are left alone */
+    for (i = 0; i < nnames; i++) {
+        if (known[i] && known[i]->building)
+            continue;
+        prev[nvols] = known[i];
+        if (VIR_ALLOC(vols[nvols]) < 0)
+            goto cleanup;
+        if (VIR_STRDUP(vols[nvols++]->name, names[i]) < 0)
+            goto cleanup;
+    }
+
+    nworkers = pool->def->refreshWorkers;
+    if (!nworkers)
+        nworkers = OPENVSTORAGE_REFRESH_WORKERS;
+
+    if (virStorageBackendOpenvStorageRefreshVols(conn, pool, vols, nvols,
+                                                 nworkers) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvols; i++) {
+        if (prev[i]) {
+            if (prev[i]->capacity == vols[i]->capacity &&
+                prev[i]->allocation == vols[i]->allocation)
+                continue;
+            /* Keep track of the parent of clones */
+            if (prev[i]->backingStore.path &&
+                VIR_STRDUP(vols[i]->backingStore.path,
+                           prev[i]->backingStore.path) < 0)
+                goto cleanup;
+            virStoragePoolObjDropVol(pool, prev[i]);
+        }
+        if (virStoragePoolObjAddVol(pool, vols[i]) < 0)
+            goto cleanup;
+        vols[i] = NULL;
+        nupdated++;
+    }
+
+    VIR_DEBUG("Pool '%s' lists %zu volumes, %zu of them new or changed",
+              pool->def->name, nnames, nupdated);
+
+    pool->def->allocation = 0;
+    for (i = 0; i < pool->volumes.count; i++)
+        pool->def->allocation += pool->volumes.objs[i]->allocation;
+    if (pool->def->allocation < fs_size)
+        pool->def->available = fs_size - pool->def->allocation;
+    else
+        pool->def->available = 0;
+    r = 0;
+
+cleanup:
+    for (i = 0; i < nvols; i++)
+        virStorageVolDefFree(vols[i]);
+    VIR_FREE(vols);
+    VIR_FREE(known);
+    VIR_FREE(prev);
+    VIR_FREE(names);
+    VIR_FREE(list.names);
+    return r;
 }
 
 virStorageBackend virStorageBackendOpenvStorage = {
     .type = VIR_STORAGE_POOL_OPENVSTORAGE,
 
+    .startPool = virStorageBackendOpenvStorageStartPool,
     .refreshPool = virStorageBackendOpenvStorageRefreshPool,
+    .stopPool = virStorageBackendOpenvStorageStopPool,
     .createVol = virStorageBackendOpenvStorageCreateVol,
     .buildVol = virStorageBackendOpenvStorageBuildVol,
+    .buildVolFrom = virStorageBackendOpenvStorageBuildVolFrom,
     .refreshVol = virStorageBackendOpenvStorageRefreshVol,
     .deleteVol = virStorageBackendOpenvStorageDeleteVol,
+    .resizeVol = virStorageBackendOpenvStorageResizeVol,
+    .uploadVol = virStorageBackendOpenvStorageUploadVol,
+    .downloadVol = virStorageBackendOpenvStorageDownloadVol,
 };
 
 virStorageBackend virStorageBackendOpenvStorageTCP = {
     .type = VIR_STORAGE_POOL_OPENVSTORAGE_TCP,
 
-    .refreshPool = virStorageBackendOpenvStorageRefreshPoolTCP,
+    .startPool = virStorageBackendOpenvStorageStartPoolTCP,
+    .refreshPool = virStorageBackendOpenvStorageRefreshPool,
+    .stopPool = virStorageBackendOpenvStorageStopPool,
     .createVol = virStorageBackendOpenvStorageCreateVol,
-    .buildVol = virStorageBackendOpenvStorageBuildVolTCP,
-    .refreshVol = virStorageBackendOpenvStorageRefreshVolTCP,
-    .deleteVol = virStorageBackendOpenvStorageDeleteVolTCP,
+    .buildVol = virStorageBackendOpenvStorageBuildVol,
+    .buildVolFrom = virStorageBackendOpenvStorageBuildVolFrom,
+    .refreshVol = virStorageBackendOpenvStorageRefreshVol,
+    .deleteVol = virStorageBackendOpenvStorageDeleteVol,
+    .resizeVol = virStorageBackendOpenvStorageResizeVol,
+    .uploadVol = virStorageBackendOpenvStorageUploadVol,
+    .downloadVol = virStorageBackendOpenvStorageDownloadVol,
 };
 
 virStorageBackend virStorageBackendOpenvStorageRDMA = {
     .type = VIR_STORAGE_POOL_OPENVSTORAGE_RDMA,
 
-    .refreshPool = virStorageBackendOpenvStorageRefreshPoolRDMA,
+    .startPool = virStorageBackendOpenvStorageStartPoolRDMA,
+    .refreshPool = virStorageBackendOpenvStorageRefreshPool,
+    .stopPool = virStorageBackendOpenvStorageStopPool,
     .createVol = virStorageBackendOpenvStorageCreateVol,
-    .buildVol = virStorageBackendOpenvStorageBuildVolRDMA,
-    .refreshVol = virStorageBackendOpenvStorageRefreshVolRDMA,
-    .deleteVol = virStorageBackendOpenvStorageDeleteVolRDMA,
+    .buildVol = virStorageBackendOpenvStorageBuildVol,
+    .buildVolFrom = virStorageBackendOpenvStorageBuildVolFrom,
+    .refreshVol = virStorageBackendOpenvStorageRefreshVol,
+    .deleteVol = virStorageBackendOpenvStorageDeleteVol,
+    .resizeVol = virStorageBackendOpenvStorageResizeVol,
+    .uploadVol = virStorageBackendOpenvStorageUploadVol,
+    .downloadVol = virStorageBackendOpenvStorageDownloadVol,
 };
@@ -329,6 +329,10 @@ static int virStorageBackendRBDRefreshPool(virConnectPtr conn,
     int len = -1;
     int r = 0;
     char *name, *names = NULL;
+    char **volnames = NULL;
+    virStorageVolDefPtr *known = NULL;
+    size_t nvolnames = 0;
+    size_t i;
     virStorageBackendRBDState ptr;
     ptr.cluster = NULL;
     ptr.ioctx = NULL;
@@ -379,33 +383,58 @@ static int virStorageBackendRBDRefreshPool(virConnectPtr conn,
         VIR_FREE(names);
     }
 
-    for (name = names; name < names + max_size;) {
-        virStorageVolDefPtr vol;
+    for (name = names;
+         name < names + max_size && STRNEQ(name, "");
+         name += strlen(name) + 1)
+        nvolnames++;
 
-        if (VIR_REALLOC_N(pool->volumes.objs, pool->volumes.count + 1) < 0) {
-            virStoragePoolObjClearVols(pool);
-            goto cleanup;
-        }
+    if (VIR_ALLOC_N(volnames, nvolnames) < 0 ||
+        VIR_ALLOC_N(known, nvolnames) < 0)
+        goto cleanup;
 
-        if (STREQ(name, ""))
-            break;
+    for (i = 0, name = names; i < nvolnames; i++, name += strlen(name) + 1)
+        volnames[i] = name;
+
+    if (pool->def->refreshMode == VIR_STORAGE_POOL_REFRESH_INCREMENTAL &&
+        virStoragePoolObjSyncVols(pool, volnames, nvolnames, known) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvolnames; i++) {
+        virStorageVolDefPtr vol;
+
+        /* librbd only lists names, so known images are stat'ed again
+         * to find out whether they changed; images being built are
+         * left alone */
+        if (known[i] && known[i]->building)
+            continue;
 
         if (VIR_ALLOC(vol) < 0)
             goto cleanup;
 
-        if (VIR_STRDUP(vol->name, name) < 0) {
+        if (VIR_STRDUP(vol->name, volnames[i]) < 0) {
             VIR_FREE(vol);
             goto cleanup;
         }
 
-        name += strlen(name) + 1;
-
         if (volStorageBackendRBDRefreshVolInfo(vol, pool, &ptr) < 0) {
             virStorageVolDefFree(vol);
             goto cleanup;
         }
 
-        pool->volumes.objs[pool->volumes.count++] = vol;
+        if (known[i]) {
+            if (known[i]->capacity == vol->capacity &&
+                known[i]->allocation == vol->allocation) {
+                virStorageVolDefFree(vol);
+                continue;
+            }
+            virStoragePoolObjDropVol(pool, known[i]);
+        }
+
+        if (virStoragePoolObjAddVol(pool, vol) < 0) {
+            virStorageVolDefFree(vol);
+            virStoragePoolObjClearVols(pool);
+            goto cleanup;
+        }
     }
 
     VIR_DEBUG("Found %zu images in RBD pool %s",
@@ -414,6 +443,8 @@ static int virStorageBackendRBDRefreshPool(virConnectPtr conn,
     ret = 0;
 
 cleanup:
+    VIR_FREE(known);
+    VIR_FREE(volnames);
     VIR_FREE(names);
     virStorageBackendRBDCloseRADOSConn(&ptr);
     return ret;
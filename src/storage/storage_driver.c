@@ -35,6 +35,10 @@
 #endif
 #include <errno.h>
 #include <string.h>
+#ifdef __linux__
+# include <sys/ioctl.h>
+# include <linux/fs.h>
+#endif
 
 #include "virerror.h"
 #include "datatypes.h"
@@ -49,10 +53,16 @@
 #include "configmake.h"
 #include "virstring.h"
 #include "viraccessapicheck.h"
+#include "virthreadpool.h"
+#include "virtime.h"
+#include "storage_job.h"
+#include "storage_event.h"
+#include "virtypedparam.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
 static virStorageDriverStatePtr driverState;
+static virStorageJobTablePtr storageJobs;
 
 static int storageStateCleanup(void);
 
@@ -65,72 +75,568 @@ static void storageDriverUnlock(virStorageDriverStatePtr driver)
     virMutexUnlock(&driver->lock);
 }
 
+/* Upper bound on the number of pools checked, started and refreshed
+ * concurrently by storageDriverAutostart */
+#define STORAGE_AUTOSTART_WORKERS 8
+
+/* Upper bound on the number of threads running storage jobs, and on the
+ * number of jobs running at the same time in a single pool; further jobs
+ * of a pool are queued */
+#define STORAGE_JOB_WORKERS 16
+#define STORAGE_JOB_POOL_LIMIT 2
+
+typedef struct _virStorageAutostartJob virStorageAutostartJob;
+typedef virStorageAutostartJob *virStorageAutostartJobPtr;
+struct _virStorageAutostartJob {
+    virStoragePoolObjPtr pool;
+
+    size_t ndeps;           /* unfinished jobs this one waits for */
+    size_t *dependents;     /* jobs waiting for this one to finish */
+    size_t ndependents;
+};
+
+typedef struct _virStorageAutostartState virStorageAutostartState;
+typedef virStorageAutostartState *virStorageAutostartStatePtr;
+struct _virStorageAutostartState {
+    virMutex lock;
+    virCond cond;
+
+    virConnectPtr conn;
+    virThreadPoolPtr workers;
+
+    virStorageAutostartJobPtr jobs;
+    size_t njobs;
+    size_t pending;         /* jobs which have not finished yet */
+};
+
+
 static void
-storageDriverAutostart(virStorageDriverStatePtr driver) {
-    size_t i;
-    virConnectPtr conn = NULL;
+storageDriverAutostartPool(virConnectPtr conn,
+                           virStoragePoolObjPtr pool)
+{
+    virStorageBackendPtr backend;
+    bool started = false;
+    unsigned long long then = 0;
+    unsigned long long now = 0;
 
-    /* XXX Remove hardcoding of QEMU URI */
-    if (driverState->privileged)
-        conn = virConnectOpen("qemu:///system");
-    else
-        conn = virConnectOpen("qemu:///session");
-    /* Ignoring NULL conn - let backends decide */
+    virStoragePoolObjLock(pool);
+    if (pool->refreshing) {
+        VIR_DEBUG("Skipping storage pool '%s' which is being refreshed",
+                  pool->def->name);
+        goto cleanup;
+    }
 
-    for (i = 0; i < driver->pools.count; i++) {
-        virStoragePoolObjPtr pool = driver->pools.objs[i];
-        virStorageBackendPtr backend;
-        bool started = false;
+    if ((backend = virStorageBackendForType(pool->def->type)) == NULL) {
+        VIR_ERROR(_("Missing backend %d"), pool->def->type);
+        goto cleanup;
+    }
 
-        virStoragePoolObjLock(pool);
-        if ((backend = virStorageBackendForType(pool->def->type)) == NULL) {
-            VIR_ERROR(_("Missing backend %d"), pool->def->type);
-            virStoragePoolObjUnlock(pool);
-            continue;
+    ignore_value(virTimeMillisNow(&then));
+
+    if (backend->checkPool &&
+        backend->checkPool(conn, pool, &started) < 0) {
+        virErrorPtr err = virGetLastError();
+        VIR_ERROR(_("Failed to initialize storage pool '%s': %s"),
+                  pool->def->name, err ? err->message :
+                  _("no error message found"));
+        goto cleanup;
+    }
+
+    if (!started &&
+        pool->autostart &&
+        !virStoragePoolObjIsActive(pool)) {
+        if (backend->startPool &&
+            backend->startPool(conn, pool) < 0) {
+            virErrorPtr err = virGetLastError();
+            VIR_ERROR(_("Failed to autostart storage pool '%s': %s"),
+                      pool->def->name, err ? err->message :
+                      _("no error message found"));
+            goto cleanup;
         }
+        started = true;
+    }
 
-        if (backend->checkPool &&
-            backend->checkPool(conn, pool, &started) < 0) {
+    if (started) {
+        if (backend->refreshPool(conn, pool) < 0) {
             virErrorPtr err = virGetLastError();
-            VIR_ERROR(_("Failed to initialize storage pool '%s': %s"),
+            if (backend->stopPool)
+                backend->stopPool(conn, pool);
+            VIR_ERROR(_("Failed to autostart storage pool '%s': %s"),
                       pool->def->name, err ? err->message :
                       _("no error message found"));
-            virStoragePoolObjUnlock(pool);
+            goto cleanup;
+        }
+        pool->active = 1;
+
+        ignore_value(virTimeMillisNow(&now));
+        VIR_INFO("Started storage pool '%s' in %llu ms",
+                 pool->def->name, now - then);
+    }
+
+ cleanup:
+    virStoragePoolObjUnlock(pool);
+}
+
+
+/*
+ * Wait for a refresh of @pool to finish before changing its volumes.
+ * The caller must hold no lock but the one of @pool, which is dropped
+ * while waiting. If a failed refresh deactivated a transient pool
+ * meanwhile, the pool is removed and *poolptr is set to NULL.
+ *
+ * Returns 0 if the pool is active and not being refreshed, -1 on error.
+ */
+static int
+storagePoolObjWaitRefresh(virStorageDriverStatePtr driver,
+                          virStoragePoolObjPtr *poolptr)
+{
+    virStoragePoolObjPtr pool = *poolptr;
+
+    while (pool->refreshing) {
+        VIR_DEBUG("Waiting for refresh of storage pool '%s'",
+                  pool->def->name);
+
+        /* asyncjobs keeps the pool from being removed meanwhile */
+        pool->asyncjobs++;
+        virStoragePoolObjUnlock(pool);
+
+        virRWLockRead(&pool->refreshLock);
+        virRWLockUnlock(&pool->refreshLock);
+
+        storageDriverLock(driver);
+        virStoragePoolObjLock(pool);
+        pool->asyncjobs--;
+
+        if (!virStoragePoolObjIsActive(pool)) {
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           _("storage pool '%s' is not active"),
+                           pool->def->name);
+            if (!pool->configFile && pool->asyncjobs == 0) {
+                virStoragePoolObjRemove(&driver->pools, pool);
+                *poolptr = NULL;
+            }
+            storageDriverUnlock(driver);
+            return -1;
+        }
+        storageDriverUnlock(driver);
+    }
+
+    return 0;
+}
+
+
+static void storageDriverAutostartWorker(void *jobdata, void *opaque);
+
+/*
+ * Hand a job whose dependencies have all finished over to the worker
+ * threads, or run it in the calling thread when there are none.
+ */
+static void
+storageDriverAutostartQueue(virStorageAutostartStatePtr state,
+                            virStorageAutostartJobPtr job)
+{
+    if (state->workers &&
+        virThreadPoolSendJob(state->workers, 0, job) == 0)
+        return;
+
+    storageDriverAutostartWorker(job, state);
+}
+
+
+static void
+storageDriverAutostartWorker(void *jobdata,
+                             void *opaque)
+{
+    virStorageAutostartJobPtr job = jobdata;
+    virStorageAutostartStatePtr state = opaque;
+    virStorageAutostartJobPtr *ready = NULL;
+    size_t nready = 0;
+    size_t i;
+
+    storageDriverAutostartPool(state->conn, job->pool);
+
+    virMutexLock(&state->lock);
+    for (i = 0; i < job->ndependents; i++) {
+        virStorageAutostartJobPtr dep = &state->jobs[job->dependents[i]];
+
+        if (dep->ndeps == 0 || --dep->ndeps > 0)
             continue;
+
+        if (VIR_APPEND_ELEMENT_COPY(ready, nready, dep) < 0) {
+            /* Nothing else would ever pick it up, so run it here */
+            virMutexUnlock(&state->lock);
+            storageDriverAutostartQueue(state, dep);
+            virMutexLock(&state->lock);
+        }
+    }
+    if (--state->pending == 0)
+        virCondBroadcast(&state->cond);
+    virMutexUnlock(&state->lock);
+
+    for (i = 0; i < nready; i++)
+        storageDriverAutostartQueue(state, ready[i]);
+    VIR_FREE(ready);
+}
+
+
+/*
+ * Returns true if @path lies strictly below directory @dir
+ */
+static bool
+storageDriverPathIsBelow(const char *path,
+                         const char *dir)
+{
+    size_t len;
+
+    if (!path || !dir)
+        return false;
+
+    len = strlen(dir);
+    while (len > 0 && dir[len - 1] == '/')
+        len--;
+
+    return len > 0 && STREQLEN(path, dir, len) && path[len] == '/';
+}
+
+
+static bool
+storageDriverPoolProvidesBlockDevs(virStoragePoolObjPtr pool)
+{
+    return pool->def->type == VIR_STORAGE_POOL_ISCSI ||
+           pool->def->type == VIR_STORAGE_POOL_SCSI ||
+           pool->def->type == VIR_STORAGE_POOL_MPATH;
+}
+
+
+static bool
+storageDriverPoolUsesBlockDevs(virStoragePoolObjPtr pool)
+{
+    return pool->def->type == VIR_STORAGE_POOL_LOGICAL ||
+           pool->def->type == VIR_STORAGE_POOL_DISK ||
+           pool->def->type == VIR_STORAGE_POOL_FS;
+}
+
+
+/*
+ * Decide whether pool @b has to wait for pool @a before it can be
+ * started. That is the case when one of its source devices, or its
+ * target directory, lives inside @a's target directory (e.g. a logical
+ * pool on top of a LUN from an iSCSI pool, or a dir pool inside an NFS
+ * mount). Block device consumers whose devices could not be matched to
+ * any pool conservatively wait for every pool that provides block
+ * devices, since the LUN may show up under a plain /dev/sdX name.
+ */
+static bool
+storageDriverPoolDependsOn(virStoragePoolObjPtr b,
+                           virStoragePoolObjPtr a,
+                           bool unmatched)
+{
+    const char *target = a->def->target.path;
+    size_t i;
+
+    if (storageDriverPathIsBelow(b->def->target.path, target))
+        return true;
+
+    for (i = 0; i < b->def->source.ndevice; i++) {
+        if (storageDriverPathIsBelow(b->def->source.devices[i].path, target))
+            return true;
+    }
+
+    return unmatched &&
+        storageDriverPoolUsesBlockDevs(b) &&
+        storageDriverPoolProvidesBlockDevs(a);
+}
+
+
+static int
+storageDriverAutostartAddDep(virStorageAutostartStatePtr state,
+                             size_t before,
+                             size_t after)
+{
+    virStorageAutostartJobPtr job = &state->jobs[before];
+
+    if (VIR_APPEND_ELEMENT(job->dependents, job->ndependents, after) < 0)
+        return -1;
+    state->jobs[after].ndeps++;
+
+    VIR_DEBUG("Storage pool '%s' will be started after '%s'",
+              state->jobs[after].pool->def->name,
+              job->pool->def->name);
+    return 0;
+}
+
+
+/*
+ * Mark in @reach the unresolved jobs which job @from is a dependency
+ * of, directly or not. @queue must have room for one more entry than
+ * there are jobs, as @from may be reached again.
+ */
+static void
+storageDriverAutostartReach(virStorageAutostartStatePtr state,
+                            const size_t *ndeps,
+                            size_t from,
+                            bool *reach,
+                            size_t *queue)
+{
+    size_t head = 0;
+    size_t tail = 0;
+    size_t k;
+
+    queue[tail++] = from;
+    while (head < tail) {
+        virStorageAutostartJobPtr job = &state->jobs[queue[head++]];
+
+        for (k = 0; k < job->ndependents; k++) {
+            size_t dep = job->dependents[k];
+
+            if (ndeps[dep] == 0 || reach[dep])
+                continue;
+            reach[dep] = true;
+            queue[tail++] = dep;
         }
+    }
+}
+
 
-        if (!started &&
-            pool->autostart &&
-            !virStoragePoolObjIsActive(pool)) {
-            if (backend->startPool &&
-                backend->startPool(conn, pool) < 0) {
-                virErrorPtr err = virGetLastError();
-                VIR_ERROR(_("Failed to autostart storage pool '%s': %s"),
-                          pool->def->name, err ? err->message :
-                          _("no error message found"));
-                virStoragePoolObjUnlock(pool);
+/*
+ * Drop the dependencies between pools which are part of the same
+ * cycle so that startup doesn't hang on a broken configuration. Pools
+ * merely depending on a cycle still wait for it. @ndeps holds what
+ * is left of the dependency counts after a topological walk.
+ */
+static int
+storageDriverAutostartBreakCycles(virStorageAutostartStatePtr state,
+                                  const size_t *ndeps)
+{
+    bool *reach = NULL;
+    size_t *queue = NULL;
+    size_t n = state->njobs;
+    size_t i, k;
+
+    if (VIR_ALLOC_N(reach, n * n) < 0 ||
+        VIR_ALLOC_N(queue, n + 1) < 0) {
+        VIR_FREE(reach);
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (ndeps[i])
+            storageDriverAutostartReach(state, ndeps, i, reach + i * n, queue);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (ndeps[i] == 0)
+            continue;
+        if (reach[i * n + i])
+            VIR_WARN("Storage pool '%s' is part of a dependency cycle, "
+                     "starting it without waiting for the other pools "
+                     "of the cycle", state->jobs[i].pool->def->name);
+        else
+            VIR_WARN("Storage pool '%s' depends on a pool in a "
+                     "dependency cycle", state->jobs[i].pool->def->name);
+    }
+
+    for (i = 0; i < n; i++)
+        state->jobs[i].ndeps = 0;
+
+    for (i = 0; i < n; i++) {
+        virStorageAutostartJobPtr job = &state->jobs[i];
+
+        for (k = 0; k < job->ndependents; ) {
+            size_t dep = job->dependents[k];
+
+            if (ndeps[i] && reach[i * n + dep] && reach[dep * n + i]) {
+                VIR_DELETE_ELEMENT(job->dependents, k, job->ndependents);
                 continue;
             }
-            started = true;
+            state->jobs[dep].ndeps++;
+            k++;
+        }
+    }
+
+    VIR_FREE(reach);
+    VIR_FREE(queue);
+    return 0;
+}
+
+
+/*
+ * Fill in the dependency graph between the autostart jobs. Pools which
+ * are still left with unresolved dependencies after a topological walk
+ * are part of a cycle, or depend on one.
+ */
+static int
+storageDriverAutostartPrepare(virStorageAutostartStatePtr state)
+{
+    size_t *ndeps = NULL;
+    size_t *queue = NULL;
+    size_t head = 0;
+    size_t tail = 0;
+    size_t i, j, k;
+    int ret = -1;
+
+    for (j = 0; j < state->njobs; j++) {
+        virStoragePoolObjPtr b = state->jobs[j].pool;
+        bool unmatched = false;
+
+        for (k = 0; k < b->def->source.ndevice && !unmatched; k++) {
+            unmatched = true;
+            for (i = 0; i < state->njobs; i++) {
+                if (storageDriverPathIsBelow(b->def->source.devices[k].path,
+                                             state->jobs[i].pool->def->target.path)) {
+                    unmatched = false;
+                    break;
+                }
+            }
         }
 
-        if (started) {
-            if (backend->refreshPool(conn, pool) < 0) {
-                virErrorPtr err = virGetLastError();
-                if (backend->stopPool)
-                    backend->stopPool(conn, pool);
-                VIR_ERROR(_("Failed to autostart storage pool '%s': %s"),
-                          pool->def->name, err ? err->message :
-                          _("no error message found"));
-                virStoragePoolObjUnlock(pool);
+        for (i = 0; i < state->njobs; i++) {
+            if (i == j ||
+                !storageDriverPoolDependsOn(b, state->jobs[i].pool, unmatched))
                 continue;
-            }
-            pool->active = 1;
+            if (storageDriverAutostartAddDep(state, i, j) < 0)
+                goto cleanup;
         }
-        virStoragePoolObjUnlock(pool);
     }
 
-    virObjectUnref(conn);
+    if (VIR_ALLOC_N(ndeps, state->njobs) < 0 ||
+        VIR_ALLOC_N(queue, state->njobs) < 0)
+        goto cleanup;
+
+    for (i = 0; i < state->njobs; i++) {
+        ndeps[i] = state->jobs[i].ndeps;
+        if (ndeps[i] == 0)
+            queue[tail++] = i;
+    }
+
+    while (head < tail) {
+        virStorageAutostartJobPtr job = &state->jobs[queue[head++]];
+
+        for (k = 0; k < job->ndependents; k++) {
+            if (--ndeps[job->dependents[k]] == 0)
+                queue[tail++] = job->dependents[k];
+        }
+    }
+
+    if (tail < state->njobs &&
+        storageDriverAutostartBreakCycles(state, ndeps) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(ndeps);
+    VIR_FREE(queue);
+    return ret;
+}
+
+
+/*
+ * Check, start and refresh all pools. Independent pools are handled
+ * concurrently by up to STORAGE_AUTOSTART_WORKERS threads; pools that
+ * depend on other pools are queued once those have finished. The
+ * caller holds the driver lock for the whole duration, so the pool
+ * list cannot change underneath the workers.
+ */
+static void
+storageDriverAutostart(virStorageDriverStatePtr driver) {
+    virStorageAutostartState state;
+    virStorageAutostartJobPtr *ready = NULL;
+    size_t nready = 0;
+    size_t i;
+    unsigned long long then = 0;
+    unsigned long long now = 0;
+
+    memset(&state, 0, sizeof(state));
+
+    if (driver->pools.count == 0)
+        return;
+
+    if (virMutexInit(&state.lock) < 0) {
+        VIR_ERROR(_("Unable to initialize mutex"));
+        return;
+    }
+    if (virCondInit(&state.cond) < 0) {
+        VIR_ERROR(_("Unable to initialize condition variable"));
+        virMutexDestroy(&state.lock);
+        return;
+    }
+
+    ignore_value(virTimeMillisNow(&then));
+
+    /* XXX Remove hardcoding of QEMU URI */
+    if (driverState->privileged)
+        state.conn = virConnectOpen("qemu:///system");
+    else
+        state.conn = virConnectOpen("qemu:///session");
+    /* Ignoring NULL conn - let backends decide */
+
+    if (VIR_ALLOC_N(state.jobs, driver->pools.count) < 0)
+        goto cleanup;
+    state.njobs = driver->pools.count;
+    for (i = 0; i < state.njobs; i++)
+        state.jobs[i].pool = driver->pools.objs[i];
+
+    if (storageDriverAutostartPrepare(&state) < 0)
+        goto cleanup;
+
+    for (i = 0; i < state.njobs; i++) {
+        virStorageAutostartJobPtr job = &state.jobs[i];
+
+        if (job->ndeps == 0 &&
+            VIR_APPEND_ELEMENT_COPY(ready, nready, job) < 0)
+            goto cleanup;
+    }
+
+    /* Without worker threads, every job runs in this thread instead */
+    if (!(state.workers = virThreadPoolNew(0,
+                                           MIN(state.njobs,
+                                               STORAGE_AUTOSTART_WORKERS),
+                                           0,
+                                           storageDriverAutostartWorker,
+                                           &state)))
+        VIR_WARN("Unable to create worker threads, "
+                 "starting storage pools sequentially");
+
+    state.pending = state.njobs;
+    for (i = 0; i < nready; i++)
+        storageDriverAutostartQueue(&state, ready[i]);
+
+    virMutexLock(&state.lock);
+    while (state.pending > 0)
+        ignore_value(virCondWait(&state.cond, &state.lock));
+    virMutexUnlock(&state.lock);
+
+    ignore_value(virTimeMillisNow(&now));
+    VIR_INFO("Processed %zu storage pools in %llu ms",
+             state.njobs, now - then);
+
+ cleanup:
+    virThreadPoolFree(state.workers);
+    for (i = 0; i < state.njobs; i++)
+        VIR_FREE(state.jobs[i].dependents);
+    VIR_FREE(state.jobs);
+    VIR_FREE(ready);
+    virObjectUnref(state.conn);
+    virCondDestroy(&state.cond);
+    virMutexDestroy(&state.lock);
+}
+
+static void
+storageJobNotify(virStorageJobPtr job,
+                 void *opaque)
+{
+    virStorageDriverStatePtr driver = opaque;
+    virObjectEventPtr event;
+
+    event = virStoragePoolEventJobCompletedNew(virStorageJobGetPool(job),
+                                               virStorageJobGetPoolUUID(job),
+                                               virStorageJobGetVol(job),
+                                               virStorageJobGetID(job),
+                                               virStorageJobGetType(job),
+                                               virStorageJobGetState(job));
+    if (event)
+        virObjectEventStateQueue(driver->storageEventState, event);
 }
 
 /**
@@ -154,6 +660,15 @@ storageStateInitialize(bool privileged,
     }
     storageDriverLock(driverState);
 
+    if (!(driverState->storageEventState = virObjectEventStateNew()))
+        goto error;
+
+    if (!(storageJobs = virStorageJobTableNew(STORAGE_JOB_WORKERS,
+                                              STORAGE_JOB_POOL_LIMIT,
+                                              storageJobNotify,
+                                              driverState)))
+        goto error;
+
     if (privileged) {
         if (VIR_STRDUP(base, SYSCONFDIR "/libvirt") < 0)
             goto error;
@@ -240,8 +755,14 @@ storageStateCleanup(void) {
     if (!driverState)
         return -1;
 
+    /* Jobs take the driver lock when they finish */
+    virStorageJobTableFree(storageJobs);
+    storageJobs = NULL;
+
     storageDriverLock(driverState);
 
+    virObjectEventStateFree(driverState->storageEventState);
+
     /* free inactive pools */
     virStoragePoolObjListFree(&driverState->pools);
 
@@ -661,6 +1182,18 @@ storagePoolDefineXML(virConnectPtr conn,
     if (virStorageBackendForType(def->type) == NULL)
         goto cleanup;
 
+    /* A build job works on the definition of the inactive pool */
+    if ((pool = virStoragePoolObjFindByUUID(&driver->pools, def->uuid))) {
+        if (!virStoragePoolObjIsActive(pool) && pool->asyncjobs > 0) {
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           _("storage pool '%s' is being built"),
+                           pool->def->name);
+            goto cleanup;
+        }
+        virStoragePoolObjUnlock(pool);
+        pool = NULL;
+    }
+
     if (!(pool = virStoragePoolObjAssignDef(&driver->pools, def)))
         goto cleanup;
 
@@ -771,6 +1304,14 @@ storagePoolCreate(virStoragePoolPtr obj,
                        pool->def->name);
         goto cleanup;
     }
+
+    if (pool->asyncjobs > 0) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("storage pool '%s' is being built"),
+                       pool->def->name);
+        goto cleanup;
+    }
+
     if (backend->startPool &&
         backend->startPool(obj->conn, pool) < 0)
         goto cleanup;
@@ -791,13 +1332,63 @@ cleanup:
     return ret;
 }
 
-static int
-storagePoolBuild(virStoragePoolPtr obj,
-                 unsigned int flags) {
-    virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
-    virStoragePoolObjPtr pool;
+typedef struct _virStoragePoolBuildJobData virStoragePoolBuildJobData;
+typedef virStoragePoolBuildJobData *virStoragePoolBuildJobDataPtr;
+struct _virStoragePoolBuildJobData {
+    virConnectPtr conn;
+    virStorageDriverStatePtr driver;
     virStorageBackendPtr backend;
-    int ret = -1;
+    virStoragePoolObjPtr pool;
+    unsigned int flags;
+};
+
+
+static void
+storagePoolBuildJobDataFree(void *opaque)
+{
+    virStoragePoolBuildJobDataPtr data = opaque;
+
+    if (!data)
+        return;
+
+    virObjectUnref(data->conn);
+    VIR_FREE(data);
+}
+
+
+static int
+storagePoolBuildJobRun(virStorageJobPtr job,
+                       void *opaque)
+{
+    virStoragePoolBuildJobDataPtr data = opaque;
+    virStoragePoolObjPtr pool = data->pool;
+    int ret = -1;
+
+    if (virStorageJobCheckAborted(job) == 0)
+        ret = data->backend->buildPool(data->conn, pool, data->flags);
+
+    storageDriverLock(data->driver);
+    virStoragePoolObjLock(pool);
+    storageDriverUnlock(data->driver);
+
+    pool->asyncjobs--;
+    if (ret == 0)
+        VIR_INFO("Built storage pool '%s'", pool->def->name);
+
+    virStoragePoolObjUnlock(pool);
+    return ret;
+}
+
+
+static int
+storagePoolBuild(virStoragePoolPtr obj,
+                 unsigned int flags) {
+    virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
+    virStoragePoolObjPtr pool;
+    virStorageBackendPtr backend;
+    virStoragePoolBuildJobDataPtr data = NULL;
+    virStorageJobPtr job;
+    int ret = -1;
 
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByUUID(&driver->pools, obj->uuid);
@@ -822,10 +1413,43 @@ storagePoolBuild(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    if (backend->buildPool &&
-        backend->buildPool(obj->conn, pool, flags) < 0)
+    if (pool->asyncjobs > 0) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("storage pool '%s' is already being built"),
+                       pool->def->name);
+        goto cleanup;
+    }
+
+    if (!backend->buildPool) {
+        ret = 0;
         goto cleanup;
-    ret = 0;
+    }
+
+    if (VIR_ALLOC(data) < 0)
+        goto cleanup;
+    data->conn = virObjectRef(obj->conn);
+    data->driver = driver;
+    data->backend = backend;
+    data->pool = pool;
+    data->flags = flags & ~VIR_STORAGE_POOL_BUILD_ASYNC;
+
+    if (!(job = virStorageJobNew(VIR_STORAGE_JOB_POOL_BUILD,
+                                 pool->def->name, pool->def->uuid, NULL,
+                                 storagePoolBuildJobRun, data,
+                                 storagePoolBuildJobDataFree))) {
+        storagePoolBuildJobDataFree(data);
+        goto cleanup;
+    }
+
+    /* Drop the pool lock while building, which may format whole disks;
+     * asyncjobs keeps the pool from being started, redefined or removed
+     * meanwhile */
+    pool->asyncjobs++;
+    virStoragePoolObjUnlock(pool);
+    pool = NULL;
+
+    ret = virStorageJobTableSubmit(storageJobs, job,
+                                   !!(flags & VIR_STORAGE_POOL_BUILD_ASYNC));
 
 cleanup:
     if (pool)
@@ -956,13 +1580,17 @@ storagePoolRefresh(virStoragePoolPtr obj,
 {
     virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
     virStoragePoolObjPtr pool;
+    virStoragePoolObjPtr shadow = NULL;
     virStorageBackendPtr backend;
+    bool driverLocked = false;
+    int refreshret;
     int ret = -1;
 
     virCheckFlags(0, -1);
 
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByUUID(&driver->pools, obj->uuid);
+    storageDriverUnlock(driver);
 
     if (!pool) {
         virReportError(VIR_ERR_NO_STORAGE_POOL,
@@ -989,25 +1617,58 @@ storagePoolRefresh(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    virStoragePoolObjClearVols(pool);
-    if (backend->refreshPool(obj->conn, pool) < 0) {
+    /* The backend refreshes a shadow copy of the pool with the pool
+     * lock dropped, so that lookups and read-only calls are not held
+     * up meanwhile. In incremental mode the backend updates the
+     * existing volume list instead of building one from scratch */
+    if (!(shadow = virStoragePoolObjNewShadow(pool,
+                                              pool->def->refreshMode ==
+                                              VIR_STORAGE_POOL_REFRESH_INCREMENTAL)))
+        goto cleanup;
+
+    /* Calls changing volumes wait on the refresh lock until the shadow
+     * is committed. Waiters only ever hold it for read briefly and
+     * without the pool lock, so taking it here cannot block for long */
+    virRWLockWrite(&pool->refreshLock);
+    pool->asyncjobs++;
+    pool->refreshing = true;
+    virStoragePoolObjUnlock(pool);
+
+    refreshret = backend->refreshPool(obj->conn, shadow);
+
+    storageDriverLock(driver);
+    driverLocked = true;
+    virStoragePoolObjLock(pool);
+
+    pool->asyncjobs--;
+    pool->refreshing = false;
+    virRWLockUnlock(&pool->refreshLock);
+
+    if (refreshret < 0) {
+        virStoragePoolObjFreeShadow(shadow);
+
         if (backend->stopPool)
             backend->stopPool(obj->conn, pool);
 
+        virStoragePoolObjClearVols(pool);
         pool->active = 0;
 
-        if (pool->configFile == NULL) {
+        /* A waiter for the refresh removes the pool once done */
+        if (pool->configFile == NULL && pool->asyncjobs == 0) {
             virStoragePoolObjRemove(&driver->pools, pool);
             pool = NULL;
         }
         goto cleanup;
     }
+
+    virStoragePoolObjCommitShadow(pool, shadow);
     ret = 0;
 
 cleanup:
     if (pool)
         virStoragePoolObjUnlock(pool);
-    storageDriverUnlock(driver);
+    if (driverLocked)
+        storageDriverUnlock(driver);
     return ret;
 }
 
@@ -1038,6 +1699,8 @@ storagePoolGetInfo(virStoragePoolPtr obj,
     memset(info, 0, sizeof(virStoragePoolInfo));
     if (pool->active)
         info->state = VIR_STORAGE_POOL_RUNNING;
+    else if (pool->asyncjobs > 0)
+        info->state = VIR_STORAGE_POOL_BUILDING;
     else
         info->state = VIR_STORAGE_POOL_INACTIVE;
     info->capacity = pool->def->capacity;
@@ -1503,7 +2166,6 @@ storageVolDelete(virStorageVolPtr obj,
     virStoragePoolObjPtr pool;
     virStorageBackendPtr backend;
     virStorageVolDefPtr vol = NULL;
-    size_t i;
     int ret = -1;
 
     storageDriverLock(driver);
@@ -1523,6 +2185,9 @@ storageVolDelete(virStorageVolPtr obj,
         goto cleanup;
     }
 
+    if (storagePoolObjWaitRefresh(driver, &pool) < 0)
+        goto cleanup;
+
     if ((backend = virStorageBackendForType(pool->def->type)) == NULL)
         goto cleanup;
 
@@ -1545,6 +2210,13 @@ storageVolDelete(virStorageVolPtr obj,
         goto cleanup;
     }
 
+    if (vol->in_use) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("volume '%s' is still in use."),
+                       vol->name);
+        goto cleanup;
+    }
+
     if (!backend->deleteVol) {
         virReportError(VIR_ERR_NO_SUPPORT,
                        "%s", _("storage pool does not support vol deletion"));
@@ -1559,16 +2231,10 @@ storageVolDelete(virStorageVolPtr obj,
     pool->def->allocation -= vol->allocation;
     pool->def->available += vol->allocation;
 
-    for (i = 0; i < pool->volumes.count; i++) {
-        if (pool->volumes.objs[i] == vol) {
-            VIR_INFO("Deleting volume '%s' from storage pool '%s'",
-                     vol->name, pool->def->name);
-            virStorageVolDefFree(vol);
-
-            VIR_DELETE_ELEMENT(pool->volumes.objs, i, pool->volumes.count);
-            break;
-        }
-    }
+    VIR_INFO("Deleting volume '%s' from storage pool '%s'",
+             vol->name, pool->def->name);
+    virStoragePoolObjRemoveVol(pool, vol);
+    virStorageVolDefFree(vol);
     ret = 0;
 
 cleanup:
@@ -1578,6 +2244,108 @@ cleanup:
 }
 
 
+typedef struct _virStorageVolBuildJobData virStorageVolBuildJobData;
+typedef virStorageVolBuildJobData *virStorageVolBuildJobDataPtr;
+struct _virStorageVolBuildJobData {
+    virConnectPtr conn;
+    virStorageDriverStatePtr driver;
+    virStorageBackendPtr backend;
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr voldef;
+    /* Shallow copy of @voldef with the requested values, NULL for clones */
+    virStorageVolDefPtr buildvoldef;
+    /* Source of a clone, and its pool when it differs from @pool */
+    virStoragePoolObjPtr origpool;
+    virStorageVolDefPtr origvol;
+    virStorageVolPtr volobj;
+    unsigned int flags;
+};
+
+
+static void
+storageVolBuildJobDataFree(void *opaque)
+{
+    virStorageVolBuildJobDataPtr data = opaque;
+
+    if (!data)
+        return;
+
+    virObjectUnref(data->conn);
+    virObjectUnref(data->volobj);
+    VIR_FREE(data->buildvoldef);
+    VIR_FREE(data);
+}
+
+
+/*
+ * Allocates a volume which is already listed in its pool with the
+ * building flag set, and the pools marked with an async job. Both the
+ * pool and the clone source are unlocked while the backend works.
+ * On failure the volume is deleted again.
+ */
+static int
+storageVolBuildJobRun(virStorageJobPtr job,
+                      void *opaque)
+{
+    virStorageVolBuildJobDataPtr data = opaque;
+    virStoragePoolObjPtr pool = data->pool;
+    virStorageVolDefPtr voldef = data->voldef;
+    unsigned long long allocation;
+    int buildret = -1;
+
+    if (virStorageJobCheckAborted(job) == 0) {
+        if (data->origvol)
+            buildret = data->backend->buildVolFrom(data->conn, pool, voldef,
+                                                   data->origvol, data->flags);
+        else
+            buildret = data->backend->buildVol(data->conn, pool,
+                                               data->buildvoldef, data->flags);
+    }
+
+    storageDriverLock(data->driver);
+    virStoragePoolObjLock(pool);
+    if (data->origpool)
+        virStoragePoolObjLock(data->origpool);
+    storageDriverUnlock(data->driver);
+
+    voldef->building = 0;
+    pool->asyncjobs--;
+    if (data->origvol)
+        data->origvol->in_use--;
+
+    if (data->origpool) {
+        data->origpool->asyncjobs--;
+        virStoragePoolObjUnlock(data->origpool);
+    }
+
+    if (buildret < 0) {
+        virErrorPtr orig_err = virSaveLastError();
+
+        virStoragePoolObjUnlock(pool);
+        storageVolDelete(data->volobj, 0);
+        if (orig_err) {
+            virSetError(orig_err);
+            virFreeError(orig_err);
+        }
+        return -1;
+    }
+
+    /* Update pool metadata */
+    if (data->buildvoldef)
+        allocation = data->buildvoldef->allocation;
+    else
+        allocation = voldef->allocation;
+    pool->def->allocation += allocation;
+    pool->def->available -= allocation;
+
+    VIR_INFO("Creating volume '%s' in storage pool '%s'",
+             data->volobj->name, pool->def->name);
+
+    virStoragePoolObjUnlock(pool);
+    return 0;
+}
+
+
 static virStorageVolPtr
 storageVolCreateXML(virStoragePoolPtr obj,
                     const char *xmldesc,
@@ -1589,8 +2357,11 @@ storageVolCreateXML(virStoragePoolPtr obj,
     virStorageVolDefPtr voldef = NULL;
     virStorageVolPtr ret = NULL, volobj = NULL;
     virStorageVolDefPtr buildvoldef = NULL;
+    virStorageVolBuildJobDataPtr data = NULL;
+    virStorageJobPtr job;
 
-    virCheckFlags(VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA, NULL);
+    virCheckFlags(VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA |
+                  VIR_STORAGE_VOL_CREATE_ASYNC, NULL);
 
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByUUID(&driver->pools, obj->uuid);
@@ -1608,6 +2379,9 @@ storageVolCreateXML(virStoragePoolPtr obj,
         goto cleanup;
     }
 
+    if (storagePoolObjWaitRefresh(driver, &pool) < 0)
+        goto cleanup;
+
     if ((backend = virStorageBackendForType(pool->def->type)) == NULL)
         goto cleanup;
 
@@ -1624,10 +2398,6 @@ storageVolCreateXML(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    if (VIR_REALLOC_N(pool->volumes.objs,
-                      pool->volumes.count+1) < 0)
-        goto cleanup;
-
     if (!backend->createVol) {
         virReportError(VIR_ERR_NO_SUPPORT,
                        "%s", _("storage pool does not support volume "
@@ -1642,11 +2412,12 @@ storageVolCreateXML(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    pool->volumes.objs[pool->volumes.count++] = voldef;
+    if (virStoragePoolObjAddVol(pool, voldef) < 0)
+        goto cleanup;
     volobj = virGetStorageVol(obj->conn, pool->def->name, voldef->name,
                               voldef->key, NULL, NULL);
     if (!volobj) {
-        pool->volumes.count--;
+        virStoragePoolObjRemoveVol(pool, voldef);
         goto cleanup;
     }
 
@@ -1662,31 +2433,45 @@ storageVolCreateXML(virStoragePoolPtr obj,
     memcpy(buildvoldef, voldef, sizeof(*voldef));
 
     if (backend->buildVol) {
-        int buildret;
-
-        /* Drop the pool lock during volume allocation */
-        pool->asyncjobs++;
-        voldef->building = 1;
-        virStoragePoolObjUnlock(pool);
-
-        buildret = backend->buildVol(obj->conn, pool, buildvoldef, flags);
-
-        storageDriverLock(driver);
-        virStoragePoolObjLock(pool);
-        storageDriverUnlock(driver);
-
-        voldef->building = 0;
-        pool->asyncjobs--;
-
+        if (VIR_ALLOC(data) < 0) {
+            voldef = NULL;
+            goto cleanup;
+        }
+        data->conn = virObjectRef(obj->conn);
+        data->driver = driver;
+        data->backend = backend;
+        data->pool = pool;
+        data->voldef = voldef;
+        data->buildvoldef = buildvoldef;
+        data->volobj = virObjectRef(volobj);
+        data->flags = flags & ~VIR_STORAGE_VOL_CREATE_ASYNC;
+        buildvoldef = NULL;
         voldef = NULL;
 
-        if (buildret < 0) {
+        if (!(job = virStorageJobNew(VIR_STORAGE_JOB_VOL_BUILD,
+                                     pool->def->name, pool->def->uuid,
+                                     volobj->name, storageVolBuildJobRun,
+                                     data, storageVolBuildJobDataFree))) {
+            storageVolBuildJobDataFree(data);
             virStoragePoolObjUnlock(pool);
             storageVolDelete(volobj, 0);
             pool = NULL;
             goto cleanup;
         }
 
+        /* Drop the pool lock during volume allocation */
+        pool->asyncjobs++;
+        data->voldef->building = 1;
+        virStoragePoolObjUnlock(pool);
+        pool = NULL;
+
+        if (virStorageJobTableSubmit(storageJobs, job,
+                                     !!(flags & VIR_STORAGE_VOL_CREATE_ASYNC)) < 0)
+            goto cleanup;
+
+        ret = volobj;
+        volobj = NULL;
+        goto cleanup;
     }
 
     /* Update pool metadata */
@@ -1719,11 +2504,13 @@ storageVolCreateXMLFrom(virStoragePoolPtr obj,
     virStorageBackendPtr backend;
     virStorageVolDefPtr origvol = NULL, newvol = NULL;
     virStorageVolPtr ret = NULL, volobj = NULL;
-    unsigned long long allocation;
-    int buildret;
+    virStorageVolBuildJobDataPtr data = NULL;
+    virStorageJobPtr job;
 
-    virCheckFlags(VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA, NULL);
+    virCheckFlags(VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA |
+                  VIR_STORAGE_VOL_CREATE_ASYNC, NULL);
 
+retry:
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByUUID(&driver->pools, obj->uuid);
     if (pool && STRNEQ(obj->name, vobj->pool)) {
@@ -1758,6 +2545,26 @@ storageVolCreateXMLFrom(virStoragePoolPtr obj,
         goto cleanup;
     }
 
+    /* Wait for a refresh of either pool with only that one locked,
+     * then look both up again */
+    if (pool->refreshing || (origpool && origpool->refreshing)) {
+        virStoragePoolObjPtr busy = pool->refreshing ? pool : origpool;
+        int waitret;
+
+        if (busy != pool)
+            virStoragePoolObjUnlock(pool);
+        else if (origpool)
+            virStoragePoolObjUnlock(origpool);
+        pool = origpool = NULL;
+
+        waitret = storagePoolObjWaitRefresh(driver, &busy);
+        if (busy)
+            virStoragePoolObjUnlock(busy);
+        if (waitret < 0)
+            goto cleanup;
+        goto retry;
+    }
+
     if ((backend = virStorageBackendForType(pool->def->type)) == NULL)
         goto cleanup;
 
@@ -1806,11 +2613,9 @@ storageVolCreateXMLFrom(virStoragePoolPtr obj,
     }
 
     if (backend->refreshVol &&
-        backend->refreshVol(obj->conn, pool, origvol) < 0)
-        goto cleanup;
-
-    if (VIR_REALLOC_N(pool->volumes.objs,
-                      pool->volumes.count+1) < 0)
+        (backend->refreshVol(obj->conn, pool, origvol) < 0 ||
+         virStoragePoolObjReindexVol(origpool ? origpool : pool,
+                                     origvol) < 0))
         goto cleanup;
 
     /* 'Define' the new volume so we get async progress reporting.
@@ -1821,58 +2626,70 @@ storageVolCreateXMLFrom(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    pool->volumes.objs[pool->volumes.count++] = newvol;
+    if (virStoragePoolObjAddVol(pool, newvol) < 0)
+        goto cleanup;
     volobj = virGetStorageVol(obj->conn, pool->def->name, newvol->name,
                               newvol->key, NULL, NULL);
     if (!volobj) {
-        pool->volumes.count--;
+        virStoragePoolObjRemoveVol(pool, newvol);
         goto cleanup;
     }
 
-    /* Drop the pool lock during volume allocation */
-    pool->asyncjobs++;
-    origvol->building = 1;
-    newvol->building = 1;
-    virStoragePoolObjUnlock(pool);
-
-    if (origpool) {
-        origpool->asyncjobs++;
-        virStoragePoolObjUnlock(origpool);
+    if (VIR_ALLOC(data) < 0) {
+        newvol = NULL;
+        virStoragePoolObjUnlock(pool);
+        pool = NULL;
+        if (origpool) {
+            virStoragePoolObjUnlock(origpool);
+            origpool = NULL;
+        }
+        storageVolDelete(volobj, 0);
+        goto cleanup;
     }
+    data->conn = virObjectRef(obj->conn);
+    data->driver = driver;
+    data->backend = backend;
+    data->pool = pool;
+    data->voldef = newvol;
+    data->origpool = origpool;
+    data->origvol = origvol;
+    data->volobj = virObjectRef(volobj);
+    data->flags = flags & ~VIR_STORAGE_VOL_CREATE_ASYNC;
+    newvol = NULL;
 
-    buildret = backend->buildVolFrom(obj->conn, pool, newvol, origvol, flags);
-
-    storageDriverLock(driver);
-    virStoragePoolObjLock(pool);
-    if (origpool)
-        virStoragePoolObjLock(origpool);
-    storageDriverUnlock(driver);
+    if (!(job = virStorageJobNew(VIR_STORAGE_JOB_VOL_CLONE,
+                                 pool->def->name, pool->def->uuid,
+                                 volobj->name, storageVolBuildJobRun,
+                                 data, storageVolBuildJobDataFree))) {
+        storageVolBuildJobDataFree(data);
+        virStoragePoolObjUnlock(pool);
+        pool = NULL;
+        if (origpool) {
+            virStoragePoolObjUnlock(origpool);
+            origpool = NULL;
+        }
+        storageVolDelete(volobj, 0);
+        goto cleanup;
+    }
 
-    origvol->building = 0;
-    newvol->building = 0;
-    allocation = newvol->allocation;
-    newvol = NULL;
-    pool->asyncjobs--;
+    /* Drop the pool lock during volume allocation. The source only has
+     * to stay around, so any number of clones may read it at once */
+    pool->asyncjobs++;
+    origvol->in_use++;
+    data->voldef->building = 1;
+    virStoragePoolObjUnlock(pool);
+    pool = NULL;
 
     if (origpool) {
-        origpool->asyncjobs--;
+        origpool->asyncjobs++;
         virStoragePoolObjUnlock(origpool);
         origpool = NULL;
     }
 
-    if (buildret < 0) {
-        virStoragePoolObjUnlock(pool);
-        storageVolDelete(volobj, 0);
-        pool = NULL;
+    if (virStorageJobTableSubmit(storageJobs, job,
+                                 !!(flags & VIR_STORAGE_VOL_CREATE_ASYNC)) < 0)
         goto cleanup;
-    }
 
-    /* Updating pool metadata */
-    pool->def->allocation += allocation;
-    pool->def->available -= allocation;
-
-    VIR_INFO("Creating volume '%s' in storage pool '%s'",
-             volobj->name, pool->def->name);
     ret = volobj;
     volobj = NULL;
 
@@ -1895,11 +2712,12 @@ storageVolDownload(virStorageVolPtr obj,
                    unsigned int flags)
 {
     virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
+    virStorageBackendPtr backend;
     virStoragePoolObjPtr pool = NULL;
     virStorageVolDefPtr vol = NULL;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM, -1);
 
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByName(&driver->pools, obj->pool);
@@ -1918,6 +2736,9 @@ storageVolDownload(virStorageVolPtr obj,
         goto out;
     }
 
+    if (storagePoolObjWaitRefresh(driver, &pool) < 0)
+        goto out;
+
     vol = virStorageVolDefFindByName(pool, obj->name);
 
     if (vol == NULL) {
@@ -1937,12 +2758,26 @@ storageVolDownload(virStorageVolPtr obj,
         goto out;
     }
 
-    if (virFDStreamOpenFile(stream,
-                            vol->target.path,
-                            offset, length,
-                            O_RDONLY) < 0)
+    if (!(backend = virStorageBackendForType(pool->def->type)))
         goto out;
 
+    if (backend->downloadVol) {
+        if (backend->downloadVol(obj->conn, pool, vol, stream,
+                                 offset, length, flags) < 0)
+            goto out;
+    } else if (flags & VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM) {
+        if (virFDStreamOpenSparseFile(stream,
+                                      vol->target.path,
+                                      offset, length,
+                                      O_RDONLY) < 0)
+            goto out;
+    } else if (virFDStreamOpenFile(stream,
+                                   vol->target.path,
+                                   offset, length,
+                                   O_RDONLY) < 0) {
+        goto out;
+    }
+
     ret = 0;
 
 out:
@@ -1961,11 +2796,12 @@ storageVolUpload(virStorageVolPtr obj,
                  unsigned int flags)
 {
     virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
+    virStorageBackendPtr backend;
     virStoragePoolObjPtr pool = NULL;
     virStorageVolDefPtr vol = NULL;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM, -1);
 
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByName(&driver->pools, obj->pool);
@@ -1984,6 +2820,9 @@ storageVolUpload(virStorageVolPtr obj,
         goto out;
     }
 
+    if (storagePoolObjWaitRefresh(driver, &pool) < 0)
+        goto out;
+
     vol = virStorageVolDefFindByName(pool, obj->name);
 
     if (vol == NULL) {
@@ -2003,13 +2842,34 @@ storageVolUpload(virStorageVolPtr obj,
         goto out;
     }
 
+    if (vol->in_use) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("volume '%s' is still in use."),
+                       vol->name);
+        goto out;
+    }
+
+    if (!(backend = virStorageBackendForType(pool->def->type)))
+        goto out;
+
     /* Not using O_CREAT because the file is required to
      * already exist at this point */
-    if (virFDStreamOpenFile(stream,
-                            vol->target.path,
-                            offset, length,
-                            O_WRONLY) < 0)
+    if (backend->uploadVol) {
+        if (backend->uploadVol(obj->conn, pool, vol, stream,
+                               offset, length, flags) < 0)
+            goto out;
+    } else if (flags & VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM) {
+        if (virFDStreamOpenSparseFile(stream,
+                                      vol->target.path,
+                                      offset, length,
+                                      O_WRONLY) < 0)
+            goto out;
+    } else if (virFDStreamOpenFile(stream,
+                                   vol->target.path,
+                                   offset, length,
+                                   O_WRONLY) < 0) {
         goto out;
+    }
 
     ret = 0;
 
@@ -2075,6 +2935,13 @@ storageVolResize(virStorageVolPtr obj,
         goto out;
     }
 
+    if (vol->in_use) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("volume '%s' is still in use."),
+                       vol->name);
+        goto out;
+    }
+
     if (flags & VIR_STORAGE_VOL_RESIZE_DELTA) {
         abs_capacity = vol->capacity + capacity;
         flags &= ~VIR_STORAGE_VOL_RESIZE_DELTA;
@@ -2173,46 +3040,272 @@ out:
 }
 
 
+typedef struct _virStorageWipeState virStorageWipeState;
+typedef virStorageWipeState *virStorageWipeStatePtr;
+struct _virStorageWipeState {
+    virMutex lock;
+
+    virStorageVolDefPtr vol;
+    virStorageJobPtr job;   /* job reporting the progress, or NULL */
+    int fd;
+    int directfd;           /* opened with O_DIRECT, or -1 */
+
+    off_t next;             /* start of the next chunk to hand out */
+    off_t end;
+
+    unsigned long long total;
+    unsigned long long wiped;
+    int err;                /* errno of the first failure */
+    off_t erroff;
+};
+
+
+static void
+storageWipeProgress(virStorageWipeStatePtr state,
+                    unsigned long long bytes)
+{
+    unsigned long long before = state->wiped;
+
+    state->wiped += bytes;
+    virStorageJobAddProcessed(state->job, bytes);
+
+    /* Log every 10% */
+    if (state->total &&
+        before * 10 / state->total != state->wiped * 10 / state->total)
+        VIR_INFO("Wiped %llu of %llu bytes of volume '%s'",
+                 state->wiped, state->total, state->vol->target.path);
+}
+
+
+/*
+ * Let the kernel zero [start, start + length): BLKZEROOUT for block
+ * devices, which the device may implement with WRITE SAME or unmap, and
+ * FALLOC_FL_ZERO_RANGE (or a punched hole that is allocated again) for
+ * files. BLKDISCARD is deliberately not used, since discarded blocks
+ * are not guaranteed to read back as zeros. Returns 0 on success, 1 if
+ * no such method is available and the data has to be written, or -1 on
+ * error.
+ */
 static int
+storageWipeExtentOffload(virStorageWipeStatePtr state,
+                         bool isblock,
+                         off_t start,
+                         off_t length)
+{
+    off_t offset = start;
+
+    while (offset < start + length) {
+        off_t len = MIN(start + length - offset, STORAGE_WIPE_OFFLOAD_SIZE);
+
+        if (virStorageJobCheckAborted(state->job) < 0)
+            return -1;
+
+        if (isblock) {
+#if defined(__linux__) && defined(BLKZEROOUT)
+            uint64_t range[2] = { offset, len };
+
+            if (ioctl(state->fd, BLKZEROOUT, range) < 0)
+                goto unsupported;
+#else
+            errno = ENOSYS;
+            goto unsupported;
+#endif
+        } else {
+#if HAVE_FALLOCATE - 0 && defined(FALLOC_FL_ZERO_RANGE)
+            if (fallocate(state->fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE,
+                          offset, len) < 0) {
+# ifdef FALLOC_FL_PUNCH_HOLE
+                if (errno != EOPNOTSUPP ||
+                    fallocate(state->fd,
+                              FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                              offset, len) < 0 ||
+                    fallocate(state->fd, FALLOC_FL_KEEP_SIZE,
+                              offset, len) < 0)
+# endif
+                    goto unsupported;
+            }
+#else
+            errno = ENOSYS;
+            goto unsupported;
+#endif
+        }
+
+        offset += len;
+        storageWipeProgress(state, len);
+    }
+
+    return 0;
+
+ unsupported:
+    if (offset == start &&
+        (errno == EOPNOTSUPP || errno == ENOTTY || errno == EINVAL ||
+         errno == ENOSYS)) {
+        VIR_DEBUG("Zeroing offload not available for '%s': %d",
+                  state->vol->target.path, errno);
+        return 1;
+    }
+
+    virReportSystemError(errno,
+                         _("Failed to zero %ju bytes at offset %ju of "
+                           "storage volume with path '%s'"),
+                         (uintmax_t)(start + length - offset),
+                         (uintmax_t)offset, state->vol->target.path);
+    return -1;
+}
+
+
+static void
+storageWipeWriter(void *opaque)
+{
+    virStorageWipeStatePtr state = opaque;
+    void *buf = NULL;
+    bool direct = state->directfd >= 0;
+    int err = 0;
+    off_t offset = 0;
+
+    if ((err = posix_memalign(&buf, STORAGE_WIPE_ALIGN,
+                              STORAGE_WIPE_BUF_SIZE)) != 0)
+        goto cleanup;
+    memset(buf, 0, STORAGE_WIPE_BUF_SIZE);
+
+    while (true) {
+        off_t end;
+
+        virMutexLock(&state->lock);
+        if (state->err || state->next >= state->end) {
+            virMutexUnlock(&state->lock);
+            break;
+        }
+        offset = state->next;
+        end = MIN(offset + STORAGE_WIPE_CHUNK_SIZE, state->end);
+        state->next = end;
+        virMutexUnlock(&state->lock);
+
+        while (offset < end) {
+            size_t len = MIN(end - offset, STORAGE_WIPE_BUF_SIZE);
+            /* O_DIRECT needs aligned offsets and lengths; the tail of the
+             * volume goes through the page cache */
+            bool aligned = direct &&
+                offset % STORAGE_WIPE_ALIGN == 0 &&
+                len % STORAGE_WIPE_ALIGN == 0;
+            ssize_t written;
+
+            if (virStorageJobIsAborted(state->job)) {
+                err = ECANCELED;
+                goto cleanup;
+            }
+
+            written = pwrite(aligned ? state->directfd : state->fd,
+                             buf, len, offset);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (aligned && errno == EINVAL) {
+                    direct = false;
+                    continue;
+                }
+                err = errno;
+                goto cleanup;
+            }
+            if (written == 0) {
+                err = ENOSPC;
+                goto cleanup;
+            }
+            offset += written;
+
+            virMutexLock(&state->lock);
+            storageWipeProgress(state, written);
+            virMutexUnlock(&state->lock);
+        }
+    }
+
+ cleanup:
+    if (err) {
+        virMutexLock(&state->lock);
+        if (!state->err) {
+            state->err = err;
+            state->erroff = offset;
+        }
+        virMutexUnlock(&state->lock);
+    }
+    free(buf);
+}
+
+
+int
 storageWipeExtent(virStorageVolDefPtr vol,
                   int fd,
+                  bool isblock,
                   off_t extent_start,
                   off_t extent_length,
-                  char *writebuf,
-                  size_t writebuf_length,
-                  size_t *bytes_wiped)
+                  unsigned long long *bytes_wiped)
 {
-    int ret = -1, written = 0;
-    off_t remaining = 0;
-    size_t write_size = 0;
+    int ret = -1;
+    virStorageWipeState state;
+    virThread writers[STORAGE_WIPE_WRITERS];
+    size_t nwriters = 0;
+    size_t maxwriters;
+    size_t i;
+    int rc;
 
     VIR_DEBUG("extent logical start: %ju len: %ju",
               (uintmax_t)extent_start, (uintmax_t)extent_length);
 
-    if ((ret = lseek(fd, extent_start, SEEK_SET)) < 0) {
-        virReportSystemError(errno,
-                             _("Failed to seek to position %ju in volume "
-                               "with path '%s'"),
-                             (uintmax_t)extent_start, vol->target.path);
-        goto out;
+    memset(&state, 0, sizeof(state));
+    state.vol = vol;
+    state.job = virStorageJobGetCurrent();
+    state.fd = fd;
+    state.directfd = -1;
+    state.next = extent_start;
+    state.end = extent_start + extent_length;
+    state.total = extent_length;
+    virStorageJobSetTotal(state.job, extent_length);
+
+    if (virMutexInit(&state.lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize mutex"));
+        return -1;
     }
 
-    remaining = extent_length;
-    while (remaining > 0) {
+    if ((rc = storageWipeExtentOffload(&state, isblock,
+                                       extent_start, extent_length)) < 0)
+        goto out;
+
+    if (rc > 0) {
+        if (O_DIRECT &&
+            (state.directfd = open(vol->target.path,
+                                   O_WRONLY | O_DIRECT)) < 0)
+            VIR_DEBUG("Cannot open '%s' with O_DIRECT: %d",
+                      vol->target.path, errno);
+
+        maxwriters = MIN(STORAGE_WIPE_WRITERS,
+                         (extent_length + STORAGE_WIPE_CHUNK_SIZE - 1) /
+                         STORAGE_WIPE_CHUNK_SIZE);
+        for (i = 0; i < maxwriters; i++) {
+            if (virThreadCreate(&writers[nwriters], true,
+                                storageWipeWriter, &state) < 0) {
+                VIR_WARN("Unable to start wipe writer thread: %d", errno);
+                break;
+            }
+            nwriters++;
+        }
+
+        if (nwriters == 0)
+            storageWipeWriter(&state);
+        for (i = 0; i < nwriters; i++)
+            virThreadJoin(&writers[i]);
 
-        write_size = (writebuf_length < remaining) ? writebuf_length : remaining;
-        written = safewrite(fd, writebuf, write_size);
-        if (written < 0) {
-            virReportSystemError(errno,
-                                 _("Failed to write %zu bytes to "
-                                   "storage volume with path '%s'"),
-                                 write_size, vol->target.path);
+        if (state.err == ECANCELED &&
+            virStorageJobCheckAborted(state.job) < 0)
+            goto out;
 
+        if (state.err) {
+            virReportSystemError(state.err,
+                                 _("Failed to write to storage volume with "
+                                   "path '%s' at offset %ju"),
+                                 vol->target.path, (uintmax_t)state.erroff);
             goto out;
         }
-
-        *bytes_wiped += written;
-        remaining -= written;
     }
 
     if (fdatasync(fd) < 0) {
@@ -2223,12 +3316,15 @@ storageWipeExtent(virStorageVolDefPtr vol,
         goto out;
     }
 
-    VIR_DEBUG("Wrote %zu bytes to volume with path '%s'",
-              *bytes_wiped, vol->target.path);
+    VIR_DEBUG("Wiped %llu bytes of volume with path '%s'",
+              state.wiped, vol->target.path);
 
     ret = 0;
 
 out:
+    *bytes_wiped += state.wiped;
+    VIR_FORCE_CLOSE(state.directfd);
+    virMutexDestroy(&state.lock);
     return ret;
 }
 
@@ -2239,8 +3335,9 @@ storageVolWipeInternal(virStorageVolDefPtr def,
 {
     int ret = -1, fd = -1;
     struct stat st;
-    char *writebuf = NULL;
-    size_t bytes_wiped = 0;
+    unsigned long long bytes_wiped = 0;
+    unsigned long long then = 0;
+    unsigned long long now = 0;
     virCommandPtr cmd = NULL;
 
     VIR_DEBUG("Wiping volume with path '%s' and algorithm %u",
@@ -2306,28 +3403,67 @@ storageVolWipeInternal(virStorageVolDefPtr def,
         if (S_ISREG(st.st_mode) && st.st_blocks < (st.st_size / DEV_BSIZE)) {
             ret = storageVolZeroSparseFile(def, st.st_size, fd);
         } else {
-
-            if (VIR_ALLOC_N(writebuf, st.st_blksize) < 0)
-                goto out;
-
+            ignore_value(virTimeMillisNow(&then));
             ret = storageWipeExtent(def,
                                     fd,
+                                    S_ISBLK(st.st_mode),
                                     0,
                                     def->allocation,
-                                    writebuf,
-                                    st.st_blksize,
                                     &bytes_wiped);
+            ignore_value(virTimeMillisNow(&now));
+            VIR_INFO("Zeroed %llu bytes of volume '%s' in %llu ms",
+                     bytes_wiped, def->target.path, now - then);
         }
     }
 
 out:
     virCommandFree(cmd);
-    VIR_FREE(writebuf);
     VIR_FORCE_CLOSE(fd);
     return ret;
 }
 
 
+typedef struct _virStorageVolWipeJobData virStorageVolWipeJobData;
+typedef virStorageVolWipeJobData *virStorageVolWipeJobDataPtr;
+struct _virStorageVolWipeJobData {
+    virStorageDriverStatePtr driver;
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr vol;
+    unsigned int algorithm;
+};
+
+
+static void
+storageVolWipeJobDataFree(void *opaque)
+{
+    virStorageVolWipeJobDataPtr data = opaque;
+
+    VIR_FREE(data);
+}
+
+
+static int
+storageVolWipeJobRun(virStorageJobPtr job,
+                     void *opaque)
+{
+    virStorageVolWipeJobDataPtr data = opaque;
+    int ret = -1;
+
+    if (virStorageJobCheckAborted(job) == 0)
+        ret = storageVolWipeInternal(data->vol, data->algorithm);
+
+    storageDriverLock(data->driver);
+    virStoragePoolObjLock(data->pool);
+    storageDriverUnlock(data->driver);
+
+    data->vol->building = 0;
+    data->pool->asyncjobs--;
+
+    virStoragePoolObjUnlock(data->pool);
+    return ret;
+}
+
+
 static int
 storageVolWipePattern(virStorageVolPtr obj,
                       unsigned int algorithm,
@@ -2336,9 +3472,11 @@ storageVolWipePattern(virStorageVolPtr obj,
     virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
     virStoragePoolObjPtr pool = NULL;
     virStorageVolDefPtr vol = NULL;
+    virStorageVolWipeJobDataPtr data = NULL;
+    virStorageJobPtr job;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_STORAGE_VOL_WIPE_ASYNC, -1);
 
     if (algorithm >= VIR_STORAGE_VOL_WIPE_ALG_LAST) {
         virReportError(VIR_ERR_INVALID_ARG,
@@ -2364,6 +3502,9 @@ storageVolWipePattern(virStorageVolPtr obj,
         goto out;
     }
 
+    if (storagePoolObjWaitRefresh(driver, &pool) < 0)
+        goto out;
+
     vol = virStorageVolDefFindByName(pool, obj->name);
 
     if (vol == NULL) {
@@ -2383,11 +3524,38 @@ storageVolWipePattern(virStorageVolPtr obj,
         goto out;
     }
 
-    if (storageVolWipeInternal(vol, algorithm) == -1) {
+    if (vol->in_use) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("volume '%s' is still in use."),
+                       vol->name);
         goto out;
     }
 
-    ret = 0;
+    if (VIR_ALLOC(data) < 0)
+        goto out;
+    data->driver = driver;
+    data->pool = pool;
+    data->vol = vol;
+    data->algorithm = algorithm;
+
+    if (!(job = virStorageJobNew(VIR_STORAGE_JOB_VOL_WIPE,
+                                 pool->def->name, pool->def->uuid, vol->name,
+                                 storageVolWipeJobRun, data,
+                                 storageVolWipeJobDataFree))) {
+        VIR_FREE(data);
+        goto out;
+    }
+
+    /* Drop the pool lock while wiping, which can take hours for a big
+     * volume; marking the volume as building keeps it from being
+     * deleted or used as a clone source meanwhile */
+    pool->asyncjobs++;
+    vol->building = 1;
+    virStoragePoolObjUnlock(pool);
+    pool = NULL;
+
+    ret = virStorageJobTableSubmit(storageJobs, job,
+                                   !!(flags & VIR_STORAGE_VOL_WIPE_ASYNC));
 
 out:
     if (pool) {
@@ -2448,7 +3616,8 @@ storageVolGetInfo(virStorageVolPtr obj,
         goto cleanup;
 
     if (backend->refreshVol &&
-        backend->refreshVol(obj->conn, pool, vol) < 0)
+        (backend->refreshVol(obj->conn, pool, vol) < 0 ||
+         virStoragePoolObjReindexVol(pool, vol) < 0))
         goto cleanup;
 
     memset(info, 0, sizeof(*info));
@@ -2508,7 +3677,8 @@ storageVolGetXMLDesc(virStorageVolPtr obj,
         goto cleanup;
 
     if (backend->refreshVol &&
-        backend->refreshVol(obj->conn, pool, vol) < 0)
+        (backend->refreshVol(obj->conn, pool, vol) < 0 ||
+         virStoragePoolObjReindexVol(pool, vol) < 0))
         goto cleanup;
 
     ret = virStorageVolDefFormat(pool->def, vol);
@@ -2586,6 +3756,177 @@ cleanup:
 }
 
 
+static virStoragePoolObjPtr
+storageVolJobPoolLookup(virStorageVolPtr obj)
+{
+    virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
+    virStoragePoolObjPtr pool;
+
+    storageDriverLock(driver);
+    pool = virStoragePoolObjFindByName(&driver->pools, obj->pool);
+    storageDriverUnlock(driver);
+    if (!pool) {
+        virReportError(VIR_ERR_NO_STORAGE_POOL,
+                       _("no storage pool with matching name '%s'"),
+                       obj->pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+
+static int
+storageVolGetJobStats(virStorageVolPtr obj,
+                      int *type,
+                      virTypedParameterPtr *params,
+                      int *nparams,
+                      unsigned int flags)
+{
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr vol;
+    virStorageJobInfo info;
+    virTypedParameterPtr par = NULL;
+    int maxpar = 0;
+    int npar = 0;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!(pool = storageVolJobPoolLookup(obj)))
+        return -1;
+
+    if (!(vol = virStorageVolDefFindByName(pool, obj->name))) {
+        virReportError(VIR_ERR_NO_STORAGE_VOL,
+                       _("no storage vol with matching name '%s'"),
+                       obj->name);
+        goto cleanup;
+    }
+
+    if (virStorageVolGetJobStatsEnsureACL(obj->conn, pool->def, vol) < 0)
+        goto cleanup;
+
+    if (virStorageJobTableGetInfo(storageJobs, obj->pool, obj->name,
+                                  &info) == 0) {
+        *type = VIR_STORAGE_JOB_NONE;
+        *params = NULL;
+        *nparams = 0;
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (virTypedParamsAddUInt(&par, &npar, &maxpar,
+                              VIR_STORAGE_JOB_ID, info.id) < 0 ||
+        virTypedParamsAddInt(&par, &npar, &maxpar,
+                             VIR_STORAGE_JOB_STATE, info.state) < 0 ||
+        virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                VIR_STORAGE_JOB_TIME_ELAPSED,
+                                info.elapsed) < 0 ||
+        virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                VIR_STORAGE_JOB_DATA_PROCESSED,
+                                info.processed) < 0)
+        goto cleanup;
+
+    if (info.total &&
+        (virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                 VIR_STORAGE_JOB_DATA_TOTAL,
+                                 info.total) < 0 ||
+         virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                 VIR_STORAGE_JOB_DATA_REMAINING,
+                                 info.total > info.processed ?
+                                 info.total - info.processed : 0) < 0))
+        goto cleanup;
+
+    *type = info.type;
+    *params = par;
+    *nparams = npar;
+    par = NULL;
+    ret = 0;
+
+cleanup:
+    virTypedParamsFree(par, npar);
+    virStoragePoolObjUnlock(pool);
+    return ret;
+}
+
+
+static int
+storageVolAbortJob(virStorageVolPtr obj,
+                   unsigned int flags)
+{
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr vol;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!(pool = storageVolJobPoolLookup(obj)))
+        return -1;
+
+    if (!(vol = virStorageVolDefFindByName(pool, obj->name))) {
+        virReportError(VIR_ERR_NO_STORAGE_VOL,
+                       _("no storage vol with matching name '%s'"),
+                       obj->name);
+        goto cleanup;
+    }
+
+    if (virStorageVolAbortJobEnsureACL(obj->conn, pool->def, vol) < 0)
+        goto cleanup;
+
+    ret = virStorageJobTableAbort(storageJobs, obj->pool, obj->name);
+
+cleanup:
+    virStoragePoolObjUnlock(pool);
+    return ret;
+}
+
+
+static int
+storageConnectStoragePoolEventRegisterAny(virConnectPtr conn,
+                                          virStoragePoolPtr pool,
+                                          int eventID,
+                                          virConnectStoragePoolEventGenericCallback callback,
+                                          void *opaque,
+                                          virFreeCallback freecb)
+{
+    virStorageDriverStatePtr driver = conn->storagePrivateData;
+    int ret = -1;
+
+    if (virConnectStoragePoolEventRegisterAnyEnsureACL(conn) < 0)
+        goto cleanup;
+
+    if (virStoragePoolEventStateRegisterID(conn, driver->storageEventState,
+                                           pool, eventID, callback,
+                                           opaque, freecb, &ret) < 0)
+        ret = -1;
+
+cleanup:
+    return ret;
+}
+
+
+static int
+storageConnectStoragePoolEventDeregisterAny(virConnectPtr conn,
+                                            int callbackID)
+{
+    virStorageDriverStatePtr driver = conn->storagePrivateData;
+    int ret = -1;
+
+    if (virConnectStoragePoolEventDeregisterAnyEnsureACL(conn) < 0)
+        goto cleanup;
+
+    if (virObjectEventStateDeregisterID(conn,
+                                        driver->storageEventState,
+                                        callbackID) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    return ret;
+}
+
+
 static virStorageDriver storageDriver = {
     .name = "storage",
     .storageOpen = storageOpen, /* 0.4.0 */
@@ -2596,6 +3937,8 @@ static virStorageDriver storageDriver = {
     .connectListDefinedStoragePools = storageConnectListDefinedStoragePools, /* 0.4.0 */
     .connectListAllStoragePools = storageConnectListAllStoragePools, /* 0.10.2 */
     .connectFindStoragePoolSources = storageConnectFindStoragePoolSources, /* 0.4.0 */
+    .connectStoragePoolEventRegisterAny = storageConnectStoragePoolEventRegisterAny, /* 1.2.3 */
+    .connectStoragePoolEventDeregisterAny = storageConnectStoragePoolEventDeregisterAny, /* 1.2.3 */
     .storagePoolLookupByName = storagePoolLookupByName, /* 0.4.0 */
     .storagePoolLookupByUUID = storagePoolLookupByUUID, /* 0.4.0 */
     .storagePoolLookupByVolume = storagePoolLookupByVolume, /* 0.4.0 */
@@ -2629,6 +3972,8 @@ static virStorageDriver storageDriver = {
     .storageVolGetXMLDesc = storageVolGetXMLDesc, /* 0.4.0 */
     .storageVolGetPath = storageVolGetPath, /* 0.4.0 */
     .storageVolResize = storageVolResize, /* 0.9.10 */
+    .storageVolGetJobStats = storageVolGetJobStats, /* 1.2.3 */
+    .storageVolAbortJob = storageVolAbortJob, /* 1.2.3 */
 
     .storagePoolIsActive = storagePoolIsActive, /* 0.7.3 */
     .storagePoolIsPersistent = storagePoolIsPersistent, /* 0.7.3 */
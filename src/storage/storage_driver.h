@@ -56,6 +56,25 @@ int virStorageFileUnlink(virStorageFilePtr file);
 int virStorageFileStat(virStorageFilePtr file,
                        struct stat *stat);
 
+/* The zero fill fallback of storageWipeExtent splits the volume into
+ * chunks of STORAGE_WIPE_CHUNK_SIZE which are handed out to up to
+ * STORAGE_WIPE_WRITERS threads, each writing from an aligned buffer
+ * (suitable for O_DIRECT) of STORAGE_WIPE_BUF_SIZE bytes. */
+# define STORAGE_WIPE_WRITERS     4
+# define STORAGE_WIPE_CHUNK_SIZE  (64 * 1024 * 1024)
+# define STORAGE_WIPE_BUF_SIZE    (4 * 1024 * 1024)
+# define STORAGE_WIPE_ALIGN       (64 * 1024)
+/* Largest range zeroed by a single BLKZEROOUT/fallocate call */
+# define STORAGE_WIPE_OFFLOAD_SIZE (1024 * 1024 * 1024)
+
+int storageWipeExtent(virStorageVolDefPtr vol,
+                      int fd,
+                      bool isblock,
+                      off_t extent_start,
+                      off_t extent_length,
+                      unsigned long long *bytes_wiped)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(6);
+
 int storageRegister(void);
 
 #endif /* __VIR_STORAGE_DRIVER_H__ */
@@ -0,0 +1,666 @@
+/*
+ * storage_job.c: background jobs of the storage driver
+ *
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "storage_job.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "viridentity.h"
+#include "virlog.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "virthreadpool.h"
+#include "virtime.h"
+#include "viruuid.h"
+
+#define VIR_FROM_THIS VIR_FROM_STORAGE
+
+/*
+ * Long running storage operations (volume allocation, clone and wipe,
+ * pool build) are handed to a table of jobs rather than being run by
+ * the RPC worker which received the request. Jobs of the same pool are
+ * run in submission order with at most 'perPool' of them at a time;
+ * the others wait in the table as VIR_STORAGE_JOB_STATE_QUEUED. A
+ * worker which finishes a job directly picks up the next queued job of
+ * the same pool, so a queued job never waits for a free thread.
+ *
+ * All fields of the jobs in the table are protected by the table lock.
+ */
+
+struct _virStorageJob {
+    virStorageJobTablePtr table;
+
+    unsigned int id;
+    int type;                   /* virStorageJobType */
+    int state;                  /* virStorageJobState */
+    char *pool;
+    unsigned char pooluuid[VIR_UUID_BUFLEN];
+    char *vol;
+
+    bool async;                 /* nobody waits for the job to finish */
+    bool aborted;
+    bool done;                  /* result ready for a synchronous submitter */
+
+    unsigned long long submitted;
+    unsigned long long total;
+    unsigned long long processed;
+
+    virIdentityPtr identity;
+    virStorageJobRunFunc run;
+    void *opaque;
+    virFreeCallback freeOpaque;
+
+    int ret;
+    virErrorPtr err;
+};
+
+struct _virStorageJobTable {
+    virMutex lock;
+    virCond cond;               /* broadcast whenever a job finishes */
+
+    virThreadPoolPtr workers;
+    size_t perPool;
+    virStorageJobNotifyFunc notify;
+    void *opaque;
+
+    unsigned int lastID;
+    bool quit;
+
+    /* Queued and running jobs, in submission order */
+    virStorageJobPtr *jobs;
+    size_t njobs;
+};
+
+static virThreadLocal virStorageJobCurrent;
+
+static int
+virStorageJobOnceInit(void)
+{
+    if (virThreadLocalInit(&virStorageJobCurrent, NULL) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize thread local variable"));
+        return -1;
+    }
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageJob)
+
+
+virStorageJobPtr
+virStorageJobNew(int type,
+                 const char *pool,
+                 const unsigned char *pooluuid,
+                 const char *vol,
+                 virStorageJobRunFunc run,
+                 void *opaque,
+                 virFreeCallback freeOpaque)
+{
+    virStorageJobPtr job;
+
+    if (VIR_ALLOC(job) < 0)
+        return NULL;
+
+    if (VIR_STRDUP(job->pool, pool) < 0 ||
+        VIR_STRDUP(job->vol, vol) < 0) {
+        VIR_FREE(job->pool);
+        VIR_FREE(job);
+        return NULL;
+    }
+
+    memcpy(job->pooluuid, pooluuid, VIR_UUID_BUFLEN);
+    job->type = type;
+    job->state = VIR_STORAGE_JOB_STATE_QUEUED;
+    job->run = run;
+    job->opaque = opaque;
+    job->freeOpaque = freeOpaque;
+
+    return job;
+}
+
+
+void
+virStorageJobFree(virStorageJobPtr job)
+{
+    if (!job)
+        return;
+
+    if (job->freeOpaque)
+        job->freeOpaque(job->opaque);
+    virObjectUnref(job->identity);
+    virFreeError(job->err);
+    VIR_FREE(job->pool);
+    VIR_FREE(job->vol);
+    VIR_FREE(job);
+}
+
+
+static void
+virStorageJobRun(virStorageJobPtr job)
+{
+    int ret;
+
+    ignore_value(virThreadLocalSet(&virStorageJobCurrent, job));
+    if (job->identity)
+        ignore_value(virIdentitySetCurrent(job->identity));
+
+    VIR_DEBUG("Running storage job %u of type %d in pool '%s'",
+              job->id, job->type, job->pool);
+
+    if ((ret = job->run(job, job->opaque)) < 0)
+        job->err = virSaveLastError();
+    job->ret = ret;
+
+    virResetLastError();
+    ignore_value(virIdentitySetCurrent(NULL));
+    ignore_value(virThreadLocalSet(&virStorageJobCurrent, NULL));
+}
+
+
+/* Must be called with the table lock held. Removes @job from the table
+ * and returns the next queued job of its pool, now marked as running,
+ * if there is one. */
+static virStorageJobPtr
+virStorageJobTableFinish(virStorageJobTablePtr table,
+                         virStorageJobPtr job)
+{
+    size_t i;
+
+    if (job->ret == 0)
+        job->state = VIR_STORAGE_JOB_STATE_COMPLETED;
+    else if (job->aborted)
+        job->state = VIR_STORAGE_JOB_STATE_CANCELLED;
+    else
+        job->state = VIR_STORAGE_JOB_STATE_FAILED;
+
+    VIR_DEBUG("Storage job %u in pool '%s' finished with state %d",
+              job->id, job->pool, job->state);
+
+    for (i = 0; i < table->njobs; i++) {
+        if (table->jobs[i] == job) {
+            VIR_DELETE_ELEMENT(table->jobs, i, table->njobs);
+            break;
+        }
+    }
+    virCondBroadcast(&table->cond);
+
+    for (i = 0; i < table->njobs; i++) {
+        virStorageJobPtr next = table->jobs[i];
+
+        if (next->state == VIR_STORAGE_JOB_STATE_QUEUED &&
+            memcmp(next->pooluuid, job->pooluuid, VIR_UUID_BUFLEN) == 0) {
+            next->state = VIR_STORAGE_JOB_STATE_RUNNING;
+            return next;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+virStorageJobWorker(void *jobdata,
+                    void *opaque)
+{
+    virStorageJobTablePtr table = opaque;
+    virStorageJobPtr job = jobdata;
+
+    while (job) {
+        virStorageJobPtr next;
+
+        virStorageJobRun(job);
+
+        virMutexLock(&table->lock);
+        next = virStorageJobTableFinish(table, job);
+        virMutexUnlock(&table->lock);
+
+        if (table->notify)
+            table->notify(job, table->opaque);
+
+        virMutexLock(&table->lock);
+        if (job->async) {
+            virMutexUnlock(&table->lock);
+            virStorageJobFree(job);
+        } else {
+            job->done = true;
+            virCondBroadcast(&table->cond);
+            virMutexUnlock(&table->lock);
+        }
+
+        job = next;
+    }
+}
+
+
+virStorageJobTablePtr
+virStorageJobTableNew(size_t maxWorkers,
+                      size_t perPool,
+                      virStorageJobNotifyFunc notify,
+                      void *opaque)
+{
+    virStorageJobTablePtr table;
+
+    if (virStorageJobInitialize() < 0)
+        return NULL;
+
+    if (VIR_ALLOC(table) < 0)
+        return NULL;
+
+    if (virMutexInit(&table->lock) < 0) {
+        virReportSystemError(errno, "%s", _("cannot initialize mutex"));
+        VIR_FREE(table);
+        return NULL;
+    }
+    if (virCondInit(&table->cond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize condition variable"));
+        virMutexDestroy(&table->lock);
+        VIR_FREE(table);
+        return NULL;
+    }
+
+    table->perPool = perPool ? perPool : 1;
+    table->notify = notify;
+    table->opaque = opaque;
+
+    if (!(table->workers = virThreadPoolNew(0, maxWorkers, 0,
+                                            virStorageJobWorker, table))) {
+        virStorageJobTableFree(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+
+/**
+ * virStorageJobTableFree:
+ * @table: job table
+ *
+ * Abort all jobs in @table, wait for them to finish and free @table.
+ * Jobs which are still queued are run, so that they can clean up after
+ * themselves, but find themselves aborted right away.
+ */
+void
+virStorageJobTableFree(virStorageJobTablePtr table)
+{
+    size_t i;
+
+    if (!table)
+        return;
+
+    virMutexLock(&table->lock);
+    table->quit = true;
+    for (i = 0; i < table->njobs; i++)
+        table->jobs[i]->aborted = true;
+    while (table->njobs > 0) {
+        if (virCondWait(&table->cond, &table->lock) < 0) {
+            VIR_WARN("Unable to wait for %zu storage jobs", table->njobs);
+            break;
+        }
+    }
+    virMutexUnlock(&table->lock);
+
+    virThreadPoolFree(table->workers);
+    VIR_FREE(table->jobs);
+    virCondDestroy(&table->cond);
+    virMutexDestroy(&table->lock);
+    VIR_FREE(table);
+}
+
+
+/**
+ * virStorageJobTableSubmit:
+ * @table: job table
+ * @job: the job to run
+ * @async: whether to return without waiting for @job to finish
+ *
+ * Hand @job over to @table, which queues it if its pool already runs as
+ * many jobs as allowed. With @async the table takes care of @job from
+ * now on, otherwise this waits for it to finish and releases it.
+ *
+ * The table always takes ownership of @job: if it cannot be queued, it
+ * is run right away as an aborted job, in the calling thread, so that it
+ * can undo whatever the caller set up for it.
+ *
+ * Returns 0 if @job was queued (@async) or ran successfully, -1 with an
+ * error reported otherwise.
+ */
+int
+virStorageJobTableSubmit(virStorageJobTablePtr table,
+                         virStorageJobPtr job,
+                         bool async)
+{
+    virErrorPtr orig_err;
+    size_t running = 0;
+    size_t i;
+    int ret = -1;
+
+    virMutexLock(&table->lock);
+
+    job->table = table;
+    job->async = async;
+
+    if (table->quit) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("storage driver is shutting down"));
+        goto error;
+    }
+
+    for (i = 0; i < table->njobs; i++) {
+        if (table->jobs[i]->state == VIR_STORAGE_JOB_STATE_RUNNING &&
+            memcmp(table->jobs[i]->pooluuid, job->pooluuid,
+                   VIR_UUID_BUFLEN) == 0)
+            running++;
+    }
+
+    job->id = ++table->lastID;
+    job->identity = virIdentityGetCurrent();
+    ignore_value(virTimeMillisNow(&job->submitted));
+    if (running < table->perPool)
+        job->state = VIR_STORAGE_JOB_STATE_RUNNING;
+
+    if (VIR_APPEND_ELEMENT_COPY(table->jobs, table->njobs, job) < 0)
+        goto error;
+
+    if (job->state == VIR_STORAGE_JOB_STATE_RUNNING &&
+        virThreadPoolSendJob(table->workers, 0, job) < 0) {
+        VIR_DELETE_ELEMENT(table->jobs, table->njobs - 1, table->njobs);
+        goto error;
+    }
+
+    VIR_DEBUG("Submitted storage job %u of type %d in pool '%s', %s",
+              job->id, job->type, job->pool,
+              job->state == VIR_STORAGE_JOB_STATE_RUNNING ?
+              "running" : "queued");
+
+    if (async) {
+        /* @job belongs to the worker from now on */
+        ret = 0;
+        goto cleanup;
+    }
+
+    while (!job->done) {
+        if (virCondWait(&table->cond, &table->lock) < 0) {
+            /* The worker would free the job once it finishes */
+            job->async = true;
+            virReportSystemError(errno, "%s",
+                                 _("failed to wait for storage job"));
+            goto cleanup;
+        }
+    }
+    virMutexUnlock(&table->lock);
+
+    if ((ret = job->ret) < 0 && job->err)
+        virSetError(job->err);
+    virStorageJobFree(job);
+    return ret;
+
+cleanup:
+    virMutexUnlock(&table->lock);
+    return ret;
+
+error:
+    job->aborted = true;
+    virMutexUnlock(&table->lock);
+
+    orig_err = virSaveLastError();
+    ignore_value(job->run(job, job->opaque));
+    if (orig_err) {
+        virSetError(orig_err);
+        virFreeError(orig_err);
+    }
+    virStorageJobFree(job);
+    return -1;
+}
+
+
+static virStorageJobPtr
+virStorageJobTableFind(virStorageJobTablePtr table,
+                       const char *pool,
+                       const char *vol)
+{
+    size_t i;
+
+    for (i = 0; i < table->njobs; i++) {
+        if (STREQ(table->jobs[i]->pool, pool) &&
+            STREQ_NULLABLE(table->jobs[i]->vol, vol))
+            return table->jobs[i];
+    }
+
+    return NULL;
+}
+
+
+/**
+ * virStorageJobTableGetInfo:
+ * @table: job table
+ * @pool: name of the pool
+ * @vol: name of the volume, or NULL for pool jobs
+ * @info: filled with the state of the job
+ *
+ * Returns 1 if a job for @vol in @pool is queued or running, 0 if not.
+ */
+int
+virStorageJobTableGetInfo(virStorageJobTablePtr table,
+                          const char *pool,
+                          const char *vol,
+                          virStorageJobInfoPtr info)
+{
+    virStorageJobPtr job;
+    unsigned long long now = 0;
+    int ret = 0;
+
+    memset(info, 0, sizeof(*info));
+    ignore_value(virTimeMillisNow(&now));
+
+    virMutexLock(&table->lock);
+    if ((job = virStorageJobTableFind(table, pool, vol))) {
+        info->id = job->id;
+        info->type = job->type;
+        info->state = job->state;
+        if (now > job->submitted)
+            info->elapsed = now - job->submitted;
+        info->total = job->total;
+        info->processed = job->processed;
+        ret = 1;
+    }
+    virMutexUnlock(&table->lock);
+
+    return ret;
+}
+
+
+/**
+ * virStorageJobTableAbort:
+ * @table: job table
+ * @pool: name of the pool
+ * @vol: name of the volume, or NULL for pool jobs
+ *
+ * Ask the job working on @vol in @pool to stop at the soonest
+ * opportunity.
+ *
+ * Returns 0 on success, -1 with an error reported if there is no such
+ * job.
+ */
+int
+virStorageJobTableAbort(virStorageJobTablePtr table,
+                        const char *pool,
+                        const char *vol)
+{
+    virStorageJobPtr job;
+    int ret = -1;
+
+    virMutexLock(&table->lock);
+    if (!(job = virStorageJobTableFind(table, pool, vol))) {
+        if (vol)
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           _("no job is active for volume '%s'"), vol);
+        else
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           _("no job is active for pool '%s'"), pool);
+        goto cleanup;
+    }
+
+    VIR_INFO("Aborting storage job %u in pool '%s'", job->id, job->pool);
+    job->aborted = true;
+    ret = 0;
+
+cleanup:
+    virMutexUnlock(&table->lock);
+    return ret;
+}
+
+
+unsigned int
+virStorageJobGetID(virStorageJobPtr job)
+{
+    return job->id;
+}
+
+
+int
+virStorageJobGetType(virStorageJobPtr job)
+{
+    return job->type;
+}
+
+
+/* Only meaningful once the job finished, that is from the notify
+ * callback */
+int
+virStorageJobGetState(virStorageJobPtr job)
+{
+    return job->state;
+}
+
+
+const char *
+virStorageJobGetPool(virStorageJobPtr job)
+{
+    return job->pool;
+}
+
+
+const unsigned char *
+virStorageJobGetPoolUUID(virStorageJobPtr job)
+{
+    return job->pooluuid;
+}
+
+
+const char *
+virStorageJobGetVol(virStorageJobPtr job)
+{
+    return job->vol;
+}
+
+
+/**
+ * virStorageJobGetCurrent:
+ *
+ * Returns the job run by the calling thread, or NULL. Code shared by
+ * jobs and synchronous callers uses it to report progress.
+ */
+virStorageJobPtr
+virStorageJobGetCurrent(void)
+{
+    if (virStorageJobInitialize() < 0)
+        return NULL;
+
+    return virThreadLocalGet(&virStorageJobCurrent);
+}
+
+
+void
+virStorageJobSetTotal(virStorageJobPtr job,
+                      unsigned long long total)
+{
+    if (!job)
+        return;
+
+    virMutexLock(&job->table->lock);
+    job->total = total;
+    virMutexUnlock(&job->table->lock);
+}
+
+
+void
+virStorageJobSetProcessed(virStorageJobPtr job,
+                          unsigned long long processed)
+{
+    if (!job)
+        return;
+
+    virMutexLock(&job->table->lock);
+    job->processed = processed;
+    virMutexUnlock(&job->table->lock);
+}
+
+
+void
+virStorageJobAddProcessed(virStorageJobPtr job,
+                          unsigned long long bytes)
+{
+    if (!job)
+        return;
+
+    virMutexLock(&job->table->lock);
+    job->processed += bytes;
+    virMutexUnlock(&job->table->lock);
+}
+
+
+bool
+virStorageJobIsAborted(virStorageJobPtr job)
+{
+    bool ret;
+
+    if (!job)
+        return false;
+
+    virMutexLock(&job->table->lock);
+    ret = job->aborted;
+    virMutexUnlock(&job->table->lock);
+
+    return ret;
+}
+
+
+/**
+ * virStorageJobCheckAborted:
+ * @job: the job, or NULL
+ *
+ * Returns -1 with an error reported if @job was asked to abort, 0
+ * otherwise.
+ */
+int
+virStorageJobCheckAborted(virStorageJobPtr job)
+{
+    if (!virStorageJobIsAborted(job))
+        return 0;
+
+    virReportError(VIR_ERR_OPERATION_ABORTED,
+                   _("storage job %u was aborted"), job->id);
+    return -1;
+}
@@ -0,0 +1,101 @@
+/*
+ * storage_job.h: background jobs of the storage driver
+ *
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VIR_STORAGE_JOB_H__
+# define __VIR_STORAGE_JOB_H__
+
+# include "internal.h"
+
+typedef struct _virStorageJob virStorageJob;
+typedef virStorageJob *virStorageJobPtr;
+
+typedef struct _virStorageJobTable virStorageJobTable;
+typedef virStorageJobTable *virStorageJobTablePtr;
+
+typedef struct _virStorageJobInfo virStorageJobInfo;
+typedef virStorageJobInfo *virStorageJobInfoPtr;
+struct _virStorageJobInfo {
+    unsigned int id;
+    int type;                       /* virStorageJobType */
+    int state;                      /* virStorageJobState */
+    unsigned long long elapsed;     /* ms since the job was submitted */
+    unsigned long long total;       /* bytes to process, 0 if unknown */
+    unsigned long long processed;   /* bytes processed so far */
+};
+
+/* Does the work of @job in a worker thread, with the submitter's
+ * identity but without any driver or pool lock held. Returns 0 on
+ * success, or -1 with an error reported. */
+typedef int (*virStorageJobRunFunc)(virStorageJobPtr job,
+                                    void *opaque);
+
+/* Called once @job has finished, before it is released */
+typedef void (*virStorageJobNotifyFunc)(virStorageJobPtr job,
+                                        void *opaque);
+
+virStorageJobTablePtr
+virStorageJobTableNew(size_t maxWorkers,
+                      size_t perPool,
+                      virStorageJobNotifyFunc notify,
+                      void *opaque);
+void virStorageJobTableFree(virStorageJobTablePtr table);
+
+virStorageJobPtr
+virStorageJobNew(int type,
+                 const char *pool,
+                 const unsigned char *pooluuid,
+                 const char *vol,
+                 virStorageJobRunFunc run,
+                 void *opaque,
+                 virFreeCallback freeOpaque)
+    ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3) ATTRIBUTE_NONNULL(5);
+void virStorageJobFree(virStorageJobPtr job);
+
+int virStorageJobTableSubmit(virStorageJobTablePtr table,
+                             virStorageJobPtr job,
+                             bool async);
+
+int virStorageJobTableGetInfo(virStorageJobTablePtr table,
+                              const char *pool,
+                              const char *vol,
+                              virStorageJobInfoPtr info);
+int virStorageJobTableAbort(virStorageJobTablePtr table,
+                            const char *pool,
+                            const char *vol);
+
+unsigned int virStorageJobGetID(virStorageJobPtr job);
+int virStorageJobGetType(virStorageJobPtr job);
+int virStorageJobGetState(virStorageJobPtr job);
+const char *virStorageJobGetPool(virStorageJobPtr job);
+const unsigned char *virStorageJobGetPoolUUID(virStorageJobPtr job);
+const char *virStorageJobGetVol(virStorageJobPtr job);
+
+virStorageJobPtr virStorageJobGetCurrent(void);
+
+void virStorageJobSetTotal(virStorageJobPtr job,
+                           unsigned long long total);
+void virStorageJobSetProcessed(virStorageJobPtr job,
+                               unsigned long long processed);
+void virStorageJobAddProcessed(virStorageJobPtr job,
+                               unsigned long long bytes);
+bool virStorageJobIsAborted(virStorageJobPtr job);
+int virStorageJobCheckAborted(virStorageJobPtr job);
+
+#endif /* __VIR_STORAGE_JOB_H__ */
@@ -1243,10 +1243,6 @@ testOpenVolumesForPool(const char *file,
         if (!def)
             goto error;
 
-        if (VIR_REALLOC_N(pool->volumes.objs,
-                          pool->volumes.count+1) < 0)
-            goto error;
-
         if (def->target.path == NULL) {
             if (virAsprintf(&def->target.path, "%s/%s",
                             pool->def->target.path,
@@ -1257,11 +1253,12 @@ testOpenVolumesForPool(const char *file,
         if (!def->key && VIR_STRDUP(def->key, def->target.path) < 0)
             goto error;
 
+        if (virStoragePoolObjAddVol(pool, def) < 0)
+            goto error;
+
         pool->def->allocation += def->allocation;
         pool->def->available = (pool->def->capacity -
                                 pool->def->allocation);
-
-        pool->volumes.objs[pool->volumes.count++] = def;
         def = NULL;
     }
 
@@ -5459,10 +5456,6 @@ testStorageVolCreateXML(virStoragePoolPtr pool,
         goto cleanup;
     }
 
-    if (VIR_REALLOC_N(privpool->volumes.objs,
-                      privpool->volumes.count+1) < 0)
-        goto cleanup;
-
     if (virAsprintf(&privvol->target.path, "%s/%s",
                     privpool->def->target.path,
                     privvol->name) == -1)
@@ -5471,12 +5464,13 @@ testStorageVolCreateXML(virStoragePoolPtr pool,
     if (VIR_STRDUP(privvol->key, privvol->target.path) < 0)
         goto cleanup;
 
+    if (virStoragePoolObjAddVol(privpool, privvol) < 0)
+        goto cleanup;
+
     privpool->def->allocation += privvol->allocation;
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    privpool->volumes.objs[privpool->volumes.count++] = privvol;
-
     ret = virGetStorageVol(pool->conn, privpool->def->name,
                            privvol->name, privvol->key,
                            NULL, NULL);
@@ -5547,10 +5541,6 @@ testStorageVolCreateXMLFrom(virStoragePoolPtr pool,
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    if (VIR_REALLOC_N(privpool->volumes.objs,
-                      privpool->volumes.count+1) < 0)
-        goto cleanup;
-
     if (virAsprintf(&privvol->target.path, "%s/%s",
                     privpool->def->target.path,
                     privvol->name) == -1)
@@ -5559,12 +5549,13 @@ testStorageVolCreateXMLFrom(virStoragePoolPtr pool,
     if (VIR_STRDUP(privvol->key, privvol->target.path) < 0)
         goto cleanup;
 
+    if (virStoragePoolObjAddVol(privpool, privvol) < 0)
+        goto cleanup;
+
     privpool->def->allocation += privvol->allocation;
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    privpool->volumes.objs[privpool->volumes.count++] = privvol;
-
     ret = virGetStorageVol(pool->conn, privpool->def->name,
                            privvol->name, privvol->key,
                            NULL, NULL);
@@ -5584,7 +5575,6 @@ testStorageVolDelete(virStorageVolPtr vol,
     testConnPtr privconn = vol->conn->privateData;
     virStoragePoolObjPtr privpool;
     virStorageVolDefPtr privvol;
-    size_t i;
     int ret = -1;
 
     virCheckFlags(0, -1);
@@ -5620,25 +5610,8 @@ testStorageVolDelete(virStorageVolPtr vol,
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    for (i = 0; i < privpool->volumes.count; i++) {
-        if (privpool->volumes.objs[i] == privvol) {
-            virStorageVolDefFree(privvol);
-
-            if (i < (privpool->volumes.count - 1))
-                memmove(privpool->volumes.objs + i,
-                        privpool->volumes.objs + i + 1,
-                        sizeof(*(privpool->volumes.objs)) *
-                                (privpool->volumes.count - (i + 1)));
-
-            if (VIR_REALLOC_N(privpool->volumes.objs,
-                              privpool->volumes.count - 1) < 0) {
-                ; /* Failure to reduce memory allocation isn't fatal */
-            }
-            privpool->volumes.count--;
-
-            break;
-        }
-    }
+    virStoragePoolObjRemoveVol(privpool, privvol);
+    virStorageVolDefFree(privvol);
     ret = 0;
 
 cleanup:
@@ -6315,6 +6288,166 @@ static int testConnectListAllDomains(virConnectPtr conn,
     return ret;
 }
 
+#define TEST_DOMAIN_STATS_SUPPORTED                 \
+    (VIR_DOMAIN_STATS_STATE |                       \
+     VIR_DOMAIN_STATS_CPU_TOTAL |                   \
+     VIR_DOMAIN_STATS_BALLOON |                     \
+     VIR_DOMAIN_STATS_VCPU)
+
+static int
+testDomainGetStats(virConnectPtr conn,
+                   virDomainObjPtr dom,
+                   unsigned int stats,
+                   virDomainStatsRecordPtr *record)
+{
+    virDomainStatsRecordPtr tmp;
+    struct timeval tv;
+    int maxparams = 0;
+    int state;
+    int reason;
+    int ret = -1;
+
+    if (VIR_ALLOC(tmp) < 0)
+        return -1;
+
+    if (stats & VIR_DOMAIN_STATS_STATE) {
+        state = virDomainObjGetState(dom, &reason);
+        if (virTypedParamsAddInt(&tmp->params, &tmp->nparams, &maxparams,
+                                 "state.state", state) < 0 ||
+            virTypedParamsAddInt(&tmp->params, &tmp->nparams, &maxparams,
+                                 "state.reason", reason) < 0)
+            goto cleanup;
+    }
+
+    if (stats & VIR_DOMAIN_STATS_CPU_TOTAL &&
+        virDomainObjIsActive(dom)) {
+        if (gettimeofday(&tv, NULL) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "%s", _("getting time of day"));
+            goto cleanup;
+        }
+
+        if (virTypedParamsAddULLong(&tmp->params, &tmp->nparams, &maxparams,
+                                    "cpu.time",
+                                    (tv.tv_sec * 1000ll * 1000ll * 1000ll) +
+                                    (tv.tv_usec * 1000ll)) < 0)
+            goto cleanup;
+    }
+
+    if (stats & VIR_DOMAIN_STATS_BALLOON) {
+        if (virTypedParamsAddULLong(&tmp->params, &tmp->nparams, &maxparams,
+                                    "balloon.current",
+                                    dom->def->mem.cur_balloon) < 0 ||
+            virTypedParamsAddULLong(&tmp->params, &tmp->nparams, &maxparams,
+                                    "balloon.maximum",
+                                    dom->def->mem.max_balloon) < 0)
+            goto cleanup;
+    }
+
+    if (stats & VIR_DOMAIN_STATS_VCPU) {
+        if (virTypedParamsAddUInt(&tmp->params, &tmp->nparams, &maxparams,
+                                  "vcpu.current", dom->def->vcpus) < 0 ||
+            virTypedParamsAddUInt(&tmp->params, &tmp->nparams, &maxparams,
+                                  "vcpu.maximum", dom->def->maxvcpus) < 0)
+            goto cleanup;
+    }
+
+    if (!(tmp->dom = virGetDomain(conn, dom->def->name, dom->def->uuid)))
+        goto cleanup;
+    tmp->dom->id = dom->def->id;
+
+    *record = tmp;
+    tmp = NULL;
+    ret = 0;
+
+cleanup:
+    if (tmp) {
+        virTypedParamsFree(tmp->params, tmp->nparams);
+        VIR_FREE(tmp);
+    }
+    return ret;
+}
+
+static int
+testConnectGetAllDomainStats(virConnectPtr conn,
+                             virDomainPtr *doms,
+                             unsigned int ndoms,
+                             unsigned int stats,
+                             virDomainStatsRecordPtr **retStats,
+                             unsigned int flags)
+{
+    testConnPtr privconn = conn->privateData;
+    virDomainPtr *domlist = NULL;
+    virDomainStatsRecordPtr *tmpstats = NULL;
+    int nstats = 0;
+    int ntempdoms;
+    size_t i;
+    int ret = -1;
+
+    if (ndoms)
+        virCheckFlags(VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS, -1);
+    else
+        virCheckFlags(VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
+                      VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
+                      VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE |
+                      VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS, -1);
+
+    if (stats == 0) {
+        stats = TEST_DOMAIN_STATS_SUPPORTED;
+    } else if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS &&
+               stats & ~TEST_DOMAIN_STATS_SUPPORTED) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED,
+                       _("Stats types bits 0x%x are not supported by this daemon"),
+                       stats & ~TEST_DOMAIN_STATS_SUPPORTED);
+        return -1;
+    }
+    stats &= TEST_DOMAIN_STATS_SUPPORTED;
+
+    testDriverLock(privconn);
+
+    if (!ndoms) {
+        flags &= ~VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS;
+        if ((ntempdoms = virDomainObjListExport(privconn->domains, conn,
+                                                &domlist, NULL, flags)) < 0)
+            goto cleanup;
+
+        ndoms = ntempdoms;
+        doms = domlist;
+    }
+
+    if (VIR_ALLOC_N(tmpstats, ndoms + 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ndoms; i++) {
+        virDomainObjPtr dom;
+        int rc;
+
+        if (!(dom = virDomainObjListFindByUUID(privconn->domains,
+                                               doms[i]->uuid)))
+            continue;
+
+        rc = testDomainGetStats(conn, dom, stats, &tmpstats[nstats]);
+        virObjectUnlock(dom);
+        if (rc < 0)
+            goto cleanup;
+        nstats++;
+    }
+
+    *retStats = tmpstats;
+    tmpstats = NULL;
+    ret = nstats;
+
+cleanup:
+    testDriverUnlock(privconn);
+    if (domlist) {
+        for (i = 0; i < ndoms; i++)
+            virDomainFree(domlist[i]);
+        VIR_FREE(domlist);
+    }
+    virDomainStatsRecordListFree(tmpstats);
+    return ret;
+}
+
 static int
 testNodeGetCPUMap(virConnectPtr conn,
                   unsigned char **cpumap,
@@ -7398,6 +7531,7 @@ static virDriver testDriver = {
     .domainGetMetadata = testDomainGetMetadata, /* 1.1.3 */
     .domainSetMetadata = testDomainSetMetadata, /* 1.1.3 */
     .connectGetCPUModelNames = testConnectGetCPUModelNames, /* 1.1.3 */
+    .connectGetAllDomainStats = testConnectGetAllDomainStats, /* 1.2.3 */
     .domainManagedSave = testDomainManagedSave, /* 1.1.4 */
     .domainHasManagedSaveImage = testDomainHasManagedSaveImage, /* 1.1.4 */
     .domainManagedSaveRemove = testDomainManagedSaveRemove, /* 1.1.4 */
@@ -30,6 +30,9 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#if HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #include "virthread.h"
 #include "virlog.h"
@@ -55,6 +58,7 @@ struct virEventPollHandle {
     virFreeCallback ff;
     void *opaque;
     int deleted;
+    bool registered; /* with the kernel, when using epoll */
 };
 
 /* State for a single timer being generated */
@@ -66,12 +70,16 @@ struct virEventPollTimeout {
     virFreeCallback ff;
     void *opaque;
     int deleted;
+    ssize_t heapIndex; /* in the heap of pending timers, or -1 */
 };
 
 /* Allocate extra slots for virEventPollHandle/virEventPollTimeout
    records in this multiple */
 #define EVENT_ALLOC_EXTENT 10
 
+/* Most ready file handles picked up by a single epoll_wait() */
+#define EVENT_EPOLL_MAX_EVENTS 64
+
 /* State for the main event loop */
 struct virEventPollLoop {
     virMutex lock;
@@ -83,7 +91,27 @@ struct virEventPollLoop {
     struct virEventPollHandle *handles;
     size_t timeoutsCount;
     size_t timeoutsAlloc;
-    struct virEventPollTimeout *timeouts;
+    struct virEventPollTimeout **timeouts; /* sorted by timer number */
+    size_t timeoutsDeleted;
+    /* Binary min-heap of the enabled timers, by expiry time */
+    size_t timeoutsHeapCount;
+    size_t timeoutsHeapAlloc;
+    struct virEventPollTimeout **timeoutsHeap;
+    /* Scratch space for the timers due in an iteration */
+    size_t timeoutsDueAlloc;
+    int *timeoutsDue;
+    /* Unless epoll is unavailable or has been given up on, the
+     * file handles stay registered with the kernel between
+     * iterations and only those which are ready get looked at */
+    int epollfd;
+    int epollfdStale;
+#if HAVE_SYS_EPOLL_H
+    struct epoll_event epollEvents[EVENT_EPOLL_MAX_EVENTS];
+    /* Watches which got events they shouldn't have in the last
+     * iteration */
+    size_t epollStaleCount;
+    int epollStale[EVENT_EPOLL_MAX_EVENTS];
+#endif
 };
 
 /* Only have one event loop */
@@ -95,6 +123,153 @@ static int nextWatch = 1;
 /* Unique ID for the next timer to be registered */
 static int nextTimer = 1;
 
+/*
+ * Handles are only ever appended with increasing watch numbers
+ * and deletion keeps their order, so the list stays sorted
+ * returns: the index of @watch in the list, or -1 if not found
+ */
+static ssize_t virEventPollFindHandle(int watch)
+{
+    size_t lo = 0;
+    size_t hi = eventLoop.handlesCount;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (eventLoop.handles[mid].watch < watch)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < eventLoop.handlesCount &&
+        eventLoop.handles[lo].watch == watch)
+        return lo;
+    return -1;
+}
+
+#if HAVE_SYS_EPOLL_H
+static uint32_t virEventPollToEpollEvents(int events)
+{
+    uint32_t ret = 0;
+    if (events & POLLIN)
+        ret |= EPOLLIN;
+    if (events & POLLOUT)
+        ret |= EPOLLOUT;
+    if (events & POLLERR)
+        ret |= EPOLLERR;
+    if (events & POLLHUP)
+        ret |= EPOLLHUP;
+    return ret;
+}
+
+static int virEventPollFromEpollEvents(uint32_t events)
+{
+    int ret = 0;
+    if (events & EPOLLIN)
+        ret |= VIR_EVENT_HANDLE_READABLE;
+    if (events & EPOLLOUT)
+        ret |= VIR_EVENT_HANDLE_WRITABLE;
+    if (events & EPOLLERR)
+        ret |= VIR_EVENT_HANDLE_ERROR;
+    if (events & EPOLLHUP)
+        ret |= VIR_EVENT_HANDLE_HANGUP;
+    return ret;
+}
+
+/*
+ * Switch back to poll(), which copes with anything epoll doesn't,
+ * like regular files or the same file handle being watched twice.
+ * The epoll fd may be in use by the thread running the loop, so
+ * it is left for that thread to close.
+ */
+static void virEventPollDisableEpoll(void)
+{
+    size_t i;
+
+    VIR_DEBUG("Falling back to poll() for file handles");
+
+    eventLoop.epollfdStale = eventLoop.epollfd;
+    eventLoop.epollfd = -1;
+    for (i = 0; i < eventLoop.handlesCount; i++)
+        eventLoop.handles[i].registered = false;
+
+    virEventPollInterruptLocked();
+}
+
+/*
+ * The kernel hands back the watch along with the fd it was registered
+ * for, so an entry can still be removed once the handle is gone
+ */
+# define EVENT_EPOLL_DATA(watch, fd) \
+    (((uint64_t)(fd) << 32) | (uint32_t)(watch))
+# define EVENT_EPOLL_WATCH(data) ((int)((data) & 0xffffffff))
+# define EVENT_EPOLL_FD(data) ((int)((data) >> 32))
+
+/*
+ * Bring the kernel's view of handle @i in line with the events it
+ * is interested in. Handles without any events are removed rather
+ * than modified, since epoll reports errors and hangups whatever
+ * events are asked for, and those would keep firing. This matches
+ * the poll() loop, which leaves such handles out entirely: a handle
+ * without events hears nothing, not even a hangup, until it is
+ * updated to wait for events again, which reports what is pending.
+ */
+static void virEventPollUpdateEpoll(size_t i)
+{
+    struct virEventPollHandle *handle = &eventLoop.handles[i];
+    struct epoll_event ev;
+    bool want = handle->events && !handle->deleted;
+    size_t j;
+
+    if (eventLoop.epollfd == -1)
+        return;
+
+    if (!want) {
+        /* The fd may already be closed, which unregistered it */
+        if (handle->registered)
+            ignore_value(epoll_ctl(eventLoop.epollfd, EPOLL_CTL_DEL,
+                                   handle->fd, NULL));
+        handle->registered = false;
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = virEventPollToEpollEvents(handle->events);
+    ev.data.u64 = EVENT_EPOLL_DATA(handle->watch, handle->fd);
+
+    if (handle->registered) {
+        if (epoll_ctl(eventLoop.epollfd, EPOLL_CTL_MOD, handle->fd, &ev) < 0) {
+            VIR_DEBUG("Unable to modify fd %d in epoll: %d", handle->fd, errno);
+            virEventPollDisableEpoll();
+        }
+        return;
+    }
+
+    /* epoll tracks file handles, not watches, so each fd
+     * can only be registered once */
+    for (j = 0; j < eventLoop.handlesCount; j++) {
+        if (j != i &&
+            eventLoop.handles[j].registered &&
+            eventLoop.handles[j].fd == handle->fd) {
+            VIR_DEBUG("fd %d is watched more than once", handle->fd);
+            virEventPollDisableEpoll();
+            return;
+        }
+    }
+
+    if (epoll_ctl(eventLoop.epollfd, EPOLL_CTL_ADD, handle->fd, &ev) < 0) {
+        VIR_DEBUG("Unable to add fd %d to epoll: %d", handle->fd, errno);
+        virEventPollDisableEpoll();
+        return;
+    }
+    handle->registered = true;
+}
+#else /* !HAVE_SYS_EPOLL_H */
+static void virEventPollUpdateEpoll(size_t i ATTRIBUTE_UNUSED)
+{
+}
+#endif /* !HAVE_SYS_EPOLL_H */
+
 /*
  * Register a callback for monitoring file handle events.
  * NB, it *must* be safe to call this from within a callback
@@ -126,8 +301,10 @@ int virEventPollAddHandle(int fd, int events,
     eventLoop.handles[eventLoop.handlesCount].ff = ff;
     eventLoop.handles[eventLoop.handlesCount].opaque = opaque;
     eventLoop.handles[eventLoop.handlesCount].deleted = 0;
+    eventLoop.handles[eventLoop.handlesCount].registered = false;
 
     eventLoop.handlesCount++;
+    virEventPollUpdateEpoll(eventLoop.handlesCount - 1);
 
     virEventPollInterruptLocked();
 
@@ -140,8 +317,7 @@ int virEventPollAddHandle(int fd, int events,
 }
 
 void virEventPollUpdateHandle(int watch, int events) {
-    size_t i;
-    bool found = false;
+    ssize_t i;
     PROBE(EVENT_POLL_UPDATE_HANDLE,
           "watch=%d events=%d",
           watch, events);
@@ -152,18 +328,15 @@ void virEventPollUpdateHandle(int watch, int events) {
     }
 
     virMutexLock(&eventLoop.lock);
-    for (i = 0; i < eventLoop.handlesCount; i++) {
-        if (eventLoop.handles[i].watch == watch) {
-            eventLoop.handles[i].events =
-                    virEventPollToNativeEvents(events);
-            virEventPollInterruptLocked();
-            found = true;
-            break;
-        }
+    if ((i = virEventPollFindHandle(watch)) >= 0) {
+        eventLoop.handles[i].events =
+                virEventPollToNativeEvents(events);
+        virEventPollUpdateEpoll(i);
+        virEventPollInterruptLocked();
     }
     virMutexUnlock(&eventLoop.lock);
 
-    if (!found)
+    if (i < 0)
         VIR_WARN("Got update for non-existent handle watch %d", watch);
 }
 
@@ -174,7 +347,7 @@ void virEventPollUpdateHandle(int watch, int events) {
  * Actual deletion will be done out-of-band
  */
 int virEventPollRemoveHandle(int watch) {
-    size_t i;
+    ssize_t i;
     PROBE(EVENT_POLL_REMOVE_HANDLE,
           "watch=%d",
           watch);
@@ -185,23 +358,115 @@ int virEventPollRemoveHandle(int watch) {
     }
 
     virMutexLock(&eventLoop.lock);
-    for (i = 0; i < eventLoop.handlesCount; i++) {
-        if (eventLoop.handles[i].deleted)
-            continue;
-
-        if (eventLoop.handles[i].watch == watch) {
-            EVENT_DEBUG("mark delete %zu %d", i, eventLoop.handles[i].fd);
-            eventLoop.handles[i].deleted = 1;
-            virEventPollInterruptLocked();
-            virMutexUnlock(&eventLoop.lock);
-            return 0;
-        }
+    if ((i = virEventPollFindHandle(watch)) >= 0 &&
+        !eventLoop.handles[i].deleted) {
+        EVENT_DEBUG("mark delete %zd %d", i, eventLoop.handles[i].fd);
+        eventLoop.handles[i].deleted = 1;
+        virEventPollUpdateEpoll(i);
+        virEventPollInterruptLocked();
+        virMutexUnlock(&eventLoop.lock);
+        return 0;
     }
     virMutexUnlock(&eventLoop.lock);
     return -1;
 }
 
 
+/*
+ * Timers are only ever appended with increasing numbers and
+ * deletion keeps their order, so the list stays sorted
+ * returns: the timer, or NULL if not found
+ */
+static struct virEventPollTimeout *virEventPollFindTimeout(int timer)
+{
+    size_t lo = 0;
+    size_t hi = eventLoop.timeoutsCount;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (eventLoop.timeouts[mid]->timer < timer)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < eventLoop.timeoutsCount &&
+        eventLoop.timeouts[lo]->timer == timer)
+        return eventLoop.timeouts[lo];
+    return NULL;
+}
+
+static void virEventPollHeapSet(size_t i, struct virEventPollTimeout *t)
+{
+    eventLoop.timeoutsHeap[i] = t;
+    t->heapIndex = i;
+}
+
+static void virEventPollHeapUp(size_t i)
+{
+    struct virEventPollTimeout *t = eventLoop.timeoutsHeap[i];
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (eventLoop.timeoutsHeap[parent]->expiresAt <= t->expiresAt)
+            break;
+        virEventPollHeapSet(i, eventLoop.timeoutsHeap[parent]);
+        i = parent;
+    }
+    virEventPollHeapSet(i, t);
+}
+
+static void virEventPollHeapDown(size_t i)
+{
+    struct virEventPollTimeout *t = eventLoop.timeoutsHeap[i];
+
+    while (1) {
+        size_t child = 2 * i + 1;
+        if (child >= eventLoop.timeoutsHeapCount)
+            break;
+        if (child + 1 < eventLoop.timeoutsHeapCount &&
+            eventLoop.timeoutsHeap[child + 1]->expiresAt <
+            eventLoop.timeoutsHeap[child]->expiresAt)
+            child++;
+        if (t->expiresAt <= eventLoop.timeoutsHeap[child]->expiresAt)
+            break;
+        virEventPollHeapSet(i, eventLoop.timeoutsHeap[child]);
+        i = child;
+    }
+    virEventPollHeapSet(i, t);
+}
+
+/*
+ * Put @t in its place in the heap after it was enabled, disabled,
+ * deleted or had its expiry time changed. There is always room in
+ * the heap, since it is grown along with the list of timers.
+ */
+static void virEventPollScheduleTimeout(struct virEventPollTimeout *t)
+{
+    bool pending = !t->deleted && t->frequency >= 0;
+
+    if (t->heapIndex < 0) {
+        if (!pending)
+            return;
+        virEventPollHeapSet(eventLoop.timeoutsHeapCount++, t);
+        virEventPollHeapUp(t->heapIndex);
+    } else if (pending) {
+        virEventPollHeapUp(t->heapIndex);
+        virEventPollHeapDown(t->heapIndex);
+    } else {
+        size_t i = t->heapIndex;
+        struct virEventPollTimeout *last =
+            eventLoop.timeoutsHeap[--eventLoop.timeoutsHeapCount];
+
+        t->heapIndex = -1;
+        if (last != t) {
+            virEventPollHeapSet(i, last);
+            virEventPollHeapUp(i);
+            virEventPollHeapDown(last->heapIndex);
+        }
+    }
+}
+
 /*
  * Register a callback for a timer event
  * NB, it *must* be safe to call this from within a callback
@@ -212,6 +477,7 @@ int virEventPollAddTimeout(int frequency,
                            void *opaque,
                            virFreeCallback ff)
 {
+    struct virEventPollTimeout *t;
     unsigned long long now;
     int ret;
 
@@ -219,6 +485,9 @@ int virEventPollAddTimeout(int frequency,
         return -1;
     }
 
+    if (VIR_ALLOC(t) < 0)
+        return -1;
+
     virMutexLock(&eventLoop.lock);
     if (eventLoop.timeoutsCount == eventLoop.timeoutsAlloc) {
         EVENT_DEBUG("Used %zu timeout slots, adding at least %d more",
@@ -226,21 +495,32 @@ int virEventPollAddTimeout(int frequency,
         if (VIR_RESIZE_N(eventLoop.timeouts, eventLoop.timeoutsAlloc,
                          eventLoop.timeoutsCount, EVENT_ALLOC_EXTENT) < 0) {
             virMutexUnlock(&eventLoop.lock);
+            VIR_FREE(t);
             return -1;
         }
     }
+    if (VIR_RESIZE_N(eventLoop.timeoutsHeap, eventLoop.timeoutsHeapAlloc,
+                     eventLoop.timeoutsCount, 1) < 0 ||
+        VIR_RESIZE_N(eventLoop.timeoutsDue, eventLoop.timeoutsDueAlloc,
+                     eventLoop.timeoutsCount, 1) < 0) {
+        virMutexUnlock(&eventLoop.lock);
+        VIR_FREE(t);
+        return -1;
+    }
+
+    t->timer = nextTimer++;
+    t->frequency = frequency;
+    t->cb = cb;
+    t->ff = ff;
+    t->opaque = opaque;
+    t->deleted = 0;
+    t->heapIndex = -1;
+    t->expiresAt = frequency >= 0 ? frequency + now : 0;
 
-    eventLoop.timeouts[eventLoop.timeoutsCount].timer = nextTimer++;
-    eventLoop.timeouts[eventLoop.timeoutsCount].frequency = frequency;
-    eventLoop.timeouts[eventLoop.timeoutsCount].cb = cb;
-    eventLoop.timeouts[eventLoop.timeoutsCount].ff = ff;
-    eventLoop.timeouts[eventLoop.timeoutsCount].opaque = opaque;
-    eventLoop.timeouts[eventLoop.timeoutsCount].deleted = 0;
-    eventLoop.timeouts[eventLoop.timeoutsCount].expiresAt =
-        frequency >= 0 ? frequency + now : 0;
+    eventLoop.timeouts[eventLoop.timeoutsCount++] = t;
+    virEventPollScheduleTimeout(t);
 
-    eventLoop.timeoutsCount++;
-    ret = nextTimer-1;
+    ret = t->timer;
     virEventPollInterruptLocked();
 
     PROBE(EVENT_POLL_ADD_TIMEOUT,
@@ -252,9 +532,8 @@ int virEventPollAddTimeout(int frequency,
 
 void virEventPollUpdateTimeout(int timer, int frequency)
 {
+    struct virEventPollTimeout *t;
     unsigned long long now;
-    size_t i;
-    bool found = false;
     PROBE(EVENT_POLL_UPDATE_TIMEOUT,
           "timer=%d frequency=%d",
           timer, frequency);
@@ -269,21 +548,17 @@ void virEventPollUpdateTimeout(int timer, int frequency)
     }
 
     virMutexLock(&eventLoop.lock);
-    for (i = 0; i < eventLoop.timeoutsCount; i++) {
-        if (eventLoop.timeouts[i].timer == timer) {
-            eventLoop.timeouts[i].frequency = frequency;
-            eventLoop.timeouts[i].expiresAt =
-                frequency >= 0 ? frequency + now : 0;
-            VIR_DEBUG("Set timer freq=%d expires=%llu", frequency,
-                      eventLoop.timeouts[i].expiresAt);
-            virEventPollInterruptLocked();
-            found = true;
-            break;
-        }
+    if ((t = virEventPollFindTimeout(timer))) {
+        t->frequency = frequency;
+        t->expiresAt = frequency >= 0 ? frequency + now : 0;
+        VIR_DEBUG("Set timer freq=%d expires=%llu", frequency,
+                  t->expiresAt);
+        virEventPollScheduleTimeout(t);
+        virEventPollInterruptLocked();
     }
     virMutexUnlock(&eventLoop.lock);
 
-    if (!found)
+    if (!t)
         VIR_WARN("Got update for non-existent timer %d", timer);
 }
 
@@ -294,7 +569,7 @@ void virEventPollUpdateTimeout(int timer, int frequency)
  * Actual deletion will be done out-of-band
  */
 int virEventPollRemoveTimeout(int timer) {
-    size_t i;
+    struct virEventPollTimeout *t;
     PROBE(EVENT_POLL_REMOVE_TIMEOUT,
           "timer=%d",
           timer);
@@ -305,42 +580,30 @@ int virEventPollRemoveTimeout(int timer) {
     }
 
     virMutexLock(&eventLoop.lock);
-    for (i = 0; i < eventLoop.timeoutsCount; i++) {
-        if (eventLoop.timeouts[i].deleted)
-            continue;
-
-        if (eventLoop.timeouts[i].timer == timer) {
-            eventLoop.timeouts[i].deleted = 1;
-            virEventPollInterruptLocked();
-            virMutexUnlock(&eventLoop.lock);
-            return 0;
-        }
+    if ((t = virEventPollFindTimeout(timer)) && !t->deleted) {
+        t->deleted = 1;
+        eventLoop.timeoutsDeleted++;
+        virEventPollScheduleTimeout(t);
+        virEventPollInterruptLocked();
+        virMutexUnlock(&eventLoop.lock);
+        return 0;
     }
     virMutexUnlock(&eventLoop.lock);
     return -1;
 }
 
-/* Iterates over all registered timeouts and determine which
- * will be the first to expire.
+/* Looks at the soonest timer to expire, at the top of the heap.
  * @timeout: filled with expiry time of soonest timer, or -1 if
  *           no timeout is pending
  * returns: 0 on success, -1 on error
  */
 static int virEventPollCalculateTimeout(int *timeout) {
     unsigned long long then = 0;
-    size_t i;
-    EVENT_DEBUG("Calculate expiry of %zu timers", eventLoop.timeoutsCount);
+    EVENT_DEBUG("Calculate expiry of %zu timers", eventLoop.timeoutsHeapCount);
     /* Figure out if we need a timeout */
-    for (i = 0; i < eventLoop.timeoutsCount; i++) {
-        if (eventLoop.timeouts[i].deleted)
-            continue;
-        if (eventLoop.timeouts[i].frequency < 0)
-            continue;
-
-        EVENT_DEBUG("Got a timeout scheduled for %llu", eventLoop.timeouts[i].expiresAt);
-        if (then == 0 ||
-            eventLoop.timeouts[i].expiresAt < then)
-            then = eventLoop.timeouts[i].expiresAt;
+    if (eventLoop.timeoutsHeapCount) {
+        then = eventLoop.timeoutsHeap[0]->expiresAt;
+        EVENT_DEBUG("Got a timeout scheduled for %llu", then);
     }
 
     /* Calculate how long we should wait for a timeout if needed */
@@ -406,11 +669,36 @@ static struct pollfd *virEventPollMakePollFDs(int *nfds) {
 
 
 /*
- * Iterate over all timers and determine if any have expired.
- * Invoke the user supplied callback for each timer whose
- * expiry time is met, and schedule the next timeout. Does
- * not try to 'catch up' on time if the actual expiry time
- * was later than the requested time.
+ * Walk the part of the heap holding timers that expire no later
+ * than @deadline, which is all of the heap below such a timer
+ */
+static void virEventPollCollectTimeouts(size_t i,
+                                        unsigned long long deadline,
+                                        size_t *ndue)
+{
+    if (i >= eventLoop.timeoutsHeapCount ||
+        eventLoop.timeoutsHeap[i]->expiresAt > deadline)
+        return;
+
+    eventLoop.timeoutsDue[(*ndue)++] = eventLoop.timeoutsHeap[i]->timer;
+    virEventPollCollectTimeouts(2 * i + 1, deadline, ndue);
+    virEventPollCollectTimeouts(2 * i + 2, deadline, ndue);
+}
+
+static int virEventPollCompareTimers(const void *a, const void *b)
+{
+    int ta = *(const int *)a;
+    int tb = *(const int *)b;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+/*
+ * Determine which timers have expired, by looking at the top of
+ * the heap only. Invoke the user supplied callback for each timer
+ * whose expiry time is met, in order of registration, and schedule
+ * the next timeout. Does not try to 'catch up' on time if the
+ * actual expiry time was later than the requested time.
  *
  * This method must cope with new timers being registered
  * by a callback, and must skip any timers marked as deleted.
@@ -420,37 +708,46 @@ static struct pollfd *virEventPollMakePollFDs(int *nfds) {
 static int virEventPollDispatchTimeouts(void)
 {
     unsigned long long now;
+    size_t ndue = 0;
     size_t i;
-    /* Save this now - it may be changed during dispatch */
-    int ntimeouts = eventLoop.timeoutsCount;
-    VIR_DEBUG("Dispatch %d", ntimeouts);
 
     if (virTimeMillisNow(&now) < 0)
         return -1;
 
-    for (i = 0; i < ntimeouts; i++) {
-        if (eventLoop.timeouts[i].deleted || eventLoop.timeouts[i].frequency < 0)
+    /* Add 20ms fuzz so we don't pointlessly spin doing
+     * <10ms sleeps, particularly on kernels with low HZ
+     * it is fine that a timer expires 20ms earlier than
+     * requested
+     */
+    virEventPollCollectTimeouts(0, now + 20, &ndue);
+    qsort(eventLoop.timeoutsDue, ndue, sizeof(*eventLoop.timeoutsDue),
+          virEventPollCompareTimers);
+    VIR_DEBUG("Dispatch %zu", ndue);
+
+    for (i = 0; i < ndue; i++) {
+        struct virEventPollTimeout *t =
+            virEventPollFindTimeout(eventLoop.timeoutsDue[i]);
+        virEventTimeoutCallback cb;
+        int timer;
+        void *opaque;
+
+        /* An earlier callback may have changed this one */
+        if (!t || t->deleted || t->frequency < 0 ||
+            t->expiresAt > now + 20)
             continue;
 
-        /* Add 20ms fuzz so we don't pointlessly spin doing
-         * <10ms sleeps, particularly on kernels with low HZ
-         * it is fine that a timer expires 20ms earlier than
-         * requested
-         */
-        if (eventLoop.timeouts[i].expiresAt <= (now+20)) {
-            virEventTimeoutCallback cb = eventLoop.timeouts[i].cb;
-            int timer = eventLoop.timeouts[i].timer;
-            void *opaque = eventLoop.timeouts[i].opaque;
-            eventLoop.timeouts[i].expiresAt =
-                now + eventLoop.timeouts[i].frequency;
-
-            PROBE(EVENT_POLL_DISPATCH_TIMEOUT,
-                  "timer=%d",
-                  timer);
-            virMutexUnlock(&eventLoop.lock);
-            (cb)(timer, opaque);
-            virMutexLock(&eventLoop.lock);
-        }
+        cb = t->cb;
+        timer = t->timer;
+        opaque = t->opaque;
+        t->expiresAt = now + t->frequency;
+        virEventPollScheduleTimeout(t);
+
+        PROBE(EVENT_POLL_DISPATCH_TIMEOUT,
+              "timer=%d",
+              timer);
+        virMutexUnlock(&eventLoop.lock);
+        (cb)(timer, opaque);
+        virMutexLock(&eventLoop.lock);
     }
     return 0;
 }
@@ -507,6 +804,95 @@ static int virEventPollDispatchHandles(int nfds, struct pollfd *fds) {
 }
 
 
+#if HAVE_SYS_EPOLL_H
+/*
+ * Deal with an event for a watch which is gone, or no longer waits
+ * for anything. Usually that is a leftover of the current batch, from
+ * a handle a callback just changed. But if removing the entry didn't
+ * reach the kernel, e.g. because the fd got closed while a duplicate
+ * keeps the file open, it would fire on every iteration: try removing
+ * it again, and if the same watch still shows up in the next
+ * iteration, fall back to poll().
+ */
+static void virEventPollDropStaleEpoll(int watch, int fd,
+                                       int *stale, size_t *nstale)
+{
+    size_t i;
+
+    for (i = 0; i < eventLoop.epollStaleCount; i++) {
+        if (eventLoop.epollStale[i] == watch) {
+            VIR_DEBUG("Unable to remove fd %d of watch %d from epoll",
+                      fd, watch);
+            virEventPollDisableEpoll();
+            return;
+        }
+    }
+
+    /* Leave the fd alone if it got registered again meanwhile */
+    for (i = 0; i < eventLoop.handlesCount; i++) {
+        if (eventLoop.handles[i].registered &&
+            eventLoop.handles[i].fd == fd)
+            break;
+    }
+    if (i == eventLoop.handlesCount)
+        ignore_value(epoll_ctl(eventLoop.epollfd, EPOLL_CTL_DEL, fd, NULL));
+
+    stale[(*nstale)++] = watch;
+}
+
+/* Dispatch the file handles reported ready by epoll_wait().
+ * Handles are looked up afresh for each event, since callbacks
+ * may add or remove handles, or change what they wait for.
+ *
+ * Returns 0 upon success, -1 if an error occurred
+ */
+static int virEventPollDispatchEpoll(int nevents)
+{
+    int stale[EVENT_EPOLL_MAX_EVENTS];
+    size_t nstale = 0;
+    size_t n;
+    VIR_DEBUG("Dispatch %d", nevents);
+
+    for (n = 0; n < nevents; n++) {
+        struct epoll_event *ev = &eventLoop.epollEvents[n];
+        int watch = EVENT_EPOLL_WATCH(ev->data.u64);
+        ssize_t i = virEventPollFindHandle(watch);
+
+        if (i < 0 ||
+            eventLoop.handles[i].deleted ||
+            !eventLoop.handles[i].events) {
+            EVENT_DEBUG("Skip stale event w=%d", watch);
+            if (eventLoop.epollfd != -1)
+                virEventPollDropStaleEpoll(watch,
+                                           EVENT_EPOLL_FD(ev->data.u64),
+                                           stale, &nstale);
+            continue;
+        }
+
+        if (ev->events) {
+            virEventHandleCallback cb = eventLoop.handles[i].cb;
+            int fd = eventLoop.handles[i].fd;
+            void *opaque = eventLoop.handles[i].opaque;
+            int hEvents = virEventPollFromEpollEvents(ev->events);
+            PROBE(EVENT_POLL_DISPATCH_HANDLE,
+                  "watch=%d events=%d",
+                  watch, hEvents);
+            virMutexUnlock(&eventLoop.lock);
+            (cb)(watch, fd, hEvents, opaque);
+            virMutexLock(&eventLoop.lock);
+        }
+    }
+
+    memcpy(eventLoop.epollStale, stale, nstale * sizeof(*stale));
+    eventLoop.epollStaleCount = nstale;
+
+    return 0;
+}
+
+
+#endif /* HAVE_SYS_EPOLL_H */
+
+
 /* Used post dispatch to actually remove any timers that
  * were previously marked as deleted. This asynchronous
  * cleanup is needed to make dispatch re-entrant safe.
@@ -514,23 +900,29 @@ static int virEventPollDispatchHandles(int nfds, struct pollfd *fds) {
 static void virEventPollCleanupTimeouts(void) {
     size_t i;
     size_t gap;
+
+    if (!eventLoop.timeoutsDeleted)
+        return;
+
     VIR_DEBUG("Cleanup %zu", eventLoop.timeoutsCount);
 
     /* Remove deleted entries, shuffling down remaining
      * entries as needed to form contiguous series
      */
     for (i = 0; i < eventLoop.timeoutsCount;) {
-        if (!eventLoop.timeouts[i].deleted) {
+        struct virEventPollTimeout *t = eventLoop.timeouts[i];
+
+        if (!t->deleted) {
             i++;
             continue;
         }
 
         PROBE(EVENT_POLL_PURGE_TIMEOUT,
               "timer=%d",
-              eventLoop.timeouts[i].timer);
-        if (eventLoop.timeouts[i].ff) {
-            virFreeCallback ff = eventLoop.timeouts[i].ff;
-            void *opaque = eventLoop.timeouts[i].opaque;
+              t->timer);
+        if (t->ff) {
+            virFreeCallback ff = t->ff;
+            void *opaque = t->opaque;
             virMutexUnlock(&eventLoop.lock);
             ff(opaque);
             virMutexLock(&eventLoop.lock);
@@ -539,10 +931,12 @@ static void virEventPollCleanupTimeouts(void) {
         if ((i+1) < eventLoop.timeoutsCount) {
             memmove(eventLoop.timeouts+i,
                     eventLoop.timeouts+i+1,
-                    sizeof(struct virEventPollTimeout)*(eventLoop.timeoutsCount
-                                                    -(i+1)));
+                    sizeof(*eventLoop.timeouts)*(eventLoop.timeoutsCount
+                                                 -(i+1)));
         }
         eventLoop.timeoutsCount--;
+        eventLoop.timeoutsDeleted--;
+        VIR_FREE(t);
     }
 
     /* Release some memory if we've got a big chunk free */
@@ -603,6 +997,61 @@ static void virEventPollCleanupHandles(void) {
     }
 }
 
+#if HAVE_SYS_EPOLL_H
+/*
+ * Run a single iteration of the event loop on top of epoll
+ */
+static int virEventPollRunOnceEpoll(void)
+{
+    int ret, timeout;
+    int epollfd = eventLoop.epollfd;
+
+    if (virEventPollCalculateTimeout(&timeout) < 0)
+        goto error;
+
+    virMutexUnlock(&eventLoop.lock);
+
+ retry:
+    PROBE(EVENT_POLL_RUN,
+          "nhandles=%zu timeout=%d",
+          eventLoop.handlesCount, timeout);
+    ret = epoll_wait(epollfd, eventLoop.epollEvents,
+                     EVENT_EPOLL_MAX_EVENTS, timeout);
+    if (ret < 0) {
+        EVENT_DEBUG("Poll got error event %d", errno);
+        if (errno == EINTR || errno == EAGAIN) {
+            goto retry;
+        }
+        virReportSystemError(errno, "%s",
+                             _("Unable to poll on file handles"));
+        goto error_unlocked;
+    }
+    EVENT_DEBUG("Poll got %d event(s)", ret);
+
+    virMutexLock(&eventLoop.lock);
+    VIR_FORCE_CLOSE(eventLoop.epollfdStale);
+
+    if (virEventPollDispatchTimeouts() < 0)
+        goto error;
+
+    if (ret > 0 &&
+        virEventPollDispatchEpoll(ret) < 0)
+        goto error;
+
+    virEventPollCleanupTimeouts();
+    virEventPollCleanupHandles();
+
+    eventLoop.running = 0;
+    virMutexUnlock(&eventLoop.lock);
+    return 0;
+
+error:
+    virMutexUnlock(&eventLoop.lock);
+error_unlocked:
+    return -1;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
 /*
  * Run a single iteration of the event loop, blocking until
  * at least one file handle has an event, or a timer expires
@@ -614,10 +1063,16 @@ int virEventPollRunOnce(void) {
     virMutexLock(&eventLoop.lock);
     eventLoop.running = 1;
     virThreadSelf(&eventLoop.leader);
+    VIR_FORCE_CLOSE(eventLoop.epollfdStale);
 
     virEventPollCleanupTimeouts();
     virEventPollCleanupHandles();
 
+#if HAVE_SYS_EPOLL_H
+    if (eventLoop.epollfd != -1)
+        return virEventPollRunOnceEpoll();
+#endif
+
     if (!(fds = virEventPollMakePollFDs(&nfds)) ||
         virEventPollCalculateTimeout(&timeout) < 0)
         goto error;
@@ -641,6 +1096,7 @@ int virEventPollRunOnce(void) {
     EVENT_DEBUG("Poll got %d event(s)", ret);
 
     virMutexLock(&eventLoop.lock);
+    VIR_FORCE_CLOSE(eventLoop.epollfdStale);
     if (virEventPollDispatchTimeouts() < 0)
         goto error;
 
@@ -675,14 +1131,34 @@ static void virEventPollHandleWakeup(int watch ATTRIBUTE_UNUSED,
     virMutexUnlock(&eventLoop.lock);
 }
 
+/*
+ * File handles are watched with epoll where available, unless
+ * LIBVIRT_EVENT_BACKEND=poll asks for the portable poll() loop
+ */
 int virEventPollInit(void)
 {
+#if HAVE_SYS_EPOLL_H
+    const char *backend = virGetEnvBlockSUID("LIBVIRT_EVENT_BACKEND");
+#endif
+
     if (virMutexInit(&eventLoop.lock) < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to initialize mutex"));
         return -1;
     }
 
+    eventLoop.epollfd = -1;
+    eventLoop.epollfdStale = -1;
+#if HAVE_SYS_EPOLL_H
+    if (backend && STRNEQ(backend, "epoll") && STRNEQ(backend, "poll"))
+        VIR_WARN("Ignoring unknown event loop backend '%s'", backend);
+    if ((!backend || STRNEQ(backend, "poll")) &&
+        (eventLoop.epollfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        VIR_DEBUG("Unable to create epoll fd, using poll(): %d", errno);
+    VIR_DEBUG("Using %s for file handles",
+              eventLoop.epollfd != -1 ? "epoll" : "poll()");
+#endif
+
     if (pipe2(eventLoop.wakeupfd, O_CLOEXEC | O_NONBLOCK) < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to setup wakeup pipe"));
@@ -29,27 +29,44 @@
 #include "viralloc.h"
 #include "virthread.h"
 #include "virerror.h"
+#include "virlog.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+/* How long, in milliseconds, an ordinary worker above the minimum
+ * count may sit idle before it exits, unless set otherwise */
+#define VIR_THREAD_POOL_IDLE_TIMEOUT (60 * 1000)
+
 typedef struct _virThreadPoolJob virThreadPoolJob;
 typedef virThreadPoolJob *virThreadPoolJobPtr;
 
+typedef struct _virThreadPoolJobList virThreadPoolJobList;
+typedef virThreadPoolJobList *virThreadPoolJobListPtr;
+
 struct _virThreadPoolJob {
+    /* Siblings in the owner's list */
     virThreadPoolJobPtr prev;
     virThreadPoolJobPtr next;
+    /* Siblings in the pool's priority queue */
+    virThreadPoolJobPtr prioPrev;
+    virThreadPoolJobPtr prioNext;
+
+    virThreadPoolJobListPtr list;
     unsigned int priority;
+    unsigned long long queued;
 
     void *data;
 };
 
-typedef struct _virThreadPoolJobList virThreadPoolJobList;
-typedef virThreadPoolJobList *virThreadPoolJobListPtr;
-
+/* Pending jobs of a single owner, in the order they were sent */
 struct _virThreadPoolJobList {
+    virThreadPoolJobListPtr prev;
+    virThreadPoolJobListPtr next;
+
+    const void *owner;
     virThreadPoolJobPtr head;
     virThreadPoolJobPtr tail;
-    virThreadPoolJobPtr firstPrio;
 };
 
 
@@ -58,8 +75,14 @@ struct _virThreadPool {
 
     virThreadPoolJobFunc jobFunc;
     void *jobOpaque;
-    virThreadPoolJobList jobList;
+    /* Owners with pending jobs, taking turns from the head */
+    virThreadPoolJobListPtr jobLists;
+    virThreadPoolJobListPtr jobListsTail;
     size_t jobQueueDepth;
+    /* Priority jobs of all owners, in the order they were sent */
+    virThreadPoolJobPtr prioHead;
+    virThreadPoolJobPtr prioTail;
+    size_t jobPrioDepth;
 
     virMutex mutex;
     virCond cond;
@@ -70,10 +93,16 @@ struct _virThreadPool {
     size_t freeWorkers;
     size_t nWorkers;
     virThreadPtr workers;
+    unsigned long long idleTimeout;
+    /* Idle workers that exited and are yet to be joined */
+    size_t nRetiredWorkers;
+    virThreadPtr retiredWorkers;
 
     size_t nPrioWorkers;
     virThreadPtr prioWorkers;
     virCond prioCond;
+
+    virThreadPoolStats stats;
 };
 
 struct virThreadPoolWorkerData {
@@ -82,6 +111,116 @@ struct virThreadPoolWorkerData {
     bool priority;
 };
 
+static void virThreadPoolAppendList(virThreadPoolPtr pool,
+                                    virThreadPoolJobListPtr list)
+{
+    list->next = NULL;
+    list->prev = pool->jobListsTail;
+    if (pool->jobListsTail)
+        pool->jobListsTail->next = list;
+    else
+        pool->jobLists = list;
+    pool->jobListsTail = list;
+}
+
+static void virThreadPoolUnlinkList(virThreadPoolPtr pool,
+                                    virThreadPoolJobListPtr list)
+{
+    if (list->prev)
+        list->prev->next = list->next;
+    else
+        pool->jobLists = list->next;
+    if (list->next)
+        list->next->prev = list->prev;
+    else
+        pool->jobListsTail = list->prev;
+    list->prev = list->next = NULL;
+}
+
+/*
+ * Take the next job to run off the queue. Ordinary workers pick
+ * the oldest job of the owner whose turn it is, priority workers
+ * the oldest priority job. Either way that owner then goes to the
+ * back of the line, so an owner with lots of pending jobs can't
+ * hold up the others.
+ */
+static virThreadPoolJobPtr virThreadPoolTakeJob(virThreadPoolPtr pool,
+                                                bool priority)
+{
+    virThreadPoolJobPtr job = priority ? pool->prioHead : pool->jobLists->head;
+    virThreadPoolJobListPtr list = job->list;
+
+    if (job->prev)
+        job->prev->next = job->next;
+    else
+        list->head = job->next;
+    if (job->next)
+        job->next->prev = job->prev;
+    else
+        list->tail = job->prev;
+
+    if (job->priority) {
+        if (job->prioPrev)
+            job->prioPrev->prioNext = job->prioNext;
+        else
+            pool->prioHead = job->prioNext;
+        if (job->prioNext)
+            job->prioNext->prioPrev = job->prioPrev;
+        else
+            pool->prioTail = job->prioPrev;
+        pool->jobPrioDepth--;
+    }
+    pool->jobQueueDepth--;
+
+    virThreadPoolUnlinkList(pool, list);
+    if (list->head)
+        virThreadPoolAppendList(pool, list);
+    else
+        VIR_FREE(list);
+
+    return job;
+}
+
+/*
+ * Called by an ordinary worker that has been idle for too long.
+ * Moves its thread over to the list of workers to be joined.
+ * Return: 0 if the worker should exit, -1 otherwise
+ */
+static int virThreadPoolRetireWorker(virThreadPoolPtr pool)
+{
+    size_t i;
+
+    for (i = 0; i < pool->nWorkers; i++) {
+        if (virThreadIsSelf(&pool->workers[i]))
+            break;
+    }
+    if (i == pool->nWorkers)
+        return -1;
+
+    if (VIR_APPEND_ELEMENT_COPY_QUIET(pool->retiredWorkers,
+                                      pool->nRetiredWorkers,
+                                      pool->workers[i]) < 0)
+        return -1;
+    VIR_DELETE_ELEMENT(pool->workers, i, pool->nWorkers);
+    pool->stats.workersRetired++;
+    return 0;
+}
+
+/*
+ * Join the workers that exited after being idle. They are done
+ * with the pool by the time they release its mutex, so the caller
+ * can hold it.
+ */
+static void virThreadPoolJoinRetiredWorkers(virThreadPoolPtr pool)
+{
+    size_t i;
+
+    for (i = 0; i < pool->nRetiredWorkers; i++)
+        virThreadJoin(&pool->retiredWorkers[i]);
+    VIR_FREE(pool->retiredWorkers);
+    pool->nRetiredWorkers = 0;
+}
+
 static void virThreadPoolWorker(void *opaque)
 {
     struct virThreadPoolWorkerData *data = opaque;
@@ -89,6 +228,8 @@ static void virThreadPoolWorker(void *opaque)
     virCondPtr cond = data->cond;
     bool priority = data->priority;
     virThreadPoolJobPtr job = NULL;
+    unsigned long long now;
+    unsigned long long elapsed;
 
     VIR_FREE(data);
 
@@ -96,54 +237,62 @@ static void virThreadPoolWorker(void *opaque)
 
     while (1) {
         while (!pool->quit &&
-               ((!priority && !pool->jobList.head) ||
-                (priority && !pool->jobList.firstPrio))) {
+               ((!priority && !pool->jobLists) ||
+                (priority && !pool->prioHead))) {
+            bool idle = false;
+            int rc;
+
             if (!priority)
                 pool->freeWorkers++;
-            if (virCondWait(cond, &pool->mutex) < 0) {
-                if (!priority)
-                    pool->freeWorkers--;
-                goto out;
+            if (!priority && pool->nWorkers > pool->minWorkers &&
+                virTimeMillisNow(&now) == 0) {
+                rc = virCondWaitUntil(cond, &pool->mutex,
+                                      now + pool->idleTimeout);
+                if (rc < 0 && errno == ETIMEDOUT) {
+                    rc = 0;
+                    idle = true;
+                }
+            } else {
+                rc = virCondWait(cond, &pool->mutex);
             }
             if (!priority)
                 pool->freeWorkers--;
+            if (rc < 0)
+                goto out;
+
+            if (idle && !pool->quit && !pool->jobLists &&
+                pool->nWorkers > pool->minWorkers &&
+                virThreadPoolRetireWorker(pool) == 0) {
+                virMutexUnlock(&pool->mutex);
+                return;
+            }
         }
 
         if (pool->quit)
             break;
 
-        if (priority) {
-            job = pool->jobList.firstPrio;
-        } else {
-            job = pool->jobList.head;
-        }
+        job = virThreadPoolTakeJob(pool, priority);
 
-        if (job == pool->jobList.firstPrio) {
-            virThreadPoolJobPtr tmp = job->next;
-            while (tmp) {
-                if (tmp->priority) {
-                    break;
-                }
-                tmp = tmp->next;
-            }
-            pool->jobList.firstPrio = tmp;
-        }
-
-        if (job->prev)
-            job->prev->next = job->next;
-        else
-            pool->jobList.head = job->next;
-        if (job->next)
-            job->next->prev = job->prev;
-        else
-            pool->jobList.tail = job->prev;
-
-        pool->jobQueueDepth--;
+        if (virTimeMillisNow(&now) < 0)
+            now = job->queued;
+        elapsed = now > job->queued ? now - job->queued : 0;
+        pool->stats.waitTotal += elapsed;
+        if (elapsed > pool->stats.waitMax)
+            pool->stats.waitMax = elapsed;
 
         virMutexUnlock(&pool->mutex);
         (pool->jobFunc)(job->data, pool->jobOpaque);
         VIR_FREE(job);
+
+        if (virTimeMillisNow(&elapsed) < 0)
+            elapsed = now;
+        elapsed = elapsed > now ? elapsed - now : 0;
         virMutexLock(&pool->mutex);
+
+        pool->stats.jobsDone++;
+        pool->stats.serviceTotal += elapsed;
+        if (elapsed > pool->stats.serviceMax)
+            pool->stats.serviceMax = elapsed;
     }
 
 out:
@@ -172,8 +321,6 @@ virThreadPoolPtr virThreadPoolNew(size_t minWorkers,
     if (VIR_ALLOC(pool) < 0)
         return NULL;
 
-    pool->jobList.tail = pool->jobList.head = NULL;
-
     pool->jobFunc = func;
     pool->jobOpaque = opaque;
 
@@ -189,6 +336,7 @@ virThreadPoolPtr virThreadPoolNew(size_t minWorkers,
 
     pool->minWorkers = minWorkers;
     pool->maxWorkers = maxWorkers;
+    pool->idleTimeout = VIR_THREAD_POOL_IDLE_TIMEOUT;
 
     for (i = 0; i < minWorkers; i++) {
         if (VIR_ALLOC(data) < 0)
@@ -239,6 +387,7 @@ error:
 
 void virThreadPoolFree(virThreadPoolPtr pool)
 {
+    virThreadPoolJobListPtr list;
     virThreadPoolJobPtr job;
     bool priority = false;
     size_t i;
@@ -262,9 +411,20 @@ void virThreadPoolFree(virThreadPoolPtr pool)
     while (pool->nWorkers > 0 || pool->nPrioWorkers > 0)
         ignore_value(virCondWait(&pool->quit_cond, &pool->mutex));
 
-    while ((job = pool->jobList.head)) {
-        pool->jobList.head = pool->jobList.head->next;
-        VIR_FREE(job);
+    VIR_DEBUG("pool=%p jobs=%llu wait=%llu/%llums service=%llu/%llums "
+              "retired=%zu",
+              pool, pool->stats.jobsDone,
+              pool->stats.waitTotal, pool->stats.waitMax,
+              pool->stats.serviceTotal, pool->stats.serviceMax,
+              pool->stats.workersRetired);
+
+    while ((list = pool->jobLists)) {
+        while ((job = list->head)) {
+            list->head = job->next;
+            VIR_FREE(job);
+        }
+        pool->jobLists = list->next;
+        VIR_FREE(list);
     }
 
     for (i = 0; i < nWorkers; i++)
@@ -273,6 +433,8 @@ void virThreadPoolFree(virThreadPoolPtr pool)
     for (i = 0; i < nPrioWorkers; i++)
         virThreadJoin(&pool->prioWorkers[i]);
 
+    virThreadPoolJoinRetiredWorkers(pool);
+
     VIR_FREE(pool->workers);
     virMutexUnlock(&pool->mutex);
     virMutexDestroy(&pool->mutex);
@@ -301,6 +463,38 @@ size_t virThreadPoolGetPriorityWorkers(virThreadPoolPtr pool)
     return pool->nPrioWorkers;
 }
 
+/*
+ * @timeout - milliseconds an ordinary worker above the minimum count
+ *            may sit idle before it exits
+ *
+ * Workers already waiting pick the new value up after their
+ * current wait.
+ */
+void virThreadPoolSetIdleTimeout(virThreadPoolPtr pool,
+                                 unsigned long long timeout)
+{
+    virMutexLock(&pool->mutex);
+    pool->idleTimeout = timeout;
+    virMutexUnlock(&pool->mutex);
+}
+
+/*
+ * @stats - filled with the current state of the pool and the
+ *          counters accumulated since it was created
+ */
+void virThreadPoolGetStats(virThreadPoolPtr pool,
+                           virThreadPoolStatsPtr stats)
+{
+    virMutexLock(&pool->mutex);
+    *stats = pool->stats;
+    stats->nWorkers = pool->nWorkers;
+    stats->freeWorkers = pool->freeWorkers;
+    stats->nPrioWorkers = pool->nPrioWorkers;
+    stats->jobQueueDepth = pool->jobQueueDepth;
+    stats->jobPrioDepth = pool->jobPrioDepth;
+    virMutexUnlock(&pool->mutex);
+}
+
 /*
  * @priority - job priority
  * Return: 0 on success, -1 otherwise
@@ -309,14 +503,44 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
                          unsigned int priority,
                          void *jobData)
 {
+    return virThreadPoolSendJobFull(pool, priority, NULL, jobData);
+}
+
+/*
+ * @priority - job priority
+ * @owner - on whose behalf the job is sent, or NULL
+ *
+ * Jobs of one owner are started in the order they were sent,
+ * while different owners take turns, one job at a time.
+ *
+ * Return: 0 on success, -1 otherwise
+ */
+int virThreadPoolSendJobFull(virThreadPoolPtr pool,
+                             unsigned int priority,
+                             const void *owner,
+                             void *jobData)
+{
+    virThreadPoolJobListPtr list;
     virThreadPoolJobPtr job;
     struct virThreadPoolWorkerData *data = NULL;
 
+    /* Keep the work done under the mutex down to linking the job */
+    if (VIR_ALLOC(job) < 0)
+        return -1;
+
+    job->data = jobData;
+    job->priority = priority;
+    if (virTimeMillisNow(&job->queued) < 0)
+        job->queued = 0;
+
     virMutexLock(&pool->mutex);
     if (pool->quit)
         goto error;
 
-    if (pool->freeWorkers - pool->jobQueueDepth <= 0 &&
+    if (pool->nRetiredWorkers)
+        virThreadPoolJoinRetiredWorkers(pool);
+
+    if (pool->freeWorkers <= pool->jobQueueDepth &&
         pool->nWorkers < pool->maxWorkers) {
         if (VIR_EXPAND_N(pool->workers, pool->nWorkers, 1) < 0)
             goto error;
@@ -339,27 +563,44 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
         }
     }
 
-    if (VIR_ALLOC(job) < 0)
-        goto error;
-
-    job->data = jobData;
-    job->priority = priority;
-
-    job->prev = pool->jobList.tail;
-    if (pool->jobList.tail)
-        pool->jobList.tail->next = job;
-    pool->jobList.tail = job;
+    for (list = pool->jobLists; list; list = list->next) {
+        if (list->owner == owner)
+            break;
+    }
 
-    if (!pool->jobList.head)
-        pool->jobList.head = job;
+    if (!list) {
+        if (VIR_ALLOC(list) < 0)
+            goto error;
+        list->owner = owner;
+        virThreadPoolAppendList(pool, list);
+    }
 
-    if (priority && !pool->jobList.firstPrio)
-        pool->jobList.firstPrio = job;
+    job->list = list;
+    job->prev = list->tail;
+    if (list->tail)
+        list->tail->next = job;
+    else
+        list->head = job;
+    list->tail = job;
 
+    if (priority) {
+        job->prioPrev = pool->prioTail;
+        if (pool->prioTail)
+            pool->prioTail->prioNext = job;
+        else
+            pool->prioHead = job;
+        pool->prioTail = job;
+        pool->jobPrioDepth++;
+    }
     pool->jobQueueDepth++;
-
-    virCondSignal(&pool->cond);
-    if (priority)
+    if (pool->jobQueueDepth > pool->stats.jobQueueDepthMax)
+        pool->stats.jobQueueDepthMax = pool->jobQueueDepth;
+
+    /* Only wake a worker if one is waiting; busy ones will come
+     * back for the job by themselves */
+    if (pool->freeWorkers)
+        virCondSignal(&pool->cond);
+    if (priority && pool->nPrioWorkers)
         virCondSignal(&pool->prioCond);
 
     virMutexUnlock(&pool->mutex);
@@ -367,5 +608,6 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
 
 error:
     virMutexUnlock(&pool->mutex);
+    VIR_FREE(job);
     return -1;
 }
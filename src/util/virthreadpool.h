@@ -33,6 +33,27 @@ typedef virThreadPool *virThreadPoolPtr;
 
 typedef void (*virThreadPoolJobFunc)(void *jobdata, void *opaque);
 
+typedef struct _virThreadPoolStats virThreadPoolStats;
+typedef virThreadPoolStats *virThreadPoolStatsPtr;
+
+/* Times are in milliseconds */
+struct _virThreadPoolStats {
+    size_t nWorkers;
+    size_t freeWorkers;
+    size_t nPrioWorkers;
+    size_t workersRetired;      /* idle workers that exited */
+
+    size_t jobQueueDepth;
+    size_t jobQueueDepthMax;
+    size_t jobPrioDepth;
+
+    unsigned long long jobsDone;
+    unsigned long long waitTotal;    /* from being sent to being started */
+    unsigned long long waitMax;
+    unsigned long long serviceTotal; /* spent in the job function */
+    unsigned long long serviceMax;
+};
+
 virThreadPoolPtr virThreadPoolNew(size_t minWorkers,
                                   size_t maxWorkers,
                                   size_t prioWorkers,
@@ -42,6 +63,12 @@ virThreadPoolPtr virThreadPoolNew(size_t minWorkers,
 size_t virThreadPoolGetMinWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetMaxWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetPriorityWorkers(virThreadPoolPtr pool);
+void virThreadPoolSetIdleTimeout(virThreadPoolPtr pool,
+                                 unsigned long long timeout)
+    ATTRIBUTE_NONNULL(1);
+void virThreadPoolGetStats(virThreadPoolPtr pool,
+                           virThreadPoolStatsPtr stats)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
 void virThreadPoolFree(virThreadPoolPtr pool);
 
@@ -50,4 +77,10 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
                          void *jobdata) ATTRIBUTE_NONNULL(1)
                                         ATTRIBUTE_RETURN_CHECK;
 
+int virThreadPoolSendJobFull(virThreadPoolPtr pool,
+                             unsigned int priority,
+                             const void *owner,
+                             void *jobdata) ATTRIBUTE_NONNULL(1)
+                                            ATTRIBUTE_RETURN_CHECK;
+
 #endif
@@ -977,6 +977,11 @@ mymain(void)
     /* Make sure to not leak fd's */
     virinitret = virInitialize();
 
+    /* The event loop holds on to a varying number of fds,
+     * depending on whether it uses poll() or epoll */
+    if (virinitret >= 0)
+        virEventRegisterDefaultImpl();
+
     /* Phase two of killing interfering fds; see above.  */
     /* coverity[overwrite_var] - silence the obvious */
     fd = 3;
@@ -995,7 +1000,6 @@ mymain(void)
     if (virinitret < 0)
         return EXIT_FAILURE;
 
-    virEventRegisterDefaultImpl();
     if (VIR_ALLOC(test) < 0)
         goto cleanup;
 
@@ -53,6 +53,13 @@ static struct timerInfo {
     int delete;
 } timers[NUM_TIME];
 
+/* A handle outside of the above, which removes itself once fired */
+static struct otherInfo {
+    int watch;
+    int fired;
+    int events;
+} other;
+
 enum {
     EV_ERROR_NONE,
     EV_ERROR_WATCH,
@@ -94,6 +101,16 @@ testPipeReader(int watch, int fd, int events, void *data)
 }
 
 
+static void
+testOther(int watch, int fd ATTRIBUTE_UNUSED, int events,
+          void *data ATTRIBUTE_UNUSED)
+{
+    other.fired++;
+    other.events = events;
+    virEventPollRemoveHandle(watch);
+}
+
+
 static void
 testTimer(int timer, void *data)
 {
@@ -264,6 +281,11 @@ mymain(void)
     size_t i;
     pthread_t eventThread;
     char one = '1';
+    int otherFD[2];
+#if HAVE_SYS_EPOLL_H
+    int dupFD;
+    const char *backend;
+#endif
 
     for (i = 0; i < NUM_FDS; i++) {
         if (pipe(handles[i].pipeFD) < 0) {
@@ -470,6 +492,95 @@ mymain(void)
     if (finishJob("Write duplicate", 1, -1) != EXIT_SUCCESS)
         return EXIT_FAILURE;
 
+    resetAll();
+
+    /* A handle waiting for no events doesn't hear about a hangup,
+     * until it waits for events again */
+    if (pipe(otherFD) < 0) {
+        fprintf(stderr, "Cannot create pipe: %d", errno);
+        return EXIT_FAILURE;
+    }
+    VIR_FORCE_CLOSE(otherFD[1]);
+    other.watch = virEventPollAddHandle(otherFD[0], 0, testOther, NULL, NULL);
+    startJob();
+    pthread_mutex_unlock(&eventThreadMutex);
+    sched_yield();
+    usleep(100 * 1000);
+    pthread_mutex_lock(&eventThreadMutex);
+    if (safewrite(handles[NUM_FDS - 1].pipeFD[1], &one, 1) != 1)
+        return EXIT_FAILURE;
+    if (finishJob("Hangup without events", NUM_FDS - 1, -1) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (other.fired) {
+        virtTestResult("Hangup without events", 1,
+                       "Handle without events fired with %d\n",
+                       other.events);
+        return EXIT_FAILURE;
+    }
+
+    resetAll();
+
+    virEventPollUpdateHandle(other.watch, VIR_EVENT_HANDLE_READABLE);
+    startJob();
+    if (finishJob("Hangup after update", -1, -1) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (other.fired != 1 || !(other.events & VIR_EVENT_HANDLE_HANGUP)) {
+        virtTestResult("Hangup after update", 1,
+                       "Handle fired %d times with %d, expected a hangup\n",
+                       other.fired, other.events);
+        return EXIT_FAILURE;
+    }
+    VIR_FORCE_CLOSE(otherFD[0]);
+
+    resetAll();
+
+#if HAVE_SYS_EPOLL_H
+    /* Closing an fd before removing its handle leaves the epoll entry
+     * behind while a duplicate keeps the file open. The stale events
+     * it reports must not make the loop spin: after at most two
+     * iterations it has to block again */
+    backend = getenv("LIBVIRT_EVENT_BACKEND");
+    if (!backend || STREQ(backend, "epoll")) {
+        if (pipe(otherFD) < 0 || (dupFD = dup(otherFD[0])) < 0) {
+            fprintf(stderr, "Cannot create pipe: %d", errno);
+            return EXIT_FAILURE;
+        }
+        other.fired = 0;
+        other.watch = virEventPollAddHandle(otherFD[0],
+                                            VIR_EVENT_HANDLE_READABLE,
+                                            testOther, NULL, NULL);
+        VIR_FORCE_CLOSE(otherFD[0]);
+        virEventPollRemoveHandle(other.watch);
+        if (safewrite(otherFD[1], &one, 1) != 1)
+            return EXIT_FAILURE;
+
+        for (i = 0; i < 2; i++) {
+            startJob();
+            if (finishJob("Stale epoll entry", -1, -1) != EXIT_SUCCESS)
+                return EXIT_FAILURE;
+        }
+
+        startJob();
+        pthread_mutex_unlock(&eventThreadMutex);
+        sched_yield();
+        usleep(100 * 1000);
+        pthread_mutex_lock(&eventThreadMutex);
+        if (safewrite(handles[NUM_FDS - 1].pipeFD[1], &one, 1) != 1)
+            return EXIT_FAILURE;
+        if (finishJob("Stale epoll entry dropped",
+                      NUM_FDS - 1, -1) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        if (other.fired) {
+            virtTestResult("Stale epoll entry dropped", 1,
+                           "Removed handle fired with %d\n", other.events);
+            return EXIT_FAILURE;
+        }
+
+        VIR_FORCE_CLOSE(otherFD[1]);
+        VIR_FORCE_CLOSE(dupFD);
+    }
+#endif
+
     //pthread_kill(eventThread, SIGTERM);
 
     return EXIT_SUCCESS;
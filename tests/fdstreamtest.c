@@ -312,6 +312,340 @@ static int testFDStreamWriteNonblock(const void *data)
     return testFDStreamWriteCommon(data, false);
 }
 
+
+#define SPARSE_HOLE_LEN (1024 * 1024)
+
+/* Copy a file with a hole in the middle and one at the end through a
+ * sparse download stream into a sparse upload stream */
+static int testFDStreamSparseCommon(const char *scratchdir, bool blocking)
+{
+    int fd = -1;
+    char *infile = NULL;
+    char *outfile = NULL;
+    int ret = -1;
+    char *pattern = NULL;
+    char *buf = NULL;
+    char *inbuf = NULL;
+    virStreamPtr in = NULL;
+    virStreamPtr out = NULL;
+    size_t i;
+    virConnectPtr conn = NULL;
+    int flags = 0;
+    long long holes = 0;
+    off_t total = PATTERN_LEN * 2 + SPARSE_HOLE_LEN * 2;
+
+    if (!blocking)
+        flags |= VIR_STREAM_NONBLOCK;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    if (VIR_ALLOC_N(pattern, PATTERN_LEN) < 0 ||
+        VIR_ALLOC_N(buf, PATTERN_LEN) < 0 ||
+        VIR_ALLOC_N(inbuf, PATTERN_LEN) < 0)
+        goto cleanup;
+
+    for (i = 0; i < PATTERN_LEN; i++)
+        pattern[i] = i;
+
+    if (virAsprintf(&infile, "%s/sparse-input.data", scratchdir) < 0 ||
+        virAsprintf(&outfile, "%s/sparse-output.data", scratchdir) < 0)
+        goto cleanup;
+
+    if ((fd = open(infile, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0 ||
+        safewrite(fd, pattern, PATTERN_LEN) != PATTERN_LEN ||
+        lseek(fd, SPARSE_HOLE_LEN, SEEK_CUR) < 0 ||
+        safewrite(fd, pattern, PATTERN_LEN) != PATTERN_LEN ||
+        ftruncate(fd, total) < 0 ||
+        VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if ((fd = open(outfile, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0 ||
+        VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if (!(in = virStreamNew(conn, flags)) ||
+        !(out = virStreamNew(conn, flags)))
+        goto cleanup;
+
+    if (virFDStreamOpenSparseFile(in, infile, 0, 0, O_RDONLY) < 0 ||
+        virFDStreamOpenSparseFile(out, outfile, 0, 0, O_WRONLY) < 0)
+        goto cleanup;
+
+    for (;;) {
+        int got;
+        size_t offset = 0;
+
+        got = in->driver->streamRecvFlags(in, buf, PATTERN_LEN,
+                                          VIR_STREAM_RECV_STOP_AT_HOLE);
+        if (got == -2 && !blocking) {
+            usleep(20 * 1000);
+            continue;
+        }
+        if (got == -3) {
+            long long len;
+            if (in->driver->streamRecvHole(in, &len, 0) < 0 ||
+                out->driver->streamSendHole(out, len, 0) < 0) {
+                virFilePrintf(stderr, "Failed to pass hole: %s\n",
+                              virGetLastErrorMessage());
+                goto cleanup;
+            }
+            holes += len;
+            continue;
+        }
+        if (got < 0) {
+            virFilePrintf(stderr, "Failed to read stream: %s\n",
+                          virGetLastErrorMessage());
+            goto cleanup;
+        }
+        if (got == 0)
+            break;
+
+        while (offset < got) {
+            int done = out->driver->streamSend(out, buf + offset, got - offset);
+            if (done == -2 && !blocking) {
+                usleep(20 * 1000);
+                continue;
+            }
+            if (done < 0) {
+                virFilePrintf(stderr, "Failed to write stream: %s\n",
+                              virGetLastErrorMessage());
+                goto cleanup;
+            }
+            offset += done;
+        }
+    }
+
+    if (in->driver->streamFinish(in) != 0 ||
+        out->driver->streamFinish(out) != 0) {
+        virFilePrintf(stderr, "Failed to finish stream: %s\n",
+                      virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    /* Hole detection depends on the file system the test runs on,
+     * the content has to be identical either way */
+    if (holes > SPARSE_HOLE_LEN * 2) {
+        virFilePrintf(stderr, "Unexpected hole length %lld\n", holes);
+        goto cleanup;
+    }
+
+    if ((fd = open(outfile, O_RDONLY)) < 0)
+        goto cleanup;
+
+    if (lseek(fd, 0, SEEK_END) != total) {
+        virFilePrintf(stderr, "Mismatched output file size\n");
+        goto cleanup;
+    }
+
+    for (i = 0; i < total; i += PATTERN_LEN) {
+        bool data = i == 0 || i == PATTERN_LEN + SPARSE_HOLE_LEN;
+
+        if (pread(fd, inbuf, PATTERN_LEN, i) != PATTERN_LEN) {
+            virFilePrintf(stderr, "Short read from data\n");
+            goto cleanup;
+        }
+
+        memset(buf, 0, PATTERN_LEN);
+        if (memcmp(inbuf, data ? pattern : buf, PATTERN_LEN) != 0) {
+            virFilePrintf(stderr, "Mismatched data at offset %zu\n", i);
+            goto cleanup;
+        }
+    }
+
+    if (VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    if (in)
+        virStreamFree(in);
+    if (out)
+        virStreamFree(out);
+    VIR_FORCE_CLOSE(fd);
+    if (infile != NULL)
+        unlink(infile);
+    if (outfile != NULL)
+        unlink(outfile);
+    if (conn)
+        virConnectClose(conn);
+    VIR_FREE(infile);
+    VIR_FREE(outfile);
+    VIR_FREE(pattern);
+    VIR_FREE(buf);
+    VIR_FREE(inbuf);
+    return ret;
+}
+
+
+static int testFDStreamSparseBlock(const void *data)
+{
+    return testFDStreamSparseCommon(data, true);
+}
+static int testFDStreamSparseNonblock(const void *data)
+{
+    return testFDStreamSparseCommon(data, false);
+}
+
+
+/*
+ * Only data waiting in a pipe the stream reads from is handed out for
+ * splicing, never more than asked for or than is left of the stream
+ */
+static int testFDStreamRecvSplice(const void *data)
+{
+    const char *scratchdir = data;
+    virConnectPtr conn = NULL;
+    virStreamPtr st = NULL;
+    char *file = NULL;
+    char pattern[PATTERN_LEN];
+    char buf[PATTERN_LEN];
+    int pipefd[2] = { -1, -1 };
+    int fd = -1;
+    size_t total;
+    size_t i;
+    int got;
+    int ret = -1;
+
+    for (i = 0; i < PATTERN_LEN; i++)
+        pattern[i] = i;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    if (virAsprintf(&file, "%s/splice.data", scratchdir) < 0)
+        goto cleanup;
+    if ((fd = open(file, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0)
+        goto cleanup;
+    for (i = 0; i < 10; i++) {
+        if (safewrite(fd, pattern, PATTERN_LEN) != PATTERN_LEN)
+            goto cleanup;
+    }
+    if (VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    /* A stream reading from a pipe */
+    if (pipe(pipefd) < 0 ||
+        !(st = virStreamNew(conn, 0)) ||
+        virFDStreamOpen(st, pipefd[0]) < 0)
+        goto cleanup;
+    pipefd[0] = -1;
+
+    if ((got = virFDStreamRecvSplice(st, PATTERN_LEN, &fd)) != 0 ||
+        fd != -1) {
+        virFilePrintf(stderr, "Expected nothing from an empty pipe, "
+                      "got %d\n", got);
+        goto cleanup;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (safewrite(pipefd[1], pattern, PATTERN_LEN) != PATTERN_LEN)
+            goto cleanup;
+    }
+
+    if ((got = virFDStreamRecvSplice(st, PATTERN_LEN / 2, &fd)) !=
+        PATTERN_LEN / 2) {
+        virFilePrintf(stderr, "Expected %d bytes, got %d\n",
+                      PATTERN_LEN / 2, got);
+        goto cleanup;
+    }
+    if (saferead(fd, buf, got) != got ||
+        memcmp(buf, pattern, got) != 0) {
+        virFilePrintf(stderr, "Mismatched data from the spliced pipe\n");
+        goto cleanup;
+    }
+    VIR_FORCE_CLOSE(fd);
+
+    if ((got = virFDStreamRecvSplice(st, PATTERN_LEN * 4, &fd)) !=
+        PATTERN_LEN * 3 / 2) {
+        virFilePrintf(stderr, "Expected the %d buffered bytes, got %d\n",
+                      PATTERN_LEN * 3 / 2, got);
+        goto cleanup;
+    }
+    VIR_FORCE_CLOSE(fd);
+    virStreamFree(st);
+    st = NULL;
+
+    /* Neither the write end of a pipe nor a plain file */
+    if (!(st = virStreamNew(conn, 0)) ||
+        virFDStreamOpen(st, pipefd[1]) < 0)
+        goto cleanup;
+    pipefd[1] = -1;
+    if ((got = virFDStreamRecvSplice(st, PATTERN_LEN, &fd)) != 0) {
+        virFilePrintf(stderr, "Expected nothing from a pipe's write end, "
+                      "got %d\n", got);
+        goto cleanup;
+    }
+    virStreamFree(st);
+    st = NULL;
+
+    if ((fd = open(file, O_RDONLY)) < 0 ||
+        !(st = virStreamNew(conn, 0)) ||
+        virFDStreamOpen(st, fd) < 0)
+        goto cleanup;
+    fd = -1;
+    if ((got = virFDStreamRecvSplice(st, PATTERN_LEN, &fd)) != 0) {
+        virFilePrintf(stderr, "Expected nothing from a file, got %d\n", got);
+        goto cleanup;
+    }
+    virStreamFree(st);
+    st = NULL;
+
+    /* The pipe of the I/O helper stops at the requested length */
+    if (!(st = virStreamNew(conn, VIR_STREAM_NONBLOCK)) ||
+        virFDStreamOpenFile(st, file, 0, PATTERN_LEN * 3 / 2,
+                            O_RDONLY) < 0)
+        goto cleanup;
+
+    for (i = 0, total = 0; total < PATTERN_LEN * 3 / 2 && i < 250; i++) {
+        if ((got = virFDStreamRecvSplice(st, PATTERN_LEN, &fd)) < 0)
+            goto cleanup;
+        if (got == 0) {
+            usleep(20 * 1000);
+            continue;
+        }
+        if (got > PATTERN_LEN ||
+            saferead(fd, buf, got) != got ||
+            memcmp(buf, pattern + (total % PATTERN_LEN),
+                   MIN(got, PATTERN_LEN - (total % PATTERN_LEN))) != 0) {
+            virFilePrintf(stderr, "Mismatched data from the I/O helper\n");
+            goto cleanup;
+        }
+        VIR_FORCE_CLOSE(fd);
+        total += got;
+    }
+    if (total != PATTERN_LEN * 3 / 2) {
+        virFilePrintf(stderr, "Expected %d bytes from the I/O helper, "
+                      "got %zu\n", PATTERN_LEN * 3 / 2, total);
+        goto cleanup;
+    }
+    if ((got = virFDStreamRecvSplice(st, PATTERN_LEN, &fd)) != 0) {
+        virFilePrintf(stderr, "Expected nothing past the end of the stream, "
+                      "got %d\n", got);
+        goto cleanup;
+    }
+
+    if (st->driver->streamFinish(st) != 0) {
+        virFilePrintf(stderr, "Failed to finish stream: %s\n",
+                      virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    if (st)
+        virStreamFree(st);
+    VIR_FORCE_CLOSE(fd);
+    VIR_FORCE_CLOSE(pipefd[0]);
+    VIR_FORCE_CLOSE(pipefd[1]);
+    if (file != NULL)
+        unlink(file);
+    if (conn)
+        virConnectClose(conn);
+    VIR_FREE(file);
+    return ret;
+}
+
 #define SCRATCHDIRTEMPLATE abs_builddir "/fakesysfsdir-XXXXXX"
 
 static int
@@ -336,6 +670,12 @@ mymain(void)
         ret = -1;
     if (virtTestRun("Stream write non-blocking ", testFDStreamWriteNonblock, scratchdir) < 0)
         ret = -1;
+    if (virtTestRun("Stream sparse blocking ", testFDStreamSparseBlock, scratchdir) < 0)
+        ret = -1;
+    if (virtTestRun("Stream sparse non-blocking ", testFDStreamSparseNonblock, scratchdir) < 0)
+        ret = -1;
+    if (virtTestRun("Stream splice ", testFDStreamRecvSplice, scratchdir) < 0)
+        ret = -1;
 
     if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
         virFileDeleteTree(scratchdir);
@@ -76,6 +76,17 @@ typedef struct {
     virNetworkPtr net;
 } objecteventTest;
 
+/* Records which callbacks fired, and in which order */
+typedef struct {
+    int calls[8];
+    size_t ncalls;
+} orderEventLog;
+
+typedef struct {
+    orderEventLog *log;
+    int tag;
+} orderEventCallback;
+
 
 static int
 domainLifecycleCb(virConnectPtr conn ATTRIBUTE_UNUSED,
@@ -106,6 +117,33 @@ domainLifecycleCb(virConnectPtr conn ATTRIBUTE_UNUSED,
     return 0;
 }
 
+static int
+domainOrderCb(virConnectPtr conn ATTRIBUTE_UNUSED,
+              virDomainPtr dom ATTRIBUTE_UNUSED,
+              int event ATTRIBUTE_UNUSED,
+              int detail ATTRIBUTE_UNUSED,
+              void *opaque)
+{
+    orderEventCallback *callback = opaque;
+    orderEventLog *log = callback->log;
+
+    if (log->ncalls < ARRAY_CARDINALITY(log->calls))
+        log->calls[log->ncalls] = callback->tag;
+    log->ncalls++;
+    return 0;
+}
+
+/* A function may be registered only once per domain and event */
+static int
+domainOrderAgainCb(virConnectPtr conn,
+                   virDomainPtr dom,
+                   int event,
+                   int detail,
+                   void *opaque)
+{
+    return domainOrderCb(conn, dom, event, detail, opaque);
+}
+
 static void
 networkLifecycleCb(virConnectPtr conn ATTRIBUTE_UNUSED,
                    virNetworkPtr net ATTRIBUTE_UNUSED,
@@ -399,6 +437,99 @@ cleanup:
     return ret;
 }
 
+static int
+testDomainFilterOrder(const void *data)
+{
+    const objecteventTest *test = data;
+    orderEventLog log;
+    orderEventCallback callbacks[4];
+    int expected[] = { 0, 1, 3 };
+    int ids[4] = { -1, -1, -1, -1 };
+    virDomainPtr dom = NULL;
+    virDomainPtr other = NULL;
+    size_t i;
+    int ret = -1;
+
+    memset(&log, 0, sizeof(log));
+    for (i = 0; i < ARRAY_CARDINALITY(callbacks); i++) {
+        callbacks[i].log = &log;
+        callbacks[i].tag = i;
+    }
+
+    if (!(dom = virDomainLookupByName(test->conn, "test")))
+        goto cleanup;
+    if (!(other = virDomainDefineXML(test->conn, domainDef)))
+        goto cleanup;
+
+    /* Callbacks for the domain, for all domains and for another
+     * domain are interleaved: only those for the domain and for all
+     * domains must fire, in the order they were registered */
+    for (i = 0; i < ARRAY_CARDINALITY(callbacks); i++) {
+        virConnectDomainEventCallback cb = domainOrderCb;
+        virDomainPtr filter = NULL;
+
+        if (i == 0) {
+            filter = dom;
+        } else if (i == 2) {
+            filter = other;
+        } else if (i == 3) {
+            filter = dom;
+            cb = domainOrderAgainCb;
+        }
+
+        ids[i] = virConnectDomainEventRegisterAny(test->conn, filter,
+                                                  VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                                                  VIR_DOMAIN_EVENT_CALLBACK(cb),
+                                                  &callbacks[i], NULL);
+        if (ids[i] < 0)
+            goto cleanup;
+    }
+
+    if (virDomainDestroy(dom) < 0 ||
+        virEventRunDefaultImpl() < 0)
+        goto cleanup;
+
+    if (log.ncalls != ARRAY_CARDINALITY(expected))
+        goto cleanup;
+    for (i = 0; i < ARRAY_CARDINALITY(expected); i++) {
+        if (log.calls[i] != expected[i])
+            goto cleanup;
+    }
+
+    /* Once deregistered, a callback must no longer fire, while the
+     * others sharing its domain still do */
+    if (virConnectDomainEventDeregisterAny(test->conn, ids[0]) != 0)
+        goto cleanup;
+    ids[0] = -1;
+    log.ncalls = 0;
+
+    if (virDomainCreate(dom) < 0 ||
+        virEventRunDefaultImpl() < 0)
+        goto cleanup;
+
+    if (log.ncalls != 2 || log.calls[0] != 1 || log.calls[1] != 3)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    for (i = 0; i < ARRAY_CARDINALITY(ids); i++) {
+        if (ids[i] >= 0)
+            virConnectDomainEventDeregisterAny(test->conn, ids[i]);
+    }
+    if (other) {
+        virDomainUndefine(other);
+        virDomainFree(other);
+    }
+    if (dom) {
+        if (virDomainIsActive(dom) == 0)
+            virDomainCreate(dom);
+        virDomainFree(dom);
+    }
+
+    return ret;
+}
+
 static int
 testNetworkCreateXML(const void *data)
 {
@@ -557,6 +688,9 @@ mymain(void)
         ret = EXIT_FAILURE;
     if (virtTestRun("Domain start stop events", testDomainStartStopEvent, &test) < 0)
         ret = EXIT_FAILURE;
+    if (virtTestRun("Domain event filtering and order",
+                    testDomainFilterOrder, &test) < 0)
+        ret = EXIT_FAILURE;
 
     /* Network event tests */
     /* Tests requiring the test network not to be set up*/
@@ -1420,6 +1420,8 @@ testQemuMonitorJSONqemuMonitorJSONGetBlockStatsInfo(const void *data)
     long long flush_req, flush_total_times, errs;
     int nparams;
     unsigned long long extent;
+    virHashTablePtr blockstats = NULL;
+    qemuBlockStatsPtr bstats;
 
     const char *reply =
         "{"
@@ -1512,13 +1514,14 @@ testQemuMonitorJSONqemuMonitorJSONGetBlockStatsInfo(const void *data)
     if (!test)
         return -1;
 
-    /* fill in seven times - we are gonna ask seven times later on */
+    /* fill in eight times - we are gonna ask eight times later on */
     if (qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0 ||
         qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0 ||
         qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0 ||
         qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0 ||
         qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0 ||
         qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0 ||
+        qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0 ||
         qemuMonitorTestAddItem(test, "query-blockstats", reply) < 0)
         goto cleanup;
 
@@ -1566,6 +1569,38 @@ testQemuMonitorJSONqemuMonitorJSONGetBlockStatsInfo(const void *data)
 
     CHECK(16, 49250, 1004952, 0, 0, 0, 0, 0, -1)
 
+    if (!(blockstats = virHashCreate(32, (virHashDataFree) free)))
+        goto cleanup;
+
+    if (qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorTestGetMonitor(test),
+                                            blockstats) < 0)
+        goto cleanup;
+
+    if (virHashSize(blockstats) != 3) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Invalid number of devices: %zd, expected 3",
+                       virHashSize(blockstats));
+        goto cleanup;
+    }
+
+    if (!(bstats = virHashLookup(blockstats, "virtio-disk1"))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Missing stats of device virtio-disk1");
+        goto cleanup;
+    }
+
+    rd_req = bstats->rd_req;
+    rd_bytes = bstats->rd_bytes;
+    rd_total_times = bstats->rd_total_times;
+    wr_req = bstats->wr_req;
+    wr_bytes = bstats->wr_bytes;
+    wr_total_times = bstats->wr_total_times;
+    flush_req = bstats->flush_req;
+    flush_total_times = bstats->flush_total_times;
+    errs = bstats->errs;
+
+    CHECK(85, 348160, 8232156, 0, 0, 0, 0, 0, -1)
+
     if (qemuMonitorJSONGetBlockStatsParamsNumber(qemuMonitorTestGetMonitor(test),
                                                  &nparams) < 0)
         goto cleanup;
@@ -1616,6 +1651,7 @@ testQemuMonitorJSONqemuMonitorJSONGetBlockStatsInfo(const void *data)
 #undef CHECK0
 
 cleanup:
+    virHashFree(blockstats);
     qemuMonitorTestFree(test);
     return ret;
 }
@@ -0,0 +1,1276 @@
+/*
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <signal.h>
+#include <poll.h>
+#ifndef WIN32
+# include <sys/socket.h>
+# include <sys/un.h>
+#endif
+
+#include "testutils.h"
+#include "virutil.h"
+#include "virerror.h"
+#include "viralloc.h"
+#include "virevent.h"
+#include "virfile.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "virtime.h"
+#include "datatypes.h"
+#include "libvirt_internal.h"
+
+#include "rpc/virnetmessage.h"
+#include "remote/remote_protocol.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+#ifndef WIN32
+
+/* How long, in milliseconds, the fake daemon holds back calls
+ * waiting for more of them to arrive, and the test waits for
+ * asynchronous calls to complete */
+# define TEST_HOLD_TIMEOUT (5 * 1000)
+# define TEST_OVERLAP_CALLS 2
+# define TEST_ASYNC_MAX 64
+# define TEST_STREAM_PACKETS 2
+# define TEST_STREAM_LEN (1024 * 1024)
+# define TEST_STREAM_CHUNK (300 * 1000)
+
+/* Written to the daemon's control pipe */
+# define TEST_DAEMON_RELEASE 'r'   /* answer the held calls, stop holding */
+# define TEST_DAEMON_HANGUP 'h'    /* drop them and the connection */
+
+struct testDaemonCall {
+    virNetMessagePtr msg;
+    unsigned int seq;           /* order the call arrived in */
+};
+
+/*
+ * A fake libvirtd, serving a single connection from a thread of
+ * the test. It answers just enough calls for the remote driver to
+ * open and close the connection, plus the few the tests make.
+ *
+ * Calls to @holdProc are held back until @holdCount of them are in
+ * flight, which only happens if the client sends them without
+ * waiting for each other's reply. They are also let through after
+ * TEST_HOLD_TIMEOUT without any other call, or when told so on the
+ * control pipe, after which no further calls are held: those the
+ * client queued before may still be on their way.
+ *
+ * Volume uploads only record the size of the biggest data packet.
+ * A volume download sends the @sendLens packets, the first one right
+ * away and each of the others before answering the next hostname
+ * call, so that the test controls when they arrive.
+ */
+struct testDaemon {
+    int listenfd;
+    int fd;
+    int ctl[2];
+    virThread thread;
+
+    int holdProc;
+    size_t holdCount;
+
+    unsigned int seq;
+    size_t nheld;
+    struct testDaemonCall *held;
+
+    bool largeStream;           /* claim support for large stream packets */
+    size_t streamMax;
+    size_t sendLens[TEST_STREAM_PACKETS];
+    size_t nsent;
+    size_t sendOffset;
+    virNetMessageHeader stream;  /* of the ongoing stream */
+};
+
+static char *sockpath;
+
+
+static virNetMessagePtr
+testDaemonRead(struct testDaemon *daemon)
+{
+    virNetMessagePtr msg;
+    size_t len;
+
+    if (!(msg = virNetMessageNew(false)))
+        return NULL;
+
+    if (virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_LEN_MAX) < 0 ||
+        saferead(daemon->fd, msg->buffer, msg->bufferLength) !=
+        msg->bufferLength ||
+        virNetMessageDecodeLength(msg) < 0)
+        goto error;
+
+    len = msg->bufferLength - msg->bufferOffset;
+    if (saferead(daemon->fd, msg->buffer + msg->bufferOffset, len) != len ||
+        virNetMessageDecodeHeader(msg) < 0)
+        goto error;
+
+    return msg;
+
+error:
+    virNetMessageFree(msg);
+    return NULL;
+}
+
+
+static int
+testDaemonReply(struct testDaemon *daemon,
+                virNetMessagePtr call,
+                int status,
+                xdrproc_t filter,
+                void *data)
+{
+    virNetMessagePtr msg;
+    int ret = -1;
+
+    if (!(msg = virNetMessageNew(false)))
+        return -1;
+
+    msg->header = call->header;
+    msg->header.type = VIR_NET_REPLY;
+    msg->header.status = status;
+
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        virNetMessageEncodePayload(msg, filter, data) < 0)
+        goto cleanup;
+
+    if (safewrite(daemon->fd, msg->buffer, msg->bufferLength) !=
+        msg->bufferLength)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
+static int
+testDaemonReplyError(struct testDaemon *daemon,
+                     virNetMessagePtr call,
+                     int code)
+{
+    virNetMessageError rerr;
+    char *message = (char *) "unsupported by the test daemon";
+
+    memset(&rerr, 0, sizeof(rerr));
+    rerr.code = code;
+    rerr.domain = VIR_FROM_REMOTE;
+    rerr.message = &message;
+    rerr.level = VIR_ERR_ERROR;
+
+    return testDaemonReply(daemon, call, VIR_NET_ERROR,
+                           (xdrproc_t) xdr_virNetMessageError, &rerr);
+}
+
+
+/* Stream data is a byte pattern, continued across packets */
+static char
+testStreamByte(size_t offset)
+{
+    return offset % 251;
+}
+
+
+static int
+testDaemonSendStream(struct testDaemon *daemon,
+                     int status,
+                     size_t len)
+{
+    virNetMessagePtr msg;
+    char *data = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (!(msg = virNetMessageNew(false)))
+        return -1;
+
+    msg->header = daemon->stream;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.status = status;
+
+    if (VIR_ALLOC_N(data, len + 1) < 0)
+        goto cleanup;
+    for (i = 0; i < len; i++)
+        data[i] = testStreamByte(daemon->sendOffset + i);
+
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        (len ? virNetMessageEncodePayloadRaw(msg, data, len) :
+         virNetMessageEncodePayloadEmpty(msg)) < 0)
+        goto cleanup;
+
+    if (safewrite(daemon->fd, msg->buffer, msg->bufferLength) !=
+        msg->bufferLength)
+        goto cleanup;
+
+    daemon->sendOffset += len;
+    ret = 0;
+cleanup:
+    VIR_FREE(data);
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
+/* Send the next packet of a download, followed by the end of the
+ * stream after the last one */
+static int
+testDaemonSendNext(struct testDaemon *daemon)
+{
+    if (daemon->nsent >= TEST_STREAM_PACKETS ||
+        !daemon->sendLens[daemon->nsent])
+        return 0;
+
+    if (testDaemonSendStream(daemon, VIR_NET_CONTINUE,
+                             daemon->sendLens[daemon->nsent++]) < 0)
+        return -1;
+
+    if (daemon->nsent == TEST_STREAM_PACKETS ||
+        !daemon->sendLens[daemon->nsent])
+        return testDaemonSendStream(daemon, VIR_NET_CONTINUE, 0);
+    return 0;
+}
+
+
+/* Data packets from the client are only measured, its finish and
+ * abort requests are confirmed */
+static int
+testDaemonStream(struct testDaemon *daemon,
+                 virNetMessagePtr msg)
+{
+    if (msg->header.status == VIR_NET_CONTINUE) {
+        daemon->streamMax = MAX(daemon->streamMax,
+                                msg->bufferLength - msg->bufferOffset);
+        return 0;
+    }
+
+    daemon->stream = msg->header;
+    return testDaemonSendStream(daemon, VIR_NET_OK, 0);
+}
+
+
+/*
+ * Answer a call. The hostname tells whether it was held back along
+ * with others, the domain info carries the order the call arrived in.
+ */
+static int
+testDaemonAnswer(struct testDaemon *daemon,
+                 struct testDaemonCall *call,
+                 bool together)
+{
+    virNetMessagePtr msg = call->msg;
+    int rv;
+
+    if (msg->header.prog != REMOTE_PROGRAM)
+        return testDaemonReplyError(daemon, msg, VIR_ERR_NO_SUPPORT);
+
+    switch (msg->header.proc) {
+    case REMOTE_PROC_AUTH_LIST: {
+        remote_auth_list_ret ret;
+
+        memset(&ret, 0, sizeof(ret));
+        rv = testDaemonReply(daemon, msg, VIR_NET_OK,
+                             (xdrproc_t) xdr_remote_auth_list_ret, &ret);
+        break;
+    }
+
+    case REMOTE_PROC_CONNECT_SUPPORTS_FEATURE: {
+        remote_connect_supports_feature_args args;
+        remote_connect_supports_feature_ret ret = { 0 };
+
+        memset(&args, 0, sizeof(args));
+        if (virNetMessageDecodePayload(msg, (xdrproc_t)
+                                       xdr_remote_connect_supports_feature_args,
+                                       &args) < 0)
+            return -1;
+        if (args.feature == VIR_DRV_FEATURE_PROGRAM_LARGE_STREAM)
+            ret.supported = daemon->largeStream;
+
+        rv = testDaemonReply(daemon, msg, VIR_NET_OK,
+                             (xdrproc_t) xdr_remote_connect_supports_feature_ret,
+                             &ret);
+        break;
+    }
+
+    case REMOTE_PROC_CONNECT_OPEN:
+    case REMOTE_PROC_CONNECT_CLOSE:
+        rv = testDaemonReply(daemon, msg, VIR_NET_OK,
+                             (xdrproc_t) xdr_void, NULL);
+        break;
+
+    case REMOTE_PROC_CONNECT_GET_HOSTNAME: {
+        remote_connect_get_hostname_ret ret;
+
+        if (testDaemonSendNext(daemon) < 0)
+            return -1;
+
+        ret.hostname = (char *) (together ? "overlapping" : "alone");
+        rv = testDaemonReply(daemon, msg, VIR_NET_OK,
+                             (xdrproc_t) xdr_remote_connect_get_hostname_ret,
+                             &ret);
+        break;
+    }
+
+    case REMOTE_PROC_DOMAIN_GET_INFO: {
+        remote_domain_get_info_ret ret;
+
+        memset(&ret, 0, sizeof(ret));
+        ret.state = VIR_DOMAIN_RUNNING;
+        ret.nrVirtCpu = 1;
+        ret.cpuTime = call->seq;
+        rv = testDaemonReply(daemon, msg, VIR_NET_OK,
+                             (xdrproc_t) xdr_remote_domain_get_info_ret,
+                             &ret);
+        break;
+    }
+
+    case REMOTE_PROC_STORAGE_VOL_UPLOAD:
+        rv = testDaemonReply(daemon, msg, VIR_NET_OK,
+                             (xdrproc_t) xdr_void, NULL);
+        break;
+
+    case REMOTE_PROC_STORAGE_VOL_DOWNLOAD:
+        daemon->stream = msg->header;
+        if ((rv = testDaemonReply(daemon, msg, VIR_NET_OK,
+                                  (xdrproc_t) xdr_void, NULL)) == 0)
+            rv = testDaemonSendNext(daemon);
+        break;
+
+    default:
+        rv = testDaemonReplyError(daemon, msg, VIR_ERR_NO_SUPPORT);
+        break;
+    }
+
+    return rv;
+}
+
+
+static void
+testDaemonDropHeld(struct testDaemon *daemon)
+{
+    while (daemon->nheld)
+        virNetMessageFree(daemon->held[--daemon->nheld].msg);
+    VIR_FREE(daemon->held);
+}
+
+
+/* Answer the held calls, the most recent first, so that the client
+ * has to match the replies up with its calls */
+static int
+testDaemonFlush(struct testDaemon *daemon)
+{
+    bool together = daemon->holdCount &&
+        daemon->nheld == daemon->holdCount;
+    int rv = 0;
+
+    while (daemon->nheld) {
+        struct testDaemonCall *call = &daemon->held[--daemon->nheld];
+
+        if (testDaemonAnswer(daemon, call, together) < 0)
+            rv = -1;
+        virNetMessageFree(call->msg);
+    }
+    VIR_FREE(daemon->held);
+
+    return rv;
+}
+
+
+static int
+testDaemonDispatch(struct testDaemon *daemon,
+                   virNetMessagePtr msg)
+{
+    struct testDaemonCall call = { msg, daemon->seq++ };
+    int rv;
+
+    if (msg->header.type == VIR_NET_STREAM) {
+        rv = testDaemonStream(daemon, msg);
+        virNetMessageFree(msg);
+        return rv;
+    }
+
+    if (msg->header.prog == REMOTE_PROGRAM &&
+        msg->header.proc == daemon->holdProc) {
+        if (VIR_APPEND_ELEMENT(daemon->held, daemon->nheld, call) < 0) {
+            virNetMessageFree(msg);
+            return -1;
+        }
+        if (daemon->nheld == daemon->holdCount)
+            return testDaemonFlush(daemon);
+        return 0;
+    }
+
+    rv = testDaemonAnswer(daemon, &call, false);
+    virNetMessageFree(msg);
+    return rv;
+}
+
+
+static void
+testDaemonRun(void *opaque)
+{
+    struct testDaemon *daemon = opaque;
+    struct pollfd pfd[2] = {
+        { .fd = daemon->listenfd, .events = POLLIN },
+        { .fd = daemon->ctl[0], .events = POLLIN },
+    };
+    virNetMessagePtr msg;
+    char ctl;
+    int rc;
+
+    if (poll(pfd, 1, TEST_HOLD_TIMEOUT) != 1 ||
+        (daemon->fd = accept(daemon->listenfd, NULL, NULL)) < 0)
+        return;
+
+    pfd[0].fd = daemon->fd;
+    while (true) {
+        rc = poll(pfd, 2, daemon->nheld ? TEST_HOLD_TIMEOUT : -1);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc < 0)
+            break;
+
+        /* Nothing else is coming, let the held calls through */
+        if (rc == 0) {
+            if (testDaemonFlush(daemon) < 0)
+                break;
+            continue;
+        }
+
+        if (pfd[1].revents) {
+            if (saferead(daemon->ctl[0], &ctl, 1) != 1 ||
+                ctl == TEST_DAEMON_HANGUP)
+                break;
+            daemon->holdProc = -1;
+            if (testDaemonFlush(daemon) < 0)
+                break;
+        }
+
+        if (pfd[0].revents &&
+            (!(msg = testDaemonRead(daemon)) ||
+             testDaemonDispatch(daemon, msg) < 0))
+            break;
+    }
+
+    testDaemonDropHeld(daemon);
+    VIR_FORCE_CLOSE(daemon->fd);
+}
+
+
+static int
+testDaemonControl(struct testDaemon *daemon, char ctl)
+{
+    return safewrite(daemon->ctl[1], &ctl, 1) == 1 ? 0 : -1;
+}
+
+
+static virConnectPtr
+testDaemonStart(struct testDaemon *daemon,
+                int holdProc,
+                size_t holdCount,
+                bool largeStream)
+{
+    struct sockaddr_un addr;
+    virConnectPtr conn = NULL;
+    char *uri = NULL;
+
+    memset(daemon, 0, sizeof(*daemon));
+    daemon->fd = -1;
+    daemon->holdProc = holdProc;
+    daemon->holdCount = holdCount;
+    daemon->largeStream = largeStream;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (virStrcpyStatic(addr.sun_path, sockpath) == NULL) {
+        fprintf(stderr, "Socket path %s too long\n", sockpath);
+        return NULL;
+    }
+
+    if (pipe(daemon->ctl) < 0) {
+        fprintf(stderr, "Cannot create pipe: %d\n", errno);
+        return NULL;
+    }
+
+    unlink(sockpath);
+    if ((daemon->listenfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        bind(daemon->listenfd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(daemon->listenfd, 1) < 0) {
+        fprintf(stderr, "Cannot listen on %s: %d\n", sockpath, errno);
+        goto error;
+    }
+
+    if (virThreadCreate(&daemon->thread, true,
+                        testDaemonRun, daemon) < 0)
+        goto error;
+
+    if (virAsprintf(&uri, "remote+unix:///system?socket=%s", sockpath) < 0 ||
+        !(conn = virConnectOpen(uri))) {
+        fprintf(stderr, "Cannot open %s: %s\n", NULLSTR(uri),
+                virGetLastErrorMessage());
+        virThreadJoin(&daemon->thread);
+        goto error;
+    }
+
+    VIR_FREE(uri);
+    return conn;
+
+error:
+    VIR_FREE(uri);
+    VIR_FORCE_CLOSE(daemon->listenfd);
+    VIR_FORCE_CLOSE(daemon->ctl[0]);
+    VIR_FORCE_CLOSE(daemon->ctl[1]);
+    return NULL;
+}
+
+
+/*
+ * The daemon goes away once the client hangs up, which for a
+ * connection with asynchronous calls outstanding may only happen
+ * once they complete. Pass a NULL @conn if the caller already
+ * closed it.
+ */
+static void
+testDaemonStop(struct testDaemon *daemon,
+               virConnectPtr conn)
+{
+    if (conn)
+        virConnectClose(conn);
+    virThreadJoin(&daemon->thread);
+    VIR_FORCE_CLOSE(daemon->listenfd);
+    VIR_FORCE_CLOSE(daemon->ctl[0]);
+    VIR_FORCE_CLOSE(daemon->ctl[1]);
+    unlink(sockpath);
+}
+
+
+struct testHostnameData {
+    virConnectPtr conn;
+    char *hostname;
+};
+
+static void
+testGetHostname(void *opaque)
+{
+    struct testHostnameData *data = opaque;
+
+    data->hostname = virConnectGetHostname(data->conn);
+}
+
+/*
+ * The driver lock is dropped while waiting for a reply, so two
+ * threads can have calls in flight on one connection at the same
+ * time. The daemon only answers once both calls arrived, and
+ * answers the second one first.
+ */
+static int
+testCallsOverlap(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testDaemon daemon;
+    struct testHostnameData data[TEST_OVERLAP_CALLS];
+    virThread threads[TEST_OVERLAP_CALLS];
+    virConnectPtr conn;
+    size_t nthreads = 0;
+    size_t i;
+    int ret = -1;
+
+    if (!(conn = testDaemonStart(&daemon, REMOTE_PROC_CONNECT_GET_HOSTNAME,
+                                 TEST_OVERLAP_CALLS, false)))
+        return -1;
+
+    memset(data, 0, sizeof(data));
+    for (i = 0; i < TEST_OVERLAP_CALLS; i++) {
+        data[i].conn = conn;
+        if (virThreadCreate(&threads[i], true,
+                            testGetHostname, &data[i]) < 0)
+            goto cleanup;
+        nthreads++;
+    }
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+    nthreads = 0;
+
+    for (i = 0; i < TEST_OVERLAP_CALLS; i++) {
+        if (STRNEQ_NULLABLE(data[i].hostname, "overlapping")) {
+            fprintf(stderr, "Call %zu got hostname '%s', expected "
+                    "'overlapping'\n", i, NULLSTR(data[i].hostname));
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+cleanup:
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+    for (i = 0; i < TEST_OVERLAP_CALLS; i++)
+        VIR_FREE(data[i].hostname);
+    testDaemonStop(&daemon, conn);
+    return ret;
+}
+
+
+/* Tracks the asynchronous calls of one test */
+struct testAsyncState {
+    virMutex lock;
+    virCond cond;
+    size_t ndone;
+    size_t nfreed;
+};
+
+struct testAsyncCall {
+    struct testAsyncState *state;
+    virDomainInfo info;
+    int ret;
+    size_t ndone;
+    size_t nfreed;
+};
+
+static void
+testAsyncDone(virConnectPtr conn ATTRIBUTE_UNUSED,
+              int ret,
+              void *opaque)
+{
+    struct testAsyncCall *call = opaque;
+
+    virMutexLock(&call->state->lock);
+    call->ret = ret;
+    call->ndone++;
+    call->state->ndone++;
+    virCondBroadcast(&call->state->cond);
+    virMutexUnlock(&call->state->lock);
+}
+
+static void
+testAsyncFree(void *opaque)
+{
+    struct testAsyncCall *call = opaque;
+
+    virMutexLock(&call->state->lock);
+    call->nfreed++;
+    call->state->nfreed++;
+    virCondBroadcast(&call->state->cond);
+    virMutexUnlock(&call->state->lock);
+}
+
+static int
+testAsyncStateInit(struct testAsyncState *state,
+                   struct testAsyncCall *calls,
+                   size_t ncalls)
+{
+    size_t i;
+
+    memset(state, 0, sizeof(*state));
+    if (virMutexInit(&state->lock) < 0)
+        return -1;
+    if (virCondInit(&state->cond) < 0) {
+        virMutexDestroy(&state->lock);
+        return -1;
+    }
+
+    memset(calls, 0, sizeof(*calls) * ncalls);
+    for (i = 0; i < ncalls; i++) {
+        calls[i].state = state;
+        calls[i].ret = -2;
+    }
+    return 0;
+}
+
+static void
+testAsyncStateDispose(struct testAsyncState *state)
+{
+    virCondDestroy(&state->cond);
+    virMutexDestroy(&state->lock);
+}
+
+static int
+testAsyncSend(virDomainPtr dom,
+              struct testAsyncCall *call)
+{
+    return virDomainGetInfoAsync(dom, &call->info, testAsyncDone,
+                                 call, testAsyncFree);
+}
+
+/* Wait for @count calls to have both their callbacks invoked */
+static int
+testAsyncWait(struct testAsyncState *state, size_t count)
+{
+    unsigned long long now;
+    int ret = 0;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    virMutexLock(&state->lock);
+    while (state->ndone < count || state->nfreed < count) {
+        if (virCondWaitUntil(&state->cond, &state->lock,
+                             now + TEST_HOLD_TIMEOUT) < 0) {
+            fprintf(stderr, "Only %zu of %zu calls completed, "
+                    "%zu freed\n", state->ndone, count, state->nfreed);
+            ret = -1;
+            break;
+        }
+    }
+    virMutexUnlock(&state->lock);
+    return ret;
+}
+
+/* Check each call completed exactly once, the way @ret says */
+static int
+testAsyncCheck(struct testAsyncState *state,
+               struct testAsyncCall *calls,
+               size_t ncalls,
+               int ret)
+{
+    size_t i;
+    int rv = 0;
+
+    virMutexLock(&state->lock);
+    for (i = 0; i < ncalls; i++) {
+        if (calls[i].ndone != 1 || calls[i].nfreed != 1 ||
+            calls[i].ret != ret) {
+            fprintf(stderr, "Call %zu completed %zu times with %d, "
+                    "freed %zu times, expected once with %d\n",
+                    i, calls[i].ndone, calls[i].ret,
+                    calls[i].nfreed, ret);
+            rv = -1;
+        }
+        if (ret == 0 && calls[i].info.state != VIR_DOMAIN_RUNNING) {
+            fprintf(stderr, "Call %zu got state %d\n",
+                    i, calls[i].info.state);
+            rv = -1;
+        }
+    }
+    virMutexUnlock(&state->lock);
+    return rv;
+}
+
+static virDomainPtr
+testAsyncDomain(virConnectPtr conn)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN] = { 0 };
+
+    return virGetDomain(conn, "test", uuid);
+}
+
+/*
+ * Asynchronous and synchronous calls go out in the order they were
+ * made, whichever thread ends up sending them. The daemon hands
+ * back the order it got them in.
+ */
+static int
+testAsyncOrdering(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testDaemon daemon;
+    struct testAsyncState state;
+    struct testAsyncCall calls[2];
+    virConnectPtr conn;
+    virDomainPtr dom = NULL;
+    virDomainInfo info;
+    size_t nsent = 0;
+    int ret = -1;
+
+    if (testAsyncStateInit(&state, calls, ARRAY_CARDINALITY(calls)) < 0)
+        return -1;
+
+    if (!(conn = testDaemonStart(&daemon, -1, 0, false))) {
+        testAsyncStateDispose(&state);
+        return -1;
+    }
+
+    if (!(dom = testAsyncDomain(conn)))
+        goto cleanup;
+
+    if (testAsyncSend(dom, &calls[0]) < 0)
+        goto error;
+    nsent++;
+    if (virDomainGetInfo(dom, &info) < 0)
+        goto error;
+    if (testAsyncSend(dom, &calls[1]) < 0)
+        goto error;
+    nsent++;
+
+    if (testAsyncWait(&state, nsent) < 0 ||
+        testAsyncCheck(&state, calls, nsent, 0) < 0)
+        goto cleanup;
+
+    if (!(calls[0].info.cpuTime < info.cpuTime &&
+          info.cpuTime < calls[1].info.cpuTime)) {
+        fprintf(stderr, "Calls arrived as %llu, %llu, %llu\n",
+                calls[0].info.cpuTime, info.cpuTime,
+                calls[1].info.cpuTime);
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    /* Don't leave callbacks behind pointing at the stack */
+    if (ret < 0 && nsent)
+        ignore_value(testAsyncWait(&state, nsent));
+    virObjectUnref(dom);
+    testDaemonStop(&daemon, conn);
+    testAsyncStateDispose(&state);
+    return ret;
+
+error:
+    fprintf(stderr, "Call failed: %s\n", virGetLastErrorMessage());
+    goto cleanup;
+}
+
+/*
+ * Only TEST_ASYNC_MAX calls may await their reply at once. Further
+ * calls fail right away, without invoking either callback, and
+ * succeed again once the outstanding ones complete.
+ */
+static int
+testAsyncLimit(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testDaemon daemon;
+    struct testAsyncState state;
+    struct testAsyncCall *calls = NULL;
+    virConnectPtr conn;
+    virDomainPtr dom = NULL;
+    virErrorPtr err;
+    size_t nsent = 0;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(calls, TEST_ASYNC_MAX + 2) < 0)
+        return -1;
+    if (testAsyncStateInit(&state, calls, TEST_ASYNC_MAX + 2) < 0) {
+        VIR_FREE(calls);
+        return -1;
+    }
+
+    if (!(conn = testDaemonStart(&daemon, REMOTE_PROC_DOMAIN_GET_INFO,
+                                 0, false))) {
+        testAsyncStateDispose(&state);
+        VIR_FREE(calls);
+        return -1;
+    }
+
+    if (!(dom = testAsyncDomain(conn)))
+        goto cleanup;
+
+    for (nsent = 0; nsent < TEST_ASYNC_MAX; nsent++) {
+        if (testAsyncSend(dom, &calls[nsent]) < 0) {
+            fprintf(stderr, "Call %zu failed: %s\n", nsent,
+                    virGetLastErrorMessage());
+            goto cleanup;
+        }
+    }
+
+    if (testAsyncSend(dom, &calls[TEST_ASYNC_MAX]) == 0) {
+        nsent++;
+        fprintf(stderr, "Call over the limit succeeded\n");
+        goto cleanup;
+    }
+    if (!(err = virGetLastError()) ||
+        err->code != VIR_ERR_OPERATION_FAILED) {
+        fprintf(stderr, "Unexpected error for the call over the limit: "
+                "%s\n", virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    if (testDaemonControl(&daemon, TEST_DAEMON_RELEASE) < 0 ||
+        testAsyncWait(&state, TEST_ASYNC_MAX) < 0 ||
+        testAsyncCheck(&state, calls, TEST_ASYNC_MAX, 0) < 0)
+        goto cleanup;
+
+    /* The rejected call was left alone */
+    if (calls[TEST_ASYNC_MAX].ndone || calls[TEST_ASYNC_MAX].nfreed) {
+        fprintf(stderr, "Rejected call completed %zu times, freed %zu "
+                "times\n", calls[TEST_ASYNC_MAX].ndone,
+                calls[TEST_ASYNC_MAX].nfreed);
+        goto cleanup;
+    }
+
+    if (testAsyncSend(dom, &calls[TEST_ASYNC_MAX + 1]) < 0) {
+        fprintf(stderr, "Call after completion failed: %s\n",
+                virGetLastErrorMessage());
+        goto cleanup;
+    }
+    nsent++;
+    if (testDaemonControl(&daemon, TEST_DAEMON_RELEASE) < 0 ||
+        testAsyncWait(&state, TEST_ASYNC_MAX + 1) < 0 ||
+        testAsyncCheck(&state, &calls[TEST_ASYNC_MAX + 1], 1, 0) < 0)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    if (ret < 0 && nsent) {
+        ignore_value(testDaemonControl(&daemon, TEST_DAEMON_RELEASE));
+        ignore_value(testAsyncWait(&state, nsent));
+    }
+    virObjectUnref(dom);
+    testDaemonStop(&daemon, conn);
+    testAsyncStateDispose(&state);
+    VIR_FREE(calls);
+    return ret;
+}
+
+/*
+ * Closing the connection with calls outstanding leaves it open until
+ * they complete, each invoking its callback once and then freecb.
+ * The last one to complete closes the connection for good.
+ */
+static int
+testAsyncClose(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testDaemon daemon;
+    struct testAsyncState state;
+    struct testAsyncCall calls[3];
+    virConnectPtr conn;
+    virDomainPtr dom = NULL;
+    size_t nsent = 0;
+    int ret = -1;
+
+    if (testAsyncStateInit(&state, calls, ARRAY_CARDINALITY(calls)) < 0)
+        return -1;
+
+    if (!(conn = testDaemonStart(&daemon, REMOTE_PROC_DOMAIN_GET_INFO,
+                                 0, false))) {
+        testAsyncStateDispose(&state);
+        return -1;
+    }
+
+    if (!(dom = testAsyncDomain(conn)))
+        goto cleanup;
+
+    for (nsent = 0; nsent < ARRAY_CARDINALITY(calls); nsent++) {
+        if (testAsyncSend(dom, &calls[nsent]) < 0)
+            break;
+    }
+    virObjectUnref(dom);
+    dom = NULL;
+
+    if (virConnectClose(conn) <= 0) {
+        fprintf(stderr, "Connection went away with calls outstanding\n");
+        conn = NULL;
+        goto cleanup;
+    }
+    conn = NULL;
+
+    if (nsent != ARRAY_CARDINALITY(calls)) {
+        fprintf(stderr, "Call %zu failed\n", nsent);
+        goto cleanup;
+    }
+
+    if (testDaemonControl(&daemon, TEST_DAEMON_RELEASE) < 0 ||
+        testAsyncWait(&state, nsent) < 0 ||
+        testAsyncCheck(&state, calls, nsent, 0) < 0)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    if (ret < 0) {
+        ignore_value(testDaemonControl(&daemon, TEST_DAEMON_RELEASE));
+        ignore_value(testAsyncWait(&state, nsent));
+    }
+    virObjectUnref(dom);
+    testDaemonStop(&daemon, conn);
+    testAsyncStateDispose(&state);
+    return ret;
+}
+
+/*
+ * Calls outstanding when the connection is lost fail, each invoking
+ * its callback once and then freecb.
+ */
+static int
+testAsyncHangup(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testDaemon daemon;
+    struct testAsyncState state;
+    struct testAsyncCall calls[3];
+    virConnectPtr conn;
+    virDomainPtr dom = NULL;
+    size_t nsent = 0;
+    int ret = -1;
+
+    if (testAsyncStateInit(&state, calls, ARRAY_CARDINALITY(calls)) < 0)
+        return -1;
+
+    if (!(conn = testDaemonStart(&daemon, REMOTE_PROC_DOMAIN_GET_INFO,
+                                 0, false))) {
+        testAsyncStateDispose(&state);
+        return -1;
+    }
+
+    if (!(dom = testAsyncDomain(conn)))
+        goto cleanup;
+
+    for (nsent = 0; nsent < ARRAY_CARDINALITY(calls); nsent++) {
+        if (testAsyncSend(dom, &calls[nsent]) < 0) {
+            fprintf(stderr, "Call %zu failed: %s\n", nsent,
+                    virGetLastErrorMessage());
+            goto cleanup;
+        }
+    }
+
+    if (testDaemonControl(&daemon, TEST_DAEMON_HANGUP) < 0 ||
+        testAsyncWait(&state, nsent) < 0 ||
+        testAsyncCheck(&state, calls, nsent, -1) < 0)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    if (ret < 0) {
+        ignore_value(testDaemonControl(&daemon, TEST_DAEMON_HANGUP));
+        ignore_value(testAsyncWait(&state, nsent));
+    }
+    virObjectUnref(dom);
+    testDaemonStop(&daemon, conn);
+    testAsyncStateDispose(&state);
+    return ret;
+}
+
+
+/*
+ * A client only sends packets bigger than the legacy limit to a
+ * server which said it takes them, otherwise it sends what fits and
+ * leaves the rest to the next call.
+ */
+static int
+testStreamSend(const void *opaque)
+{
+    bool largeStream = *(const bool *) opaque;
+    size_t expect = largeStream ? TEST_STREAM_LEN :
+                    VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    struct testDaemon daemon;
+    virConnectPtr conn;
+    virStorageVolPtr vol = NULL;
+    virStreamPtr st = NULL;
+    char *data = NULL;
+    int rv;
+    int ret = -1;
+
+    if (!(conn = testDaemonStart(&daemon, -1, 0, largeStream)))
+        return -1;
+
+    if (VIR_ALLOC_N(data, TEST_STREAM_LEN) < 0 ||
+        !(vol = virGetStorageVol(conn, "pool", "vol", "key", NULL, NULL)) ||
+        !(st = virStreamNew(conn, 0)) ||
+        virStorageVolUpload(vol, st, 0, 0, 0) < 0)
+        goto cleanup;
+
+    if ((rv = virStreamSend(st, data, TEST_STREAM_LEN)) != expect) {
+        fprintf(stderr, "Expected %zu bytes sent, got %d\n", expect, rv);
+        goto cleanup;
+    }
+
+    if (virStreamFinish(st) < 0)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    if (ret < 0)
+        fprintf(stderr, "Upload failed: %s\n", virGetLastErrorMessage());
+    if (st)
+        virStreamFree(st);
+    virObjectUnref(vol);
+    VIR_FREE(data);
+    testDaemonStop(&daemon, conn);
+
+    if (ret == 0 && daemon.streamMax != expect) {
+        fprintf(stderr, "Expected a %zu bytes packet, the daemon got %zu\n",
+                expect, daemon.streamMax);
+        ret = -1;
+    }
+    return ret;
+}
+
+
+static int
+testStreamRecvCheck(virStreamPtr st,
+                    char *buf,
+                    size_t len,
+                    size_t *offset)
+{
+    size_t i;
+    int rv;
+
+    if ((rv = virStreamRecv(st, buf, len)) < 0) {
+        fprintf(stderr, "Receive failed: %s\n", virGetLastErrorMessage());
+        return -1;
+    }
+
+    for (i = 0; i < rv; i++) {
+        if (buf[i] != testStreamByte(*offset + i)) {
+            fprintf(stderr, "Mismatched stream data at %zu\n", *offset + i);
+            return -1;
+        }
+    }
+
+    *offset += rv;
+    return rv;
+}
+
+/*
+ * Packets bigger than the legacy limit arrive whole. The client reads
+ * them in smaller chunks, and a packet arriving while the previous one
+ * is half read is appended behind what remains of it.
+ */
+static int
+testStreamRecv(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testDaemon daemon;
+    virConnectPtr conn;
+    virStorageVolPtr vol = NULL;
+    virStreamPtr st = NULL;
+    char *hostname = NULL;
+    char *buf = NULL;
+    size_t offset = 0;
+    size_t total;
+    int rv;
+    int ret = -1;
+
+    if (!(conn = testDaemonStart(&daemon, -1, 0, true)))
+        return -1;
+
+    daemon.sendLens[0] = TEST_STREAM_LEN;
+    daemon.sendLens[1] = TEST_STREAM_LEN / 2;
+    total = daemon.sendLens[0] + daemon.sendLens[1];
+
+    if (VIR_ALLOC_N(buf, TEST_STREAM_LEN) < 0 ||
+        !(vol = virGetStorageVol(conn, "pool", "vol", "key", NULL, NULL)) ||
+        !(st = virStreamNew(conn, 0)) ||
+        virStorageVolDownload(vol, st, 0, 0, 0) < 0)
+        goto cleanup;
+
+    if ((rv = testStreamRecvCheck(st, buf, TEST_STREAM_CHUNK,
+                                  &offset)) != TEST_STREAM_CHUNK) {
+        fprintf(stderr, "Expected %d bytes, got %d\n", TEST_STREAM_CHUNK, rv);
+        goto cleanup;
+    }
+
+    /* Lets the second packet in while the first one is not read up */
+    if (!(hostname = virConnectGetHostname(conn)))
+        goto cleanup;
+
+    while ((rv = testStreamRecvCheck(st, buf, TEST_STREAM_CHUNK,
+                                     &offset)) > 0)
+        ;
+    if (rv < 0)
+        goto cleanup;
+
+    if (offset != total) {
+        fprintf(stderr, "Expected %zu bytes in total, got %zu\n",
+                total, offset);
+        goto cleanup;
+    }
+
+    if (virStreamFinish(st) < 0)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    if (st)
+        virStreamFree(st);
+    virObjectUnref(vol);
+    VIR_FREE(hostname);
+    VIR_FREE(buf);
+    testDaemonStop(&daemon, conn);
+    return ret;
+}
+
+
+static void
+testEventLoop(void *opaque ATTRIBUTE_UNUSED)
+{
+    while (true)
+        ignore_value(virEventRunDefaultImpl());
+}
+
+
+# define SCRATCHDIRTEMPLATE abs_builddir "/remotedriver-XXXXXX"
+
+static int
+mymain(void)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    virThread eventLoop;
+    bool largeStream;
+    int ret = 0;
+
+    /* Keep a dead daemon from killing the test */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (virEventRegisterDefaultImpl() < 0 ||
+        virThreadCreate(&eventLoop, false, testEventLoop, NULL) < 0)
+        return EXIT_FAILURE;
+
+    if (!mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create scratch dir\n");
+        return EXIT_FAILURE;
+    }
+
+    if (virAsprintf(&sockpath, "%s/sock", scratchdir) < 0) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    /* Some tests expect calls to fail */
+    virtTestQuiesceLibvirtErrors(false);
+
+    if (virtTestRun("Calls overlap", testCallsOverlap, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Async calls ordering", testAsyncOrdering, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Async calls limit", testAsyncLimit, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Async calls close", testAsyncClose, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Async calls hangup", testAsyncHangup, NULL) < 0)
+        ret = -1;
+
+    largeStream = false;
+    if (virtTestRun("Stream send to a legacy server",
+                    testStreamSend, &largeStream) < 0)
+        ret = -1;
+    largeStream = true;
+    if (virtTestRun("Stream send large packets",
+                    testStreamSend, &largeStream) < 0)
+        ret = -1;
+    if (virtTestRun("Stream receive large packets",
+                    testStreamRecv, NULL) < 0)
+        ret = -1;
+
+cleanup:
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+    VIR_FREE(sockpath);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#else
+
+static int
+mymain(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif
+
+VIRT_TEST_MAIN(mymain)
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "testutils.h"
+
+#include "storage/storage_backend.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virstring.h"
+#include "virutil.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* The input file is DATA_LEN bytes of data, a hole of HOLE_LEN bytes,
+ * another DATA_LEN bytes of data and a trailing hole of HOLE_LEN bytes */
+#define DATA_LEN (64 * 1024)
+#define HOLE_LEN (1024 * 1024)
+#define INPUT_LEN (DATA_LEN * 2 + HOLE_LEN * 2)
+
+struct testCopyData {
+    const char *scratchdir;
+    const char *input;      /* NULL for the sparse input file */
+    bool want_sparse;
+    unsigned long long total;
+    unsigned long long remain;
+};
+
+static char *pattern;
+
+static bool
+testInputIsData(unsigned long long offset)
+{
+    return offset < DATA_LEN ||
+        (offset >= DATA_LEN + HOLE_LEN && offset < DATA_LEN * 2 + HOLE_LEN);
+}
+
+static int
+testCreateInput(const char *path)
+{
+    int fd;
+
+    if ((fd = open(path, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0 ||
+        safewrite(fd, pattern, DATA_LEN) != DATA_LEN ||
+        lseek(fd, HOLE_LEN, SEEK_CUR) < 0 ||
+        safewrite(fd, pattern, DATA_LEN) != DATA_LEN ||
+        ftruncate(fd, INPUT_LEN) < 0 ||
+        VIR_CLOSE(fd) < 0) {
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Only check for holes in the output if the file system the test
+ * runs on keeps them in the input */
+static bool
+testHaveHoles(const char *path)
+{
+    int fd;
+    off_t data;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return false;
+    data = lseek(fd, DATA_LEN, SEEK_DATA);
+    VIR_FORCE_CLOSE(fd);
+
+    return data == DATA_LEN + HOLE_LEN;
+}
+
+static int
+testCheckNoData(int fd, off_t start, off_t end)
+{
+    off_t data = lseek(fd, start, SEEK_DATA);
+
+    if (data < 0 && errno == ENXIO)
+        return 0;
+    if (data < 0 || data < end) {
+        fprintf(stderr, "Expected a hole at %lld-%lld, found data at %lld\n",
+                (long long) start, (long long) end, (long long) data);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+testCopy(const void *opaque)
+{
+    const struct testCopyData *data = opaque;
+    virStorageVolDefPtr vol = NULL;
+    virStorageVolDefPtr inputvol = NULL;
+    unsigned long long total = data->total;
+    unsigned long long copied;
+    unsigned long long size;
+    char *buf = NULL;
+    char *zero = NULL;
+    int fd = -1;
+    int ret = -1;
+    size_t i;
+
+    if (VIR_ALLOC(vol) < 0 || VIR_ALLOC(inputvol) < 0 ||
+        VIR_ALLOC_N(buf, DATA_LEN) < 0 || VIR_ALLOC_N(zero, DATA_LEN) < 0)
+        goto cleanup;
+
+    if (virAsprintf(&vol->target.path, "%s/copy-output.data",
+                    data->scratchdir) < 0)
+        goto cleanup;
+
+    if (data->input) {
+        if (VIR_STRDUP(inputvol->target.path, data->input) < 0)
+            goto cleanup;
+        copied = data->total;
+    } else {
+        if (virAsprintf(&inputvol->target.path, "%s/copy-input.data",
+                        data->scratchdir) < 0 ||
+            testCreateInput(inputvol->target.path) < 0)
+            goto cleanup;
+        copied = MIN(data->total, INPUT_LEN);
+    }
+
+    /* Skipped zeros are not written at all, so sparse copies rely on the
+     * caller to size the file upfront, exactly like createRawFile does */
+    size = data->want_sparse ? data->total : copied;
+    if ((fd = open(vol->target.path, O_CREAT|O_RDWR|O_EXCL, 0600)) < 0 ||
+        (data->want_sparse && ftruncate(fd, size) < 0))
+        goto cleanup;
+
+    if (virStorageBackendCopyToFD(vol, inputvol, fd, &total,
+                                  data->want_sparse) < 0) {
+        fprintf(stderr, "Copy failed: %s\n", virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    if (total != data->remain) {
+        fprintf(stderr, "Expected %llu bytes left, got %llu\n",
+                data->remain, total);
+        goto cleanup;
+    }
+
+    if (lseek(fd, 0, SEEK_END) != size) {
+        fprintf(stderr, "Expected output size %llu, got %lld\n",
+                size, (long long) lseek(fd, 0, SEEK_END));
+        goto cleanup;
+    }
+
+    /* Anything past the copied range has to read back as zeros */
+    for (i = 0; i < size; i += DATA_LEN) {
+        size_t len = MIN(DATA_LEN, size - i);
+        size_t valid = i < copied ? MIN(len, copied - i) : 0;
+        const char *expect = zero;
+
+        if (!data->input && testInputIsData(i))
+            expect = pattern;
+
+        if (pread(fd, buf, len, i) != len) {
+            fprintf(stderr, "Short read at offset %zu\n", i);
+            goto cleanup;
+        }
+        if (memcmp(buf, expect, valid) != 0 ||
+            memcmp(buf + valid, zero, len - valid) != 0) {
+            fprintf(stderr, "Mismatched data at offset %zu\n", i);
+            goto cleanup;
+        }
+    }
+
+    /* Non-sparse copies must not leave any holes behind, provided the
+     * file system keeps them at all */
+    if (!data->want_sparse && testHaveHoles(inputvol->target.path)) {
+        struct stat st;
+
+        if (fstat(fd, &st) < 0 ||
+            (unsigned long long) st.st_blocks * 512 < size) {
+            fprintf(stderr, "Expected %llu bytes allocated, got %llu\n",
+                    size, (unsigned long long) st.st_blocks * 512);
+            goto cleanup;
+        }
+    }
+
+    if (data->want_sparse) {
+        if (data->input) {
+            if (testCheckNoData(fd, 0, size) < 0)
+                goto cleanup;
+        } else if (testHaveHoles(inputvol->target.path)) {
+            if (testCheckNoData(fd, DATA_LEN, DATA_LEN + HOLE_LEN) < 0 ||
+                (copied > DATA_LEN * 2 + HOLE_LEN &&
+                 testCheckNoData(fd, DATA_LEN * 2 + HOLE_LEN, size) < 0))
+                goto cleanup;
+        }
+    }
+
+    ret = 0;
+cleanup:
+    VIR_FORCE_CLOSE(fd);
+    if (vol && vol->target.path)
+        unlink(vol->target.path);
+    if (inputvol && !data->input && inputvol->target.path)
+        unlink(inputvol->target.path);
+    virStorageVolDefFree(vol);
+    virStorageVolDefFree(inputvol);
+    VIR_FREE(buf);
+    VIR_FREE(zero);
+    return ret;
+}
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/storagebackendcopy-XXXXXX"
+
+static int
+mymain(void)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    int ret = 0;
+    size_t i;
+
+    if (VIR_ALLOC_N(pattern, DATA_LEN) < 0)
+        return EXIT_FAILURE;
+    /* Avoid zero bytes, those could be skipped as holes */
+    for (i = 0; i < DATA_LEN; i++)
+        pattern[i] = (i % 251) + 1;
+
+    if (!mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create scratch dir\n");
+        VIR_FREE(pattern);
+        return EXIT_FAILURE;
+    }
+
+#define DO_TEST(name, input, sparse, total, remain)                     \
+    do {                                                                \
+        struct testCopyData data = {                                    \
+            scratchdir, input, sparse, total, remain                    \
+        };                                                              \
+        if (virtTestRun("Copy " name, testCopy, &data) < 0)             \
+            ret = -1;                                                   \
+    } while (0)
+
+    /* Regular input: every byte written out, or a walk over the data
+     * extents leaving the holes alone */
+    DO_TEST("whole file", NULL, false, INPUT_LEN, 0);
+    DO_TEST("whole file sparse", NULL, true, INPUT_LEN, 0);
+
+    /* Copies are cut short at *total, what is left is accounted for
+     * the caller to fill in */
+    DO_TEST("truncated", NULL, false, DATA_LEN + HOLE_LEN + DATA_LEN / 2, 0);
+    DO_TEST("truncated sparse", NULL, true,
+            DATA_LEN + HOLE_LEN + DATA_LEN / 2, 0);
+    DO_TEST("short input", NULL, false, INPUT_LEN + HOLE_LEN, HOLE_LEN);
+    DO_TEST("short input sparse", NULL, true, INPUT_LEN + HOLE_LEN, HOLE_LEN);
+
+    /* Non-regular input always goes through the read/write loop, which
+     * skips blocks of zeros when sparse output is wanted */
+    if (virFileExists("/dev/zero")) {
+        DO_TEST("device", "/dev/zero", false, HOLE_LEN, 0);
+        DO_TEST("device sparse", "/dev/zero", true, HOLE_LEN, 0);
+    }
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+    VIR_FREE(pattern);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "testutils.h"
+
+#include "storage/storage_backend_fs.h"
+#include "storage_conf.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virstring.h"
+#include "stat-time.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_FILES 4
+#define TEST_FILE_LEN 1024
+
+static const char *names[TEST_FILES] = { "a.img", "b.img", "c.img", "d.img" };
+
+/* The pool under test, refreshed by each test case in turn */
+struct testCacheData {
+    virStoragePoolObjPtr pool;
+    const char *scratchdir;
+    unsigned long long hits;
+    unsigned long long misses;
+};
+
+static int
+testCreateFile(const char *scratchdir,
+               const char *name)
+{
+    char buf[TEST_FILE_LEN];
+    char *path;
+    int fd;
+    int ret = -1;
+
+    memset(buf, 'x', sizeof(buf));
+    if (virAsprintf(&path, "%s/%s", scratchdir, name) < 0)
+        return -1;
+
+    if ((fd = open(path, O_CREAT|O_WRONLY|O_TRUNC, 0600)) >= 0 &&
+        safewrite(fd, buf, sizeof(buf)) == sizeof(buf) &&
+        VIR_CLOSE(fd) == 0)
+        ret = 0;
+
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(path);
+    return ret;
+}
+
+/*
+ * Refresh the pool, and check how many of its files were answered from
+ * the metadata cache, were probed, and are left in the cache afterwards.
+ */
+static int
+testRefresh(struct testCacheData *data,
+            unsigned long long hits,
+            unsigned long long misses,
+            size_t entries)
+{
+    unsigned long long nhits;
+    unsigned long long nmisses;
+    size_t nentries;
+
+    virStoragePoolObjClearVols(data->pool);
+    if (virStorageBackendDirectory.refreshPool(NULL, data->pool) < 0) {
+        fprintf(stderr, "Refresh failed: %s\n", virGetLastErrorMessage());
+        return -1;
+    }
+
+    if (virStorageBackendFSCacheGetStats(data->pool, &nhits, &nmisses,
+                                         &nentries) < 0)
+        return -1;
+
+    if (nhits - data->hits != hits || nmisses - data->misses != misses ||
+        nentries != entries) {
+        fprintf(stderr, "Expected %llu hits, %llu misses and %zu entries, "
+                "got %llu, %llu and %zu\n", hits, misses, entries,
+                nhits - data->hits, nmisses - data->misses, nentries);
+        return -1;
+    }
+
+    data->hits = nhits;
+    data->misses = nmisses;
+    return 0;
+}
+
+static int
+testCacheFill(const void *opaque)
+{
+    struct testCacheData *data = (struct testCacheData *) opaque;
+
+    /* Everything is probed once, and answered from the cache after */
+    if (testRefresh(data, 0, TEST_FILES, TEST_FILES) < 0 ||
+        testRefresh(data, TEST_FILES, 0, TEST_FILES) < 0)
+        return -1;
+    return 0;
+}
+
+enum {
+    TEST_CHANGE_SIZE,
+    TEST_CHANGE_MTIME,
+    TEST_CHANGE_CTIME,
+    TEST_CHANGE_INODE,
+};
+
+struct testChangeData {
+    struct testCacheData *data;
+    const char *name;
+    int change;
+};
+
+/* Change one file behind the cache's back, only that one is probed
+ * again on the next refresh */
+static int
+testCacheChange(const void *opaque)
+{
+    const struct testChangeData *change = opaque;
+    struct testCacheData *data = change->data;
+    struct timespec times[2];
+    struct stat before;
+    struct stat after;
+    char *path = NULL;
+    char *tmp = NULL;
+    int fd = -1;
+    int ret = -1;
+
+    if (virAsprintf(&path, "%s/%s", data->scratchdir, change->name) < 0 ||
+        virAsprintf(&tmp, "%s/%s.tmp", data->scratchdir, change->name) < 0 ||
+        stat(path, &before) < 0)
+        goto cleanup;
+
+    switch (change->change) {
+    case TEST_CHANGE_SIZE:
+        if ((fd = open(path, O_WRONLY)) < 0 ||
+            ftruncate(fd, TEST_FILE_LEN * 2) < 0 ||
+            VIR_CLOSE(fd) < 0)
+            goto cleanup;
+        break;
+
+    case TEST_CHANGE_MTIME:
+        times[0].tv_sec = times[1].tv_sec = before.st_mtime - 3600;
+        times[0].tv_nsec = times[1].tv_nsec = 0;
+        if (utimensat(AT_FDCWD, path, times, 0) < 0)
+            goto cleanup;
+        break;
+
+    case TEST_CHANGE_CTIME:
+        /* Wait for the clock to tick over, and skip the check if the
+         * file system doesn't record the change anyway */
+        usleep(50 * 1000);
+        if (chmod(path, 0640) < 0 ||
+            stat(path, &after) < 0)
+            goto cleanup;
+        if (get_stat_ctime(&after).tv_sec == get_stat_ctime(&before).tv_sec &&
+            get_stat_ctime(&after).tv_nsec == get_stat_ctime(&before).tv_nsec) {
+            ret = EXIT_AM_SKIP;
+            goto cleanup;
+        }
+        break;
+
+    case TEST_CHANGE_INODE:
+        /* Same size and mtime, but a different file */
+        times[0] = get_stat_atime(&before);
+        times[1] = get_stat_mtime(&before);
+        if (rename(path, tmp) < 0 ||
+            testCreateFile(data->scratchdir, change->name) < 0 ||
+            utimensat(AT_FDCWD, path, times, 0) < 0 ||
+            unlink(tmp) < 0 ||
+            stat(path, &after) < 0)
+            goto cleanup;
+        if (after.st_ino == before.st_ino) {
+            ret = EXIT_AM_SKIP;
+            goto cleanup;
+        }
+        break;
+    }
+
+    ret = testRefresh(data, TEST_FILES - 1, 1, TEST_FILES);
+
+ cleanup:
+    if (ret < 0)
+        fprintf(stderr, "Cannot change %s: %s\n", NULLSTR(path),
+                virGetLastErrorMessage());
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(path);
+    VIR_FREE(tmp);
+    return ret;
+}
+
+/* Entries of deleted files are dropped on the next refresh */
+static int
+testCachePrune(const void *opaque)
+{
+    struct testCacheData *data = (struct testCacheData *) opaque;
+    char *path;
+    int ret;
+
+    if (virAsprintf(&path, "%s/%s", data->scratchdir, names[0]) < 0)
+        return -1;
+    ret = unlink(path);
+    VIR_FREE(path);
+    if (ret < 0)
+        return -1;
+
+    return testRefresh(data, TEST_FILES - 1, 0, TEST_FILES - 1);
+}
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/storagefscache-XXXXXX"
+
+static int
+mymain(void)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    virStoragePoolObjList pools = { 0 };
+    virStoragePoolDefPtr def = NULL;
+    struct testCacheData data;
+    char *xml = NULL;
+    size_t i;
+    int ret = 0;
+
+    if (!mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create scratch dir\n");
+        return EXIT_FAILURE;
+    }
+
+    memset(&data, 0, sizeof(data));
+    data.scratchdir = scratchdir;
+
+    for (i = 0; i < TEST_FILES; i++) {
+        if (testCreateFile(scratchdir, names[i]) < 0) {
+            ret = -1;
+            goto cleanup;
+        }
+    }
+
+    if (virAsprintf(&xml,
+                    "<pool type='dir'>"
+                    "  <name>cache</name>"
+                    "  <target><path>%s</path></target>"
+                    "</pool>", scratchdir) < 0 ||
+        !(def = virStoragePoolDefParseString(xml)) ||
+        !(data.pool = virStoragePoolObjAssignDef(&pools, def))) {
+        virStoragePoolDefFree(def);
+        ret = -1;
+        goto cleanup;
+    }
+    virStoragePoolObjUnlock(data.pool);
+    data.pool->active = 1;
+
+    if (virtTestRun("Cache fill", testCacheFill, &data) < 0)
+        ret = -1;
+
+#define DO_TEST_CHANGE(name, file, what)                                \
+    do {                                                                \
+        struct testChangeData change = { &data, file, what };           \
+        if (virtTestRun("Invalidate on " name " change",                \
+                        testCacheChange, &change) < 0)                  \
+            ret = -1;                                                   \
+    } while (0)
+
+    DO_TEST_CHANGE("size", names[0], TEST_CHANGE_SIZE);
+    DO_TEST_CHANGE("mtime", names[1], TEST_CHANGE_MTIME);
+    DO_TEST_CHANGE("ctime", names[2], TEST_CHANGE_CTIME);
+    DO_TEST_CHANGE("inode", names[3], TEST_CHANGE_INODE);
+
+    if (virtTestRun("Prune deleted files", testCachePrune, &data) < 0)
+        ret = -1;
+
+ cleanup:
+    virStoragePoolObjListFree(&pools);
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+    VIR_FREE(xml);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
@@ -0,0 +1,557 @@
+/*
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "testutils.h"
+
+#include "storage/storage_job.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "virtime.h"
+#include "viruuid.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_JOBS 6
+#define TEST_POOLS 2
+
+/* What the jobs record, and when the blocking ones may return */
+struct testJobState {
+    virMutex lock;
+    virCond cond;
+    bool release;
+    size_t running[TEST_POOLS];
+    size_t maxRunning[TEST_POOLS];
+    size_t nstarted;
+    int started[TEST_JOBS];
+    size_t nnotified;
+    int notified[TEST_JOBS];
+    int states[TEST_JOBS];
+    size_t nfreed;
+};
+
+struct testJob {
+    struct testJobState *state;
+    int id;
+    int pool;
+    bool block;
+    bool fail;
+};
+
+static int
+testJobRun(virStorageJobPtr job,
+           void *opaque)
+{
+    struct testJob *data = opaque;
+    struct testJobState *state = data->state;
+
+    virMutexLock(&state->lock);
+    if (state->nstarted < TEST_JOBS)
+        state->started[state->nstarted++] = data->id;
+    if (++state->running[data->pool] > state->maxRunning[data->pool])
+        state->maxRunning[data->pool] = state->running[data->pool];
+    virCondBroadcast(&state->cond);
+
+    /* Aborting a job doesn't wake us up, so poll for it */
+    while (data->block && !state->release &&
+           !virStorageJobIsAborted(job)) {
+        virMutexUnlock(&state->lock);
+        usleep(1000);
+        virMutexLock(&state->lock);
+    }
+    state->running[data->pool]--;
+    virMutexUnlock(&state->lock);
+
+    if (virStorageJobCheckAborted(job) < 0)
+        return -1;
+
+    if (data->fail) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "job %d failed", data->id);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+testJobFree(void *opaque)
+{
+    struct testJob *data = opaque;
+    struct testJobState *state = data->state;
+
+    virMutexLock(&state->lock);
+    state->nfreed++;
+    virMutexUnlock(&state->lock);
+    VIR_FREE(data);
+}
+
+static void
+testJobNotify(virStorageJobPtr job,
+              void *opaque)
+{
+    struct testJobState *state = opaque;
+    int id;
+
+    if (virStrToLong_i(virStorageJobGetVol(job) + strlen("vol"),
+                       NULL, 10, &id) < 0)
+        id = -1;
+
+    virMutexLock(&state->lock);
+    if (state->nnotified < TEST_JOBS) {
+        state->notified[state->nnotified] = id;
+        state->states[state->nnotified++] = virStorageJobGetState(job);
+    }
+    virCondBroadcast(&state->cond);
+    virMutexUnlock(&state->lock);
+}
+
+static int
+testJobStateInit(struct testJobState *state)
+{
+    memset(state, 0, sizeof(*state));
+    if (virMutexInit(&state->lock) < 0)
+        return -1;
+    if (virCondInit(&state->cond) < 0) {
+        virMutexDestroy(&state->lock);
+        return -1;
+    }
+    return 0;
+}
+
+static void
+testJobStateDispose(struct testJobState *state)
+{
+    virCondDestroy(&state->cond);
+    virMutexDestroy(&state->lock);
+}
+
+static void
+testJobRelease(struct testJobState *state)
+{
+    virMutexLock(&state->lock);
+    state->release = true;
+    virCondBroadcast(&state->cond);
+    virMutexUnlock(&state->lock);
+}
+
+/* Wait for @count jobs to have started, or to have finished */
+static int
+testJobWait(struct testJobState *state,
+            size_t *counter,
+            size_t count)
+{
+    unsigned long long now;
+    int ret = 0;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    virMutexLock(&state->lock);
+    while (*counter < count) {
+        if (virCondWaitUntil(&state->cond, &state->lock, now + 5000) < 0) {
+            fprintf(stderr, "Only %zu of %zu jobs got there\n",
+                    *counter, count);
+            ret = -1;
+            break;
+        }
+    }
+    virMutexUnlock(&state->lock);
+    return ret;
+}
+
+#define testJobWaitStarted(state, count) \
+    testJobWait(state, &(state)->nstarted, count)
+#define testJobWaitNotified(state, count) \
+    testJobWait(state, &(state)->nnotified, count)
+
+/* Submit job @id to pool @pool, its volume is named after the job */
+static int
+testJobSubmit(virStorageJobTablePtr table,
+              struct testJobState *state,
+              int id,
+              int pool,
+              bool block,
+              bool fail,
+              bool async)
+{
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    char poolname[32];
+    char volname[32];
+    struct testJob *data;
+    virStorageJobPtr job;
+
+    if (VIR_ALLOC(data) < 0)
+        return -1;
+    data->state = state;
+    data->id = id;
+    data->pool = pool;
+    data->block = block;
+    data->fail = fail;
+
+    memset(uuid, pool + 1, sizeof(uuid));
+    snprintf(poolname, sizeof(poolname), "pool%d", pool);
+    snprintf(volname, sizeof(volname), "vol%d", id);
+
+    if (!(job = virStorageJobNew(VIR_STORAGE_JOB_VOL_BUILD, poolname, uuid,
+                                 volname, testJobRun, data, testJobFree))) {
+        VIR_FREE(data);
+        return -1;
+    }
+
+    return virStorageJobTableSubmit(table, job, async);
+}
+
+static int
+testJobCheckState(virStorageJobTablePtr table,
+                  int pool,
+                  int id,
+                  int expect)
+{
+    virStorageJobInfo info;
+    char poolname[32];
+    char volname[32];
+
+    snprintf(poolname, sizeof(poolname), "pool%d", pool);
+    snprintf(volname, sizeof(volname), "vol%d", id);
+
+    if (virStorageJobTableGetInfo(table, poolname, volname, &info) != 1) {
+        fprintf(stderr, "No job for %s\n", volname);
+        return -1;
+    }
+    if (info.state != expect) {
+        fprintf(stderr, "Expected job for %s in state %d, got %d\n",
+                volname, expect, info.state);
+        return -1;
+    }
+    return 0;
+}
+
+/* Check that jobs were notified in order 0, 1, ... with state @expect */
+static int
+testJobCheckNotified(struct testJobState *state,
+                     size_t count,
+                     int expect)
+{
+    size_t i;
+
+    if (state->nnotified != count) {
+        fprintf(stderr, "Expected %zu notifications, got %zu\n",
+                count, state->nnotified);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (state->notified[i] != (int) i || state->states[i] != expect) {
+            fprintf(stderr, "Expected job %zu to finish in state %d at %zu, "
+                    "got job %d in state %d\n", i, expect, i,
+                    state->notified[i], state->states[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Only one job of the pool runs at a time, the others wait as queued
+ * and run in submission order once the first one returns.
+ */
+static int
+testJobOrder(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testJobState state;
+    virStorageJobTablePtr table = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testJobStateInit(&state) < 0)
+        return -1;
+
+    if (!(table = virStorageJobTableNew(4, 1, testJobNotify, &state)))
+        goto cleanup;
+
+    for (i = 0; i < 4; i++) {
+        if (testJobSubmit(table, &state, i, 0, true, false, true) < 0)
+            goto cleanup;
+    }
+    if (testJobWaitStarted(&state, 1) < 0)
+        goto cleanup;
+
+    /* Give the queued jobs a chance to start if they were allowed to */
+    usleep(50 * 1000);
+    if (testJobCheckState(table, 0, 0, VIR_STORAGE_JOB_STATE_RUNNING) < 0)
+        goto cleanup;
+    for (i = 1; i < 4; i++) {
+        if (testJobCheckState(table, 0, i, VIR_STORAGE_JOB_STATE_QUEUED) < 0)
+            goto cleanup;
+    }
+
+    testJobRelease(&state);
+    if (testJobWaitNotified(&state, 4) < 0 ||
+        testJobCheckNotified(&state, 4, VIR_STORAGE_JOB_STATE_COMPLETED) < 0)
+        goto cleanup;
+
+    for (i = 0; i < 4; i++) {
+        if (state.started[i] != (int) i) {
+            fprintf(stderr, "Expected job %zu to start at %zu, got %d\n",
+                    i, i, state.started[i]);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+cleanup:
+    testJobRelease(&state);
+    virStorageJobTableFree(table);
+    testJobStateDispose(&state);
+    return ret;
+}
+
+/*
+ * With room for two jobs per pool, two pools run four jobs at once and
+ * keep the others queued, even though there are workers left.
+ */
+static int
+testJobPerPool(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testJobState state;
+    virStorageJobTablePtr table = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testJobStateInit(&state) < 0)
+        return -1;
+
+    if (!(table = virStorageJobTableNew(TEST_JOBS, 2, testJobNotify, &state)))
+        goto cleanup;
+
+    for (i = 0; i < TEST_JOBS; i++) {
+        if (testJobSubmit(table, &state, i, i % TEST_POOLS,
+                          true, false, true) < 0)
+            goto cleanup;
+    }
+    if (testJobWaitStarted(&state, 4) < 0)
+        goto cleanup;
+
+    usleep(50 * 1000);
+    virMutexLock(&state.lock);
+    if (state.nstarted != 4 || state.running[0] != 2 ||
+        state.running[1] != 2) {
+        fprintf(stderr, "Expected 2 running jobs per pool, got %zu and %zu "
+                "out of %zu\n", state.running[0], state.running[1],
+                state.nstarted);
+        virMutexUnlock(&state.lock);
+        goto cleanup;
+    }
+    virMutexUnlock(&state.lock);
+
+    testJobRelease(&state);
+    if (testJobWaitNotified(&state, TEST_JOBS) < 0)
+        goto cleanup;
+
+    for (i = 0; i < TEST_POOLS; i++) {
+        if (state.maxRunning[i] != 2) {
+            fprintf(stderr, "Pool %zu ran up to %zu jobs at once\n",
+                    i, state.maxRunning[i]);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+cleanup:
+    testJobRelease(&state);
+    virStorageJobTableFree(table);
+    testJobStateDispose(&state);
+    return ret;
+}
+
+/*
+ * Aborting the running job makes it return, and a queued job which was
+ * aborted still runs, to clean up after itself, but fails right away.
+ */
+static int
+testJobAbort(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testJobState state;
+    virStorageJobTablePtr table = NULL;
+    int ret = -1;
+
+    if (testJobStateInit(&state) < 0)
+        return -1;
+
+    if (!(table = virStorageJobTableNew(4, 1, testJobNotify, &state)))
+        goto cleanup;
+
+    if (testJobSubmit(table, &state, 0, 0, true, false, true) < 0 ||
+        testJobSubmit(table, &state, 1, 0, true, false, true) < 0 ||
+        testJobWaitStarted(&state, 1) < 0)
+        goto cleanup;
+
+    if (virStorageJobTableAbort(table, "pool0", "vol1") < 0 ||
+        virStorageJobTableAbort(table, "pool0", "vol0") < 0)
+        goto cleanup;
+
+    if (virStorageJobTableAbort(table, "pool0", "vol2") == 0) {
+        fprintf(stderr, "Aborting a missing job succeeded\n");
+        goto cleanup;
+    }
+
+    if (testJobWaitNotified(&state, 2) < 0 ||
+        testJobCheckNotified(&state, 2, VIR_STORAGE_JOB_STATE_CANCELLED) < 0)
+        goto cleanup;
+
+    if (state.nstarted != 2 || state.started[1] != 1) {
+        fprintf(stderr, "Expected the aborted queued job to run\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    testJobRelease(&state);
+    virStorageJobTableFree(table);
+    testJobStateDispose(&state);
+    return ret;
+}
+
+/*
+ * A synchronous submit returns once the job finished and was notified,
+ * with the job's error; an asynchronous one returns while it runs.
+ */
+static int
+testJobSync(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testJobState state;
+    virStorageJobTablePtr table = NULL;
+    const char *msg;
+    int ret = -1;
+
+    if (testJobStateInit(&state) < 0)
+        return -1;
+
+    if (!(table = virStorageJobTableNew(4, 1, testJobNotify, &state)))
+        goto cleanup;
+
+    if (testJobSubmit(table, &state, 0, 0, false, false, false) < 0)
+        goto cleanup;
+    if (testJobCheckNotified(&state, 1, VIR_STORAGE_JOB_STATE_COMPLETED) < 0)
+        goto cleanup;
+
+    if (testJobSubmit(table, &state, 1, 0, false, true, false) == 0) {
+        fprintf(stderr, "Failing job reported success\n");
+        goto cleanup;
+    }
+    msg = virGetLastErrorMessage();
+    if (!strstr(msg, "job 1 failed")) {
+        fprintf(stderr, "Expected the job's error, got '%s'\n", msg);
+        goto cleanup;
+    }
+    if (state.nnotified != 2 ||
+        state.states[1] != VIR_STORAGE_JOB_STATE_FAILED) {
+        fprintf(stderr, "Failing job was not notified as failed\n");
+        goto cleanup;
+    }
+
+    if (testJobSubmit(table, &state, 2, 0, true, false, true) < 0 ||
+        testJobWaitStarted(&state, 3) < 0 ||
+        testJobCheckState(table, 0, 2, VIR_STORAGE_JOB_STATE_RUNNING) < 0)
+        goto cleanup;
+
+    testJobRelease(&state);
+    if (testJobWaitNotified(&state, 3) < 0 ||
+        state.states[2] != VIR_STORAGE_JOB_STATE_COMPLETED)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    testJobRelease(&state);
+    virStorageJobTableFree(table);
+    testJobStateDispose(&state);
+    return ret;
+}
+
+/*
+ * Freeing the table aborts the running job and runs the queued ones as
+ * aborted, waits for all of them and releases them.
+ */
+static int
+testJobCleanup(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testJobState state;
+    virStorageJobTablePtr table = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testJobStateInit(&state) < 0)
+        return -1;
+
+    if (!(table = virStorageJobTableNew(4, 1, testJobNotify, &state)))
+        goto cleanup;
+
+    for (i = 0; i < 3; i++) {
+        if (testJobSubmit(table, &state, i, 0, true, false, true) < 0)
+            goto cleanup;
+    }
+    if (testJobWaitStarted(&state, 1) < 0)
+        goto cleanup;
+
+    virStorageJobTableFree(table);
+    table = NULL;
+
+    if (testJobCheckNotified(&state, 3, VIR_STORAGE_JOB_STATE_CANCELLED) < 0)
+        goto cleanup;
+    if (state.nstarted != 3 || state.nfreed != 3) {
+        fprintf(stderr, "Expected 3 jobs run and freed, got %zu and %zu\n",
+                state.nstarted, state.nfreed);
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    testJobRelease(&state);
+    virStorageJobTableFree(table);
+    testJobStateDispose(&state);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    virtTestQuiesceLibvirtErrors(false);
+
+    if (virtTestRun("Queueing and ordering", testJobOrder, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Per-pool limit", testJobPerPool, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Abort queued and running jobs", testJobAbort, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Sync and async submit", testJobSync, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Cleanup with pending jobs", testJobCleanup, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
@@ -0,0 +1,615 @@
+/*
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#include "storage_conf.h"
+#include "viralloc.h"
+#include "viruuid.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+static virStoragePoolDefPtr
+testPoolDefParse(const char *name)
+{
+    virStoragePoolDefPtr def;
+    char *file;
+
+    if (virAsprintf(&file, "%s/storagepoolxml2xmlin/%s.xml",
+                    abs_srcdir, name) < 0)
+        return NULL;
+
+    def = virStoragePoolDefParseFile(file);
+    VIR_FREE(file);
+    return def;
+}
+
+static virStorageVolDefPtr
+testVolDefParse(virStoragePoolObjPtr pool,
+                const char *name)
+{
+    virStorageVolDefPtr def;
+    char *file;
+
+    if (virAsprintf(&file, "%s/storagevolxml2xmlin/%s.xml",
+                    abs_srcdir, name) < 0)
+        return NULL;
+
+    def = virStorageVolDefParseFile(pool->def, file);
+    VIR_FREE(file);
+    return def;
+}
+
+/* Add a pool of definition @name to @pools, returning it unlocked */
+static virStoragePoolObjPtr
+testPoolObjNew(virStoragePoolObjListPtr pools,
+               const char *name)
+{
+    virStoragePoolDefPtr def;
+    virStoragePoolObjPtr pool;
+
+    if (!(def = testPoolDefParse(name)))
+        return NULL;
+
+    if (!(pool = virStoragePoolObjAssignDef(pools, def))) {
+        virStoragePoolDefFree(def);
+        return NULL;
+    }
+    pool->active = 1;
+    virStoragePoolObjUnlock(pool);
+
+    return pool;
+}
+
+static int
+testPoolObjAddVols(virStoragePoolObjPtr pool,
+                   const char *const *names,
+                   size_t nnames)
+{
+    virStorageVolDefPtr vol;
+    size_t i;
+
+    for (i = 0; i < nnames; i++) {
+        if (!(vol = testVolDefParse(pool, names[i])))
+            return -1;
+
+        if (virStoragePoolObjAddVol(pool, vol) < 0) {
+            virStorageVolDefFree(vol);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Check that each lookup index of @pool yields @vol */
+static int
+testCheckVolIndexed(virStoragePoolObjPtr pool,
+                    virStorageVolDefPtr vol)
+{
+    if (virStorageVolDefFindByName(pool, vol->name) != vol) {
+        fprintf(stderr, "volume '%s' not found by name\n", vol->name);
+        return -1;
+    }
+
+    if (vol->key && virStorageVolDefFindByKey(pool, vol->key) != vol) {
+        fprintf(stderr, "volume '%s' not found by key '%s'\n",
+                vol->name, vol->key);
+        return -1;
+    }
+
+    if (vol->target.path &&
+        virStorageVolDefFindByPath(pool, vol->target.path) != vol) {
+        fprintf(stderr, "volume '%s' not found by path '%s'\n",
+                vol->name, vol->target.path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+testCheckAllVolsIndexed(virStoragePoolObjPtr pool)
+{
+    size_t i;
+
+    for (i = 0; i < pool->volumes.count; i++) {
+        if (testCheckVolIndexed(pool, pool->volumes.objs[i]) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static const char *const testVolNames[] = {
+    "vol-file", "vol-file-naming", "vol-qcow2",
+};
+
+static int
+testPoolIndex(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools;
+    virStoragePoolObjPtr pool;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    char *name = NULL;
+    const char *names[] = { "pool-dir", "pool-fs", "pool-logical" };
+    size_t i;
+    int ret = -1;
+
+    memset(&pools, 0, sizeof(pools));
+
+    for (i = 0; i < ARRAY_CARDINALITY(names); i++) {
+        if (!testPoolObjNew(&pools, names[i]))
+            goto cleanup;
+    }
+
+    for (i = 0; i < pools.count; i++) {
+        virStoragePoolObjPtr obj = pools.objs[i];
+
+        if ((pool = virStoragePoolObjFindByName(&pools, obj->def->name)))
+            virStoragePoolObjUnlock(pool);
+        if (pool != obj) {
+            fprintf(stderr, "pool '%s' not found by name\n", obj->def->name);
+            goto cleanup;
+        }
+
+        if ((pool = virStoragePoolObjFindByUUID(&pools, obj->def->uuid)))
+            virStoragePoolObjUnlock(pool);
+        if (pool != obj) {
+            fprintf(stderr, "pool '%s' not found by UUID\n", obj->def->name);
+            goto cleanup;
+        }
+    }
+
+    /* Removing a pool takes it out of both indexes */
+    pool = pools.objs[1];
+    memcpy(uuid, pool->def->uuid, VIR_UUID_BUFLEN);
+    if (VIR_STRDUP(name, pool->def->name) < 0)
+        goto cleanup;
+    virStoragePoolObjLock(pool);
+    virStoragePoolObjRemove(&pools, pool);
+
+    if (pools.count != 2 ||
+        virStoragePoolObjFindByName(&pools, name) ||
+        virStoragePoolObjFindByUUID(&pools, uuid)) {
+        fprintf(stderr, "removed pool is still listed\n");
+        goto cleanup;
+    }
+
+    for (i = 0; i < pools.count; i++) {
+        if ((pool = virStoragePoolObjFindByName(&pools,
+                                                pools.objs[i]->def->name)))
+            virStoragePoolObjUnlock(pool);
+        if (pool != pools.objs[i]) {
+            fprintf(stderr, "pool '%s' lost by removal\n",
+                    pools.objs[i]->def->name);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(name);
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+static int
+testVolIndexAddRemove(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools;
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr vol;
+    char *key = NULL;
+    char *path = NULL;
+    int ret = -1;
+
+    memset(&pools, 0, sizeof(pools));
+    if (!(pool = testPoolObjNew(&pools, "pool-dir")))
+        goto cleanup;
+
+    if (testPoolObjAddVols(pool, testVolNames,
+                           ARRAY_CARDINALITY(testVolNames)) < 0 ||
+        testCheckAllVolsIndexed(pool) < 0)
+        goto cleanup;
+
+    if (virStorageVolDefFindByName(pool, "no-such-vol") ||
+        virStorageVolDefFindByPath(pool, "/no/such/path")) {
+        fprintf(stderr, "lookup of missing volume succeeded\n");
+        goto cleanup;
+    }
+
+    if (!(vol = virStorageVolDefFindByName(pool, "OtherDemo.img")) ||
+        VIR_STRDUP(key, vol->key) < 0 ||
+        VIR_STRDUP(path, vol->target.path) < 0)
+        goto cleanup;
+
+    virStoragePoolObjRemoveVol(pool, vol);
+    virStorageVolDefFree(vol);
+
+    if (pool->volumes.count != 2 ||
+        virStorageVolDefFindByName(pool, "OtherDemo.img") ||
+        virStorageVolDefFindByKey(pool, key) ||
+        virStorageVolDefFindByPath(pool, path)) {
+        fprintf(stderr, "removed volume is still indexed\n");
+        goto cleanup;
+    }
+
+    if (testCheckAllVolsIndexed(pool) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(key);
+    VIR_FREE(path);
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+static int
+testVolReindex(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools;
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr vol;
+    virStorageVolDefPtr other;
+    char *oldKey = NULL;
+    char *oldPath = NULL;
+    int ret = -1;
+
+    memset(&pools, 0, sizeof(pools));
+    if (!(pool = testPoolObjNew(&pools, "pool-dir")))
+        goto cleanup;
+
+    if (testPoolObjAddVols(pool, testVolNames,
+                           ARRAY_CARDINALITY(testVolNames)) < 0)
+        goto cleanup;
+
+    if (!(vol = virStorageVolDefFindByName(pool, "OtherDemo.img")) ||
+        !(other = virStorageVolDefFindByName(pool, "sparse.img")))
+        goto cleanup;
+
+    /* Change key and path the way a refreshVol callback does */
+    oldKey = vol->key;
+    oldPath = vol->target.path;
+    vol->key = NULL;
+    vol->target.path = NULL;
+    if (VIR_STRDUP(vol->key, "/dev/vg/OtherDemo") < 0 ||
+        VIR_STRDUP(vol->target.path, "/dev/vg/OtherDemo") < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjReindexVol(pool, vol) < 0)
+        goto cleanup;
+
+    if (virStorageVolDefFindByKey(pool, oldKey) ||
+        virStorageVolDefFindByPath(pool, oldPath)) {
+        fprintf(stderr, "stale key or path is still indexed\n");
+        goto cleanup;
+    }
+
+    if (testCheckAllVolsIndexed(pool) < 0)
+        goto cleanup;
+
+    /* Reindexing an unchanged volume is a no-op */
+    if (virStoragePoolObjReindexVol(pool, other) < 0 ||
+        testCheckAllVolsIndexed(pool) < 0)
+        goto cleanup;
+
+    /* A volume which lost its key is no longer found by the old one */
+    VIR_FREE(vol->key);
+    if (virStoragePoolObjReindexVol(pool, vol) < 0)
+        goto cleanup;
+
+    if (virStorageVolDefFindByKey(pool, "/dev/vg/OtherDemo")) {
+        fprintf(stderr, "dropped key is still indexed\n");
+        goto cleanup;
+    }
+
+    if (testCheckAllVolsIndexed(pool) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(oldKey);
+    VIR_FREE(oldPath);
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+static int
+testShadowFull(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools;
+    virStoragePoolObjPtr pool;
+    virStoragePoolObjPtr shadow = NULL;
+    virStorageVolDefPtr oldvol;
+    const char *refreshed[] = { "vol-file-backing", "vol-sheepdog" };
+    int ret = -1;
+
+    memset(&pools, 0, sizeof(pools));
+    if (!(pool = testPoolObjNew(&pools, "pool-dir")))
+        goto cleanup;
+
+    if (testPoolObjAddVols(pool, testVolNames,
+                           ARRAY_CARDINALITY(testVolNames)) < 0)
+        goto cleanup;
+    oldvol = virStorageVolDefFindByName(pool, "sparse.img");
+
+    if (!(shadow = virStoragePoolObjNewShadow(pool, false)))
+        goto cleanup;
+
+    if (shadow->volumes.count != 0 || shadow->origin != pool) {
+        fprintf(stderr, "full refresh shadow does not start out empty\n");
+        goto cleanup;
+    }
+
+    /* The refresh rebuilds the list while the pool keeps its own */
+    if (testPoolObjAddVols(shadow, refreshed,
+                           ARRAY_CARDINALITY(refreshed)) < 0)
+        goto cleanup;
+
+    if (pool->volumes.count != 3 ||
+        virStorageVolDefFindByName(pool, "sparse.img") != oldvol ||
+        virStorageVolDefFindByName(pool, "test2") ||
+        testCheckAllVolsIndexed(pool) < 0) {
+        fprintf(stderr, "refresh shadow changed the live pool\n");
+        goto cleanup;
+    }
+
+    virStoragePoolObjCommitShadow(pool, shadow);
+    shadow = NULL;
+
+    if (pool->volumes.count != 2 ||
+        !virStorageVolDefFindByName(pool, "test2") ||
+        !virStorageVolDefFindByKey(pool,
+                                   "/var/lib/libvirt/images/sparse.img") ||
+        virStorageVolDefFindByName(pool, "OtherDemo.img") ||
+        virStorageVolDefFindByName(pool, "<sparse>.img") ||
+        virStorageVolDefFindByKey(pool,
+                                  "/var/lib/libvirt/images/OtherDemo.img")) {
+        fprintf(stderr, "commit did not replace the volume list\n");
+        goto cleanup;
+    }
+
+    if (testCheckAllVolsIndexed(pool) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virStoragePoolObjFreeShadow(shadow);
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+/* Run an incremental refresh of the volumes of @pool, which drops
+ * OtherDemo.img and finds test2 */
+static virStoragePoolObjPtr
+testShadowIncrementalRefresh(virStoragePoolObjPtr pool)
+{
+    virStoragePoolObjPtr shadow;
+    virStorageVolDefPtr vol;
+    const char *found[] = { "vol-sheepdog" };
+    size_t i;
+
+    if (!(shadow = virStoragePoolObjNewShadow(pool, true)))
+        return NULL;
+
+    if (shadow->volumes.count != pool->volumes.count) {
+        fprintf(stderr, "incremental shadow lacks volumes of the pool\n");
+        goto error;
+    }
+    for (i = 0; i < pool->volumes.count; i++) {
+        if (shadow->volumes.objs[i] != pool->volumes.objs[i]) {
+            fprintf(stderr, "incremental shadow does not borrow volumes\n");
+            goto error;
+        }
+    }
+
+    if (!(vol = virStorageVolDefFindByName(shadow, "OtherDemo.img")))
+        goto error;
+    virStoragePoolObjDropVol(shadow, vol);
+
+    if (testPoolObjAddVols(shadow, found, ARRAY_CARDINALITY(found)) < 0)
+        goto error;
+
+    /* A borrowed volume is not freed when dropped from the shadow */
+    if (virStorageVolDefFindByName(shadow, "OtherDemo.img") ||
+        virStorageVolDefFindByName(pool, "OtherDemo.img") != vol ||
+        STRNEQ(vol->name, "OtherDemo.img") ||
+        virStorageVolDefFindByName(pool, "test2") ||
+        testCheckAllVolsIndexed(pool) < 0 ||
+        testCheckAllVolsIndexed(shadow) < 0) {
+        fprintf(stderr, "dropping a borrowed volume changed the pool\n");
+        goto error;
+    }
+
+    return shadow;
+
+error:
+    virStoragePoolObjFreeShadow(shadow);
+    return NULL;
+}
+
+static int
+testShadowIncremental(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools;
+    virStoragePoolObjPtr pool;
+    virStoragePoolObjPtr shadow = NULL;
+    virStorageVolDefPtr kept;
+    int ret = -1;
+
+    memset(&pools, 0, sizeof(pools));
+    if (!(pool = testPoolObjNew(&pools, "pool-dir")))
+        goto cleanup;
+
+    if (testPoolObjAddVols(pool, testVolNames,
+                           ARRAY_CARDINALITY(testVolNames)) < 0)
+        goto cleanup;
+    kept = virStorageVolDefFindByName(pool, "sparse.img");
+
+    /* A failed refresh leaves the pool alone */
+    if (!(shadow = testShadowIncrementalRefresh(pool)))
+        goto cleanup;
+    virStoragePoolObjFreeShadow(shadow);
+    shadow = NULL;
+
+    if (pool->volumes.count != 3 ||
+        !virStorageVolDefFindByName(pool, "OtherDemo.img") ||
+        testCheckAllVolsIndexed(pool) < 0) {
+        fprintf(stderr, "discarding the shadow changed the pool\n");
+        goto cleanup;
+    }
+
+    if (!(shadow = testShadowIncrementalRefresh(pool)))
+        goto cleanup;
+    virStoragePoolObjCommitShadow(pool, shadow);
+    shadow = NULL;
+
+    if (pool->volumes.count != 3 ||
+        virStorageVolDefFindByName(pool, "sparse.img") != kept ||
+        !virStorageVolDefFindByName(pool, "<sparse>.img") ||
+        !virStorageVolDefFindByName(pool, "test2") ||
+        virStorageVolDefFindByName(pool, "OtherDemo.img") ||
+        virStorageVolDefFindByKey(pool,
+                                  "/var/lib/libvirt/images/OtherDemo.img")) {
+        fprintf(stderr, "commit did not update the volume list\n");
+        goto cleanup;
+    }
+
+    if (testCheckAllVolsIndexed(pool) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virStoragePoolObjFreeShadow(shadow);
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+static size_t testPrivateDataFreed;
+
+static void
+testPrivateDataFree(void *opaque)
+{
+    testPrivateDataFreed++;
+    VIR_FREE(opaque);
+}
+
+static int
+testShadowPrivateData(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools;
+    virStoragePoolObjPtr pool;
+    virStoragePoolObjPtr shadow = NULL;
+    int *priv = NULL;
+    int ret = -1;
+
+    memset(&pools, 0, sizeof(pools));
+    testPrivateDataFreed = 0;
+
+    if (!(pool = testPoolObjNew(&pools, "pool-dir")) ||
+        VIR_ALLOC(priv) < 0)
+        goto cleanup;
+    pool->privateData = priv;
+    pool->privateDataFreeFunc = testPrivateDataFree;
+    priv = NULL;
+
+    /* Shared private data stays with the pool */
+    if (!(shadow = virStoragePoolObjNewShadow(pool, false)))
+        goto cleanup;
+    if (shadow->privateData != pool->privateData) {
+        fprintf(stderr, "shadow does not share the private data\n");
+        goto cleanup;
+    }
+    virStoragePoolObjFreeShadow(shadow);
+    shadow = NULL;
+    if (testPrivateDataFreed != 0) {
+        fprintf(stderr, "discarded shadow freed shared private data\n");
+        goto cleanup;
+    }
+
+    /* Private data set up by a failed refresh is dropped with it */
+    if (!(shadow = virStoragePoolObjNewShadow(pool, false)) ||
+        VIR_ALLOC(priv) < 0)
+        goto cleanup;
+    shadow->privateData = priv;
+    priv = NULL;
+    virStoragePoolObjFreeShadow(shadow);
+    shadow = NULL;
+    if (testPrivateDataFreed != 1) {
+        fprintf(stderr, "discarded shadow leaked its private data\n");
+        goto cleanup;
+    }
+
+    /* ... and replaces the one of the pool on commit */
+    if (!(shadow = virStoragePoolObjNewShadow(pool, false)) ||
+        VIR_ALLOC(priv) < 0)
+        goto cleanup;
+    shadow->privateData = priv;
+    virStoragePoolObjCommitShadow(pool, shadow);
+    shadow = NULL;
+    if (testPrivateDataFreed != 2 || pool->privateData != priv) {
+        priv = NULL;
+        fprintf(stderr, "commit did not hand over the private data\n");
+        goto cleanup;
+    }
+    priv = NULL;
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(priv);
+    virStoragePoolObjFreeShadow(shadow);
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virtTestRun("Pool name and UUID index", testPoolIndex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Volume index add and remove",
+                    testVolIndexAddRemove, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Volume reindex", testVolReindex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Shadow of full refresh", testShadowFull, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Shadow of incremental refresh",
+                    testShadowIncremental, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Shadow private data",
+                    testShadowPrivateData, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
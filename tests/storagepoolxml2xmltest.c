@@ -103,6 +103,7 @@ mymain(void)
     DO_TEST("pool-sheepdog");
     DO_TEST("pool-gluster");
     DO_TEST("pool-gluster-sub");
+    DO_TEST("pool-openvstorage");
 
     return ret==0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "testutils.h"
+
+#if defined(__linux__) && HAVE_FALLOCATE - 0 && \
+    defined(FALLOC_FL_ZERO_RANGE) && defined(FALLOC_FL_PUNCH_HOLE)
+
+# include <dlfcn.h>
+
+# include "storage/storage_driver.h"
+# include "viralloc.h"
+# include "virerror.h"
+# include "virfile.h"
+# include "virstring.h"
+# include "virthread.h"
+
+# define VIR_FROM_THIS VIR_FROM_NONE
+
+/* pwrite and fallocate are replaced below, so the test can look at the
+ * writes done by the zero fill fallback, and take away the offload
+ * methods which are otherwise picked on any file system supporting
+ * them */
+static ssize_t (*realpwrite)(int fd, const void *buf, size_t count,
+                             off_t offset);
+static int (*realfallocate)(int fd, int mode, off_t offset, off_t len);
+
+typedef struct _testWipeWrite testWipeWrite;
+struct _testWipeWrite {
+    off_t offset;
+    size_t len;
+    int thread;
+    bool direct;
+    bool failed;
+};
+
+static virMutex mockLock;
+static bool mockActive;
+static int mockFallocateFail;   /* fallocate modes failing with EOPNOTSUPP */
+static bool mockDirectFail;     /* fail O_DIRECT writes with EINVAL */
+static bool mockDryRun;         /* record writes without doing them */
+static testWipeWrite *mockWrites;
+static size_t mockNWrites;
+
+static void
+init_syms(void)
+{
+    if (realpwrite)
+        return;
+
+# define LOAD_SYM(name)                                                 \
+    do {                                                                \
+        if (!(real ## name = dlsym(RTLD_NEXT, #name))) {                \
+            fprintf(stderr, "Cannot find real '%s' symbol\n", #name);   \
+            abort();                                                    \
+        }                                                               \
+    } while (0)
+
+    LOAD_SYM(fallocate);
+    LOAD_SYM(pwrite);
+}
+
+int
+fallocate(int fd, int mode, off_t offset, off_t len)
+{
+    init_syms();
+
+    if (mockActive && (mode & mockFallocateFail)) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return realfallocate(fd, mode, offset, len);
+}
+
+ssize_t
+pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    testWipeWrite entry = { offset, count, virThreadSelfID(), false, false };
+
+    init_syms();
+
+    if (!mockActive)
+        return realpwrite(fd, buf, count, offset);
+
+    entry.direct = (fcntl(fd, F_GETFL) & O_DIRECT) != 0;
+    entry.failed = entry.direct && mockDirectFail;
+
+    virMutexLock(&mockLock);
+    if (VIR_APPEND_ELEMENT_COPY_QUIET(mockWrites, mockNWrites, entry) < 0)
+        abort();
+    virMutexUnlock(&mockLock);
+
+    if (entry.failed) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (mockDryRun)
+        return count;
+    return realpwrite(fd, buf, count, offset);
+}
+
+
+/* The volume is filled with FILL_BYTE, then the range starting at
+ * WIPE_START is wiped. Its start is aligned for O_DIRECT, its length
+ * is not, to get a tail written through the page cache. */
+# define FILL_BYTE 0x5a
+# define WIPE_START (STORAGE_WIPE_ALIGN * 2)
+# define WIPE_LEN (1024 * 1024 + 100)
+# define VOLUME_LEN (WIPE_START + WIPE_LEN + STORAGE_WIPE_ALIGN)
+
+enum {
+    TEST_WIPE_OFFLOAD,      /* FALLOC_FL_ZERO_RANGE */
+    TEST_WIPE_PUNCH,        /* FALLOC_FL_PUNCH_HOLE and allocate again */
+    TEST_WIPE_WRITE,        /* zero fill, O_DIRECT where aligned */
+    TEST_WIPE_WRITE_NODIRECT, /* zero fill, O_DIRECT failing with EINVAL */
+};
+
+struct testWipeData {
+    const char *scratchdir;
+    int method;
+};
+
+static bool haveDirect;
+
+static int
+testWriteCompare(const void *a, const void *b)
+{
+    const testWipeWrite *wa = a;
+    const testWipeWrite *wb = b;
+
+    if (wa->offset < wb->offset)
+        return -1;
+    return wa->offset > wb->offset;
+}
+
+/* Checks the writes handed out by the zero fill fallback: they have to
+ * cover [start, end) exactly once, each staying within its chunk and
+ * the buffer size, and go through O_DIRECT only when aligned. Failed
+ * O_DIRECT writes are retried through the page cache, and make the
+ * writer stay there. */
+static int
+testCheckWrites(off_t start, off_t end, bool direct)
+{
+    off_t offset = start;
+    size_t nthreads = 0;
+    int threads[STORAGE_WIPE_WRITERS];
+    size_t i, j;
+
+    for (i = 0; i < mockNWrites; i++) {
+        testWipeWrite *entry = &mockWrites[i];
+
+        if (entry->failed) {
+            for (j = i + 1; j < mockNWrites; j++) {
+                if (mockWrites[j].thread == entry->thread &&
+                    mockWrites[j].direct) {
+                    fprintf(stderr, "Writer %d kept using O_DIRECT\n",
+                            entry->thread);
+                    return -1;
+                }
+            }
+        }
+
+        for (j = 0; j < nthreads; j++) {
+            if (threads[j] == entry->thread)
+                break;
+        }
+        if (j == nthreads) {
+            if (nthreads == STORAGE_WIPE_WRITERS) {
+                fprintf(stderr, "More than %d writers\n",
+                        STORAGE_WIPE_WRITERS);
+                return -1;
+            }
+            threads[nthreads++] = entry->thread;
+        }
+    }
+
+    /* Drop the failed attempts, they are covered by their retry */
+    for (i = 0, j = 0; i < mockNWrites; i++) {
+        if (!mockWrites[i].failed)
+            mockWrites[j++] = mockWrites[i];
+    }
+    mockNWrites = j;
+    qsort(mockWrites, mockNWrites, sizeof(*mockWrites), testWriteCompare);
+
+    for (i = 0; i < mockNWrites; i++) {
+        testWipeWrite *entry = &mockWrites[i];
+        bool aligned = entry->offset % STORAGE_WIPE_ALIGN == 0 &&
+            entry->len % STORAGE_WIPE_ALIGN == 0;
+
+        if (entry->offset != offset) {
+            fprintf(stderr, "Expected a write at %lld, got one at %lld\n",
+                    (long long) offset, (long long) entry->offset);
+            return -1;
+        }
+        if (entry->len > STORAGE_WIPE_BUF_SIZE ||
+            (entry->offset - start) / STORAGE_WIPE_CHUNK_SIZE !=
+            (entry->offset + entry->len - 1 - start) / STORAGE_WIPE_CHUNK_SIZE) {
+            fprintf(stderr, "Write of %zu bytes at %lld is not within "
+                    "a single chunk\n", entry->len, (long long) entry->offset);
+            return -1;
+        }
+        if (entry->direct != (direct && aligned)) {
+            fprintf(stderr, "Write of %zu bytes at %lld %s O_DIRECT\n",
+                    entry->len, (long long) entry->offset,
+                    entry->direct ? "used" : "did not use");
+            return -1;
+        }
+        offset += entry->len;
+    }
+
+    if (offset != end) {
+        fprintf(stderr, "Writes stopped at %lld instead of %lld\n",
+                (long long) offset, (long long) end);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+testMockReset(void)
+{
+    mockActive = false;
+    mockFallocateFail = 0;
+    mockDirectFail = false;
+    mockDryRun = false;
+    VIR_FREE(mockWrites);
+    mockNWrites = 0;
+}
+
+static int
+testWipe(const void *opaque)
+{
+    const struct testWipeData *data = opaque;
+    virStorageVolDefPtr vol = NULL;
+    unsigned long long wiped = 0;
+    char *buf = NULL;
+    int fd = -1;
+    int ret = -1;
+    int rc;
+    size_t i;
+
+    if (VIR_ALLOC(vol) < 0 || VIR_ALLOC_N(buf, VOLUME_LEN) < 0 ||
+        virAsprintf(&vol->target.path, "%s/wipe.data", data->scratchdir) < 0)
+        goto cleanup;
+
+    memset(buf, FILL_BYTE, VOLUME_LEN);
+    if ((fd = open(vol->target.path, O_CREAT|O_RDWR|O_EXCL, 0600)) < 0 ||
+        safewrite(fd, buf, VOLUME_LEN) != VOLUME_LEN)
+        goto cleanup;
+
+    switch (data->method) {
+    case TEST_WIPE_OFFLOAD:
+        break;
+    case TEST_WIPE_PUNCH:
+        mockFallocateFail = FALLOC_FL_ZERO_RANGE;
+        break;
+    case TEST_WIPE_WRITE_NODIRECT:
+        mockDirectFail = true;
+        /* fallthrough */
+    case TEST_WIPE_WRITE:
+        mockFallocateFail = FALLOC_FL_ZERO_RANGE | FALLOC_FL_PUNCH_HOLE;
+        break;
+    }
+
+    mockActive = true;
+    rc = storageWipeExtent(vol, fd, false, WIPE_START, WIPE_LEN, &wiped);
+    mockActive = false;
+    if (rc < 0) {
+        fprintf(stderr, "Wipe failed: %s\n", virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    if (wiped != WIPE_LEN) {
+        fprintf(stderr, "Expected %d bytes wiped, got %llu\n",
+                WIPE_LEN, wiped);
+        goto cleanup;
+    }
+
+    if (data->method == TEST_WIPE_OFFLOAD ||
+        data->method == TEST_WIPE_PUNCH) {
+        if (mockNWrites) {
+            fprintf(stderr, "Offloaded wipe wrote %zu times\n", mockNWrites);
+            goto cleanup;
+        }
+    } else if (testCheckWrites(WIPE_START, WIPE_START + WIPE_LEN,
+                               haveDirect &&
+                               data->method == TEST_WIPE_WRITE) < 0) {
+        goto cleanup;
+    }
+
+    if (lseek(fd, 0, SEEK_END) != VOLUME_LEN) {
+        fprintf(stderr, "Volume size changed\n");
+        goto cleanup;
+    }
+    if (pread(fd, buf, VOLUME_LEN, 0) != VOLUME_LEN)
+        goto cleanup;
+    for (i = 0; i < VOLUME_LEN; i++) {
+        char expect = (i >= WIPE_START && i < WIPE_START + WIPE_LEN) ?
+            0 : FILL_BYTE;
+
+        if (buf[i] != expect) {
+            fprintf(stderr, "Unexpected byte 0x%x at offset %zu\n",
+                    (unsigned char) buf[i], i);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+cleanup:
+    testMockReset();
+    VIR_FORCE_CLOSE(fd);
+    if (vol && vol->target.path)
+        unlink(vol->target.path);
+    virStorageVolDefFree(vol);
+    VIR_FREE(buf);
+    return ret;
+}
+
+/* A volume spanning several chunks plus an unaligned tail, sparse and
+ * never actually written, to see how the chunks are handed out */
+# define CHUNKS_LEN (STORAGE_WIPE_CHUNK_SIZE * (STORAGE_WIPE_WRITERS + 1) + \
+                     STORAGE_WIPE_ALIGN + 100)
+
+static int
+testWipeChunks(const void *opaque)
+{
+    const struct testWipeData *data = opaque;
+    virStorageVolDefPtr vol = NULL;
+    unsigned long long wiped = 0;
+    int fd = -1;
+    int ret = -1;
+    int rc;
+
+    if (VIR_ALLOC(vol) < 0 ||
+        virAsprintf(&vol->target.path, "%s/wipe-chunks.data",
+                    data->scratchdir) < 0)
+        goto cleanup;
+
+    if ((fd = open(vol->target.path, O_CREAT|O_RDWR|O_EXCL, 0600)) < 0 ||
+        ftruncate(fd, CHUNKS_LEN) < 0)
+        goto cleanup;
+
+    mockFallocateFail = FALLOC_FL_ZERO_RANGE | FALLOC_FL_PUNCH_HOLE;
+    mockDryRun = true;
+    mockActive = true;
+    rc = storageWipeExtent(vol, fd, false, 0, CHUNKS_LEN, &wiped);
+    mockActive = false;
+    if (rc < 0) {
+        fprintf(stderr, "Wipe failed: %s\n", virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    if (wiped != CHUNKS_LEN) {
+        fprintf(stderr, "Expected %llu bytes wiped, got %llu\n",
+                (unsigned long long) CHUNKS_LEN, wiped);
+        goto cleanup;
+    }
+
+    if (testCheckWrites(0, CHUNKS_LEN, haveDirect) < 0)
+        goto cleanup;
+
+    ret = 0;
+cleanup:
+    testMockReset();
+    VIR_FORCE_CLOSE(fd);
+    if (vol && vol->target.path)
+        unlink(vol->target.path);
+    virStorageVolDefFree(vol);
+    return ret;
+}
+
+# define SCRATCHDIRTEMPLATE abs_builddir "/storagewipe-XXXXXX"
+
+static int
+mymain(void)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    char *path = NULL;
+    int ret = 0;
+    int fd;
+
+    if (virMutexInit(&mockLock) < 0)
+        return EXIT_FAILURE;
+
+    if (!mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create scratch dir\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Not every file system allows O_DIRECT, the writers then stick to
+     * the page cache */
+    if (virAsprintf(&path, "%s/direct.data", scratchdir) < 0)
+        return EXIT_FAILURE;
+    if ((fd = open(path, O_CREAT|O_WRONLY|O_DIRECT, 0600)) >= 0) {
+        haveDirect = true;
+        VIR_FORCE_CLOSE(fd);
+        unlink(path);
+    }
+    VIR_FREE(path);
+
+# define DO_TEST(name, func, method)                                     \
+    do {                                                                \
+        struct testWipeData data = { scratchdir, method };              \
+        if (virtTestRun(name, func, &data) < 0)                         \
+            ret = -1;                                                   \
+    } while (0)
+
+    DO_TEST("Wipe with zero range", testWipe, TEST_WIPE_OFFLOAD);
+    DO_TEST("Wipe with punched hole", testWipe, TEST_WIPE_PUNCH);
+    DO_TEST("Wipe with writes", testWipe, TEST_WIPE_WRITE);
+    DO_TEST("Wipe with writes, no O_DIRECT", testWipe,
+            TEST_WIPE_WRITE_NODIRECT);
+    DO_TEST("Wipe chunks", testWipeChunks, TEST_WIPE_WRITE);
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif
@@ -519,6 +519,75 @@ cleanup:
     return ret;
 }
 
+static int testMessagePool(const void *args ATTRIBUTE_UNUSED)
+{
+    virNetMessagePoolPtr pool = NULL;
+    virNetMessagePtr msg = NULL;
+    char *buffer;
+    int ret = -1;
+
+    if (!(pool = virNetMessagePoolNew(1024 * 1024)))
+        return -1;
+
+    if (!(msg = virNetMessagePoolGet(pool, false)))
+        goto cleanup;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_CALL;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_OK;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    buffer = msg->buffer;
+    virNetMessageFree(msg);
+    msg = NULL;
+
+    if (virNetMessagePoolGetIdleBytes(pool) == 0) {
+        VIR_DEBUG("Expected the message to be kept in the pool");
+        goto cleanup;
+    }
+
+    if (!(msg = virNetMessagePoolGet(pool, false)))
+        goto cleanup;
+
+    if (msg->buffer != buffer ||
+        msg->bufferLength != 0 ||
+        msg->bufferOffset != 0 ||
+        msg->header.serial != 0) {
+        VIR_DEBUG("Expected a recycled, cleared message");
+        goto cleanup;
+    }
+
+    if (virNetMessagePoolGetIdleBytes(pool) != 0) {
+        VIR_DEBUG("Expected the pool to be empty, got %zu idle bytes",
+                  virNetMessagePoolGetIdleBytes(pool));
+        goto cleanup;
+    }
+
+    /* Oversized buffers are not worth keeping around */
+    if (virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_MAX) < 0)
+        goto cleanup;
+
+    virNetMessageFree(msg);
+    msg = NULL;
+
+    if (virNetMessagePoolGetIdleBytes(pool) != 0) {
+        VIR_DEBUG("Expected the oversized message to be released, got %zu idle bytes",
+                  virNetMessagePoolGetIdleBytes(pool));
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    virNetMessageFree(msg);
+    virObjectUnref(pool);
+    return ret;
+}
+
 
 static int
 mymain(void)
@@ -542,6 +611,9 @@ mymain(void)
     if (virtTestRun("Message Payload Stream Encode", testMessagePayloadStreamEncode, NULL) < 0)
         ret = -1;
 
+    if (virtTestRun("Message Pool", testMessagePool, NULL) < 0)
+        ret = -1;
+
     return ret==0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -20,8 +20,13 @@
 
 #include <config.h>
 
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include "testutils.h"
 #include "virerror.h"
+#include "virfile.h"
+#include "virutil.h"
 #include "rpc/virnetserverclient.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
@@ -137,16 +142,210 @@ static int testIdentity(const void *opaque ATTRIBUTE_UNUSED)
 }
 
 
+# define SPLICE_LEN (32 * 1024)
+# define SPLICE_HEADER_LEN (VIR_NET_MESSAGE_HEADER_XDR_LEN + 6 * 4)
+
+/* Stands in for the daemon's stream, which stops sending stream data
+ * until its previous message is freed */
+static void
+testSpliceMessageFinished(virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                          void *opaque)
+{
+    int *tx = opaque;
+    *tx = 1;
+}
+
+static void
+testSpliceTimeout(int timer ATTRIBUTE_UNUSED,
+                  void *opaque ATTRIBUTE_UNUSED)
+{
+}
+
+/*
+ * Stream data spliced from a pipe, or copied when splicing is refused,
+ * reaches the peer in full, right after the message header. The
+ * message, and with it the stream's permission to send more, is only
+ * released once all of it went out, which here has to wait for the
+ * peer to make room in the socket.
+ */
+static int testSplice(const void *opaque)
+{
+    bool fromPipe = *(const bool *) opaque;
+    int sv[2] = { -1, -1 };
+    int src[2] = { -1, -1 };
+    int timer = -1;
+    int bufsize = 4096;
+    int tx = 1;
+    int ret = -1;
+    virNetSocketPtr sock = NULL;
+    virNetServerClientPtr client = NULL;
+    virNetMessagePtr msg = NULL;
+    char *payload = NULL;
+    char *buf = NULL;
+    size_t filled = 0;
+    size_t want;
+    size_t got = 0;
+    bool held = false;
+    size_t i;
+    ssize_t rv;
+    int fd;
+
+    if (VIR_ALLOC_N(payload, SPLICE_LEN) < 0)
+        goto cleanup;
+
+    /* A socket as the source makes splice() fail with EINVAL */
+    if (socketpair(PF_UNIX, SOCK_STREAM, 0, sv) < 0 ||
+        (fromPipe ? pipe(src) : socketpair(PF_UNIX, SOCK_STREAM, 0, src)) < 0) {
+        virReportSystemError(errno, "%s", "Cannot create sockets");
+        goto cleanup;
+    }
+
+    /* Fill the socket, so nothing gets out before the peer reads */
+    if (setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF,
+                   &bufsize, sizeof(bufsize)) < 0 ||
+        virSetNonBlock(sv[0]) < 0 ||
+        virSetNonBlock(sv[1]) < 0)
+        goto cleanup;
+    memset(payload, 'x', SPLICE_LEN);
+    while ((rv = write(sv[0], payload, bufsize)) > 0)
+        filled += rv;
+    if (errno != EAGAIN)
+        goto cleanup;
+
+    want = filled + SPLICE_HEADER_LEN + SPLICE_LEN;
+    if (VIR_ALLOC_N(buf, want) < 0)
+        goto cleanup;
+    for (i = 0; i < SPLICE_LEN; i++)
+        payload[i] = i % 251;
+    if (safewrite(src[1], payload, SPLICE_LEN) != SPLICE_LEN)
+        goto cleanup;
+
+    if (virNetSocketNewConnectSockFD(sv[0], &sock) < 0)
+        goto cleanup;
+    sv[0] = -1;
+
+    if (!(client = virNetServerClientNew(sock, 0, false, 1,
+# ifdef WITH_GNUTLS
+                                         NULL,
+# endif
+                                         NULL, NULL, NULL, NULL)) ||
+        virNetServerClientInit(client) < 0)
+        goto cleanup;
+
+    if (!(msg = virNetMessageNew(false)))
+        goto cleanup;
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 1;
+    msg->header.proc = 1;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = 7;
+    msg->header.status = VIR_NET_CONTINUE;
+    msg->cb = testSpliceMessageFinished;
+    msg->opaque = &tx;
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        (fd = dup(src[0])) < 0 ||
+        virNetMessageEncodePayloadSplice(msg, fd, SPLICE_LEN) < 0)
+        goto cleanup;
+
+    tx = 0;
+    if (virNetServerClientSendMessage(client, msg) < 0)
+        goto cleanup;
+    msg = NULL;
+
+    /* Keeps the event loop from blocking if the client gave up */
+    if ((timer = virEventAddTimeout(10, testSpliceTimeout, NULL, NULL)) < 0)
+        goto cleanup;
+
+    for (i = 0; i < 1000; i++) {
+        bool finished = tx;
+
+        while (got < want &&
+               (rv = read(sv[1], buf + got, want - got)) > 0)
+            got += rv;
+
+        if (finished)
+            break;
+        if (got == want) {
+            fprintf(stderr, "All data arrived but the message was "
+                    "not released\n");
+            goto cleanup;
+        }
+        if (got > 0)
+            held = true;
+
+        if (virEventRunDefaultImpl() < 0)
+            goto cleanup;
+    }
+
+    if (!tx || got != want) {
+        fprintf(stderr, "Message %sreleased with %zu of %zu bytes sent\n",
+                tx ? "" : "not ", got, want);
+        goto cleanup;
+    }
+    if (!held) {
+        fprintf(stderr, "Message released before the peer read\n");
+        goto cleanup;
+    }
+
+    want -= filled;
+    if (buf[filled] != 0 || buf[filled + 1] != 0 ||
+        (unsigned char) buf[filled + 2] != (want >> 8) ||
+        (unsigned char) buf[filled + 3] != (want & 0xff)) {
+        fprintf(stderr, "Bad length word\n");
+        goto cleanup;
+    }
+    if (memcmp(buf + filled + SPLICE_HEADER_LEN, payload, SPLICE_LEN) != 0) {
+        fprintf(stderr, "Mismatched stream data\n");
+        goto cleanup;
+    }
+
+    /* A refused splice isn't tried again on this client */
+    if (!fromPipe && virNetServerClientCanSplice(client)) {
+        fprintf(stderr, "Client still offered for splicing\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (timer >= 0)
+        virEventRemoveTimeout(timer);
+    virNetMessageFree(msg);
+    if (client)
+        virNetServerClientClose(client);
+    virObjectUnref(client);
+    virObjectUnref(sock);
+    VIR_FORCE_CLOSE(sv[0]);
+    VIR_FORCE_CLOSE(sv[1]);
+    VIR_FORCE_CLOSE(src[0]);
+    VIR_FORCE_CLOSE(src[1]);
+    VIR_FREE(payload);
+    VIR_FREE(buf);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
     int ret = 0;
+    bool fromPipe;
 
+    if (virEventRegisterDefaultImpl() < 0)
+        return EXIT_FAILURE;
 
     if (virtTestRun("Identity",
                     testIdentity, NULL) < 0)
         ret = -1;
 
+    fromPipe = true;
+    if (virtTestRun("Splice stream data",
+                    testSplice, &fromPipe) < 0)
+        ret = -1;
+    fromPipe = false;
+    if (virtTestRun("Copy stream data when splice is refused",
+                    testSplice, &fromPipe) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 VIRT_TEST_MAIN_PRELOAD(mymain, abs_builddir "/.libs/virnetserverclientmock.so")
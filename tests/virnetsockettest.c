@@ -26,6 +26,7 @@
 # include <ifaddrs.h>
 #endif
 #include <netdb.h>
+#include <fcntl.h>
 
 #include "testutils.h"
 #include "virutil.h"
@@ -451,6 +452,251 @@ cleanup:
     return ret;
 }
 
+# if WITH_SASL
+/*
+ * A SASL packet which could not be written out in one go is finished by
+ * a later call, by which time the caller may have queued more messages
+ * behind it. Only the bytes that went into the packet may be reported
+ * as written, the rest has to be encoded and sent afterwards.
+ */
+#  define SASL_MSG_LEN 4096
+
+static int testSocketSASLPending(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetSocketPtr sock = NULL;
+    virNetSASLContextPtr ctxt = NULL;
+    virNetSASLSessionPtr sasl = NULL;
+    int fds[2] = { -1, -1 };
+    char msgs[3][SASL_MSG_LEN];
+    char buf[SASL_MSG_LEN];
+    struct iovec iov[3];
+    size_t filled = 0;
+    ssize_t rv;
+    size_t i;
+    int ret = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        VIR_DEBUG("Cannot create socket pair");
+        goto cleanup;
+    }
+
+    /* Fill the socket, so nothing of the first packet gets out */
+    memset(buf, 'x', sizeof(buf));
+    if (virSetNonBlock(fds[0]) < 0)
+        goto cleanup;
+    for (i = sizeof(buf); i > 0; i /= 2) {
+        while ((rv = write(fds[0], buf, i)) > 0)
+            filled += rv;
+        if (errno != EAGAIN)
+            goto cleanup;
+    }
+
+    if (virNetSocketNewConnectSockFD(fds[0], &sock) < 0)
+        goto cleanup;
+    fds[0] = -1;
+
+    /* Without a negotiated security layer the encoding is a plain
+     * copy, which is all this needs */
+    if (!(ctxt = virNetSASLContextNewClient()) ||
+        !(sasl = virNetSASLSessionNewClient(ctxt, "libvirt", "localhost",
+                                            NULL, NULL, NULL)) ||
+        virNetSASLSessionSecProps(sasl, 0, 0, true) < 0)
+        goto cleanup;
+    virNetSocketSetSASLSession(sock, sasl);
+
+    for (i = 0; i < ARRAY_CARDINALITY(msgs); i++) {
+        memset(msgs[i], 'a' + i, SASL_MSG_LEN);
+        iov[i].iov_base = msgs[i];
+        iov[i].iov_len = SASL_MSG_LEN;
+    }
+
+    if ((rv = virNetSocketWriteV(sock, iov, 2)) != 0) {
+        VIR_DEBUG("Expected the packet to stay pending, got %zd", rv);
+        goto cleanup;
+    }
+
+    /* Make a little room for part of the packet, then queue a third
+     * message behind it */
+    if (saferead(fds[1], buf, SASL_MSG_LEN) != SASL_MSG_LEN)
+        goto cleanup;
+    filled -= SASL_MSG_LEN;
+    if ((rv = virNetSocketWriteV(sock, iov, 3)) != 0 &&
+        rv != SASL_MSG_LEN * 2) {
+        VIR_DEBUG("Expected %d bytes or none written, got %zd",
+                  SASL_MSG_LEN * 2, rv);
+        goto cleanup;
+    }
+
+    while (filled > 0) {
+        size_t len = MIN(filled, sizeof(buf));
+        if (saferead(fds[1], buf, len) != len)
+            goto cleanup;
+        filled -= len;
+    }
+
+    if (rv == 0 &&
+        (rv = virNetSocketWriteV(sock, iov, 3)) != SASL_MSG_LEN * 2) {
+        VIR_DEBUG("Expected %d bytes written, got %zd",
+                  SASL_MSG_LEN * 2, rv);
+        goto cleanup;
+    }
+
+    if ((rv = virNetSocketWriteV(sock, iov + 2, 1)) != SASL_MSG_LEN) {
+        VIR_DEBUG("Expected %d bytes written, got %zd", SASL_MSG_LEN, rv);
+        goto cleanup;
+    }
+
+    /* Each message must arrive exactly once, in order */
+    for (i = 0; i < ARRAY_CARDINALITY(msgs); i++) {
+        if (saferead(fds[1], buf, SASL_MSG_LEN) != SASL_MSG_LEN ||
+            memcmp(buf, msgs[i], SASL_MSG_LEN) != 0) {
+            VIR_DEBUG("Message %zu mismatch", i);
+            goto cleanup;
+        }
+    }
+    if (recv(fds[1], buf, 1, MSG_DONTWAIT) != -1 || errno != EAGAIN) {
+        VIR_DEBUG("Got more data than was sent");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virObjectUnref(sock);
+    virObjectUnref(sasl);
+    virObjectUnref(ctxt);
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    return ret;
+}
+# endif
+
+#endif
+
+
+#ifdef __linux__
+# define SPLICE_LEN 1024
+
+/*
+ * Stream data waiting in a pipe is moved into the socket as it is,
+ * and splicing into a full socket is reported as would block
+ */
+static int testSocketSplice(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetSocketPtr sock = NULL;
+    int fds[2] = { -1, -1 };
+    int pipefd[2] = { -1, -1 };
+    char in[SPLICE_LEN];
+    char out[SPLICE_LEN];
+    ssize_t rv;
+    size_t i;
+    int ret = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0 ||
+        pipe(pipefd) < 0) {
+        VIR_DEBUG("Cannot create socket pair or pipe");
+        goto cleanup;
+    }
+
+    if (virNetSocketNewConnectSockFD(fds[0], &sock) < 0)
+        goto cleanup;
+    fds[0] = -1;
+
+    if (!virNetSocketCanSplice(sock)) {
+        VIR_DEBUG("Expected a plain socket to allow splicing");
+        goto cleanup;
+    }
+
+    for (i = 0; i < sizeof(in); i++)
+        in[i] = i % 251;
+    if (safewrite(pipefd[1], in, sizeof(in)) != sizeof(in))
+        goto cleanup;
+
+    if ((rv = virNetSocketSplice(sock, pipefd[0], sizeof(in))) != sizeof(in)) {
+        VIR_DEBUG("Expected %zu bytes spliced, got %zd", sizeof(in), rv);
+        goto cleanup;
+    }
+    if (saferead(fds[1], out, sizeof(out)) != sizeof(out) ||
+        memcmp(in, out, sizeof(out)) != 0) {
+        VIR_DEBUG("Spliced data mismatch");
+        goto cleanup;
+    }
+
+    /* Fill the socket, then the data has to stay in the pipe */
+    if (virNetSocketSetBlocking(sock, false) < 0)
+        goto cleanup;
+    if (safewrite(pipefd[1], in, sizeof(in)) != sizeof(in))
+        goto cleanup;
+    while ((rv = virNetSocketSplice(sock, pipefd[0], sizeof(in))) > 0) {
+        if (safewrite(pipefd[1], in, rv) != rv)
+            goto cleanup;
+    }
+    if (rv != 0) {
+        VIR_DEBUG("Expected splicing into a full socket to block");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virObjectUnref(sock);
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    VIR_FORCE_CLOSE(pipefd[0]);
+    VIR_FORCE_CLOSE(pipefd[1]);
+    return ret;
+}
+
+
+/*
+ * When splice() refuses the file descriptors with EINVAL, the caller is
+ * told to copy the data instead, and the socket is not offered for
+ * splicing any more
+ */
+static int testSocketSpliceFallback(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetSocketPtr sock = NULL;
+    int fds[2] = { -1, -1 };
+    int fd = -1;
+    ssize_t rv;
+    int ret = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        VIR_DEBUG("Cannot create socket pair");
+        goto cleanup;
+    }
+
+    if (virNetSocketNewConnectSockFD(fds[0], &sock) < 0)
+        goto cleanup;
+    fds[0] = -1;
+
+    /* Neither end is a pipe, which splice() rejects */
+    if ((fd = open("/dev/null", O_RDONLY)) < 0)
+        goto cleanup;
+
+    virResetLastError();
+    if ((rv = virNetSocketSplice(sock, fd, SPLICE_LEN)) != -2) {
+        VIR_DEBUG("Expected -2 from splicing a non pipe, got %zd", rv);
+        goto cleanup;
+    }
+    if (virGetLastError()) {
+        VIR_DEBUG("Unexpected error reported: %s", virGetLastErrorMessage());
+        goto cleanup;
+    }
+    if (virNetSocketCanSplice(sock)) {
+        VIR_DEBUG("Socket still offered for splicing");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virObjectUnref(sock);
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    VIR_FORCE_CLOSE(fd);
+    return ret;
+}
 #endif
 
 
@@ -610,6 +856,20 @@ mymain(void)
     if (virtTestRun("SSH test 7", testSocketSSH, &sshData7) < 0)
         ret = -1;
 
+# if WITH_SASL
+    if (virtTestRun("Socket SASL pending packet",
+                    testSocketSASLPending, NULL) < 0)
+        ret = -1;
+# endif
+
+#endif
+
+#ifdef __linux__
+    if (virtTestRun("Socket splice", testSocketSplice, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Socket splice fallback",
+                    testSocketSpliceFallback, NULL) < 0)
+        ret = -1;
 #endif
 
     return ret==0 ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2026 iNuron NV
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "testutils.h"
+
+#include "virthreadpool.h"
+#include "virthread.h"
+#include "virtime.h"
+#include "virutil.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define FLOOD_JOBS 10
+#define GROW_JOBS 4
+
+/* What the jobs record, and when the blocking ones may return */
+struct testPoolState {
+    virMutex lock;
+    virCond cond;
+    size_t running;
+    bool release;
+    size_t ndone;
+    int done[FLOOD_JOBS + 2];
+};
+
+enum {
+    TEST_JOB_BLOCK = -1,
+};
+
+static void
+testPoolJob(void *jobdata, void *opaque)
+{
+    struct testPoolState *state = opaque;
+    int id = (intptr_t) jobdata;
+
+    virMutexLock(&state->lock);
+    state->running++;
+    virCondBroadcast(&state->cond);
+    if (id == TEST_JOB_BLOCK) {
+        while (!state->release)
+            ignore_value(virCondWait(&state->cond, &state->lock));
+    } else if (state->ndone < ARRAY_CARDINALITY(state->done)) {
+        state->done[state->ndone++] = id;
+    }
+    state->running--;
+    virMutexUnlock(&state->lock);
+}
+
+static int
+testPoolStateInit(struct testPoolState *state)
+{
+    memset(state, 0, sizeof(*state));
+    if (virMutexInit(&state->lock) < 0)
+        return -1;
+    if (virCondInit(&state->cond) < 0) {
+        virMutexDestroy(&state->lock);
+        return -1;
+    }
+    return 0;
+}
+
+static void
+testPoolStateDispose(struct testPoolState *state)
+{
+    virCondDestroy(&state->cond);
+    virMutexDestroy(&state->lock);
+}
+
+/* Wait for @count blocking jobs to be running at the same time */
+static int
+testPoolWaitRunning(struct testPoolState *state, size_t count)
+{
+    unsigned long long now;
+    int ret = 0;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    virMutexLock(&state->lock);
+    while (state->running < count) {
+        if (virCondWaitUntil(&state->cond, &state->lock, now + 5000) < 0) {
+            fprintf(stderr, "Only %zu of %zu jobs started\n",
+                    state->running, count);
+            ret = -1;
+            break;
+        }
+    }
+    virMutexUnlock(&state->lock);
+    return ret;
+}
+
+static void
+testPoolRelease(struct testPoolState *state)
+{
+    virMutexLock(&state->lock);
+    state->release = true;
+    virCondBroadcast(&state->cond);
+    virMutexUnlock(&state->lock);
+}
+
+/* Poll the pool until @check holds, for up to five seconds */
+static int
+testPoolWaitStats(virThreadPoolPtr pool,
+                  virThreadPoolStatsPtr stats,
+                  bool (*check)(virThreadPoolStatsPtr stats))
+{
+    size_t i;
+
+    for (i = 0; i < 500; i++) {
+        virThreadPoolGetStats(pool, stats);
+        if (check(stats))
+            return 0;
+        usleep(10 * 1000);
+    }
+    return -1;
+}
+
+static bool
+testPoolFloodDone(virThreadPoolStatsPtr stats)
+{
+    return stats->jobsDone == FLOOD_JOBS + 2;
+}
+
+/*
+ * A single worker is kept busy while one owner floods the queue and
+ * another sends a single job. Once the worker is free again, the
+ * second owner must get its turn right after the first flooded job
+ * rather than after the whole backlog.
+ */
+static int
+testPoolFairness(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testPoolState state;
+    virThreadPoolPtr pool = NULL;
+    virThreadPoolStats stats;
+    int flooder;
+    int other;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolStateInit(&state) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNew(1, 1, 0, testPoolJob, &state)))
+        goto cleanup;
+
+    if (virThreadPoolSendJobFull(pool, 0, &flooder,
+                                 (void *)(intptr_t) TEST_JOB_BLOCK) < 0 ||
+        testPoolWaitRunning(&state, 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < FLOOD_JOBS; i++) {
+        if (virThreadPoolSendJobFull(pool, 0, &flooder,
+                                     (void *)(intptr_t) i) < 0)
+            goto cleanup;
+    }
+    if (virThreadPoolSendJobFull(pool, 0, &other,
+                                 (void *)(intptr_t) FLOOD_JOBS) < 0)
+        goto cleanup;
+
+    testPoolRelease(&state);
+
+    /* Freeing the pool drops what is still queued, so wait for
+     * everything to make it through first */
+    if (testPoolWaitStats(pool, &stats, testPoolFloodDone) < 0) {
+        fprintf(stderr, "Expected %d jobs done, got %llu\n",
+                FLOOD_JOBS + 2, stats.jobsDone);
+        goto cleanup;
+    }
+
+    if (state.done[0] != 0 || state.done[1] != FLOOD_JOBS) {
+        fprintf(stderr, "Expected the other owner's job second, "
+                "got jobs %d, %d\n", state.done[0], state.done[1]);
+        goto cleanup;
+    }
+
+    for (i = 2; i < state.ndone; i++) {
+        if (state.done[i] != (int) i - 1) {
+            fprintf(stderr, "Expected job %zu at %zu, got %d\n",
+                    i - 1, i, state.done[i]);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+cleanup:
+    testPoolRelease(&state);
+    virThreadPoolFree(pool);
+    testPoolStateDispose(&state);
+    return ret;
+}
+
+static bool
+testPoolAllDone(virThreadPoolStatsPtr stats)
+{
+    return stats->jobsDone == GROW_JOBS;
+}
+
+static bool
+testPoolShrunk(virThreadPoolStatsPtr stats)
+{
+    return stats->nWorkers == 1 && stats->freeWorkers == 1;
+}
+
+static bool
+testPoolReused(virThreadPoolStatsPtr stats)
+{
+    return stats->jobsDone == GROW_JOBS + 1 && testPoolShrunk(stats);
+}
+
+/*
+ * Blocking jobs make the pool grow up to its maximum. Once they
+ * are done, the extra workers exit after the idle timeout, leaving
+ * the minimum count, and the pool keeps serving jobs afterwards.
+ */
+static int
+testPoolRetire(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testPoolState state;
+    virThreadPoolPtr pool = NULL;
+    virThreadPoolStats stats;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolStateInit(&state) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNew(1, GROW_JOBS, 0, testPoolJob, &state)))
+        goto cleanup;
+    virThreadPoolSetIdleTimeout(pool, 100);
+
+    for (i = 0; i < GROW_JOBS; i++) {
+        if (virThreadPoolSendJob(pool, 0,
+                                 (void *)(intptr_t) TEST_JOB_BLOCK) < 0)
+            goto cleanup;
+    }
+    if (testPoolWaitRunning(&state, GROW_JOBS) < 0)
+        goto cleanup;
+
+    virThreadPoolGetStats(pool, &stats);
+    if (stats.nWorkers != GROW_JOBS || stats.freeWorkers != 0 ||
+        stats.jobQueueDepth != 0 || stats.jobsDone != 0) {
+        fprintf(stderr, "Busy pool: workers=%zu free=%zu depth=%zu "
+                "done=%llu\n", stats.nWorkers, stats.freeWorkers,
+                stats.jobQueueDepth, stats.jobsDone);
+        goto cleanup;
+    }
+
+    /* Make the jobs take long enough to show up in the stats */
+    usleep(100 * 1000);
+    testPoolRelease(&state);
+
+    if (testPoolWaitStats(pool, &stats, testPoolAllDone) < 0) {
+        fprintf(stderr, "Expected %d jobs done, got %llu\n",
+                GROW_JOBS, stats.jobsDone);
+        goto cleanup;
+    }
+    if (stats.serviceMax < 100 || stats.serviceTotal < stats.serviceMax ||
+        stats.jobQueueDepthMax < 1) {
+        fprintf(stderr, "Unexpected stats: service=%llu/%llums "
+                "depth max=%zu\n", stats.serviceTotal, stats.serviceMax,
+                stats.jobQueueDepthMax);
+        goto cleanup;
+    }
+
+    if (testPoolWaitStats(pool, &stats, testPoolShrunk) < 0 ||
+        stats.workersRetired != GROW_JOBS - 1) {
+        fprintf(stderr, "Idle pool: workers=%zu free=%zu retired=%zu\n",
+                stats.nWorkers, stats.freeWorkers, stats.workersRetired);
+        goto cleanup;
+    }
+
+    /* The retired workers are joined here, the remaining one runs
+     * the job without the pool growing again */
+    if (virThreadPoolSendJob(pool, 0, (void *)(intptr_t) 0) < 0)
+        goto cleanup;
+    if (testPoolWaitStats(pool, &stats, testPoolReused) < 0 ||
+        stats.workersRetired != GROW_JOBS - 1) {
+        fprintf(stderr, "After retirement: workers=%zu free=%zu "
+                "done=%llu retired=%zu\n", stats.nWorkers,
+                stats.freeWorkers, stats.jobsDone, stats.workersRetired);
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    testPoolRelease(&state);
+    virThreadPoolFree(pool);
+    testPoolStateDispose(&state);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virtTestRun("Fairness across owners", testPoolFairness, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Retire idle workers", testPoolRetire, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
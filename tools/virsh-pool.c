@@ -450,6 +450,10 @@ static const vshCmdOptDef opts_pool_build[] = {
      .type = VSH_OT_BOOL,
      .help = N_("overwrite any existing data")
     },
+    {.name = "async",
+     .type = VSH_OT_BOOL,
+     .help = N_("return at once, building the pool in the background")
+    },
     {.name = NULL}
 };
 
@@ -472,8 +476,14 @@ cmdPoolBuild(vshControl *ctl, const vshCmd *cmd)
         flags |= VIR_STORAGE_POOL_BUILD_OVERWRITE;
     }
 
+    if (vshCommandOptBool(cmd, "async"))
+        flags |= VIR_STORAGE_POOL_BUILD_ASYNC;
+
     if (virStoragePoolBuild(pool, flags) == 0) {
-        vshPrint(ctl, _("Pool %s built\n"), name);
+        if (flags & VIR_STORAGE_POOL_BUILD_ASYNC)
+            vshPrint(ctl, _("Build of pool %s started\n"), name);
+        else
+            vshPrint(ctl, _("Pool %s built\n"), name);
     } else {
         vshError(ctl, _("Failed to build pool %s"), name);
         ret = false;
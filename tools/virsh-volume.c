@@ -151,6 +151,10 @@ static const vshCmdOptDef opts_vol_create_as[] = {
      .type = VSH_OT_BOOL,
      .help = N_("preallocate metadata (for qcow2 instead of full allocation)")
     },
+    {.name = "async",
+     .type = VSH_OT_BOOL,
+     .help = N_("return once the volume is defined, allocating it in the background")
+    },
     {.name = NULL}
 };
 
@@ -177,6 +181,8 @@ cmdVolCreateAs(vshControl *ctl, const vshCmd *cmd)
 
     if (vshCommandOptBool(cmd, "prealloc-metadata"))
         flags |= VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA;
+    if (vshCommandOptBool(cmd, "async"))
+        flags |= VIR_STORAGE_VOL_CREATE_ASYNC;
     if (!(pool = vshCommandOptPool(ctl, cmd, "pool", NULL)))
         return false;
 
@@ -330,6 +336,10 @@ static const vshCmdOptDef opts_vol_create[] = {
      .type = VSH_OT_BOOL,
      .help = N_("preallocate metadata (for qcow2 instead of full allocation)")
     },
+    {.name = "async",
+     .type = VSH_OT_BOOL,
+     .help = N_("return once the volume is defined, allocating it in the background")
+    },
     {.name = NULL}
 };
 
@@ -345,6 +355,8 @@ cmdVolCreate(vshControl *ctl, const vshCmd *cmd)
 
     if (vshCommandOptBool(cmd, "prealloc-metadata"))
         flags |= VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA;
+    if (vshCommandOptBool(cmd, "async"))
+        flags |= VIR_STORAGE_VOL_CREATE_ASYNC;
     if (!(pool = vshCommandOptPool(ctl, cmd, "pool", NULL)))
         return false;
 
@@ -408,6 +420,10 @@ static const vshCmdOptDef opts_vol_create_from[] = {
      .type = VSH_OT_BOOL,
      .help = N_("preallocate metadata (for qcow2 instead of full allocation)")
     },
+    {.name = "async",
+     .type = VSH_OT_BOOL,
+     .help = N_("return once the volume is defined, allocating it in the background")
+    },
     {.name = NULL}
 };
 
@@ -426,6 +442,8 @@ cmdVolCreateFrom(vshControl *ctl, const vshCmd *cmd)
 
     if (vshCommandOptBool(cmd, "prealloc-metadata"))
         flags |= VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA;
+    if (vshCommandOptBool(cmd, "async"))
+        flags |= VIR_STORAGE_VOL_CREATE_ASYNC;
 
     if (vshCommandOptStringReq(ctl, cmd, "file", &from) < 0)
         goto cleanup;
@@ -521,6 +539,10 @@ static const vshCmdOptDef opts_vol_clone[] = {
      .type = VSH_OT_BOOL,
      .help = N_("preallocate metadata (for qcow2 instead of full allocation)")
     },
+    {.name = "async",
+     .type = VSH_OT_BOOL,
+     .help = N_("return once the volume is defined, allocating it in the background")
+    },
     {.name = NULL}
 };
 
@@ -540,6 +562,8 @@ cmdVolClone(vshControl *ctl, const vshCmd *cmd)
 
     if (vshCommandOptBool(cmd, "prealloc-metadata"))
         flags |= VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA;
+    if (vshCommandOptBool(cmd, "async"))
+        flags |= VIR_STORAGE_VOL_CREATE_ASYNC;
 
     origpool = virStoragePoolLookupByVolume(origvol);
     if (!origpool) {
@@ -621,6 +645,10 @@ static const vshCmdOptDef opts_vol_upload[] = {
      .type = VSH_OT_INT,
      .help = N_("amount of data to upload")
     },
+    {.name = "sparse",
+     .type = VSH_OT_BOOL,
+     .help = N_("preserve sparseness of volume")
+    },
     {.name = NULL}
 };
 
@@ -633,6 +661,56 @@ cmdVolUploadSource(virStreamPtr st ATTRIBUTE_UNUSED,
     return saferead(*fd, bytes, nbytes);
 }
 
+static int
+cmdVolUploadSourceHole(virStreamPtr st ATTRIBUTE_UNUSED,
+                       int *inData, long long *length, void *opaque)
+{
+    int *fd = opaque;
+    off_t cur;
+    off_t next;
+
+    *inData = 1;
+    *length = 0;
+
+    if ((cur = lseek(*fd, 0, SEEK_CUR)) < 0)
+        return -1;
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    if ((next = lseek(*fd, cur, SEEK_DATA)) < 0) {
+        if (errno == ENXIO) {
+            /* only a hole remains, up to the end of file */
+            if ((next = lseek(*fd, 0, SEEK_END)) < 0)
+                return -1;
+            *inData = next == cur;
+            *length = next - cur;
+        } else if (errno != EINVAL) {
+            return -1;
+        }
+    } else if (next > cur) {
+        *inData = 0;
+        *length = next - cur;
+    } else if ((next = lseek(*fd, cur, SEEK_HOLE)) >= 0) {
+        *length = next - cur;
+    }
+#else
+    next = cur;
+#endif
+
+    if (next != cur && lseek(*fd, cur, SEEK_SET) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int
+cmdVolUploadSourceSkip(virStreamPtr st ATTRIBUTE_UNUSED,
+                       long long length, void *opaque)
+{
+    int *fd = opaque;
+
+    return lseek(*fd, length, SEEK_CUR) < 0 ? -1 : 0;
+}
+
 static bool
 cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
 {
@@ -643,6 +721,8 @@ cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
     virStreamPtr st = NULL;
     const char *name = NULL;
     unsigned long long offset = 0, length = 0;
+    unsigned int flags = 0;
+    bool sparse = vshCommandOptBool(cmd, "sparse");
 
     if (vshCommandOptULongLong(cmd, "offset", &offset) < 0) {
         vshError(ctl, _("Unable to parse integer"));
@@ -654,6 +734,9 @@ cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
         return false;
     }
 
+    if (sparse)
+        flags |= VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM;
+
     if (!(vol = vshCommandOptVol(ctl, cmd, "vol", "pool", &name))) {
         return false;
     }
@@ -671,12 +754,19 @@ cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    if (virStorageVolUpload(vol, st, offset, length, 0) < 0) {
+    if (virStorageVolUpload(vol, st, offset, length, flags) < 0) {
         vshError(ctl, _("cannot upload to volume %s"), name);
         goto cleanup;
     }
 
-    if (virStreamSendAll(st, cmdVolUploadSource, &fd) < 0) {
+    if (sparse) {
+        if (virStreamSparseSendAll(st, cmdVolUploadSource,
+                                   cmdVolUploadSourceHole,
+                                   cmdVolUploadSourceSkip, &fd) < 0) {
+            vshError(ctl, _("cannot send data to volume %s"), name);
+            goto cleanup;
+        }
+    } else if (virStreamSendAll(st, cmdVolUploadSource, &fd) < 0) {
         vshError(ctl, _("cannot send data to volume %s"), name);
         goto cleanup;
     }
@@ -739,9 +829,22 @@ static const vshCmdOptDef opts_vol_download[] = {
      .type = VSH_OT_INT,
      .help = N_("amount of data to download")
     },
+    {.name = "sparse",
+     .type = VSH_OT_BOOL,
+     .help = N_("preserve sparseness of volume")
+    },
     {.name = NULL}
 };
 
+static int
+cmdVolDownloadSinkHole(virStreamPtr st ATTRIBUTE_UNUSED,
+                       long long length, void *opaque)
+{
+    int *fd = opaque;
+
+    return lseek(*fd, length, SEEK_CUR) < 0 ? -1 : 0;
+}
+
 static bool
 cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
 {
@@ -753,6 +856,9 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
     const char *name = NULL;
     unsigned long long offset = 0, length = 0;
     bool created = false;
+    unsigned int flags = 0;
+    bool sparse = vshCommandOptBool(cmd, "sparse");
+    off_t end;
 
     if (vshCommandOptULongLong(cmd, "offset", &offset) < 0) {
         vshError(ctl, _("Unable to parse integer"));
@@ -764,6 +870,9 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
         return false;
     }
 
+    if (sparse)
+        flags |= VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM;
+
     if (!(vol = vshCommandOptVol(ctl, cmd, "vol", "pool", &name)))
         return false;
 
@@ -785,12 +894,26 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    if (virStorageVolDownload(vol, st, offset, length, 0) < 0) {
+    if (virStorageVolDownload(vol, st, offset, length, flags) < 0) {
         vshError(ctl, _("cannot download from volume %s"), name);
         goto cleanup;
     }
 
-    if (virStreamRecvAll(st, vshStreamSink, &fd) < 0) {
+    if (sparse) {
+        if (virStreamSparseRecvAll(st, vshStreamSink,
+                                   cmdVolDownloadSinkHole, &fd) < 0) {
+            vshError(ctl, _("cannot receive data from volume %s"), name);
+            goto cleanup;
+        }
+
+        /* a trailing hole only moved the file offset */
+        if ((end = lseek(fd, 0, SEEK_CUR)) < 0 ||
+            ftruncate(fd, end) < 0) {
+            vshError(ctl, _("cannot resize file %s"), file);
+            virStreamAbort(st);
+            goto cleanup;
+        }
+    } else if (virStreamRecvAll(st, vshStreamSink, &fd) < 0) {
         vshError(ctl, _("cannot receive data from volume %s"), name);
         goto cleanup;
     }
@@ -894,6 +1017,10 @@ static const vshCmdOptDef opts_vol_wipe[] = {
      .type = VSH_OT_STRING,
      .help = N_("perform selected wiping algorithm")
     },
+    {.name = "async",
+     .type = VSH_OT_BOOL,
+     .help = N_("return at once, wiping the volume in the background")
+    },
     {.name = NULL}
 };
 
@@ -911,11 +1038,15 @@ cmdVolWipe(vshControl *ctl, const vshCmd *cmd)
     const char *algorithm_str = NULL;
     int algorithm = VIR_STORAGE_VOL_WIPE_ALG_ZERO;
     int funcRet;
+    unsigned int flags = 0;
 
     if (!(vol = vshCommandOptVol(ctl, cmd, "vol", "pool", &name))) {
         return false;
     }
 
+    if (vshCommandOptBool(cmd, "async"))
+        flags |= VIR_STORAGE_VOL_WIPE_ASYNC;
+
     if (vshCommandOptStringReq(ctl, cmd, "algorithm", &algorithm_str) < 0)
         goto out;
 
@@ -925,10 +1056,10 @@ cmdVolWipe(vshControl *ctl, const vshCmd *cmd)
         goto out;
     }
 
-    if ((funcRet = virStorageVolWipePattern(vol, algorithm, 0)) < 0) {
+    if ((funcRet = virStorageVolWipePattern(vol, algorithm, flags)) < 0) {
         if (last_error->code == VIR_ERR_NO_SUPPORT &&
             algorithm == VIR_STORAGE_VOL_WIPE_ALG_ZERO)
-            funcRet = virStorageVolWipe(vol, 0);
+            funcRet = virStorageVolWipe(vol, flags);
     }
 
     if (funcRet < 0) {
@@ -936,7 +1067,10 @@ cmdVolWipe(vshControl *ctl, const vshCmd *cmd)
         goto out;
     }
 
-    vshPrint(ctl, _("Vol %s wiped\n"), name);
+    if (flags & VIR_STORAGE_VOL_WIPE_ASYNC)
+        vshPrint(ctl, _("Wipe of vol %s started\n"), name);
+    else
+        vshPrint(ctl, _("Vol %s wiped\n"), name);
     ret = true;
 out:
     virStorageVolFree(vol);
@@ -944,6 +1078,186 @@ out:
 }
 
 
+/*
+ * "vol-jobinfo" command
+ */
+static const vshCmdInfo info_vol_jobinfo[] = {
+    {.name = "help",
+     .data = N_("storage vol job information")
+    },
+    {.name = "desc",
+     .data = N_("Returns information about the job allocating, cloning "
+                "or wiping a vol.")
+    },
+    {.name = NULL}
+};
+
+static const vshCmdOptDef opts_vol_jobinfo[] = {
+    {.name = "vol",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("vol name, key or path")
+    },
+    {.name = "pool",
+     .type = VSH_OT_STRING,
+     .help = N_("pool name or uuid")
+    },
+    {.name = NULL}
+};
+
+VIR_ENUM_DECL(vshStorageJob)
+VIR_ENUM_IMPL(vshStorageJob,
+              VIR_STORAGE_JOB_LAST,
+              N_("None"),
+              N_("Build"),
+              N_("Clone"),
+              N_("Wipe"),
+              N_("Pool build"))
+
+VIR_ENUM_DECL(vshStorageJobState)
+VIR_ENUM_IMPL(vshStorageJobState,
+              VIR_STORAGE_JOB_STATE_LAST,
+              N_("Queued"),
+              N_("Running"),
+              N_("Completed"),
+              N_("Failed"),
+              N_("Cancelled"))
+
+static const char *
+vshStorageJobToString(int type)
+{
+    const char *str = vshStorageJobTypeToString(type);
+    return str ? _(str) : _("unknown");
+}
+
+static const char *
+vshStorageJobStateToString(int state)
+{
+    const char *str = vshStorageJobStateTypeToString(state);
+    return str ? _(str) : _("unknown");
+}
+
+static bool
+cmdVolJobinfo(vshControl *ctl, const vshCmd *cmd)
+{
+    virStorageVolPtr vol;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    int type;
+    unsigned int id = 0;
+    int state = 0;
+    unsigned long long value;
+    const char *unit;
+    double val;
+    bool ret = false;
+    int rc;
+
+    if (!(vol = vshCommandOptVol(ctl, cmd, "vol", "pool", NULL)))
+        return false;
+
+    if (virStorageVolGetJobStats(vol, &type, &params, &nparams, 0) < 0)
+        goto cleanup;
+
+    vshPrint(ctl, "%-17s %-12s\n", _("Job type:"),
+             vshStorageJobToString(type));
+    if (type == VIR_STORAGE_JOB_NONE) {
+        ret = true;
+        goto cleanup;
+    }
+
+    if (virTypedParamsGetUInt(params, nparams, VIR_STORAGE_JOB_ID, &id) < 0 ||
+        virTypedParamsGetInt(params, nparams, VIR_STORAGE_JOB_STATE,
+                             &state) < 0)
+        goto cleanup;
+    vshPrint(ctl, "%-17s %-12u\n", _("Job ID:"), id);
+    vshPrint(ctl, "%-17s %-12s\n", _("Job state:"),
+             vshStorageJobStateToString(state));
+
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_STORAGE_JOB_TIME_ELAPSED,
+                                      &value)) < 0)
+        goto cleanup;
+    else if (rc)
+        vshPrint(ctl, "%-17s %-12llu ms\n", _("Time elapsed:"), value);
+
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_STORAGE_JOB_DATA_PROCESSED,
+                                      &value)) < 0) {
+        goto cleanup;
+    } else if (rc) {
+        val = vshPrettyCapacity(value, &unit);
+        vshPrint(ctl, "%-17s %-.3lf %s\n", _("Data processed:"), val, unit);
+    }
+
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_STORAGE_JOB_DATA_REMAINING,
+                                      &value)) < 0) {
+        goto cleanup;
+    } else if (rc) {
+        val = vshPrettyCapacity(value, &unit);
+        vshPrint(ctl, "%-17s %-.3lf %s\n", _("Data remaining:"), val, unit);
+    }
+
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_STORAGE_JOB_DATA_TOTAL,
+                                      &value)) < 0) {
+        goto cleanup;
+    } else if (rc) {
+        val = vshPrettyCapacity(value, &unit);
+        vshPrint(ctl, "%-17s %-.3lf %s\n", _("Data total:"), val, unit);
+    }
+
+    ret = true;
+
+cleanup:
+    virTypedParamsFree(params, nparams);
+    virStorageVolFree(vol);
+    return ret;
+}
+
+/*
+ * "vol-jobabort" command
+ */
+static const vshCmdInfo info_vol_jobabort[] = {
+    {.name = "help",
+     .data = N_("abort active storage vol job")
+    },
+    {.name = "desc",
+     .data = N_("Aborts the job allocating, cloning or wiping a vol.")
+    },
+    {.name = NULL}
+};
+
+static const vshCmdOptDef opts_vol_jobabort[] = {
+    {.name = "vol",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("vol name, key or path")
+    },
+    {.name = "pool",
+     .type = VSH_OT_STRING,
+     .help = N_("pool name or uuid")
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdVolJobabort(vshControl *ctl, const vshCmd *cmd)
+{
+    virStorageVolPtr vol;
+    bool ret = true;
+
+    if (!(vol = vshCommandOptVol(ctl, cmd, "vol", "pool", NULL)))
+        return false;
+
+    if (virStorageVolAbortJob(vol, 0) < 0)
+        ret = false;
+
+    virStorageVolFree(vol);
+    return ret;
+}
+
+
 VIR_ENUM_DECL(vshStorageVol)
 VIR_ENUM_IMPL(vshStorageVol,
               VIR_STORAGE_VOL_LAST,
@@ -1772,6 +2086,18 @@ const vshCmdDef storageVolCmds[] = {
      .info = info_vol_info,
      .flags = 0
     },
+    {.name = "vol-jobabort",
+     .handler = cmdVolJobabort,
+     .opts = opts_vol_jobabort,
+     .info = info_vol_jobabort,
+     .flags = 0
+    },
+    {.name = "vol-jobinfo",
+     .handler = cmdVolJobinfo,
+     .opts = opts_vol_jobinfo,
+     .info = info_vol_jobinfo,
+     .flags = 0
+    },
     {.name = "vol-key",
      .handler = cmdVolKey,
      .opts = opts_vol_key,